@@ -60,6 +60,7 @@ struct packet_provider_data {
   frame_data  *prev_cap;
   frame_data_sequence *frames;       /* Sequence of frames, if we're keeping that information */
   GTree       *frames_user_comments; /* BST with user comments for frames (key = frame_data) */
+  GArray      *frames_shift_offsets; /* time shift offsets for frames (index = frame number - 1) */
 };
 
 typedef struct _capture_file {
@@ -90,6 +91,8 @@ typedef struct _capture_file {
   dfilter_t                  *rfcode;               /* Compiled read filter program */
   dfilter_t                  *dfcode;               /* Compiled display filter program */
   gchar                      *dfilter;              /* Display filter string */
+  gchar                      *applied_dfilter;      /* Display filter all frames were last checked against, if known */
+  GSList                     *dfilter_results;      /* Frames that passed recently applied display filters */
   gboolean                    redissecting;         /* TRUE if currently redissecting (cf_redissect_packets) */
   gboolean                    read_lock;            /* TRUE if currently processing a file (cf_read) */
   rescan_type                 redissection_queued;  /* Queued redissection type. */
@@ -133,6 +136,8 @@ const char *cap_file_provider_get_interface_name(struct packet_provider_data *pr
 const char *cap_file_provider_get_interface_description(struct packet_provider_data *prov, guint32 interface_id);
 const char *cap_file_provider_get_user_comment(struct packet_provider_data *prov, const frame_data *fd);
 void cap_file_provider_set_user_comment(struct packet_provider_data *prov, frame_data *fd, const char *new_comment);
+const nstime_t *cap_file_provider_get_shift_offset(struct packet_provider_data *prov, const frame_data *fd);
+void cap_file_provider_set_shift_offset(struct packet_provider_data *prov, frame_data *fd, const nstime_t *offset);
 
 #ifdef __cplusplus
 }
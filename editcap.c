@@ -173,6 +173,7 @@ static gboolean               dup_detect                = FALSE;
 static gboolean               dup_detect_by_time        = FALSE;
 static gboolean               skip_radiotap             = FALSE;
 static gboolean               discard_all_secrets       = FALSE;
+static wtap_compression_type  out_compression_type      = WTAP_UNCOMPRESSED;
 
 static int                    do_strict_time_adjustment = FALSE;
 static struct time_adjustment strict_time_adj           = {NSTIME_INIT_ZERO, 0}; /* strict time adjustment */
@@ -845,6 +846,8 @@ print_usage(FILE *output)
     fprintf(output, "                         when writing the output file.  Does not discard\n");
     fprintf(output, "                         secrets added by \"--inject-secrets\" in the same\n");
     fprintf(output, "                         command line.\n");
+    fprintf(output, "  --compress <type>      compress the output file(s) with <type>, which is\n");
+    fprintf(output, "                         gzip, zstd or lz4.\n");
     fprintf(output, "\n");
     fprintf(output, "Miscellaneous:\n");
     fprintf(output, "  -h                     display this help and exit.\n");
@@ -992,6 +995,25 @@ failure_message_cont(const char *msg_format, va_list ap)
     fprintf(stderr, "\n");
 }
 
+/*
+ * Get the next record from the input file, reading the file a batch
+ * of records at a time.
+ */
+static gboolean
+read_next_rec(wtap *wth, wtap_batch *batch, guint *batch_index,
+              wtap_rec **rec, Buffer **buf, int *err, gchar **err_info)
+{
+    if (*batch_index >= batch->count) {
+        if (!wtap_read_batch(wth, batch, err, err_info))
+            return FALSE;
+        *batch_index = 0;
+    }
+    *rec = &batch->recs[*batch_index];
+    *buf = &batch->bufs[*batch_index];
+    (*batch_index)++;
+    return TRUE;
+}
+
 static wtap_dumper *
 editcap_dump_open(const char *filename, const wtap_dump_params *params,
                   int *write_err)
@@ -1000,10 +1022,10 @@ editcap_dump_open(const char *filename, const wtap_dump_params *params,
 
     if (strcmp(filename, "-") == 0) {
         /* Write to the standard output. */
-        pdh = wtap_dump_open_stdout(out_file_type_subtype, WTAP_UNCOMPRESSED,
+        pdh = wtap_dump_open_stdout(out_file_type_subtype, out_compression_type,
                                     params, write_err);
     } else {
-        pdh = wtap_dump_open(filename, out_file_type_subtype, WTAP_UNCOMPRESSED,
+        pdh = wtap_dump_open(filename, out_file_type_subtype, out_compression_type,
                              params, write_err);
     }
     return pdh;
@@ -1023,6 +1045,7 @@ main(int argc, char *argv[])
 #define LONGOPT_SEED                 LONGOPT_BASE_APPLICATION+3
 #define LONGOPT_INJECT_SECRETS       LONGOPT_BASE_APPLICATION+4
 #define LONGOPT_DISCARD_ALL_SECRETS  LONGOPT_BASE_APPLICATION+5
+#define LONGOPT_COMPRESS             LONGOPT_BASE_APPLICATION+6
 
     static const struct option long_options[] = {
         {"novlan", no_argument, NULL, LONGOPT_NO_VLAN},
@@ -1030,6 +1053,7 @@ main(int argc, char *argv[])
         {"seed", required_argument, NULL, LONGOPT_SEED},
         {"inject-secrets", required_argument, NULL, LONGOPT_INJECT_SECRETS},
         {"discard-all-secrets", no_argument, NULL, LONGOPT_DISCARD_ALL_SECRETS},
+        {"compress", required_argument, NULL, LONGOPT_COMPRESS},
         {"help", no_argument, NULL, 'h'},
         {"version", no_argument, NULL, 'V'},
         {0, 0, 0, 0 }
@@ -1042,7 +1066,6 @@ main(int argc, char *argv[])
     wtap_dumper  *pdh                = NULL;
     unsigned int  count              = 1;
     unsigned int  duplicate_count    = 0;
-    gint64        data_offset;
     int           err_type;
     guint8       *buf;
     guint32       read_count         = 0;
@@ -1059,8 +1082,10 @@ main(int argc, char *argv[])
     guint         max_packet_number  = 0;
     GArray       *dsb_types          = NULL;
     GPtrArray    *dsb_filenames      = NULL;
-    wtap_rec                     read_rec;
-    Buffer                       read_buf;
+    wtap_batch                  *batch = NULL;
+    guint                        batch_index = 0;
+    wtap_rec                    *read_rec;
+    Buffer                      *read_buf;
     const wtap_rec              *rec;
     wtap_rec                     temp_rec;
     wtap_dump_params             params = WTAP_DUMP_PARAMS_INIT;
@@ -1169,6 +1194,17 @@ main(int argc, char *argv[])
             break;
         }
 
+        case LONGOPT_COMPRESS:
+        {
+            if (!wtap_name_to_compression_type(optarg, &out_compression_type)) {
+                fprintf(stderr, "editcap: \"%s\" isn't a supported compression type\n\n",
+                        optarg);
+                ret = INVALID_OPTION;
+                goto clean_exit;
+            }
+            break;
+        }
+
         case 'a':
         {
             guint frame_number;
@@ -1570,15 +1606,14 @@ main(int argc, char *argv[])
     }
 
     /* Read all of the packets in turn */
-    wtap_rec_init(&read_rec);
-    ws_buffer_init(&read_buf, 1514);
-    while (wtap_read(wth, &read_rec, &read_buf, &read_err, &read_err_info, &data_offset)) {
+    batch = wtap_batch_new(WTAP_BATCH_SIZE);
+    while (read_next_rec(wth, batch, &batch_index, &read_rec, &read_buf, &read_err, &read_err_info)) {
         if (max_packet_number <= read_count)
             break;
 
         read_count++;
 
-        rec = &read_rec;
+        rec = read_rec;
 
         /* Extra actions for the first packet */
         if (read_count == 1) {
@@ -1611,7 +1646,7 @@ main(int argc, char *argv[])
         } /* first packet only handling */
 
 
-        buf = ws_buffer_start_ptr(&read_buf);
+        buf = ws_buffer_start_ptr(read_buf);
 
         /*
          * Not all packets have time stamps. Only process the time
@@ -1710,7 +1745,7 @@ main(int argc, char *argv[])
             /* We simply write it, perhaps after truncating it; we could
              * do other things, like modify it. */
 
-            rec = &read_rec;
+            rec = read_rec;
 
             if (rec->presence_flags & WTAP_HAS_TS) {
                 /* Do we adjust timestamps to ensure strict chronological
@@ -2046,8 +2081,6 @@ main(int argc, char *argv[])
         }
         count++;
     }
-    wtap_rec_cleanup(&read_rec);
-    ws_buffer_free(&read_buf);
 
     g_free(fprefix);
     g_free(fsuffix);
@@ -2105,6 +2138,7 @@ clean_exit:
     }
     g_free(params.idb_inf);
     wtap_dump_params_cleanup(&params);
+    wtap_batch_free(batch);
     if (wth != NULL)
         wtap_close(wth);
     wtap_cleanup();
@@ -30,6 +30,10 @@
 # include <fcntl.h>
 #endif
 
+#ifdef HAVE_MALLOC_TRIM
+#include <malloc.h>
+#endif
+
 #include "wsutil/file_util.h"
 #include "app_mem_usage.h"
 
@@ -196,6 +200,12 @@ memory_usage_gc(void)
 		if (memory_components[i]->gc)
 			memory_components[i]->gc();
 	}
+
+#ifdef HAVE_MALLOC_TRIM
+	/* Give memory that has been freed back to the system, so that it
+	 * no longer counts toward our RSS. */
+	malloc_trim(0);
+#endif
 }
 
 
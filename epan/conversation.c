@@ -43,24 +43,77 @@ struct conversation_key {
 };
 
 /*
- * Hash table for conversations with no wildcards.
+ * Which of address 2 and port 2 are wildcarded in a conversation key.
+ * All conversations are kept in a single index, and this is part of
+ * the key, so that, for example, a conversation with a wildcarded port 2
+ * is only found by lookups that wildcard port 2.
  */
-static wmem_map_t *conversation_hashtable_exact = NULL;
+#define CONV_KIND_EXACT			0x00
+#define CONV_KIND_NO_ADDR2		0x01
+#define CONV_KIND_NO_PORT2		0x02
+#define CONV_KIND_NO_ADDR2_OR_PORT2	(CONV_KIND_NO_ADDR2|CONV_KIND_NO_PORT2)
 
 /*
- * Hash table for conversations with one wildcard address.
+ * Longest address stored in the index itself; enough for IPv4, IPv6
+ * and MAC addresses.
  */
-static wmem_map_t *conversation_hashtable_no_addr2 = NULL;
+#define CONV_INDEX_ADDR_LEN	16
 
 /*
- * Hash table for conversations with one wildcard port.
+ * A compact copy of a conversation key, stored in the index so that
+ * probing it doesn't require following a pointer to the conversation.
+ *
+ * Wildcarded fields and unused address bytes are zero, so that keys can
+ * be compared with memcmp().  If an address is longer than
+ * CONV_INDEX_ADDR_LEN, or its type or the endpoint type doesn't fit in a
+ * byte, the addresses aren't copied, "inline_addrs" is FALSE, and the
+ * addresses and endpoint type are compared with those in the key of the
+ * first conversation in the slot.
+ */
+typedef struct {
+	guint32	hash;
+	guint32	port1;
+	guint32	port2;
+	guint8	etype;
+	guint8	kind;
+	guint8	inline_addrs;
+	guint8	addr1_type;
+	guint8	addr1_len;
+	guint8	addr2_type;
+	guint8	addr2_len;
+	guint8	unused;
+	guint8	addr1[CONV_INDEX_ADDR_LEN];
+	guint8	addr2[CONV_INDEX_ADDR_LEN];
+} conv_index_key_t;
+
+/*
+ * A slot in the conversation index.
+ *
+ * Several conversations can have the same key, if they were set up in
+ * different frames, e.g. when a TCP connection reuses the ports of an
+ * earlier one; all of them are in the same slot, sorted by setup frame,
+ * so that the one for a given frame can be found with a binary search.
+ * There's usually only one, in which case it's stored directly.
  */
-static wmem_map_t *conversation_hashtable_no_port2 = NULL;
+typedef struct {
+	conv_index_key_t key;
+	guint32	count;		/* number of conversations; 0 if the slot is empty */
+	union {
+		conversation_t *conv;	/* if count is 1 */
+		conversation_t **convs;	/* if count is more than 1 */
+	} u;
+} conv_index_slot_t;
 
 /*
- * Hash table for conversations with one wildcard address and port.
+ * The conversation index, an open-addressing hash table with linear
+ * probing.  It's allocated in file scope, and doubled in size when it
+ * becomes three-quarters full.
  */
-static wmem_map_t *conversation_hashtable_no_addr2_or_port2 = NULL;
+#define CONV_INDEX_INITIAL_SIZE	1024	/* must be a power of 2 */
+
+static conv_index_slot_t *conv_index_table = NULL;
+static guint32 conv_index_size = 0;	/* number of slots */
+static guint32 conv_index_used = 0;	/* number of non-empty slots */
 
 
 static guint32 new_index;
@@ -202,401 +255,303 @@ conversation_hash_exact(gconstpointer v)
 }
 
 /*
- * Compare two conversation keys for an exact match.
+ * The index is allocated in file scope, so forget about it when that's
+ * freed.
  */
-static gint
-conversation_match_exact(gconstpointer v, gconstpointer w)
+static gboolean
+conv_index_reset_cb(wmem_allocator_t *allocator _U_, wmem_cb_event_t event _U_,
+    void *user_data _U_)
 {
-	const conversation_key_t v1 = (const conversation_key_t)v;
-	const conversation_key_t v2 = (const conversation_key_t)w;
-
-	if (v1->etype != v2->etype)
-		return 0;	/* different types of port */
-
-	/*
-	 * Are the first and second port 1 values the same, the first and
-	 * second port 2 values the same, the first and second address
-	 * 1 values the same, and the first and second address 2 values
-	 * the same?
-	 */
-	if (v1->port1 == v2->port1 &&
-	    v1->port2 == v2->port2 &&
-	    addresses_equal(&v1->addr1, &v2->addr1) &&
-	    addresses_equal(&v1->addr2, &v2->addr2)) {
-		/*
-		 * Yes.  It's the same conversation, and the two
-		 * address/port pairs are going in the same direction.
-		 */
-		return 1;
-	}
-
-	/*
-	 * Is the first port 2 the same as the second port 1, the first
-	 * port 1 the same as the second port 2, the first address 2
-	 * the same as the second address 1, and the first address 1
-	 * the same as the second address 2?
-	 */
-	if (v1->port2 == v2->port1 &&
-	    v1->port1 == v2->port2 &&
-	    addresses_equal(&v1->addr2, &v2->addr1) &&
-	    addresses_equal(&v1->addr1, &v2->addr2)) {
-		/*
-		 * Yes.  It's the same conversation, and the two
-		 * address/port pairs are going in opposite directions.
-		 */
-		return 1;
-	}
+	conv_index_table = NULL;
+	conv_index_size = 0;
+	conv_index_used = 0;
 
-	/*
-	 * The addresses or the ports don't match.
-	 */
-	return 0;
+	return TRUE;
 }
 
-/*
- * Compute the hash value for two given address/port pairs if the match
- * has a wildcard address 2.
+/**
+ * Create the index for conversations.
  */
-static guint
-conversation_hash_no_addr2(gconstpointer v)
+void
+conversation_init(void)
 {
-	const conversation_key_t key = (const conversation_key_t)v;
-	guint hash_val;
-	address tmp_addr;
-
-	hash_val = 0;
-	tmp_addr.len  = 4;
-
-	hash_val = add_address_to_hash(hash_val, &key->addr1);
-
-	tmp_addr.data = &key->port1;
-	hash_val = add_address_to_hash(hash_val, &tmp_addr);
-
-	tmp_addr.data = &key->port2;
-	hash_val = add_address_to_hash(hash_val, &tmp_addr);
-
-	hash_val += ( hash_val << 3 );
-	hash_val ^= ( hash_val >> 11 );
-	hash_val += ( hash_val << 15 );
-
-	return hash_val;
+	wmem_register_callback(wmem_file_scope(), conv_index_reset_cb, NULL);
 }
 
-/*
- * Compare two conversation keys, except for the address 2 value.
- * We don't check both directions of the conversation - the routine
- * doing the hash lookup has to do two searches, as the hash key
- * will be different for the two directions.
+/**
+ * Initialize some variables every time a file is loaded or re-loaded.
  */
-static gint
-conversation_match_no_addr2(gconstpointer v, gconstpointer w)
+void conversation_epan_reset(void)
 {
-	const conversation_key_t v1 = (const conversation_key_t)v;
-	const conversation_key_t v2 = (const conversation_key_t)w;
-
-	if (v1->etype != v2->etype)
-		return 0;	/* different types of port */
-
 	/*
-	 * Are the first and second port 1 values the same, the first and
-	 * second port 2 valuess the same, and the first and second
-	 * address 1 values the same?
-	 */
-	if (v1->port1 == v2->port1 &&
-	    v1->port2 == v2->port2 &&
-	    addresses_equal(&v1->addr1, &v2->addr1)) {
-		/*
-		 * Yes.  It's the same conversation, and the two
-		 * address/port pairs are going in the same direction.
-		 */
-		return 1;
-	}
-
-	/*
-	 * The addresses or the ports don't match.
+	 * Start the conversation indices over at 0.
 	 */
-	return 0;
+	new_index = 0;
 }
 
 /*
- * Compute the hash value for two given address/port pairs if the match
- * has a wildcard port 2.
+ * Return the kind of key, for the index, of a conversation with the
+ * given options.
  */
 static guint
-conversation_hash_no_port2(gconstpointer v)
+conv_index_kind(const guint options)
 {
-	const conversation_key_t key = (const conversation_key_t)v;
-	guint hash_val;
-	address tmp_addr;
-
-	hash_val = 0;
-	tmp_addr.len  = 4;
-
-	hash_val = add_address_to_hash(hash_val, &key->addr1);
-
-	tmp_addr.data = &key->port1;
-	hash_val = add_address_to_hash(hash_val, &tmp_addr);
-
-	hash_val = add_address_to_hash(hash_val, &key->addr2);
-
-	hash_val += ( hash_val << 3 );
-	hash_val ^= ( hash_val >> 11 );
-	hash_val += ( hash_val << 15 );
+	guint kind = CONV_KIND_EXACT;
 
-	return hash_val;
+	if (options & NO_ADDR2)
+		kind |= CONV_KIND_NO_ADDR2;
+	if (options & (NO_PORT2|NO_PORT2_FORCE))
+		kind |= CONV_KIND_NO_PORT2;
+	return kind;
 }
 
-/*
- * Compare two conversation keys, except for the port 2 value.
- * We don't check both directions of the conversation - the routine
- * doing the hash lookup has to do two searches, as the hash key
- * will be different for the two directions.
- */
-static gint
-conversation_match_no_port2(gconstpointer v, gconstpointer w)
+static inline gboolean
+conv_index_addr_fits(const address *addr)
 {
-	const conversation_key_t v1 = (const conversation_key_t)v;
-	const conversation_key_t v2 = (const conversation_key_t)w;
-
-	if (v1->etype != v2->etype)
-		return 0;	/* different types of port */
-
-	/*
-	 * Are the first and second port 1 values the same, the first and
-	 * second address 1 values the same, and the first and second
-	 * address 2 values the same?
-	 */
-	if (v1->port1 == v2->port1 &&
-	    addresses_equal(&v1->addr1, &v2->addr1) &&
-	    addresses_equal(&v1->addr2, &v2->addr2)) {
-		/*
-		 * Yes.  It's the same conversation, and the two
-		 * address/port pairs are going in the same direction.
-		 */
-		return 1;
-	}
-
-	/*
-	 * The addresses or the ports don't match.
-	 */
-	return 0;
+	return (guint)addr->type <= G_MAXUINT8 &&
+	    addr->len >= 0 && addr->len <= CONV_INDEX_ADDR_LEN;
 }
 
 /*
- * Compute the hash value for two given address/port pairs if the match
- * has a wildcard address 2 and port 2.
+ * Fill in an index key, including its hash, from a conversation key of
+ * the given kind.  A NULL address is treated as an AT_NONE address.
  */
-static guint
-conversation_hash_no_addr2_or_port2(gconstpointer v)
+static void
+conv_index_key_init(conv_index_key_t *key, const guint kind, const endpoint_type etype,
+    const address *addr1, const address *addr2, const guint32 port1, const guint32 port2)
 {
-	const conversation_key_t key = (const conversation_key_t)v;
-	guint hash_val;
 	address tmp_addr;
+	guint hash_val;
 
-	hash_val = 0;
-	tmp_addr.len  = 4;
-
-	hash_val = add_address_to_hash(hash_val, &key->addr1);
+	if (addr1 == NULL)
+		addr1 = &null_address_;
+	if (addr2 == NULL || (kind & CONV_KIND_NO_ADDR2))
+		addr2 = &null_address_;
+
+	memset(key, 0, sizeof *key);
+	key->port1 = port1;
+	if (!(kind & CONV_KIND_NO_PORT2))
+		key->port2 = port2;
+	key->etype = (guint8)etype;
+	key->kind = (guint8)kind;
+	if ((guint)etype <= G_MAXUINT8 && conv_index_addr_fits(addr1) &&
+	    conv_index_addr_fits(addr2)) {
+		key->inline_addrs = TRUE;
+		key->addr1_type = (guint8)addr1->type;
+		key->addr1_len = (guint8)addr1->len;
+		if (addr1->len != 0)
+			memcpy(key->addr1, addr1->data, addr1->len);
+		key->addr2_type = (guint8)addr2->type;
+		key->addr2_len = (guint8)addr2->len;
+		if (addr2->len != 0)
+			memcpy(key->addr2, addr2->data, addr2->len);
+	}
 
-	tmp_addr.data = &key->port1;
-	hash_val = add_address_to_hash(hash_val, &tmp_addr);
+	/*
+	 * Hash the fixed-length part of the key, and then the addresses;
+	 * the latter are hashed from the originals so that the hash is
+	 * the same whether they're copied into the key or not.
+	 */
+	set_address(&tmp_addr, AT_NONE,
+	    (int)offsetof(conv_index_key_t, addr1) - (int)offsetof(conv_index_key_t, port1),
+	    &key->port1);
+	hash_val = add_address_to_hash(0, &tmp_addr);
+	hash_val = add_address_to_hash(hash_val, addr1);
+	hash_val = add_address_to_hash(hash_val, addr2);
 
 	hash_val += ( hash_val << 3 );
 	hash_val ^= ( hash_val >> 11 );
 	hash_val += ( hash_val << 15 );
 
-	return hash_val;
+	key->hash = hash_val;
+}
+
+static inline conversation_t *
+conv_index_slot_first(const conv_index_slot_t *slot)
+{
+	return slot->count == 1 ? slot->u.conv : slot->u.convs[0];
 }
 
 /*
- * Compare the address 1 and port 1 in the two conversation keys.
- * We don't check both directions of the conversation - the routine
- * doing the hash lookup has to do two searches, as the hash key
- * will be different for the two directions.
+ * Find the slot with the given key, or return NULL if there isn't one.
+ * The endpoint type and addresses are only used if the key doesn't
+ * include the addresses.
  */
-static gint
-conversation_match_no_addr2_or_port2(gconstpointer v, gconstpointer w)
+static conv_index_slot_t *
+conv_index_find(const conv_index_key_t *key, const endpoint_type etype,
+    const address *addr1, const address *addr2)
 {
-	const conversation_key_t v1 = (const conversation_key_t)v;
-	const conversation_key_t v2 = (const conversation_key_t)w;
+	conv_index_slot_t *slot;
+	conversation_key_t conv_key;
+	guint32 mask, i;
 
-	if (v1->etype != v2->etype)
-		return 0;	/* different types of port */
+	if (conv_index_table == NULL)
+		return NULL;
 
-	/*
-	 * Are the first and second port 1 values the same and the first
-	 * and second address 1 values the same?
-	 */
-	if (v1->port1 == v2->port1 &&
-	    addresses_equal(&v1->addr1, &v2->addr1)) {
-		/*
-		 * Yes.  It's the same conversation, and the two
-		 * address/port pairs are going in the same direction.
-		 */
-		return 1;
+	mask = conv_index_size - 1;
+	for (i = key->hash & mask; ; i = (i + 1) & mask) {
+		slot = &conv_index_table[i];
+		if (slot->count == 0)
+			return NULL;
+		if (memcmp(&slot->key, key, sizeof *key) != 0)
+			continue;
+		if (key->inline_addrs)
+			return slot;
+
+		conv_key = conv_index_slot_first(slot)->key_ptr;
+		if (conv_key->etype == etype &&
+		    addresses_equal(&conv_key->addr1, addr1 ? addr1 : &null_address_) &&
+		    ((key->kind & CONV_KIND_NO_ADDR2) ||
+		     addresses_equal(&conv_key->addr2, addr2 ? addr2 : &null_address_)))
+			return slot;
 	}
-
-	/*
-	 * The addresses or the ports don't match.
-	 */
-	return 0;
 }
 
-/**
- * Create a new hash tables for conversations.
+/*
+ * Double the size of the index, or create it if it doesn't exist.
  */
-void
-conversation_init(void)
+static void
+conv_index_grow(void)
 {
-	/*
-	 * Free up any space allocated for conversation protocol data
-	 * areas.
-	 *
-	 * We can free the space, as the structures it contains are
-	 * pointed to by conversation data structures that were freed
-	 * above.
-	 */
-	conversation_hashtable_exact =
-	    wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_exact,
-	      conversation_match_exact);
-	conversation_hashtable_no_addr2 =
-	    wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_no_addr2,
-	      conversation_match_no_addr2);
-	conversation_hashtable_no_port2 =
-	    wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_no_port2,
-	      conversation_match_no_port2);
-	conversation_hashtable_no_addr2_or_port2 =
-	    wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_no_addr2_or_port2,
-	      conversation_match_no_addr2_or_port2);
-
+	conv_index_slot_t *old_index = conv_index_table;
+	guint32 old_size = conv_index_size;
+	guint32 mask, i, j;
+
+	conv_index_size = old_size ? old_size * 2 : CONV_INDEX_INITIAL_SIZE;
+	conv_index_table = wmem_alloc0_array(wmem_file_scope(), conv_index_slot_t, conv_index_size);
+
+	mask = conv_index_size - 1;
+	for (i = 0; i < old_size; i++) {
+		if (old_index[i].count == 0)
+			continue;
+		for (j = old_index[i].key.hash & mask; conv_index_table[j].count != 0; j = (j + 1) & mask)
+			;
+		conv_index_table[j] = old_index[i];
+	}
+	wmem_free(wmem_file_scope(), old_index);
 }
 
-/**
- * Initialize some variables every time a file is loaded or re-loaded.
+/*
+ * Empty a slot, moving back any entries after it that would no longer
+ * be reachable from their home slot, so that no tombstones are needed.
  */
-void conversation_epan_reset(void)
+static void
+conv_index_remove_slot(conv_index_slot_t *slot)
 {
-	/*
-	 * Start the conversation indices over at 0.
-	 */
-	new_index = 0;
+	guint32 mask = conv_index_size - 1;
+	guint32 i = (guint32)(slot - conv_index_table);
+	guint32 j, home;
+
+	for (j = (i + 1) & mask; conv_index_table[j].count != 0; j = (j + 1) & mask) {
+		home = conv_index_table[j].key.hash & mask;
+		/* Is the hole at i between the entry's home slot and j? */
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			conv_index_table[i] = conv_index_table[j];
+			i = j;
+		}
+	}
+	memset(&conv_index_table[i], 0, sizeof conv_index_table[i]);
+	conv_index_used--;
 }
 
 /*
- * Does the right thing when inserting into one of the conversation hash tables,
- * taking into account ordering and hash chains and all that good stuff.
- *
- * Mostly adapted from the old conversation_new().
+ * Add a conversation to the index.
  */
 static void
-conversation_insert_into_hashtable(wmem_map_t *hashtable, conversation_t *conv)
+conversation_insert_into_index(conversation_t *conv)
 {
-	conversation_t *chain_head, *chain_tail, *cur, *prev;
+	conversation_key_t conv_key = conv->key_ptr;
+	conv_index_key_t key;
+	conv_index_slot_t *slot;
+	conversation_t **convs;
+	guint32 mask, i;
+
+	conv_index_key_init(&key, conv_index_kind(conv->options), conv_key->etype,
+	    &conv_key->addr1, &conv_key->addr2, conv_key->port1, conv_key->port2);
+	slot = conv_index_find(&key, conv_key->etype, &conv_key->addr1, &conv_key->addr2);
+
+	if (slot == NULL) {
+		/* New key */
+		if ((conv_index_used + 1) > conv_index_size / 4 * 3)
+			conv_index_grow();
+		mask = conv_index_size - 1;
+		for (i = key.hash & mask; conv_index_table[i].count != 0; i = (i + 1) & mask)
+			;
+		slot = &conv_index_table[i];
+		memcpy(&slot->key, &key, sizeof key);
+		slot->count = 1;
+		slot->u.conv = conv;
+		conv_index_used++;
+		DPRINT(("created a new conversation index entry"));
+		return;
+	}
 
-	chain_head = (conversation_t *)wmem_map_lookup(hashtable, conv->key_ptr);
+	DPRINT(("there's an existing conversation index entry"));
 
-	if (NULL==chain_head) {
-		/* New entry */
-		conv->next = NULL;
-		conv->last = conv;
-		wmem_map_insert(hashtable, conv->key_ptr, conv);
-		DPRINT(("created a new conversation chain"));
-	}
-	else {
-		/* There's an existing chain for this key */
-		DPRINT(("there's an existing conversation chain"));
-
-		chain_tail = chain_head->last;
-
-		if (conv->setup_frame >= chain_tail->setup_frame) {
-			/* This convo belongs at the end of the chain */
-			conv->next = NULL;
-			conv->last = NULL;
-			chain_tail->next = conv;
-			chain_head->last = conv;
-		}
-		else {
-			/* Loop through the chain to find the right spot */
-			cur = chain_head;
-			prev = NULL;
-
-			for (; (conv->setup_frame > cur->setup_frame) && cur->next; prev=cur, cur=cur->next)
-				;
-
-			if (NULL==prev) {
-				/* Changing the head of the chain */
-				conv->next = chain_head;
-				conv->last = chain_tail;
-				chain_head->last = NULL;
-				wmem_map_insert(hashtable, conv->key_ptr, conv);
-			}
-			else {
-				/* Inserting into the middle of the chain */
-				conv->next = cur;
-				conv->last = NULL;
-				prev->next = conv;
-			}
-		}
+	/*
+	 * The array of conversations is allocated in powers of 2, so it's
+	 * full if the count is a power of 2.
+	 */
+	if (slot->count == 1) {
+		convs = wmem_alloc_array(wmem_file_scope(), conversation_t *, 2);
+		convs[0] = slot->u.conv;
+		slot->u.convs = convs;
+	} else if ((slot->count & (slot->count - 1)) == 0) {
+		slot->u.convs = (conversation_t **)wmem_realloc(wmem_file_scope(),
+		    slot->u.convs, 2 * slot->count * sizeof (conversation_t *));
 	}
+
+	/*
+	 * Keep the array sorted by setup frame, with conversations set
+	 * up in the same frame in the order in which they were created.
+	 * Conversations are almost always created in frame order, so
+	 * search from the end.
+	 */
+	convs = slot->u.convs;
+	for (i = slot->count; i > 0 && convs[i - 1]->setup_frame > conv->setup_frame; i--)
+		convs[i] = convs[i - 1];
+	convs[i] = conv;
+	slot->count++;
 }
 
 /*
- * Does the right thing when removing from one of the conversation hash tables,
- * taking into account ordering and hash chains and all that good stuff.
+ * Remove a conversation from the index.
  */
 static void
-conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
+conversation_remove_from_index(conversation_t *conv)
 {
-	conversation_t *chain_head, *cur, *prev;
-
-	chain_head = (conversation_t *)wmem_map_lookup(hashtable, conv->key_ptr);
-
-	if (conv == chain_head) {
-		/* We are currently the front of the chain */
-		if (NULL == conv->next) {
-			/* We are the only conversation in the chain, no need to
-			 * update next pointer, but do not call
-			 * wmem_map_remove() either because the conv data
-			 * will be re-inserted. */
-			wmem_map_steal(hashtable, conv->key_ptr);
-		}
-		else {
-			/* Update the head of the chain */
-			chain_head = conv->next;
-			chain_head->last = conv->last;
-
-			if (conv->latest_found == conv)
-				chain_head->latest_found = NULL;
-			else
-				chain_head->latest_found = conv->latest_found;
-
-			wmem_map_insert(hashtable, chain_head->key_ptr, chain_head);
-		}
+	conversation_key_t conv_key = conv->key_ptr;
+	conv_index_key_t key;
+	conv_index_slot_t *slot;
+	conversation_t **convs;
+	guint32 i;
+
+	conv_index_key_init(&key, conv_index_kind(conv->options), conv_key->etype,
+	    &conv_key->addr1, &conv_key->addr2, conv_key->port1, conv_key->port2);
+	slot = conv_index_find(&key, conv_key->etype, &conv_key->addr1, &conv_key->addr2);
+	if (slot == NULL) {
+		/* XXX: Conversation not found. */
+		return;
 	}
-	else {
-		/* We are not the front of the chain. Loop through to find us.
-		 * Start loop at chain_head->next rather than chain_head because
-		 * we already know we're not at the head. */
-		cur = chain_head->next;
-		prev = chain_head;
-
-		for (; (cur != conv) && cur->next; prev=cur, cur=cur->next)
-			;
-
-		if (cur != conv) {
-			/* XXX: Conversation not found. Wrong hashtable? */
-			return;
-		}
 
-		prev->next = conv->next;
-
-		if (NULL == conv->next) {
-			/* We're at the very end of the list. */
-			chain_head->last = prev;
-		}
+	if (slot->count == 1) {
+		if (slot->u.conv == conv)
+			conv_index_remove_slot(slot);
+		return;
+	}
 
-		if (chain_head->latest_found == conv)
-			chain_head->latest_found = prev;
+	convs = slot->u.convs;
+	for (i = 0; i < slot->count && convs[i] != conv; i++)
+		;
+	if (i == slot->count) {
+		/* XXX: Conversation not found. */
+		return;
+	}
+	memmove(&convs[i], &convs[i + 1], (slot->count - i - 1) * sizeof (conversation_t *));
+	slot->count--;
+	if (slot->count == 1) {
+		slot->u.conv = convs[0];
+		wmem_free(wmem_file_scope(), convs);
 	}
 }
 
@@ -616,7 +571,6 @@ conversation_new(const guint32 setup_frame, const address *addr1, const address
 	DISSECTOR_ASSERT(!(options | CONVERSATION_TEMPLATE) || ((options | (NO_ADDR2 | NO_PORT2 | NO_PORT2_FORCE))) &&
 				"A conversation template may not be constructed without wildcard options");
 */
-	wmem_map_t* hashtable;
 	conversation_t *conversation=NULL;
 	conversation_key_t new_key;
 
@@ -709,20 +663,6 @@ conversation_new(const guint32 setup_frame, const address *addr1, const address
 	}
 #endif
 
-	if (options & NO_ADDR2) {
-		if (options & (NO_PORT2|NO_PORT2_FORCE)) {
-			hashtable = conversation_hashtable_no_addr2_or_port2;
-		} else {
-			hashtable = conversation_hashtable_no_addr2;
-		}
-	} else {
-		if (options & (NO_PORT2|NO_PORT2_FORCE)) {
-			hashtable = conversation_hashtable_no_port2;
-		} else {
-			hashtable = conversation_hashtable_exact;
-		}
-	}
-
 	new_key = wmem_new(wmem_file_scope(), struct conversation_key);
 	if (addr1 != NULL) {
 		copy_address_wmem(wmem_file_scope(), &new_key->addr1, addr1);
@@ -754,7 +694,7 @@ conversation_new(const guint32 setup_frame, const address *addr1, const address
 	new_index++;
 
 	DINDENT();
-	conversation_insert_into_hashtable(hashtable, conversation);
+	conversation_insert_into_index(conversation);
 	DENDENT();
 
 	return conversation;
@@ -785,18 +725,10 @@ conversation_set_port2(conversation_t *conv, const guint32 port)
 		return;
 
 	DINDENT();
-	if (conv->options & NO_ADDR2) {
-		conversation_remove_from_hashtable(conversation_hashtable_no_addr2_or_port2, conv);
-	} else {
-		conversation_remove_from_hashtable(conversation_hashtable_no_port2, conv);
-	}
+	conversation_remove_from_index(conv);
 	conv->options &= ~NO_PORT2;
 	conv->key_ptr->port2  = port;
-	if (conv->options & NO_ADDR2) {
-		conversation_insert_into_hashtable(conversation_hashtable_no_addr2, conv);
-	} else {
-		conversation_insert_into_hashtable(conversation_hashtable_exact, conv);
-	}
+	conversation_insert_into_index(conv);
 	DENDENT();
 }
 
@@ -822,74 +754,166 @@ conversation_set_addr2(conversation_t *conv, const address *addr)
 		return;
 
 	DINDENT();
-	if (conv->options & NO_PORT2) {
-		conversation_remove_from_hashtable(conversation_hashtable_no_addr2_or_port2, conv);
-	} else {
-		conversation_remove_from_hashtable(conversation_hashtable_no_port2, conv);
-	}
+	conversation_remove_from_index(conv);
 	conv->options &= ~NO_ADDR2;
 	copy_address_wmem(wmem_file_scope(), &conv->key_ptr->addr2, addr);
-	if (conv->options & NO_PORT2) {
-		conversation_insert_into_hashtable(conversation_hashtable_no_port2, conv);
-	} else {
-		conversation_insert_into_hashtable(conversation_hashtable_exact, conv);
-	}
+	conversation_insert_into_index(conv);
 	DENDENT();
 }
 
 /*
- * Search a particular hash table for a conversation with the specified
- * {addr1, port1, addr2, port2} and set up before frame_num.
+ * Functions to free conversation data when a conversation is retired,
+ * keyed by protocol ID.
  */
-static conversation_t *
-conversation_lookup_hashtable(wmem_map_t *hashtable, const guint32 frame_num, const address *addr1, const address *addr2,
-    const endpoint_type etype, const guint32 port1, const guint32 port2)
+typedef struct {
+	conversation_proto_data_retire_func retire_func;
+} proto_data_retire_t;
+
+static GHashTable *proto_data_retire_funcs = NULL;
+
+void
+conversation_register_proto_data_retire(const int proto,
+    conversation_proto_data_retire_func retire_func)
 {
-	conversation_t* convo=NULL;
-	conversation_t* match=NULL;
-	conversation_t* chain_head=NULL;
-	struct conversation_key key;
+	proto_data_retire_t *retire;
 
-	/*
-	 * We don't make a copy of the address data, we just copy the
-	 * pointer to it, as "key" disappears when we return.
-	 */
-	if (addr1 != NULL) {
-		key.addr1 = *addr1;
-	} else {
-		clear_address(&key.addr1);
-	}
-	if (addr2 != NULL) {
-		key.addr2 = *addr2;
-	} else {
-		clear_address(&key.addr2);
-	}
-	key.etype = etype;
-	key.port1 = port1;
-	key.port2 = port2;
+	if (proto_data_retire_funcs == NULL)
+		proto_data_retire_funcs = g_hash_table_new_full(g_direct_hash,
+		    g_direct_equal, NULL, g_free);
+
+	retire = g_new(proto_data_retire_t, 1);
+	retire->retire_func = retire_func;
+	g_hash_table_insert(proto_data_retire_funcs, GINT_TO_POINTER(proto), retire);
+}
+
+static gboolean
+retire_proto_data(const void *key, void *value, void *userdata _U_)
+{
+	proto_data_retire_t *retire;
 
-	chain_head = (conversation_t *)wmem_map_lookup(hashtable, &key);
+	retire = (proto_data_retire_t *)g_hash_table_lookup(proto_data_retire_funcs, key);
+	if (retire != NULL && value != NULL)
+		retire->retire_func(value);
+	return FALSE;
+}
 
-	if (chain_head && (chain_head->setup_frame <= frame_num)) {
-		match = chain_head;
+/*
+ * Free the protocol data of a conversation that's no longer in the index.
+ * The dissector tree may be shared with the template the conversation was
+ * created from, so it's left alone.
+ */
+static void
+conversation_retire(conversation_t *conv)
+{
+	if (conv->data_list == NULL)
+		return;
 
-		if ((chain_head->last)&&(chain_head->last->setup_frame<=frame_num))
-			return chain_head->last;
+	if (proto_data_retire_funcs != NULL)
+		wmem_tree_foreach(conv->data_list, retire_proto_data, NULL);
+	wmem_tree_destroy(conv->data_list, FALSE, FALSE);
+	conv->data_list = NULL;
+}
 
-		if ((chain_head->latest_found)&&(chain_head->latest_found->setup_frame<=frame_num))
-			match = chain_head->latest_found;
+/*
+ * Remove from the index all conversations in which no packet has been
+ * seen since before the given frame, and free their protocol data.
+ */
+void
+conversation_retire_idle(const guint32 before_frame)
+{
+	conv_index_slot_t *slot;
+	conversation_t **convs;
+	guint32 i, j, kept;
+
+	i = 0;
+	while (i < conv_index_size) {
+		slot = &conv_index_table[i];
+		if (slot->count == 0) {
+			i++;
+			continue;
+		}
 
-		for (convo = match; convo && convo->setup_frame <= frame_num; convo = convo->next) {
-			if (convo->setup_frame > match->setup_frame) {
-				match = convo;
+		if (slot->count == 1) {
+			kept = (slot->u.conv->last_frame >= before_frame) ? 1 : 0;
+			if (kept == 0)
+				conversation_retire(slot->u.conv);
+		} else {
+			convs = slot->u.convs;
+			kept = 0;
+			for (j = 0; j < slot->count; j++) {
+				if (convs[j]->last_frame >= before_frame)
+					convs[kept++] = convs[j];
+				else
+					conversation_retire(convs[j]);
+			}
+			if (kept == 1) {
+				slot->u.conv = convs[0];
+				wmem_free(wmem_file_scope(), convs);
+			} else if (kept == 0) {
+				wmem_free(wmem_file_scope(), convs);
 			}
+			/*
+			 * The array is allocated in powers of 2 bigger
+			 * than the count, and it's not shrunk, so it's
+			 * still big enough.
+			 */
+		}
+
+		if (kept == 0) {
+			/*
+			 * Emptying the slot may move a later entry into
+			 * it, so look at it again.
+			 */
+			conv_index_remove_slot(slot);
+		} else {
+			slot->count = kept;
+			i++;
 		}
 	}
+}
 
-	if (match)
-		chain_head->latest_found = match;
+/*
+ * Search the index for a conversation of the given kind with the
+ * specified {addr1, port1, addr2, port2} and set up before frame_num.
+ */
+static conversation_t *
+conversation_lookup_index(const guint kind, const guint32 frame_num, const address *addr1, const address *addr2,
+    const endpoint_type etype, const guint32 port1, const guint32 port2)
+{
+	conv_index_key_t key;
+	conv_index_slot_t *slot;
+	conversation_t **convs;
+	guint32 lo, hi, mid;
+
+	conv_index_key_init(&key, kind, etype, addr1, addr2, port1, port2);
+	slot = conv_index_find(&key, etype, addr1, addr2);
+	if (slot == NULL)
+		return NULL;
 
-	return match;
+	if (slot->count == 1)
+		return (slot->u.conv->setup_frame <= frame_num) ? slot->u.conv : NULL;
+
+	/*
+	 * Most lookups are for the most recently set up conversation.
+	 */
+	convs = slot->u.convs;
+	if (convs[slot->count - 1]->setup_frame <= frame_num)
+		return convs[slot->count - 1];
+
+	/*
+	 * Find the first conversation set up after frame_num; the one
+	 * before it, if any, is the one we want.
+	 */
+	lo = 0;
+	hi = slot->count - 1;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (convs[mid]->setup_frame <= frame_num)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo > 0) ? convs[lo - 1] : NULL;
 }
 
 
@@ -948,7 +972,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 		DPRINT(("trying exact match: %s:%d -> %s:%d",
 		    addr_a_str, port_a, addr_b_str, port_b));
 		conversation =
-		    conversation_lookup_hashtable(conversation_hashtable_exact,
+		    conversation_lookup_index(CONV_KIND_EXACT,
 			frame_num, addr_a, addr_b, etype,
 			port_a, port_b);
 		/* Didn't work, try the other direction */
@@ -956,7 +980,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			DPRINT(("trying exact match: %s:%d -> %s:%d",
 			    addr_b_str, port_b, addr_a_str, port_a));
 			conversation =
-			    conversation_lookup_hashtable(conversation_hashtable_exact,
+			    conversation_lookup_index(CONV_KIND_EXACT,
 				frame_num, addr_b, addr_a, etype,
 				port_b, port_a);
 		}
@@ -967,7 +991,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			DPRINT(("trying exact match: %s:%d -> %s:%d",
 			    addr_b_str, port_a, addr_a_str, port_b));
 			conversation =
-			    conversation_lookup_hashtable(conversation_hashtable_exact,
+			    conversation_lookup_index(CONV_KIND_EXACT,
 				frame_num, addr_b, addr_a, etype,
 				port_a, port_b);
 		}
@@ -993,7 +1017,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 		DPRINT(("trying wildcarded match: %s:%d -> *:%d",
 		    addr_a_str, port_a, port_b));
 		conversation =
-		    conversation_lookup_hashtable(conversation_hashtable_no_addr2,
+		    conversation_lookup_index(CONV_KIND_NO_ADDR2,
 			frame_num, addr_a, addr_b, etype, port_a, port_b);
 		if ((conversation == NULL) && (addr_a->type == AT_FC)) {
 			/* In Fibre channel, OXID & RXID are never swapped as
@@ -1002,7 +1026,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			DPRINT(("trying wildcarded match: %s:%d -> *:%d",
 			    addr_b_str, port_a, port_b));
 			conversation =
-			    conversation_lookup_hashtable(conversation_hashtable_no_addr2,
+			    conversation_lookup_index(CONV_KIND_NO_ADDR2,
 				frame_num, addr_b, addr_a, etype,
 				port_a, port_b);
 		}
@@ -1048,7 +1072,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			DPRINT(("trying wildcarded match: %s:%d -> *:%d",
 			    addr_b_str, port_b, port_a));
 			conversation =
-			    conversation_lookup_hashtable(conversation_hashtable_no_addr2,
+			    conversation_lookup_index(CONV_KIND_NO_ADDR2,
 				frame_num, addr_b, addr_a, etype, port_b, port_a);
 			if (conversation != NULL) {
 				/*
@@ -1093,7 +1117,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 		DPRINT(("trying wildcarded match: %s:%d -> %s:*",
 		    addr_a_str, port_a, addr_b_str));
 		conversation =
-		    conversation_lookup_hashtable(conversation_hashtable_no_port2,
+		    conversation_lookup_index(CONV_KIND_NO_PORT2,
 			frame_num, addr_a, addr_b, etype, port_a, port_b);
 		if ((conversation == NULL) && (addr_a->type == AT_FC)) {
 			/* In Fibre channel, OXID & RXID are never swapped as
@@ -1101,7 +1125,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			 */
 			DPRINT(("trying wildcarded match: %s:%d -> %s:*", addr_b_str, port_a, addr_a_str));
 			conversation =
-			    conversation_lookup_hashtable(conversation_hashtable_no_port2,
+			    conversation_lookup_index(CONV_KIND_NO_PORT2,
 				frame_num, addr_b, addr_a, etype, port_a, port_b);
 		}
 		if (conversation != NULL) {
@@ -1146,7 +1170,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			DPRINT(("trying wildcarded match: %s:%d -> %s:*",
 			    addr_b_str, port_b, addr_a_str));
 			conversation =
-			    conversation_lookup_hashtable(conversation_hashtable_no_port2,
+			    conversation_lookup_index(CONV_KIND_NO_PORT2,
 				frame_num, addr_b, addr_a, etype, port_b, port_a);
 			if (conversation != NULL) {
 				/*
@@ -1185,7 +1209,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 	 */
 	DPRINT(("trying wildcarded match: %s:%d -> *:*", addr_a_str, port_a));
 	conversation =
-	    conversation_lookup_hashtable(conversation_hashtable_no_addr2_or_port2,
+	    conversation_lookup_index(CONV_KIND_NO_ADDR2_OR_PORT2,
 		frame_num, addr_a, addr_b, etype, port_a, port_b);
 	if (conversation != NULL) {
 		/*
@@ -1240,13 +1264,13 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			DPRINT(("trying wildcarded match: %s:%d -> *:*",
 			    addr_b_str, port_a));
 			conversation =
-			    conversation_lookup_hashtable(conversation_hashtable_no_addr2_or_port2,
+			    conversation_lookup_index(CONV_KIND_NO_ADDR2_OR_PORT2,
 				frame_num, addr_b, addr_a, etype, port_a, port_b);
 		} else {
 			DPRINT(("trying wildcarded match: %s:%d -> *:*",
 			    addr_b_str, port_b));
 			conversation =
-			    conversation_lookup_hashtable(conversation_hashtable_no_addr2_or_port2,
+			    conversation_lookup_index(CONV_KIND_NO_ADDR2_OR_PORT2,
 				frame_num, addr_b, addr_a, etype, port_b, port_a);
 		}
 		if (conversation != NULL) {
@@ -1283,6 +1307,8 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 	conversation = NULL;
 
 end:
+	if (conversation != NULL && frame_num > conversation->last_frame)
+		conversation->last_frame = frame_num;
 	DINSTR(wmem_free(NULL, addr_a_str));
 	DINSTR(wmem_free(NULL, addr_b_str));
 	return conversation;
@@ -1564,28 +1590,18 @@ guint32 conversation_get_endpoint_by_id(struct _packet_info *pinfo, endpoint_typ
 	return pinfo->conv_endpoint->port1;
 }
 
-wmem_map_t *
-get_conversation_hashtable_exact(void)
+wmem_list_t *
+conversation_get_keys(wmem_allocator_t *allocator, const guint options)
 {
-	return conversation_hashtable_exact;
-}
+	wmem_list_t *keys = wmem_list_new(allocator);
+	guint kind = conv_index_kind(options);
+	guint32 i;
 
-wmem_map_t *
-get_conversation_hashtable_no_addr2(void)
-{
-	return conversation_hashtable_no_addr2;
-}
-
-wmem_map_t *
-get_conversation_hashtable_no_port2(void)
-{
-	return conversation_hashtable_no_port2;
-}
-
-wmem_map_t *
-get_conversation_hashtable_no_addr2_or_port2(void)
-{
-	return conversation_hashtable_no_addr2_or_port2;
+	for (i = 0; i < conv_index_size; i++) {
+		if (conv_index_table[i].count != 0 && conv_index_table[i].key.kind == kind)
+			wmem_list_append(keys, conv_index_slot_first(&conv_index_table[i])->key_ptr);
+	}
+	return keys;
 }
 
 address*
@@ -87,9 +87,6 @@ struct conversation_key;
 typedef struct conversation_key* conversation_key_t;
 
 typedef struct conversation {
-	struct conversation *next;	/** pointer to next conversation on hash chain */
-	struct conversation *last;	/** pointer to the last conversation on hash chain */
-	struct conversation *latest_found; /** pointer to the last conversation on hash chain */
 	guint32	conv_index;		/** unique ID for conversation */
 	guint32 setup_frame;		/** frame number that setup this conversation */
 					/* Assume that setup_frame is also the lowest frame number for now. */
@@ -110,7 +107,7 @@ WS_DLL_PUBLIC guint32 conversation_key_port1(const conversation_key_t key);
 WS_DLL_PUBLIC guint32 conversation_key_port2(const conversation_key_t key);
 
 /**
- * Create a new hash tables for conversations.
+ * Create the index for conversations.
  */
 extern void conversation_init(void);
 
@@ -119,6 +116,17 @@ extern void conversation_init(void);
  */
 extern void conversation_epan_reset(void);
 
+/**
+ * Remove conversations in which no packet has been seen since before
+ * the given frame, so that they're no longer found; a later packet
+ * between the same endpoints starts a new conversation.  Their protocol
+ * data is freed by the functions registered with
+ * conversation_register_proto_data_retire(); the conversations
+ * themselves are small and are left for the next file scope reset, as
+ * dissectors may still have pointers to them.
+ */
+extern void conversation_retire_idle(const guint32 before_frame);
+
 /*
  * Given two address/port pairs for a packet, create a new conversation
  * to contain packets between those address/port pairs.
@@ -197,6 +205,17 @@ WS_DLL_PUBLIC void conversation_add_proto_data(conversation_t *conv, const int p
 WS_DLL_PUBLIC void *conversation_get_proto_data(const conversation_t *conv, const int proto);
 WS_DLL_PUBLIC void conversation_delete_proto_data(conversation_t *conv, const int proto);
 
+typedef void (*conversation_proto_data_retire_func)(void *proto_data);
+
+/**
+ * Register a function to free a protocol's conversation data when the
+ * conversation is retired for being idle, e.g. by TShark's
+ * --idle-timeout.  The data of protocols that don't register one isn't
+ * freed until the file scope is.
+ */
+WS_DLL_PUBLIC void conversation_register_proto_data_retire(const int proto,
+    conversation_proto_data_retire_func retire_func);
+
 WS_DLL_PUBLIC void conversation_set_dissector(conversation_t *conversation,
     const dissector_handle_t handle);
 
@@ -241,17 +260,14 @@ void conversation_set_port2(conversation_t *conv, const guint32 port);
 WS_DLL_PUBLIC
 void conversation_set_addr2(conversation_t *conv, const address *addr);
 
+/**
+ * Get the keys of the conversations whose wildcards, NO_ADDR2 and/or
+ * NO_PORT2 (or NO_PORT2_FORCE), are those in options.  The list is
+ * allocated in the given scope; conversations set up in different frames
+ * with the same key are listed once.
+ */
 WS_DLL_PUBLIC
-wmem_map_t *get_conversation_hashtable_exact(void);
-
-WS_DLL_PUBLIC
-wmem_map_t *get_conversation_hashtable_no_addr2(void);
-
-WS_DLL_PUBLIC
-wmem_map_t * get_conversation_hashtable_no_port2(void);
-
-WS_DLL_PUBLIC
-wmem_map_t *get_conversation_hashtable_no_addr2_or_port2(void);
+wmem_list_t *conversation_get_keys(wmem_allocator_t *allocator, const guint options);
 
 /* Temporary function to handle port_type to endpoint_type conversion
    For now it's a 1-1 mapping, but the intention is to remove
@@ -27,6 +27,7 @@ struct epan_dfilter {
 	int		*interesting_fields;
 	int		num_interesting_fields;
 	GPtrArray	*deprecated;
+	GPtrArray	*prefilter;	/* byte strings, one of which a matching packet must contain */
 };
 
 typedef struct {
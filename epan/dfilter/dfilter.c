@@ -13,13 +13,16 @@
 
 #include "dfilter-int.h"
 #include "syntax-tree.h"
+#include "sttype-test.h"
 #include "gencode.h"
 #include "semcheck.h"
 #include "dfvm.h"
 #include <epan/epan_dissect.h>
+#include <epan/strutil.h>
 #include "dfilter.h"
 #include "dfilter-macro.h"
 #include "scanner_lex.h"
+#include <wsutil/pint.h>
 #include <wsutil/ws_printf.h> /* ws_debug_printf */
 
 
@@ -147,6 +150,10 @@ dfilter_free(dfilter_t *df)
 		g_ptr_array_free(df->deprecated, TRUE);
 	}
 
+	if (df->prefilter) {
+		g_ptr_array_free(df->prefilter, TRUE);
+	}
+
 	g_free(df->registers);
 	g_free(df->attempted_load);
 	g_free(df->owns_memory);
@@ -195,6 +202,200 @@ dfwork_free(dfwork_t *dfw)
 	g_free(dfw);
 }
 
+/*
+ * Fields whose values are carried in the packet as they are compared,
+ * i.e. in network byte order and not split across packets, so that a
+ * packet can only have one of these fields equal to a value if the bytes
+ * of that value appear somewhere in the packet.
+ */
+static const char *prefilter_fields[] = {
+	"eth.addr", "eth.src", "eth.dst",
+	"ip.addr", "ip.src", "ip.dst",
+	"ipv6.addr", "ipv6.src", "ipv6.dst",
+	"tcp.port", "tcp.srcport", "tcp.dstport",
+	"udp.port", "udp.srcport", "udp.dstport",
+	"sctp.port", "sctp.srcport", "sctp.dstport",
+	NULL
+};
+
+/* Don't bother with byte strings short enough to be in almost every
+ * packet. */
+#define PREFILTER_MIN_LEN	2
+
+static void
+prefilter_free_needle(gpointer data)
+{
+	g_byte_array_free((GByteArray *)data, TRUE);
+}
+
+/* Append the bytes that any packet in which "hfinfo == fv" must contain
+ * to "needles"; return FALSE if there are none that we know of. */
+static gboolean
+prefilter_add_value(GPtrArray *needles, header_field_info *hfinfo, fvalue_t *fv)
+{
+	const char	**name;
+	guint8		buf[16];
+	guint		len;
+	guint32		addr, mask;
+
+	for (name = prefilter_fields; *name != NULL; name++) {
+		if (strcmp(hfinfo->abbrev, *name) == 0)
+			break;
+	}
+	if (*name == NULL)
+		return FALSE;
+
+	switch (fvalue_type_ftenum(fv)) {
+		case FT_UINT16:
+			phton16(buf, (guint16)fvalue_get_uinteger(fv));
+			len = 2;
+			break;
+
+		case FT_IPv4:
+			/* Only the bytes covered by the netmask are known. */
+			addr = g_htonl(fv->value.ipv4.addr);
+			memcpy(buf, &addr, 4);
+			mask = fv->value.ipv4.nmask;
+			for (len = 0; len < 4 && (mask & 0xff000000) == 0xff000000; len++)
+				mask <<= 8;
+			break;
+
+		case FT_IPv6:
+			memcpy(buf, fv->value.ipv6.addr.bytes, 16);
+			len = MIN(fv->value.ipv6.prefix, 128) / 8;
+			break;
+
+		case FT_ETHER:
+			if (fv->value.bytes->len != 6)
+				return FALSE;
+			memcpy(buf, fv->value.bytes->data, 6);
+			len = 6;
+			break;
+
+		default:
+			return FALSE;
+	}
+
+	if (len < PREFILTER_MIN_LEN)
+		return FALSE;
+
+	g_ptr_array_add(needles, g_byte_array_append(g_byte_array_new(), buf, len));
+	return TRUE;
+}
+
+static guint
+prefilter_min_len(GPtrArray *needles)
+{
+	guint	i, len = G_MAXUINT;
+
+	for (i = 0; i < needles->len; i++)
+		len = MIN(len, ((GByteArray *)g_ptr_array_index(needles, i))->len);
+	return len;
+}
+
+/*
+ * Derive from the syntax tree a set of byte strings, at least one of
+ * which appears in the raw bytes of every packet that can match the
+ * filter.  Returns NULL if there is no such set that we know of.
+ *
+ * This has to be done before the code is generated, as generating the
+ * code steals the values from the syntax tree.
+ */
+static GPtrArray *
+prefilter_derive(stnode_t *st_node)
+{
+	test_op_t	op;
+	stnode_t	*st_arg1, *st_arg2, *st_tmp;
+	GPtrArray	*needles, *needles2;
+	GSList		*nodelist;
+	guint		i;
+
+	if (stnode_type_id(st_node) != STTYPE_TEST)
+		return NULL;
+
+	sttype_test_get(st_node, &op, &st_arg1, &st_arg2);
+
+	switch (op) {
+		case TEST_OP_AND:
+			/* Either side will do; use the more selective one. */
+			needles = prefilter_derive(st_arg1);
+			needles2 = prefilter_derive(st_arg2);
+			if (needles == NULL)
+				return needles2;
+			if (needles2 == NULL)
+				return needles;
+			if (prefilter_min_len(needles2) > prefilter_min_len(needles)) {
+				g_ptr_array_free(needles, TRUE);
+				return needles2;
+			}
+			g_ptr_array_free(needles2, TRUE);
+			return needles;
+
+		case TEST_OP_OR:
+			/* We need both sides. */
+			needles = prefilter_derive(st_arg1);
+			if (needles == NULL)
+				return NULL;
+			needles2 = prefilter_derive(st_arg2);
+			if (needles2 == NULL) {
+				g_ptr_array_free(needles, TRUE);
+				return NULL;
+			}
+			for (i = 0; i < needles2->len; i++)
+				g_ptr_array_add(needles, g_ptr_array_index(needles2, i));
+			g_ptr_array_set_free_func(needles2, NULL);
+			g_ptr_array_free(needles2, TRUE);
+			return needles;
+
+		case TEST_OP_EQ:
+			if (stnode_type_id(st_arg1) == STTYPE_FVALUE) {
+				st_tmp = st_arg1;
+				st_arg1 = st_arg2;
+				st_arg2 = st_tmp;
+			}
+			if (stnode_type_id(st_arg1) != STTYPE_FIELD ||
+			    stnode_type_id(st_arg2) != STTYPE_FVALUE)
+				return NULL;
+			needles = g_ptr_array_new_with_free_func(prefilter_free_needle);
+			if (!prefilter_add_value(needles,
+			    (header_field_info *)stnode_data(st_arg1),
+			    (fvalue_t *)stnode_data(st_arg2))) {
+				g_ptr_array_free(needles, TRUE);
+				return NULL;
+			}
+			return needles;
+
+		case TEST_OP_IN:
+			if (stnode_type_id(st_arg1) != STTYPE_FIELD ||
+			    stnode_type_id(st_arg2) != STTYPE_SET)
+				return NULL;
+			needles = g_ptr_array_new_with_free_func(prefilter_free_needle);
+			/* Each element is a value followed by NULL, or the
+			 * lower and upper bounds of a range. */
+			for (nodelist = (GSList *)stnode_data(st_arg2);
+			    nodelist != NULL && nodelist->next != NULL;
+			    nodelist = nodelist->next->next) {
+				st_tmp = (stnode_t *)nodelist->data;
+				if (nodelist->next->data != NULL ||
+				    stnode_type_id(st_tmp) != STTYPE_FVALUE ||
+				    !prefilter_add_value(needles,
+				    (header_field_info *)stnode_data(st_arg1),
+				    (fvalue_t *)stnode_data(st_tmp))) {
+					g_ptr_array_free(needles, TRUE);
+					return NULL;
+				}
+			}
+			if (needles->len == 0) {
+				g_ptr_array_free(needles, TRUE);
+				return NULL;
+			}
+			return needles;
+
+		default:
+			return NULL;
+	}
+}
+
 gboolean
 dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 {
@@ -210,6 +411,7 @@ dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 	guint		i;
 	/* XXX, GHashTable */
 	GPtrArray	*deprecated;
+	GPtrArray	*prefilter;
 
 	g_assert(dfp);
 
@@ -334,6 +536,8 @@ dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 			goto FAILURE;
 		}
 
+		prefilter = prefilter_derive(dfw->st_root);
+
 		/* Create bytecode */
 		dfw_gencode(dfw);
 
@@ -345,6 +549,7 @@ dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 		dfw->consts = NULL;
 		dfilter->interesting_fields = dfw_interesting_fields(dfw,
 			&dfilter->num_interesting_fields);
+		dfilter->prefilter = prefilter;
 
 		/* Initialize run-time space */
 		dfilter->num_registers = dfw->first_constant;
@@ -427,6 +632,29 @@ dfilter_has_interesting_fields(const dfilter_t *df)
 	return (df->num_interesting_fields > 0);
 }
 
+gboolean
+dfilter_has_prefilter(const dfilter_t *df)
+{
+	return (df->prefilter != NULL);
+}
+
+gboolean
+dfilter_prefilter_might_match(const dfilter_t *df, const guint8 *data, guint len)
+{
+	guint		i;
+	GByteArray	*needle;
+
+	if (df->prefilter == NULL)
+		return TRUE;
+
+	for (i = 0; i < df->prefilter->len; i++) {
+		needle = (GByteArray *)g_ptr_array_index(df->prefilter, i);
+		if (epan_memmem(data, len, needle->data, needle->len) != NULL)
+			return TRUE;
+	}
+	return FALSE;
+}
+
 GPtrArray *
 dfilter_deprecated_tokens(dfilter_t *df) {
 	if (df->deprecated && df->deprecated->len > 0) {
@@ -435,6 +663,73 @@ dfilter_deprecated_tokens(dfilter_t *df) {
 	return NULL;
 }
 
+/* Returns a pointer past "base" (with surrounding white space removed) at
+ * the start of "text", optionally in parentheses, or NULL. */
+static const gchar *
+skip_base_filter(const gchar *text, const gchar *base, gsize base_len)
+{
+	if (strncmp(text, base, base_len) == 0)
+		return text + base_len;
+
+	if (*text != '(')
+		return NULL;
+	text++;
+	while (g_ascii_isspace(*text))
+		text++;
+	if (strncmp(text, base, base_len) != 0)
+		return NULL;
+	text += base_len;
+	while (g_ascii_isspace(*text))
+		text++;
+	if (*text != ')')
+		return NULL;
+	return text + 1;
+}
+
+gboolean
+dfilter_is_refinement(const gchar *base, const gchar *refined)
+{
+	gsize base_len;
+	const gchar *p;
+
+	if (base == NULL || refined == NULL)
+		return FALSE;
+
+	while (g_ascii_isspace(*base))
+		base++;
+	base_len = strlen(base);
+	while (base_len > 0 && g_ascii_isspace(base[base_len - 1]))
+		base_len--;
+	if (base_len == 0)
+		return FALSE;
+
+	while (g_ascii_isspace(*refined))
+		refined++;
+	p = skip_base_filter(refined, base, base_len);
+	if (p == NULL)
+		return FALSE;
+
+	/*
+	 * "and" has the lowest precedence of all operators, and is left
+	 * associative, so if "base" is a valid filter by itself,
+	 * "base and X" is always parsed as "(base) and (X)".
+	 */
+	while (g_ascii_isspace(*p))
+		p++;
+	if (strncmp(p, "&&", 2) == 0) {
+		p += 2;
+	} else if (strncmp(p, "and", 3) == 0 &&
+	    (g_ascii_isspace(p[3]) || p[3] == '(' || p[3] == '!')) {
+		p += 3;
+	} else {
+		return FALSE;
+	}
+
+	while (g_ascii_isspace(*p))
+		p++;
+	return *p != '\0';
+}
+
 void
 dfilter_dump(dfilter_t *df)
 {
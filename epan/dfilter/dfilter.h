@@ -76,6 +76,31 @@ WS_DLL_PUBLIC
 GPtrArray *
 dfilter_deprecated_tokens(dfilter_t *df);
 
+/* Returns TRUE if a test on the raw bytes of a packet could be derived
+ * from the filter, i.e. if dfilter_prefilter_might_match() can ever
+ * return FALSE. */
+WS_DLL_PUBLIC
+gboolean
+dfilter_has_prefilter(const dfilter_t *df);
+
+/* Returns FALSE if the raw bytes of a packet show that the packet can't
+ * match the filter, without dissecting it.  The test is a conservative
+ * one: it only looks for the values that the filter compares address
+ * and port fields with, so it can't see values that are compressed or
+ * encrypted in the packet, or fields that are only added when a
+ * reassembly that the packet completes is dissected; callers have to
+ * take care of those cases themselves. */
+WS_DLL_PUBLIC
+gboolean
+dfilter_prefilter_might_match(const dfilter_t *df, const guint8 *data, guint len);
+
+/* Returns TRUE if the filter text "refined" is the filter text "base"
+ * with further tests ANDed to it ("base && ..." or "(base) and ..."),
+ * so that only packets matching "base" can match "refined". */
+WS_DLL_PUBLIC
+gboolean
+dfilter_is_refinement(const gchar *base, const gchar *refined);
+
 /* Print bytecode of dfilter to stdout */
 WS_DLL_PUBLIC
 void
@@ -8,6 +8,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "dfvm.h"
 
 #include <ftypes/ftypes-int.h>
@@ -72,6 +74,36 @@ dfvm_value_new(dfvm_value_type_t type)
 	return v;
 }
 
+static const char *
+relation_op_str(dfvm_opcode_t op)
+{
+	switch (op) {
+		case ANY_EQ:	return "==";
+		case ANY_NE:	return "!=";
+		case ANY_GT:	return ">";
+		case ANY_GE:	return ">=";
+		case ANY_LT:	return "<";
+		case ANY_LE:	return "<=";
+		default:
+			g_assert_not_reached();
+			return "?";
+	}
+}
+
+static void
+dump_field_cmp(FILE *f, int id, const char *opcode_name, dfvm_insn_t *insn)
+{
+	char	*value_str;
+
+	value_str = fvalue_to_string_repr(NULL, insn->arg2->value.fvalue,
+		FTREPR_DFILTER, BASE_NONE);
+	fprintf(f, "%05d %s\t%s %s %s <%s>\n",
+		id, opcode_name, insn->arg1->value.hfinfo->abbrev,
+		relation_op_str((dfvm_opcode_t)insn->arg3->value.numeric),
+		value_str, fvalue_type_name(insn->arg2->value.fvalue));
+	wmem_free(NULL, value_str);
+}
+
 
 void
 dfvm_dump(FILE *f, dfilter_t *df)
@@ -119,6 +151,10 @@ dfvm_dump(FILE *f, dfilter_t *df)
 			case ANY_CONTAINS:
 			case ANY_MATCHES:
 			case ANY_IN_RANGE:
+			case FIELD_CMP_UINT:
+			case FIELD_CMP_SINT:
+			case FIELD_CMP_IPV4:
+			case FIELD_CMP_BYTES:
 			case NOT:
 			case RETURN:
 			case IF_TRUE_GOTO:
@@ -259,6 +295,22 @@ dfvm_dump(FILE *f, dfilter_t *df)
 					arg3->value.numeric);
 				break;
 
+			case FIELD_CMP_UINT:
+				dump_field_cmp(f, id, "FIELD_CMP_UINT", insn);
+				break;
+
+			case FIELD_CMP_SINT:
+				dump_field_cmp(f, id, "FIELD_CMP_SINT", insn);
+				break;
+
+			case FIELD_CMP_IPV4:
+				dump_field_cmp(f, id, "FIELD_CMP_IPV4", insn);
+				break;
+
+			case FIELD_CMP_BYTES:
+				dump_field_cmp(f, id, "FIELD_CMP_BYTES", insn);
+				break;
+
 			case NOT:
 				fprintf(f, "%05d NOT\n", id);
 				break;
@@ -400,6 +452,111 @@ any_in_range(dfilter_t *df, int reg1, int reg2, int reg3)
 	return FALSE;
 }
 
+static gboolean
+fvalue_test(dfvm_opcode_t op, const fvalue_t *a, const fvalue_t *b)
+{
+	switch (op) {
+		case ANY_EQ:	return fvalue_eq(a, b);
+		case ANY_NE:	return fvalue_ne(a, b);
+		case ANY_GT:	return fvalue_gt(a, b);
+		case ANY_GE:	return fvalue_ge(a, b);
+		case ANY_LT:	return fvalue_lt(a, b);
+		case ANY_LE:	return fvalue_le(a, b);
+		default:
+			g_assert_not_reached();
+			return FALSE;
+	}
+}
+
+/* Returns the result of a relation, given whether its first operand
+ * is less than (< 0), equal to (0) or greater than (> 0) the second. */
+static inline gboolean
+order_test(dfvm_opcode_t op, int order)
+{
+	switch (op) {
+		case ANY_EQ:	return order == 0;
+		case ANY_NE:	return order != 0;
+		case ANY_GT:	return order > 0;
+		case ANY_GE:	return order >= 0;
+		case ANY_LT:	return order < 0;
+		case ANY_LE:	return order <= 0;
+		default:
+			g_assert_not_reached();
+			return FALSE;
+	}
+}
+
+#define ORDER(a, b)	(((a) > (b)) - ((a) < (b)))
+
+/* Compares the values of a field with a constant, straight from the
+ * tree's arrays of interesting fields, rather than loading them into
+ * a register and going through the ftype's comparison functions.
+ *
+ * The constant is of the type of the field; values of other fields
+ * with the same name but of a different type are compared as
+ * any_test() would. */
+static gboolean
+field_cmp(proto_tree *tree, dfvm_opcode_t kind, header_field_info *hfinfo,
+		dfvm_opcode_t op, const fvalue_t *fv_b)
+{
+	GPtrArray	*finfos;
+	const fvalue_t	*fv_a;
+	guint		i;
+	int		order;
+	guint32		nmask;
+	GByteArray	*bytes_a, *bytes_b;
+
+	for (; hfinfo; hfinfo = hfinfo->same_name_next) {
+		finfos = proto_get_finfo_ptr_array(tree, hfinfo->id);
+		if (finfos == NULL)
+			continue;
+
+		for (i = 0; i < finfos->len; i++) {
+			fv_a = &((field_info *)g_ptr_array_index(finfos, i))->value;
+
+			if (fv_a->ftype != fv_b->ftype) {
+				if (fvalue_test(op, fv_a, fv_b))
+					return TRUE;
+				continue;
+			}
+
+			switch (kind) {
+				case FIELD_CMP_UINT:
+					order = ORDER(fv_a->value.uinteger, fv_b->value.uinteger);
+					break;
+
+				case FIELD_CMP_SINT:
+					order = ORDER(fv_a->value.sinteger, fv_b->value.sinteger);
+					break;
+
+				case FIELD_CMP_IPV4:
+					/* As in ftype-ipv4.c, use the less restrictive mask. */
+					nmask = MIN(fv_a->value.ipv4.nmask, fv_b->value.ipv4.nmask);
+					order = ORDER(fv_a->value.ipv4.addr & nmask,
+							fv_b->value.ipv4.addr & nmask);
+					break;
+
+				case FIELD_CMP_BYTES:
+					/* Only generated for == and !=. */
+					bytes_a = fv_a->value.bytes;
+					bytes_b = fv_b->value.bytes;
+					if (bytes_a->len != bytes_b->len)
+						order = 1;
+					else
+						order = memcmp(bytes_a->data, bytes_b->data, bytes_a->len);
+					break;
+
+				default:
+					g_assert_not_reached();
+					return FALSE;
+			}
+
+			if (order_test(op, order))
+				return TRUE;
+		}
+	}
+	return FALSE;
+}
 
 static void
 free_owned_register(gpointer data, gpointer user_data _U_)
@@ -579,6 +736,16 @@ dfvm_apply(dfilter_t *df, proto_tree *tree)
 						arg3->value.numeric);
 				break;
 
+			case FIELD_CMP_UINT:
+			case FIELD_CMP_SINT:
+			case FIELD_CMP_IPV4:
+			case FIELD_CMP_BYTES:
+				arg3 = insn->arg3;
+				accum = field_cmp(tree, insn->op, arg1->value.hfinfo,
+						(dfvm_opcode_t)arg3->value.numeric,
+						arg2->value.fvalue);
+				break;
+
 			case NOT:
 				accum = !accum;
 				break;
@@ -654,6 +821,10 @@ dfvm_init_const(dfilter_t *df)
 			case ANY_CONTAINS:
 			case ANY_MATCHES:
 			case ANY_IN_RANGE:
+			case FIELD_CMP_UINT:
+			case FIELD_CMP_SINT:
+			case FIELD_CMP_IPV4:
+			case FIELD_CMP_BYTES:
 			case NOT:
 			case RETURN:
 			case IF_TRUE_GOTO:
@@ -60,7 +60,15 @@ typedef enum {
 	ANY_MATCHES,
 	MK_RANGE,
 	CALL_FUNCTION,
-	ANY_IN_RANGE
+	ANY_IN_RANGE,
+
+	/* Comparisons of a field with a constant, done directly on the
+	 * field values in the tree.  arg1 is the field, arg2 the constant
+	 * and arg3 the ANY_* opcode of the comparison. */
+	FIELD_CMP_UINT,
+	FIELD_CMP_SINT,
+	FIELD_CMP_IPV4,
+	FIELD_CMP_BYTES
 
 } dfvm_opcode_t;
 
@@ -252,12 +252,134 @@ gen_relation_regs(dfwork_t *dfw, dfvm_opcode_t op, int reg1, int reg2)
 	dfw_append_insn(dfw, insn);
 }
 
+/* Gets the opcode to compare a field of the given type directly with
+ * a constant; returns FALSE if there isn't one for that type and relation. */
+static gboolean
+field_cmp_opcode(ftenum_t ftype, dfvm_opcode_t op, dfvm_opcode_t *fast_op)
+{
+	switch (ftype) {
+		case FT_CHAR:
+		case FT_UINT8:
+		case FT_UINT16:
+		case FT_UINT24:
+		case FT_UINT32:
+		case FT_IPXNET:
+		case FT_FRAMENUM:
+			*fast_op = FIELD_CMP_UINT;
+			return TRUE;
+
+		case FT_INT8:
+		case FT_INT16:
+		case FT_INT24:
+		case FT_INT32:
+			*fast_op = FIELD_CMP_SINT;
+			return TRUE;
+
+		case FT_IPv4:
+			*fast_op = FIELD_CMP_IPV4;
+			return TRUE;
+
+		case FT_BYTES:
+		case FT_UINT_BYTES:
+		case FT_ETHER:
+			if (op != ANY_EQ && op != ANY_NE)
+				return FALSE;
+			*fast_op = FIELD_CMP_BYTES;
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+/* If the relation compares a field with a constant, and the values are of
+ * a type that has a FIELD_CMP_* instruction, generate that instead of
+ * loading the field and the constant into registers. */
+static gboolean
+gen_field_cmp(dfwork_t *dfw, dfvm_opcode_t op, stnode_t *st_arg1, stnode_t *st_arg2)
+{
+	stnode_t	*st_tmp;
+	header_field_info	*hfinfo;
+	dfvm_opcode_t	fast_op;
+	dfvm_insn_t	*insn;
+	dfvm_value_t	*val;
+
+	switch (op) {
+		case ANY_EQ:
+		case ANY_NE:
+		case ANY_GT:
+		case ANY_GE:
+		case ANY_LT:
+		case ANY_LE:
+			break;
+		default:
+			return FALSE;
+	}
+
+	/* "constant op field" is "field reverse-op constant". */
+	if (stnode_type_id(st_arg1) == STTYPE_FVALUE &&
+	    stnode_type_id(st_arg2) == STTYPE_FIELD) {
+		st_tmp = st_arg1;
+		st_arg1 = st_arg2;
+		st_arg2 = st_tmp;
+		switch (op) {
+			case ANY_GT:	op = ANY_LT; break;
+			case ANY_GE:	op = ANY_LE; break;
+			case ANY_LT:	op = ANY_GT; break;
+			case ANY_LE:	op = ANY_GE; break;
+			default:	break;
+		}
+	}
+
+	if (stnode_type_id(st_arg1) != STTYPE_FIELD ||
+	    stnode_type_id(st_arg2) != STTYPE_FVALUE) {
+		return FALSE;
+	}
+
+	if (!field_cmp_opcode(fvalue_type_ftenum((fvalue_t *)stnode_data(st_arg2)),
+	    op, &fast_op)) {
+		return FALSE;
+	}
+
+	/* Rewind to find the first field of this name. */
+	hfinfo = (header_field_info*)stnode_data(st_arg1);
+	while (hfinfo->same_name_prev_id != -1) {
+		hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+	}
+
+	insn = dfvm_insn_new(fast_op);
+	val = dfvm_value_new(HFINFO);
+	val->value.hfinfo = hfinfo;
+	insn->arg1 = val;
+	val = dfvm_value_new(FVALUE);
+	val->value.fvalue = (fvalue_t *)stnode_steal_data(st_arg2);
+	insn->arg2 = val;
+	val = dfvm_value_new(INTEGER);
+	val->value.numeric = op;
+	insn->arg3 = val;
+	dfw_append_insn(dfw, insn);
+
+	/* Record the FIELD_ID in hash of interesting fields. */
+	while (hfinfo) {
+		g_hash_table_insert(dfw->interesting_fields,
+			GINT_TO_POINTER(hfinfo->id),
+			GUINT_TO_POINTER(TRUE));
+		hfinfo = hfinfo->same_name_next;
+	}
+
+	return TRUE;
+}
+
 static void
 gen_relation(dfwork_t *dfw, dfvm_opcode_t op, stnode_t *st_arg1, stnode_t *st_arg2)
 {
 	dfvm_value_t	*jmp1 = NULL, *jmp2 = NULL;
 	int		reg1 = -1, reg2 = -1;
 
+	if (gen_field_cmp(dfw, op, st_arg1, st_arg2)) {
+		return;
+	}
+
 	/* Create code for the LHS and RHS of the relation */
 	reg1 = gen_entity(dfw, st_arg1, &jmp1);
 	reg2 = gen_entity(dfw, st_arg2, &jmp2);
@@ -1464,6 +1464,43 @@ init_tcp_conversation_data(packet_info *pinfo)
     return tcpd;
 }
 
+static void
+free_tcp_flow_data(tcp_flow_t *flow)
+{
+    tcp_unacked_t *ual, *next;
+
+    if (flow->tcp_analyze_seq_info) {
+        for (ual = flow->tcp_analyze_seq_info->segments; ual; ual = next) {
+            next = ual->next;
+            wmem_free(wmem_file_scope(), ual);
+        }
+        wmem_free(wmem_file_scope(), flow->tcp_analyze_seq_info);
+    }
+    wmem_tree_destroy(flow->multisegment_pdus, FALSE, TRUE);
+    if (flow->process_info) {
+        wmem_free(wmem_file_scope(), flow->process_info->username);
+        wmem_free(wmem_file_scope(), flow->process_info->command);
+        wmem_free(wmem_file_scope(), flow->process_info);
+    }
+}
+
+/* Free the data of a conversation that has been retired for being idle. */
+static void
+retire_tcp_conversation_data(void *proto_data)
+{
+    struct tcp_analysis *tcpd = (struct tcp_analysis *)proto_data;
+
+    /* The MPTCP analysis is shared with the other subflows, which refer
+     * back to this one, so leave it all for the file scope to free. */
+    if (tcpd->mptcp_analysis)
+        return;
+
+    free_tcp_flow_data(&tcpd->flow1);
+    free_tcp_flow_data(&tcpd->flow2);
+    wmem_tree_destroy(tcpd->acked_table, FALSE, TRUE);
+    wmem_free(wmem_file_scope(), tcpd);
+}
+
 /* setup meta as well */
 static void
 mptcp_init_subflow(tcp_flow_t *flow)
@@ -7938,6 +7975,7 @@ proto_register_tcp(void)
         &tcp_display_process_info);
 
     register_init_routine(tcp_init);
+    conversation_register_proto_data_retire(proto_tcp, retire_tcp_conversation_data);
     reassembly_table_register(&tcp_reassembly_table,
                           &addresses_ports_reassembly_table_functions);
 
@@ -429,6 +429,15 @@ epan_get_user_comment(const epan_t *session, const frame_data *fd)
 	return NULL;
 }
 
+const nstime_t *
+epan_get_shift_offset(const epan_t *session, const frame_data *fd)
+{
+	if (fd->has_shift_offset && session->funcs.get_shift_offset)
+		return session->funcs.get_shift_offset(session->prov, fd);
+
+	return NULL;
+}
+
 const char *
 epan_get_interface_name(const epan_t *session, guint32 interface_id)
 {
@@ -478,6 +487,13 @@ epan_conversation_init(void)
 	conversation_epan_reset();
 }
 
+void
+epan_retire_idle_state(const guint32 before_frame)
+{
+	conversation_retire_idle(before_frame);
+	reassembly_tables_retire(before_frame);
+}
+
 /* Overrides proto_tree_visible i epan_dissect_init to make all fields visible.
  * This is > 0 if a Lua script wanted to see all fields all the time.
  * This is ref-counted, so clearing it won't override other taps/scripts wanting it.
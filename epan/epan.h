@@ -50,6 +50,7 @@ struct packet_provider_funcs {
 	const char *(*get_interface_name)(struct packet_provider_data *prov, guint32 interface_id);
 	const char *(*get_interface_description)(struct packet_provider_data *prov, guint32 interface_id);
 	const char *(*get_user_comment)(struct packet_provider_data *prov, const frame_data *fd);
+	const nstime_t *(*get_shift_offset)(struct packet_provider_data *prov, const frame_data *fd);
 };
 
 #ifdef HAVE_PLUGINS
@@ -153,6 +154,8 @@ WS_DLL_PUBLIC epan_t *epan_new(struct packet_provider_data *prov,
 
 WS_DLL_PUBLIC const char *epan_get_user_comment(const epan_t *session, const frame_data *fd);
 
+WS_DLL_PUBLIC const nstime_t *epan_get_shift_offset(const epan_t *session, const frame_data *fd);
+
 WS_DLL_PUBLIC const char *epan_get_interface_name(const epan_t *session, guint32 interface_id);
 
 WS_DLL_PUBLIC const char *epan_get_interface_description(const epan_t *session, guint32 interface_id);
@@ -161,6 +164,16 @@ const nstime_t *epan_get_frame_ts(const epan_t *session, guint32 frame_num);
 
 WS_DLL_PUBLIC void epan_free(epan_t *session);
 
+/**
+ * Discard dissection state that hasn't been used since before the given
+ * frame: conversations in which no packet has been seen since then stop
+ * being found, and reassemblies to which no fragment has been added
+ * since then are freed.  This is intended for long-running single-pass
+ * dissection, e.g. of a live capture, where frames are never
+ * redissected; it must not be used if they might be.
+ */
+WS_DLL_PUBLIC void epan_retire_idle_state(const guint32 before_frame);
+
 WS_DLL_PUBLIC const gchar*
 epan_get_version(void);
 
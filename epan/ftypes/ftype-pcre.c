@@ -9,6 +9,9 @@
 /* Perl-Compatible Regular Expression (PCRE) internal field type.
  * Used with the "matches" dfilter operator, allowing efficient
  * compilation and studying of a PCRE pattern in dfilters.
+ *
+ * Patterns are compiled with PCRE2, using its JIT compiler where it's
+ * available, or with GRegex if we weren't built with PCRE2.
  */
 
 #include "config.h"
@@ -18,6 +21,171 @@
 #include <glib.h>
 #include <string.h>
 
+#ifdef HAVE_PCRE2
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#endif
+
+struct _fvalue_regex_t {
+    char *pattern;
+    /* Literal text every match starts with, lower-cased, or NULL. */
+    char *prefix;
+    gsize prefix_len;
+#ifdef HAVE_PCRE2
+    pcre2_code *code;
+#else
+    GRegex *code;
+#endif
+};
+
+#ifdef HAVE_PCRE2
+static void
+match_data_free(gpointer data)
+{
+    pcre2_match_data_free((pcre2_match_data *)data);
+}
+
+/* Match data is only used for the duration of a match, so each thread
+ * can keep one around rather than allocating it for every match. */
+static GPrivate match_data_key = G_PRIVATE_INIT(match_data_free);
+
+static pcre2_match_data *
+get_match_data(void)
+{
+    pcre2_match_data *match_data;
+
+    match_data = (pcre2_match_data *)g_private_get(&match_data_key);
+    if (match_data == NULL) {
+        /* We only care whether there's a match, so room for the offsets
+         * of the whole match is enough for any pattern. */
+        match_data = pcre2_match_data_create(1, NULL);
+        g_private_set(&match_data_key, match_data);
+    }
+    return match_data;
+}
+#endif
+
+/*
+ * Get the literal text, if any, that the pattern has to start with, so
+ * that subjects that don't contain it can be rejected without running
+ * the regex, and the others searched from where it first appears.
+ *
+ * This is deliberately simple-minded: patterns with alternatives have
+ * no prefix, and the prefix ends at the first character that isn't a
+ * plain character or an escaped punctuation character.
+ */
+static void
+set_literal_prefix(fvalue_regex_t *regex)
+{
+    const char *p = regex->pattern;
+    GString *prefix;
+    gsize last_len = 0;
+
+    if (strchr(p, '|') != NULL)
+        return;
+
+    prefix = g_string_new(NULL);
+    while (*p != '\0') {
+        if (*p == '\\') {
+            /* Escaped alphanumerics are classes, assertions, etc. */
+            if (p[1] == '\0' || g_ascii_isalnum(p[1]))
+                break;
+            last_len = prefix->len;
+            g_string_append_c(prefix, g_ascii_tolower(p[1]));
+            p += 2;
+        } else if (strchr("^$.[]()?*+{}", *p) != NULL) {
+            break;
+        } else {
+            last_len = prefix->len;
+            g_string_append_c(prefix, g_ascii_tolower(*p));
+            p++;
+        }
+    }
+
+    /* If the last literal is optional or repeated, it might not be there,
+     * so leave it out. */
+    if (*p == '?' || *p == '*' || *p == '{')
+        g_string_truncate(prefix, last_len);
+
+    regex->prefix_len = prefix->len;
+    regex->prefix = g_string_free(prefix, prefix->len == 0);
+}
+
+/* Patterns are caseless, so look for the prefix ignoring (ASCII) case,
+ * as PCRE does for subjects that aren't UTF-8. */
+static const char *
+find_literal_prefix(const fvalue_regex_t *regex, const char *subject, gsize subject_len)
+{
+    const char *p, *last;
+
+    if (subject_len < regex->prefix_len)
+        return NULL;
+
+    last = subject + subject_len - regex->prefix_len;
+    for (p = subject; p <= last; p++) {
+        if (g_ascii_tolower(*p) == regex->prefix[0] &&
+                g_ascii_strncasecmp(p + 1, regex->prefix + 1, regex->prefix_len - 1) == 0)
+            return p;
+    }
+    return NULL;
+}
+
+gboolean
+fvalue_regex_matches(const fvalue_regex_t *regex, const char *subject, gsize subject_len)
+{
+    gsize start = 0;
+    const char *p;
+#ifdef HAVE_PCRE2
+    int rc;
+#endif
+
+    if (subject == NULL)
+        subject = "";
+
+    if (regex->prefix != NULL) {
+        p = find_literal_prefix(regex, subject, subject_len);
+        if (p == NULL)
+            return FALSE;
+        start = p - subject;
+    }
+
+#ifdef HAVE_PCRE2
+    rc = pcre2_match(regex->code, (PCRE2_SPTR)subject, subject_len, start,
+            0, get_match_data(), NULL);
+    if (rc == PCRE2_ERROR_JIT_STACKLIMIT) {
+        /* The interpreter isn't limited by the size of the JIT stack. */
+        rc = pcre2_match(regex->code, (PCRE2_SPTR)subject, subject_len, start,
+                PCRE2_NO_JIT, get_match_data(), NULL);
+    }
+    /* 0 means that there was a match, but no room for the offsets of the
+     * captured substrings, which we don't want anyway. */
+    return rc >= 0;
+#else
+    return g_regex_match_full(
+            regex->code,            /* Compiled PCRE */
+            subject,                /* The data to check for the pattern... */
+            (gssize)subject_len,    /* ... and its length */
+            (gint)start,            /* Start offset within data */
+            (GRegexMatchFlags)0,    /* GRegexMatchFlags */
+            NULL,                   /* We are not interested in the match information */
+            NULL                    /* We don't want error information */
+            );
+#endif
+}
+
+static void
+regex_free(fvalue_regex_t *regex)
+{
+#ifdef HAVE_PCRE2
+    pcre2_code_free(regex->code);
+#else
+    g_regex_unref(regex->code);
+#endif
+    g_free(regex->prefix);
+    g_free(regex->pattern);
+    g_free(regex);
+}
+
 static void
 gregex_fvalue_new(fvalue_t *fv)
 {
@@ -28,7 +196,7 @@ static void
 gregex_fvalue_free(fvalue_t *fv)
 {
     if (fv->value.re) {
-        g_regex_unref(fv->value.re);
+        regex_free(fv->value.re);
         fv->value.re = NULL;
     }
 }
@@ -39,8 +207,20 @@ gregex_fvalue_free(fvalue_t *fv)
 static gboolean
 val_from_string(fvalue_t *fv, const char *pattern, gchar **err_msg)
 {
+    fvalue_regex_t *regex;
+#ifdef HAVE_PCRE2
+    int errcode;
+    PCRE2_SIZE erroffset;
+    PCRE2_UCHAR errbuf[256];
+#else
     GError *regex_error = NULL;
     GRegexCompileFlags cflags = (GRegexCompileFlags)(G_REGEX_CASELESS | G_REGEX_OPTIMIZE);
+#endif
+
+    /* Free up the old value, if we have one */
+    gregex_fvalue_free(fv);
+
+    regex = g_new0(fvalue_regex_t, 1);
 
     /*
      * As FT_BYTES and FT_PROTOCOL contain arbitrary binary data and FT_STRING
@@ -48,15 +228,36 @@ val_from_string(fvalue_t *fv, const char *pattern, gchar **err_msg)
      * UTF-8 patterns and treat every pattern and subject as raw bytes.
      *
      * Should support for UTF-8 patterns be necessary, then we should compile a
-     * pattern without G_REGEX_RAW. Additionally, we MUST use g_utf8_validate()
-     * before calling g_regex_match_full() or risk crashes.
+     * pattern with PCRE2_UTF (or without G_REGEX_RAW). Additionally, we MUST
+     * use g_utf8_validate() before matching or risk crashes.
      */
-    cflags = (GRegexCompileFlags)(cflags | G_REGEX_RAW);
+#ifdef HAVE_PCRE2
+    regex->code = pcre2_compile(
+            (PCRE2_SPTR)pattern,    /* pattern */
+            PCRE2_ZERO_TERMINATED,  /* pattern length */
+            PCRE2_CASELESS,         /* Compile options */
+            &errcode,               /* Compile error... */
+            &erroffset,             /* ... and where in the pattern it is */
+            NULL                    /* Default compile context */
+            );
 
-    /* Free up the old value, if we have one */
-    gregex_fvalue_free(fv);
+    if (regex->code == NULL) {
+        if (err_msg) {
+            pcre2_get_error_message(errcode, errbuf, sizeof(errbuf));
+            *err_msg = g_strdup_printf("Error while compiling regular expression %s at char %" G_GSIZE_FORMAT ": %s",
+                    pattern, (gsize)erroffset, errbuf);
+        }
+        g_free(regex);
+        return FALSE;
+    }
 
-    fv->value.re = g_regex_new(
+    /* If JIT compilation isn't supported on this platform or fails, pcre2_match()
+     * just uses the interpreter. */
+    pcre2_jit_compile(regex->code, PCRE2_JIT_COMPLETE);
+#else
+    cflags = (GRegexCompileFlags)(cflags | G_REGEX_RAW);
+
+    regex->code = g_regex_new(
             pattern,            /* pattern */
             cflags,             /* Compile options */
             (GRegexMatchFlags)0,                  /* Match options */
@@ -68,11 +269,17 @@ val_from_string(fvalue_t *fv, const char *pattern, gchar **err_msg)
             *err_msg = g_strdup(regex_error->message);
         }
         g_error_free(regex_error);
-        if (fv->value.re) {
-            g_regex_unref(fv->value.re);
+        if (regex->code) {
+            g_regex_unref(regex->code);
         }
+        g_free(regex);
         return FALSE;
     }
+#endif
+
+    regex->pattern = g_strdup(pattern);
+    set_literal_prefix(regex);
+    fv->value.re = regex;
     return TRUE;
 }
 
@@ -91,14 +298,14 @@ static int
 gregex_repr_len(fvalue_t *fv, ftrepr_t rtype, int field_display _U_)
 {
     g_assert(rtype == FTREPR_DFILTER);
-    return (int)strlen(g_regex_get_pattern(fv->value.re));
+    return (int)strlen(fv->value.re->pattern);
 }
 
 static void
 gregex_to_repr(fvalue_t *fv, ftrepr_t rtype, int field_display _U_, char *buf, unsigned int size)
 {
     g_assert(rtype == FTREPR_DFILTER);
-    g_strlcpy(buf, g_regex_get_pattern(fv->value.re), size);
+    g_strlcpy(buf, fv->value.re->pattern, size);
 }
 
 /* BEHOLD - value contains the string representation of the regular expression,
@@ -124,7 +331,7 @@ ftype_register_pcre(void)
     static ftype_t pcre_type = {
         FT_PCRE,            /* ftype */
         "FT_PCRE",          /* name */
-        "Compiled Perl-Compatible Regular Expression (GRegex) object", /* pretty_name */
+        "Compiled Perl-Compatible Regular Expression object", /* pretty_name */
         0,                  /* wire_size */
         gregex_fvalue_new,  /* new_value */
         gregex_fvalue_free, /* free_value */
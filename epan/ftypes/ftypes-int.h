@@ -34,6 +34,11 @@ void ftype_register_time(void);
 void ftype_register_tvbuff(void);
 void ftype_register_pcre(void);
 
+/* Returns TRUE if the FT_PCRE pattern matches the subject, which is
+ * treated as raw bytes. */
+gboolean
+fvalue_regex_matches(const fvalue_regex_t *regex, const char *subject, gsize subject_len);
+
 typedef void (*FvalueNewFunc)(fvalue_t*);
 typedef void (*FvalueFreeFunc)(fvalue_t*);
 
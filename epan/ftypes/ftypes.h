@@ -220,6 +220,9 @@ typedef struct _protocol_value_t
 	gchar		*proto_string;
 } protocol_value_t;
 
+/* Compiled FT_PCRE pattern; opaque outside ftype-pcre.c. */
+typedef struct _fvalue_regex_t fvalue_regex_t;
+
 typedef struct _fvalue_t {
 	ftype_t	*ftype;
 	union {
@@ -238,7 +241,7 @@ typedef struct _fvalue_t {
 		e_guid_t		guid;
 		nstime_t		time;
 		protocol_value_t 	protocol;
-		GRegex			*re;
+		fvalue_regex_t		*re;
 		guint16			sfloat_ieee_11073;
 		guint32			float_ieee_11073;
 	} value;
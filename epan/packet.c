@@ -37,6 +37,7 @@
 #include <epan/expert.h>
 #include <epan/prefs.h>
 #include <epan/range.h>
+#include <epan/conversation.h>
 
 #include <wsutil/str_util.h>
 #include <wsutil/ws_printf.h> /* ws_debug_printf */
@@ -66,7 +67,13 @@ struct data_source {
  * used in that table; not all of them are necessarily in the table,
  * as they may be for protocols that don't have a fixed uint value,
  * e.g. for TCP or UDP port number tables and protocols with no fixed
- * port number.
+ * port number.  Handles are prepended as they're registered, and the
+ * list is only sorted, by protocol filter name, when it's looked at,
+ * if "dissector_handles_sorted" is FALSE; "decode_as_handles" maps
+ * each handle in the list to itself, and "decode_as_protocols" maps
+ * the protocol of each handle to the handle, so that adding handles,
+ * which is done for almost every entry added to the table, doesn't
+ * have to walk the list.
  *
  * "ui_name" is the name the dissector table has in the user interface.
  *
@@ -79,10 +86,29 @@ struct data_source {
  *
  * "protocol" is the protocol associated with the dissector table. Used
  * for determining dependencies.
+ *
+ * "uint_pages" is, for FT_UINT8 and FT_UINT16 tables, a direct-indexed
+ * copy of "hash_table", so that looking up a value, which is done for
+ * almost every packet with tables such as "tcp.port", "udp.port" and
+ * "ethertype", is two loads rather than a hash lookup.  It's an array
+ * of DTBL_PAGE_COUNT pages, indexed by the upper bits of the value, of
+ * DTBL_PAGE_SIZE dtbl_entry_t pointers, indexed by the lower bits; it
+ * is allocated when the first entry is added, and a page is allocated
+ * when the first entry in it is added.  Entries are shared with
+ * "hash_table", so changing an entry's handle, as Decode As does,
+ * needs no updating of the pages; adding or removing an entry does.
  */
+#define DTBL_PAGE_SHIFT	8
+#define DTBL_PAGE_SIZE	(1U << DTBL_PAGE_SHIFT)
+#define DTBL_PAGE_COUNT	(65536U >> DTBL_PAGE_SHIFT)
+
 struct dissector_table {
 	GHashTable	*hash_table;
+	dtbl_entry_t	***uint_pages;
 	GSList		*dissector_handles;
+	gboolean	dissector_handles_sorted;
+	GHashTable	*decode_as_handles;
+	GHashTable	*decode_as_protocols;
 	const char	*ui_name;
 	ftenum_t	type;
 	int		param;
@@ -111,6 +137,7 @@ static GHashTable *registered_dissectors = NULL;
  */
 struct depend_dissector_list {
 	GSList		*dissectors;
+	GHashTable	*dissector_set;	/* the names in "dissectors", for lookups */
 };
 
 /* Maps char *dissector_name to depend_dissector_list_t */
@@ -147,6 +174,7 @@ destroy_depend_dissector_list(void *data)
 	depend_dissector_list_t dissector_list = (depend_dissector_list_t)data;
 	GSList **list = &(dissector_list->dissectors);
 
+	g_hash_table_destroy(dissector_list->dissector_set);
 	g_slist_free_full(*list, g_free);
 	g_slice_free(struct depend_dissector_list, dissector_list);
 }
@@ -157,10 +185,65 @@ destroy_depend_dissector_list(void *data)
 struct heur_dissector_list {
 	protocol_t	*protocol;
 	GSList		*dissectors;
+	guint		generation;	/* changed whenever dissectors is */
 };
 
 static GHashTable *heur_dissector_lists = NULL;
 
+/*
+ * If the "protocols.adaptive_heuristics" preference is set, we remember,
+ * for each conversation and heuristic dissector list, the heuristic
+ * dissector that first accepted a packet of the conversation, and try
+ * it first for later packets of that conversation.  The dissector is
+ * remembered by its short name, as heuristic dissectors can be removed.
+ */
+typedef struct {
+	conversation_t        *conversation;
+	heur_dissector_list_t  list;	/* only used as a key */
+} heur_conv_key_t;
+
+typedef struct {
+	const gchar *short_name;	/* of the dissector that accepted */
+	guint32      first_frame;	/* frame in which it first did */
+} heur_conv_value_t;
+
+static wmem_map_t *heur_conv_cache = NULL;
+
+/*
+ * If the "protocols.adaptive_heuristics" preference is set, the
+ * dissectors in each heuristic dissector list are tried in an order
+ * kept for the current file, which starts out as the registration order
+ * and moves dissectors that have accepted more packets ahead.  The
+ * registered lists themselves are left alone, so that the next file,
+ * or dissection with the preference turned off, starts from the
+ * registration order again.
+ */
+typedef struct {
+	guint               generation;	/* of the list it was made from */
+	guint               count;
+	heur_dtbl_entry_t **entries;	/* in the order to try them */
+	guint32            *hits;	/* packets accepted by each of them */
+} heur_file_order_t;
+
+static wmem_map_t *heur_file_orders = NULL;
+
+static guint
+heur_conv_hash(gconstpointer k)
+{
+	const heur_conv_key_t *key = (const heur_conv_key_t *)k;
+
+	return g_direct_hash(key->conversation) ^ g_direct_hash(key->list);
+}
+
+static gboolean
+heur_conv_equal(gconstpointer k1, gconstpointer k2)
+{
+	const heur_conv_key_t *key1 = (const heur_conv_key_t *)k1;
+	const heur_conv_key_t *key2 = (const heur_conv_key_t *)k2;
+
+	return key1->conversation == key2->conversation && key1->list == key2->list;
+}
+
 /* Name hashtables for fast detection of duplicate names */
 static GHashTable* heuristic_short_names  = NULL;
 
@@ -189,7 +272,18 @@ destroy_dissector_table(void *data)
 	struct dissector_table *table = (struct dissector_table *)data;
 
 	g_hash_table_destroy(table->hash_table);
+	if (table->uint_pages) {
+		guint i;
+
+		for (i = 0; i < DTBL_PAGE_COUNT; i++)
+			g_free(table->uint_pages[i]);
+		g_free(table->uint_pages);
+	}
 	g_slist_free(table->dissector_handles);
+	if (table->decode_as_handles)
+		g_hash_table_destroy(table->decode_as_handles);
+	if (table->decode_as_protocols)
+		g_hash_table_destroy(table->decode_as_protocols);
 	g_slice_free(struct dissector_table, data);
 }
 
@@ -212,6 +306,12 @@ packet_init(void)
 			NULL, destroy_heuristic_dissector_list);
 
 	heuristic_short_names  = g_hash_table_new(g_str_hash, g_str_equal);
+
+	heur_conv_cache = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
+			heur_conv_hash, heur_conv_equal);
+
+	heur_file_orders = wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
+			g_direct_hash, g_direct_equal);
 }
 
 void
@@ -955,10 +1055,72 @@ find_dissector_table(const char *name)
 	return dissector_table;
 }
 
+/* Set the entry for a value in the pages of a uint dissector table,
+   if it has them; a NULL entry removes the value. */
+static void
+uint_pages_set(dissector_table_t sub_dissectors, const guint32 pattern,
+	       dtbl_entry_t *dtbl_entry)
+{
+	dtbl_entry_t **page;
+
+	if (sub_dissectors->type != FT_UINT8 && sub_dissectors->type != FT_UINT16)
+		return;
+	if (pattern > 0xFFFF) {
+		/* Too big for the table's type; leave it to the hash table. */
+		return;
+	}
+
+	if (sub_dissectors->uint_pages == NULL) {
+		if (dtbl_entry == NULL)
+			return;
+		sub_dissectors->uint_pages = g_new0(dtbl_entry_t **, DTBL_PAGE_COUNT);
+	}
+	page = sub_dissectors->uint_pages[pattern >> DTBL_PAGE_SHIFT];
+	if (page == NULL) {
+		if (dtbl_entry == NULL)
+			return;
+		page = g_new0(dtbl_entry_t *, DTBL_PAGE_SIZE);
+		sub_dissectors->uint_pages[pattern >> DTBL_PAGE_SHIFT] = page;
+	}
+	page[pattern & (DTBL_PAGE_SIZE - 1)] = dtbl_entry;
+}
+
+static void
+uint_pages_add_entry(gpointer key, gpointer value, gpointer user_data)
+{
+	uint_pages_set((dissector_table_t)user_data, GPOINTER_TO_UINT(key),
+	    (dtbl_entry_t *)value);
+}
+
+/* Bring the pages of a uint dissector table back in sync with its hash
+   table, after removing an arbitrary set of entries from the latter. */
+static void
+uint_pages_rebuild(dissector_table_t sub_dissectors)
+{
+	guint i;
+
+	if (sub_dissectors->uint_pages == NULL)
+		return;
+	for (i = 0; i < DTBL_PAGE_COUNT; i++) {
+		if (sub_dissectors->uint_pages[i] != NULL)
+			memset(sub_dissectors->uint_pages[i], 0,
+			    DTBL_PAGE_SIZE * sizeof (dtbl_entry_t *));
+	}
+	g_hash_table_foreach(sub_dissectors->hash_table, uint_pages_add_entry,
+	    sub_dissectors);
+}
+
 /* Find an entry in a uint dissector table. */
 static dtbl_entry_t *
 find_uint_dtbl_entry(dissector_table_t sub_dissectors, const guint32 pattern)
 {
+	dtbl_entry_t **page;
+
+	if (sub_dissectors->uint_pages != NULL && pattern <= 0xFFFF) {
+		page = sub_dissectors->uint_pages[pattern >> DTBL_PAGE_SHIFT];
+		return page != NULL ? page[pattern & (DTBL_PAGE_SIZE - 1)] : NULL;
+	}
+
 	switch (sub_dissectors->type) {
 
 	case FT_UINT8:
@@ -1067,6 +1229,7 @@ dissector_add_uint(const char *name, const guint32 pattern, dissector_handle_t h
 	/* do the table insertion */
 	g_hash_table_insert(sub_dissectors->hash_table,
 			     GUINT_TO_POINTER(pattern), (gpointer)dtbl_entry);
+	uint_pages_set(sub_dissectors, pattern, dtbl_entry);
 
 	/*
 	 * Now, if this table supports "Decode As", add this handle
@@ -1226,6 +1389,7 @@ dissector_delete_uint(const char *name, const guint32 pattern,
 		/*
 		 * Found - remove it.
 		 */
+		uint_pages_set(sub_dissectors, pattern, NULL);
 		g_hash_table_remove(sub_dissectors->hash_table,
 				    GUINT_TO_POINTER(pattern));
 	}
@@ -1269,6 +1433,7 @@ void dissector_delete_all(const char *name, dissector_handle_t handle)
 	g_assert (sub_dissectors);
 
 	g_hash_table_foreach_remove (sub_dissectors->hash_table, dissector_delete_all_check, handle);
+	uint_pages_rebuild(sub_dissectors);
 }
 
 static void
@@ -1278,7 +1443,15 @@ dissector_delete_from_table(gpointer key _U_, gpointer value, gpointer user_data
 	g_assert (sub_dissectors);
 
 	g_hash_table_foreach_remove(sub_dissectors->hash_table, dissector_delete_all_check, user_data);
-	sub_dissectors->dissector_handles = g_slist_remove(sub_dissectors->dissector_handles, user_data);
+	uint_pages_rebuild(sub_dissectors);
+	if (sub_dissectors->decode_as_handles &&
+	    g_hash_table_remove(sub_dissectors->decode_as_handles, user_data)) {
+		dissector_handle_t handle = (dissector_handle_t)user_data;
+
+		sub_dissectors->dissector_handles = g_slist_remove(sub_dissectors->dissector_handles, handle);
+		if (g_hash_table_lookup(sub_dissectors->decode_as_protocols, handle->protocol) == handle)
+			g_hash_table_remove(sub_dissectors->decode_as_protocols, handle->protocol);
+	}
 }
 
 /* Delete handle from all tables and dissector_handles lists */
@@ -1323,6 +1496,7 @@ dissector_change_uint(const char *name, const guint32 pattern, dissector_handle_
 	/* do the table insertion */
 	g_hash_table_insert(sub_dissectors->hash_table,
 			     GUINT_TO_POINTER(pattern), (gpointer)dtbl_entry);
+	uint_pages_set(sub_dissectors, pattern, dtbl_entry);
 }
 
 /* Reset an entry in a uint dissector table to its initial value. */
@@ -1349,6 +1523,7 @@ dissector_reset_uint(const char *name, const guint32 pattern)
 	if (dtbl_entry->initial != NULL) {
 		dtbl_entry->current = dtbl_entry->initial;
 	} else {
+		uint_pages_set(sub_dissectors, pattern, NULL);
 		g_hash_table_remove(sub_dissectors->hash_table,
 				    GUINT_TO_POINTER(pattern));
 	}
@@ -2008,7 +2183,6 @@ void
 dissector_add_for_decode_as(const char *name, dissector_handle_t handle)
 {
 	dissector_table_t  sub_dissectors = find_dissector_table(name);
-	GSList            *entry;
 	dissector_handle_t dup_handle;
 
 	/*
@@ -2048,9 +2222,13 @@ dissector_add_for_decode_as(const char *name, dissector_handle_t handle)
 	if (sub_dissectors->protocol != NULL)
 		register_depend_dissector(proto_get_protocol_short_name(sub_dissectors->protocol), proto_get_protocol_short_name(handle->protocol));
 
+	if (sub_dissectors->decode_as_handles == NULL) {
+		sub_dissectors->decode_as_handles = g_hash_table_new(g_direct_hash, g_direct_equal);
+		sub_dissectors->decode_as_protocols = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+
 	/* Is it already in this list? */
-	entry = g_slist_find(sub_dissectors->dissector_handles, (gpointer)handle);
-	if (entry != NULL) {
+	if (g_hash_table_contains(sub_dissectors->decode_as_handles, handle)) {
 		/*
 		 * Yes - don't insert it again.
 		 */
@@ -2064,32 +2242,49 @@ dissector_add_for_decode_as(const char *name, dissector_handle_t handle)
 	   so we don't do the check for them. */
 	if (sub_dissectors->type != FT_STRING)
 	{
-		for (entry = sub_dissectors->dissector_handles; entry != NULL; entry = g_slist_next(entry))
+		dup_handle = (dissector_handle_t)g_hash_table_lookup(sub_dissectors->decode_as_protocols, handle->protocol);
+		if (dup_handle != NULL)
 		{
-			dup_handle = (dissector_handle_t)entry->data;
-			if (dup_handle->protocol == handle->protocol)
-			{
-				const char *dissector_name, *dup_dissector_name;
-
-				dissector_name = dissector_handle_get_dissector_name(handle);
-				if (dissector_name == NULL)
-					dissector_name = "(anonymous)";
-				dup_dissector_name = dissector_handle_get_dissector_name(dup_handle);
-				if (dup_dissector_name == NULL)
-					dup_dissector_name = "(anonymous)";
-				fprintf(stderr, "Duplicate dissectors %s and %s for protocol %s in dissector table %s\n",
-				    dissector_name, dup_dissector_name,
-				    proto_get_protocol_short_name(handle->protocol),
-				    name);
-				if (wireshark_abort_on_dissector_bug)
-					abort();
-			}
+			const char *dissector_name, *dup_dissector_name;
+
+			dissector_name = dissector_handle_get_dissector_name(handle);
+			if (dissector_name == NULL)
+				dissector_name = "(anonymous)";
+			dup_dissector_name = dissector_handle_get_dissector_name(dup_handle);
+			if (dup_dissector_name == NULL)
+				dup_dissector_name = "(anonymous)";
+			fprintf(stderr, "Duplicate dissectors %s and %s for protocol %s in dissector table %s\n",
+			    dissector_name, dup_dissector_name,
+			    proto_get_protocol_short_name(handle->protocol),
+			    name);
+			if (wireshark_abort_on_dissector_bug)
+				abort();
 		}
 	}
 
-	/* Add it to the list. */
+	/* Add it to the list; it's sorted when it's next looked at. */
 	sub_dissectors->dissector_handles =
-		g_slist_insert_sorted(sub_dissectors->dissector_handles, (gpointer)handle, (GCompareFunc)dissector_compare_filter_name);
+		g_slist_prepend(sub_dissectors->dissector_handles, (gpointer)handle);
+	sub_dissectors->dissector_handles_sorted = FALSE;
+	g_hash_table_insert(sub_dissectors->decode_as_handles, handle, handle);
+	if (!g_hash_table_contains(sub_dissectors->decode_as_protocols, handle->protocol))
+		g_hash_table_insert(sub_dissectors->decode_as_protocols, handle->protocol, handle);
+}
+
+/* Get the list of handles that could be used with a table, sorted by
+   protocol filter name. */
+static GSList *
+dissector_table_sorted_handles(dissector_table_t sub_dissectors)
+{
+	if (!sub_dissectors->dissector_handles_sorted) {
+		/* g_slist_sort() is stable, and handles were prepended, so
+		   handles with the same name end up in the reverse of the
+		   order in which they were added, as with g_slist_insert_sorted(). */
+		sub_dissectors->dissector_handles =
+			g_slist_sort(sub_dissectors->dissector_handles, (GCompareFunc)dissector_compare_filter_name);
+		sub_dissectors->dissector_handles_sorted = TRUE;
+	}
+	return sub_dissectors->dissector_handles;
 }
 
 void dissector_add_for_decode_as_with_preference(const char *name,
@@ -2115,7 +2310,7 @@ dissector_table_get_dissector_handles(dissector_table_t dissector_table) {
 	if (!dissector_table)
 		return NULL;
 
-	return dissector_table->dissector_handles;
+	return dissector_table_sorted_handles(dissector_table);
 }
 
 /*
@@ -2148,7 +2343,7 @@ dissector_handle_t dissector_table_get_dissector_handle(dissector_table_t dissec
 	lookup.dissector_short_name = short_name;
 	lookup.handle = NULL;
 
-	g_slist_foreach(dissector_table->dissector_handles, find_dissector_in_table, &lookup);
+	g_slist_foreach(dissector_table_sorted_handles(dissector_table), find_dissector_in_table, &lookup);
 	return lookup.handle;
 }
 
@@ -2292,7 +2487,7 @@ dissector_table_foreach_handle(const char     *table_name,
 	dissector_table_t sub_dissectors = find_dissector_table(table_name);
 	GSList *tmp;
 
-	for (tmp = sub_dissectors->dissector_handles; tmp != NULL;
+	for (tmp = dissector_table_sorted_handles(sub_dissectors); tmp != NULL;
 	     tmp = g_slist_next(tmp))
         func(table_name, tmp->data, user_data);
 }
@@ -2482,7 +2677,11 @@ register_dissector_table(const char *name, const char *ui_name, const int proto,
 		g_error("The dissector table %s (%s) is registering an unsupported type - are you using a buggy plugin?", name, ui_name);
 		g_assert_not_reached();
 	}
+	sub_dissectors->uint_pages = NULL;
 	sub_dissectors->dissector_handles = NULL;
+	sub_dissectors->dissector_handles_sorted = TRUE;
+	sub_dissectors->decode_as_handles = NULL;
+	sub_dissectors->decode_as_protocols = NULL;
 	sub_dissectors->ui_name = ui_name;
 	sub_dissectors->type    = type;
 	sub_dissectors->param   = param;
@@ -2511,7 +2710,11 @@ dissector_table_t register_custom_dissector_table(const char *name,
 							       &g_free,
 							       &g_free);
 
+	sub_dissectors->uint_pages = NULL;
 	sub_dissectors->dissector_handles = NULL;
+	sub_dissectors->dissector_handles_sorted = TRUE;
+	sub_dissectors->decode_as_handles = NULL;
+	sub_dissectors->decode_as_protocols = NULL;
 	sub_dissectors->ui_name = ui_name;
 	sub_dissectors->type    = FT_BYTES; /* Consider key a "blob" of data, no need to really create new type */
 	sub_dissectors->param   = BASE_NONE;
@@ -2690,6 +2893,7 @@ heur_dissector_add(const char *name, heur_dissector_t dissector, const char *dis
 
 	sub_dissectors->dissectors = g_slist_prepend(sub_dissectors->dissectors,
 	    (gpointer)hdtbl_entry);
+	sub_dissectors->generation++;
 
 	/* XXX - could be optimized to pass hdtbl_entry directly */
 	proto_add_heuristic_dissector(hdtbl_entry->protocol, hdtbl_entry->short_name);
@@ -2735,9 +2939,189 @@ heur_dissector_delete(const char *name, heur_dissector_t dissector, const int pr
 		g_slice_free(heur_dtbl_entry_t, found_entry->data);
 		sub_dissectors->dissectors = g_slist_delete_link(sub_dissectors->dissectors,
 		    found_entry);
+		sub_dissectors->generation++;
+	}
+}
+
+/* Call one heuristic dissector; returns what it returned. */
+static int
+call_heur_dtbl_entry(heur_dtbl_entry_t *hdtbl_entry, tvbuff_t *tvb,
+			packet_info *pinfo, proto_tree *tree, void *data,
+			guint saved_layers_len, int saved_tree_count)
+{
+	int                proto_id;
+	int                len;
+
+	if (hdtbl_entry->protocol != NULL) {
+		proto_id = proto_get_id(hdtbl_entry->protocol);
+		/* do NOT change this behavior - wslua uses the protocol short name set here in order
+		   to determine which Lua-based heurisitc dissector to call */
+		pinfo->current_proto =
+			proto_get_protocol_short_name(hdtbl_entry->protocol);
+
+		/*
+		 * Add the protocol name to the layers; we'll remove it
+		 * if the dissector fails.
+		 */
+		pinfo->curr_layer_num++;
+		wmem_list_append(pinfo->layers, GINT_TO_POINTER(proto_id));
+	}
+
+	pinfo->heur_list_name = hdtbl_entry->list_name;
+
+	len = (hdtbl_entry->dissector)(tvb, pinfo, tree, data);
+	if (hdtbl_entry->protocol != NULL &&
+		(len == 0 || (tree && saved_tree_count == tree->tree_data->count))) {
+		/*
+		 * We added a protocol layer above. The dissector
+		 * didn't accept the packet or it didn't add any
+		 * items to the tree so remove it from the list.
+		 */
+		while (wmem_list_count(pinfo->layers) > saved_layers_len) {
+			if (len == 0) {
+				/*
+				 * Only reduce the layer number if the dissector
+				 * rejected the data. Since tree can be NULL on
+				 * the first pass, we cannot check it or it will
+				 * break dissectors that rely on a stable value.
+				 */
+				pinfo->curr_layer_num--;
+			}
+			wmem_list_remove_frame(pinfo->layers, wmem_list_tail(pinfo->layers));
+		}
+	}
+	return len;
+}
+
+static gboolean
+heur_dtbl_entry_is_enabled(const heur_dtbl_entry_t *hdtbl_entry)
+{
+	return hdtbl_entry->protocol == NULL ||
+		(proto_is_protocol_enabled(hdtbl_entry->protocol) && hdtbl_entry->enabled);
+}
+
+/* Look up the heuristic dissector that accepted an earlier packet of
+   the conversation to which this packet belongs. */
+static heur_dtbl_entry_t *
+heur_conv_cache_lookup(heur_dissector_list_t sub_dissectors, conversation_t *conversation,
+			guint32 frame)
+{
+	heur_conv_key_t    key;
+	heur_conv_value_t *value;
+	heur_dtbl_entry_t *hdtbl_entry;
+
+	key.conversation = conversation;
+	key.list = sub_dissectors;
+	value = (heur_conv_value_t *)wmem_map_lookup(heur_conv_cache, &key);
+	if (value == NULL || frame < value->first_frame)
+		return NULL;
+
+	hdtbl_entry = (heur_dtbl_entry_t *)g_hash_table_lookup(heuristic_short_names, value->short_name);
+	if (hdtbl_entry == NULL || !heur_dtbl_entry_is_enabled(hdtbl_entry))
+		return NULL;
+	return hdtbl_entry;
+}
+
+static void
+heur_conv_cache_add(heur_dissector_list_t sub_dissectors, conversation_t *conversation,
+			guint32 frame, const heur_dtbl_entry_t *hdtbl_entry)
+{
+	heur_conv_key_t    key, *new_key;
+	heur_conv_value_t *value;
+
+	key.conversation = conversation;
+	key.list = sub_dissectors;
+	value = (heur_conv_value_t *)wmem_map_lookup(heur_conv_cache, &key);
+	if (value != NULL) {
+		/* Keep the dissector that claimed the conversation first, so
+		   that redissecting a frame after it tries the same dissector
+		   first as the first pass did; a later packet that another
+		   dissector accepts doesn't change that. */
+		if (frame < value->first_frame &&
+		    strcmp(value->short_name, hdtbl_entry->short_name) == 0)
+			value->first_frame = frame;
+		return;
+	}
+	new_key = wmem_new(wmem_file_scope(), heur_conv_key_t);
+	*new_key = key;
+	value = wmem_new(wmem_file_scope(), heur_conv_value_t);
+	value->short_name = wmem_strdup(wmem_file_scope(), hdtbl_entry->short_name);
+	value->first_frame = frame;
+	wmem_map_insert(heur_conv_cache, new_key, value);
+}
+
+/* Get the order in which to try the dissectors in a heuristic dissector
+   list for the current file, making it from the list if the file doesn't
+   have one yet, or if dissectors have been added to or removed from the
+   list since it was made. */
+static heur_file_order_t *
+heur_file_order_get(heur_dissector_list_t sub_dissectors)
+{
+	heur_file_order_t *order;
+	GSList            *entry;
+	guint              i;
+
+	order = (heur_file_order_t *)wmem_map_lookup(heur_file_orders, sub_dissectors);
+	if (order != NULL && order->generation == sub_dissectors->generation)
+		return order;
+
+	if (order == NULL) {
+		order = wmem_new(wmem_file_scope(), heur_file_order_t);
+		wmem_map_insert(heur_file_orders, sub_dissectors, order);
+	}
+	order->generation = sub_dissectors->generation;
+	order->count = g_slist_length(sub_dissectors->dissectors);
+	order->entries = wmem_alloc_array(wmem_file_scope(), heur_dtbl_entry_t *, order->count);
+	order->hits = wmem_alloc0_array(wmem_file_scope(), guint32, order->count);
+	for (entry = sub_dissectors->dissectors, i = 0; entry != NULL;
+	    entry = g_slist_next(entry), i++)
+		order->entries[i] = (heur_dtbl_entry_t *)entry->data;
+	return order;
+}
+
+/* Count a packet accepted by a heuristic dissector, and move it ahead of
+   the one before it if it has now accepted more packets, so that the
+   order ends up sorted by the number of packets accepted.  "i" is where
+   we expect to find the dissector; nested calls might have moved it. */
+static void
+heur_file_order_count_hit(heur_file_order_t *order, guint i,
+			const heur_dtbl_entry_t *hdtbl_entry)
+{
+	heur_dtbl_entry_t *prev_entry;
+	guint32            prev_hits;
+
+	if (i >= order->count || order->entries[i] != hdtbl_entry) {
+		for (i = 0; i < order->count; i++) {
+			if (order->entries[i] == hdtbl_entry)
+				break;
+		}
+		if (i == order->count)
+			return;
+	}
+
+	if (order->hits[i] < G_MAXUINT32)
+		order->hits[i]++;
+	if (i > 0 && order->hits[i - 1] < order->hits[i]) {
+		prev_entry = order->entries[i - 1];
+		prev_hits = order->hits[i - 1];
+		order->entries[i - 1] = order->entries[i];
+		order->hits[i - 1] = order->hits[i];
+		order->entries[i] = prev_entry;
+		order->hits[i] = prev_hits;
 	}
 }
 
+/* Try all the dissectors in a given heuristic dissector list. This
+ * is done until we find one that recognizes the protocol.
+ * Return TRUE if we find one that recognizes the protocol,
+ * FALSE if not.
+ *
+ * If the "protocols.adaptive_heuristics" preference is set, the
+ * dissector that accepted an earlier packet of the same conversation
+ * is tried first, and the others are tried in the order kept for the
+ * current file, by the number of packets they accepted the first time
+ * the packets before this one were dissected.
+ */
 gboolean
 dissector_try_heuristic(heur_dissector_list_t sub_dissectors, tvbuff_t *tvb,
 			packet_info *pinfo, proto_tree *tree, heur_dtbl_entry_t **heur_dtbl_entry, void *data)
@@ -2746,10 +3130,13 @@ dissector_try_heuristic(heur_dissector_list_t sub_dissectors, tvbuff_t *tvb,
 	const char        *saved_curr_proto;
 	const char        *saved_heur_list_name;
 	GSList            *entry;
+	heur_file_order_t *order = NULL;
+	guint              i;
 	guint16            saved_can_desegment;
 	guint              saved_layers_len = 0;
 	heur_dtbl_entry_t *hdtbl_entry;
-	int                proto_id;
+	heur_dtbl_entry_t *cached_entry = NULL;
+	conversation_t    *conversation = NULL;
 	int                len;
 	int                saved_tree_count = tree ? tree->tree_data->count : 0;
 
@@ -2775,62 +3162,62 @@ dissector_try_heuristic(heur_dissector_list_t sub_dissectors, tvbuff_t *tvb,
 
 	DISSECTOR_ASSERT(saved_layers_len < PINFO_LAYER_MAX_RECURSION_DEPTH);
 
-	for (entry = sub_dissectors->dissectors; entry != NULL;
-	    entry = g_slist_next(entry)) {
+	if (prefs.adaptive_heuristics) {
+		order = heur_file_order_get(sub_dissectors);
+		conversation = find_conversation_pinfo(pinfo, 0);
+		if (conversation != NULL)
+			cached_entry = heur_conv_cache_lookup(sub_dissectors, conversation, pinfo->num);
+		if (cached_entry != NULL) {
+			len = call_heur_dtbl_entry(cached_entry, tvb, pinfo, tree, data,
+			    saved_layers_len, saved_tree_count);
+			if (len) {
+				if (!pinfo->fd->visited)
+					heur_file_order_count_hit(order, order->count, cached_entry);
+				*heur_dtbl_entry = cached_entry;
+				status = TRUE;
+			}
+		}
+	}
+
+	entry = sub_dissectors->dissectors;
+	for (i = 0; !status; i++) {
+		if (order != NULL) {
+			if (i >= order->count)
+				break;
+			hdtbl_entry = order->entries[i];
+		} else {
+			if (entry == NULL)
+				break;
+			hdtbl_entry = (heur_dtbl_entry_t *)entry->data;
+			entry = g_slist_next(entry);
+		}
+
 		/* XXX - why set this now and above? */
 		pinfo->can_desegment = saved_can_desegment-(saved_can_desegment>0);
-		hdtbl_entry = (heur_dtbl_entry_t *)entry->data;
 
-		if (hdtbl_entry->protocol != NULL &&
-			(!proto_is_protocol_enabled(hdtbl_entry->protocol)||(hdtbl_entry->enabled==FALSE))) {
+		if (!heur_dtbl_entry_is_enabled(hdtbl_entry)) {
 			/*
 			 * No - don't try this dissector.
 			 */
 			continue;
 		}
 
-		if (hdtbl_entry->protocol != NULL) {
-			proto_id = proto_get_id(hdtbl_entry->protocol);
-			/* do NOT change this behavior - wslua uses the protocol short name set here in order
-			   to determine which Lua-based heurisitc dissector to call */
-			pinfo->current_proto =
-				proto_get_protocol_short_name(hdtbl_entry->protocol);
-
-			/*
-			 * Add the protocol name to the layers; we'll remove it
-			 * if the dissector fails.
-			 */
-			pinfo->curr_layer_num++;
-			wmem_list_append(pinfo->layers, GINT_TO_POINTER(proto_id));
+		if (hdtbl_entry == cached_entry) {
+			/* We've already tried it. */
+			continue;
 		}
 
-		pinfo->heur_list_name = hdtbl_entry->list_name;
-
-		len = (hdtbl_entry->dissector)(tvb, pinfo, tree, data);
-		if (hdtbl_entry->protocol != NULL &&
-			(len == 0 || (tree && saved_tree_count == tree->tree_data->count))) {
-			/*
-			 * We added a protocol layer above. The dissector
-			 * didn't accept the packet or it didn't add any
-			 * items to the tree so remove it from the list.
-			 */
-			while (wmem_list_count(pinfo->layers) > saved_layers_len) {
-				if (len == 0) {
-					/*
-					 * Only reduce the layer number if the dissector
-					 * rejected the data. Since tree can be NULL on
-					 * the first pass, we cannot check it or it will
-					 * break dissectors that rely on a stable value.
-					 */
-					pinfo->curr_layer_num--;
-				}
-				wmem_list_remove_frame(pinfo->layers, wmem_list_tail(pinfo->layers));
-			}
-		}
+		len = call_heur_dtbl_entry(hdtbl_entry, tvb, pinfo, tree, data,
+		    saved_layers_len, saved_tree_count);
 		if (len) {
 			*heur_dtbl_entry = hdtbl_entry;
 			status = TRUE;
-			break;
+			if (order != NULL) {
+				if (conversation != NULL)
+					heur_conv_cache_add(sub_dissectors, conversation, pinfo->num, hdtbl_entry);
+				if (!pinfo->fd->visited)
+					heur_file_order_count_hit(order, i, hdtbl_entry);
+			}
 		}
 	}
 
@@ -2988,6 +3375,7 @@ register_heur_dissector_list(const char *name, const int proto)
 	sub_dissectors = g_slice_new(struct heur_dissector_list);
 	sub_dissectors->protocol  = find_protocol_by_id(proto);
 	sub_dissectors->dissectors = NULL;	/* initially empty */
+	sub_dissectors->generation = 0;
 	g_hash_table_insert(heur_dissector_lists, (gpointer)name,
 			    (gpointer) sub_dissectors);
 	return sub_dissectors;
@@ -3159,10 +3547,14 @@ remove_depend_dissector_from_list(depend_dissector_list_t sub_dissectors, const
 {
 	GSList *found_entry;
 
+	if (!g_hash_table_contains(sub_dissectors->dissector_set, dependent))
+		return FALSE;
+
 	found_entry = g_slist_find_custom(sub_dissectors->dissectors,
 		dependent, (GCompareFunc)strcmp);
 
 	if (found_entry) {
+		g_hash_table_remove(sub_dissectors->dissector_set, found_entry->data);
 		g_free(found_entry->data);
 		sub_dissectors->dissectors = g_slist_delete_link(sub_dissectors->dissectors, found_entry);
 		return TRUE;
@@ -3314,18 +3706,9 @@ void call_heur_dissector_direct(heur_dtbl_entry_t *heur_dtbl_entry, tvbuff_t *tv
 
 }
 
-static gint
-find_matching_proto_name(gconstpointer arg1, gconstpointer arg2)
-{
-	const char    *protocol_name = (const char*)arg1;
-	const gchar   *name   = (const gchar *)arg2;
-
-	return strcmp(protocol_name, name);
-}
-
 gboolean register_depend_dissector(const char* parent, const char* dependent)
 {
-	GSList                *list_entry;
+	gchar                 *dependent_copy;
 	depend_dissector_list_t sub_dissectors;
 
 	if ((parent == NULL) || (dependent == NULL))
@@ -3339,15 +3722,17 @@ gboolean register_depend_dissector(const char* parent, const char* dependent)
 		/* parent protocol doesn't exist, create it */
 		sub_dissectors = g_slice_new(struct depend_dissector_list);
 		sub_dissectors->dissectors = NULL;	/* initially empty */
+		sub_dissectors->dissector_set = g_hash_table_new(g_str_hash, g_str_equal);
 		g_hash_table_insert(depend_dissector_lists, (gpointer)g_strdup(parent), (gpointer) sub_dissectors);
 	}
 
 	/* Verify that sub-dissector is not already in the list */
-	list_entry = g_slist_find_custom(sub_dissectors->dissectors, (gpointer)dependent, find_matching_proto_name);
-	if (list_entry != NULL)
+	if (g_hash_table_contains(sub_dissectors->dissector_set, dependent))
 		return TRUE; /* Dependency already exists */
 
-	sub_dissectors->dissectors = g_slist_prepend(sub_dissectors->dissectors, (gpointer)g_strdup(dependent));
+	dependent_copy = g_strdup(dependent);
+	sub_dissectors->dissectors = g_slist_prepend(sub_dissectors->dissectors, (gpointer)dependent_copy);
+	g_hash_table_add(sub_dissectors->dissector_set, dependent_copy);
 	return TRUE;
 }
 
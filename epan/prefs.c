@@ -3415,6 +3415,15 @@ prefs_register_modules(void)
                                    "Show the intelligent scroll bar (a minimap of packet list colors in the scrollbar)",
                                    &prefs.gui_packet_list_show_minimap);
 
+    prefs_register_bool_preference(gui_module, "use_capture_index",
+                                   "Use capture file indexes",
+                                   "Save an index of each capture file that is read (as \"<file>.wsidx\") and use "
+                                   "it to open the file again without reading and dissecting every packet. Packets "
+                                   "are then dissected as they are displayed, so information that depends on earlier "
+                                   "packets may be missing until the packets are redissected. For gzip-compressed "
+                                   "files, the places in the file where decompression can start are also saved, in "
+                                   "the user's cache directory",
+                                   &prefs.gui_use_capture_index);
 
     prefs_register_bool_preference(gui_module, "interfaces_show_hidden",
                                    "Show hidden interfaces",
@@ -3680,6 +3689,35 @@ prefs_register_modules(void)
                                    "Currently only ICMP and ICMPv6 use this preference to add VLAN ID to conversation tracking",
                                    &prefs.strict_conversation_tracking_heuristics);
 
+    prefs_register_bool_preference(protocols_module, "adaptive_heuristics",
+                                   "Remember which heuristic dissectors match each conversation",
+                                   "Try the heuristic dissector that accepted an earlier packet of a conversation first "
+                                   "for later packets of that conversation, and try the others in order of how many "
+                                   "packets they have accepted. This is faster, but which dissector is used for a "
+                                   "packet that more than one would accept may then depend on the packets dissected before it.",
+                                   &prefs.adaptive_heuristics);
+
+    prefs_register_uint_preference(protocols_module, "reassembly_memory_limit",
+                                   "Maximum memory for incomplete reassemblies (MB)",
+                                   "If the fragments held for incomplete reassemblies in a reassembly table take up "
+                                   "more than this many megabytes, discard the reassemblies to which no fragment has "
+                                   "been added for the longest time. 0 means no limit.",
+                                   10, &prefs.reassembly_memory_limit);
+
+    prefs_register_uint_preference(protocols_module, "reassembly_spill_threshold",
+                                   "Keep reassembled data larger than this on disk (KB)",
+                                   "Write reassembled packets of at least this many kilobytes to a temporary file "
+                                   "and map them back into memory when needed, instead of keeping them in memory. "
+                                   "0 disables this. Not supported on Windows.",
+                                   10, &prefs.reassembly_spill_threshold);
+
+    prefs_register_bool_preference(protocols_module, "reassembly_zero_copy",
+                                   "Reassemble packets without copying their fragments",
+                                   "Make a reassembled packet refer to the data of its fragments instead of copying "
+                                   "that data into a new buffer, if the fragments don't overlap. Data that spans "
+                                   "fragments is still copied if a dissector needs it to be contiguous.",
+                                   &prefs.reassembly_zero_copy);
+
     /* Obsolete preferences
      * These "modules" were reorganized/renamed to correspond to their GUI
      * configuration screen within the preferences dialog
@@ -4128,6 +4166,7 @@ pre_init_prefs(void)
     prefs.gui_packet_list_elide_mode = ELIDE_RIGHT;
     prefs.gui_packet_list_show_related = TRUE;
     prefs.gui_packet_list_show_minimap = TRUE;
+    prefs.gui_use_capture_index = FALSE;
     g_free (prefs.gui_interfaces_hide_types);
     prefs.gui_interfaces_hide_types = g_strdup("");
     prefs.gui_interfaces_show_hidden = FALSE;
@@ -4191,6 +4230,10 @@ pre_init_prefs(void)
     prefs.st_sort_showfullname = FALSE;
     prefs.display_hidden_proto_items = FALSE;
     prefs.display_byte_fields_with_spaces = FALSE;
+    prefs.adaptive_heuristics = FALSE;
+    prefs.reassembly_memory_limit = 0;
+    prefs.reassembly_spill_threshold = 0;
+    prefs.reassembly_zero_copy = FALSE;
 }
 
 /*
@@ -342,20 +342,116 @@ static GPtrArray *deregistered_data = NULL;
 /* indexed by prefix, contains initializers */
 static GHashTable* prefixes = NULL;
 
+/*
+ * The proto_nodes and field_infos of a protocol tree are allocated from
+ * a slab of fixed-size chunks that belongs to the tree, rather than from
+ * pinfo->pool, so that they're laid out contiguously in the order in
+ * which they're added, without the overhead of a general-purpose
+ * allocator.  Nothing is ever freed individually; proto_tree_reset()
+ * rewinds the slab to the start of its first chunk, keeping the chunks
+ * for the next packet, and proto_tree_free() frees them.
+ */
+#define PROTO_SLAB_CHUNK_SIZE	(64 * 1024)
+#define PROTO_SLAB_ALIGN_AMOUNT	(2 * sizeof (gsize))
+#define PROTO_SLAB_ALIGN_SIZE(SIZE) ((~(PROTO_SLAB_ALIGN_AMOUNT-1)) & \
+		((SIZE) + (PROTO_SLAB_ALIGN_AMOUNT-1)))
+
+typedef struct _proto_slab_chunk {
+	struct _proto_slab_chunk *next;
+	/* Followed by the chunk's space, suitably aligned. */
+} proto_slab_chunk_t;
+
+#define PROTO_SLAB_HEADER_SIZE	PROTO_SLAB_ALIGN_SIZE(sizeof(proto_slab_chunk_t))
+
+typedef struct _proto_slab {
+	proto_slab_chunk_t *first;
+	proto_slab_chunk_t *current;
+	guint8             *free_ptr;	/* next free byte in the current chunk */
+	guint8             *end;	/* end of the current chunk */
+} proto_slab_t;
+
+static void
+proto_slab_use_chunk(proto_slab_t *slab, proto_slab_chunk_t *chunk)
+{
+	slab->current  = chunk;
+	slab->free_ptr = (guint8 *)chunk + PROTO_SLAB_HEADER_SIZE;
+	slab->end      = (guint8 *)chunk + PROTO_SLAB_CHUNK_SIZE;
+}
+
+static proto_slab_t *
+proto_slab_new(void)
+{
+	proto_slab_t *slab = g_new(proto_slab_t, 1);
+
+	slab->first = (proto_slab_chunk_t *)g_malloc(PROTO_SLAB_CHUNK_SIZE);
+	slab->first->next = NULL;
+	proto_slab_use_chunk(slab, slab->first);
+	return slab;
+}
+
+static void *
+proto_slab_alloc_slow(proto_slab_t *slab, size_t size)
+{
+	proto_slab_chunk_t *chunk = slab->current->next;
+
+	if (chunk == NULL) {
+		/* We've used all the chunks we have; add another one. */
+		chunk = (proto_slab_chunk_t *)g_malloc(PROTO_SLAB_CHUNK_SIZE);
+		chunk->next = NULL;
+		slab->current->next = chunk;
+	}
+	proto_slab_use_chunk(slab, chunk);
+	slab->free_ptr += size;
+	return slab->free_ptr - size;
+}
+
+/* "size" must be a multiple of the alignment, and much less than the
+ * chunk size; it's always the size of a proto_node or field_info. */
+static inline void *
+proto_slab_alloc(proto_slab_t *slab, size_t size)
+{
+	guint8 *p = slab->free_ptr;
+
+	if (G_UNLIKELY((size_t)(slab->end - p) < size))
+		return proto_slab_alloc_slow(slab, size);
+	slab->free_ptr = p + size;
+	return p;
+}
+
+static void
+proto_slab_reset(proto_slab_t *slab)
+{
+	proto_slab_use_chunk(slab, slab->first);
+}
+
+static void
+proto_slab_free(proto_slab_t *slab)
+{
+	proto_slab_chunk_t *chunk, *next;
+
+	for (chunk = slab->first; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		g_free(chunk);
+	}
+	g_free(slab);
+}
+
 /* Contains information about a field when a dissector calls
  * proto_tree_add_item.  */
-#define FIELD_INFO_NEW(pool, fi)  fi = wmem_new(pool, field_info)
-#define FIELD_INFO_FREE(pool, fi) wmem_free(pool, fi)
+#define FIELD_INFO_NEW(tree, fi)			\
+	fi = (field_info *)proto_slab_alloc(PTREE_DATA(tree)->slab,	\
+	    PROTO_SLAB_ALIGN_SIZE(sizeof(field_info)))
 
 /* Contains the space for proto_nodes. */
+#define PROTO_NODE_NEW(tree, node)			\
+	node = (proto_node *)proto_slab_alloc(PTREE_DATA(tree)->slab,	\
+	    PROTO_SLAB_ALIGN_SIZE(sizeof(proto_node)))
+
 #define PROTO_NODE_INIT(node)			\
 	node->first_child = NULL;		\
 	node->last_child = NULL;		\
 	node->next = NULL;
 
-#define PROTO_NODE_FREE(pool, node)			\
-	wmem_free(pool, node)
-
 /* String space for protocol and field items for the GUI */
 #define ITEM_LABEL_NEW(pool, il)			\
 	il = wmem_new(pool, item_label_t);
@@ -749,6 +845,9 @@ proto_tree_reset(proto_tree *tree)
 	/* Reset track of the number of children */
 	tree_data->count = 0;
 
+	/* All the nodes are gone; reuse their space. */
+	proto_slab_reset(tree_data->slab);
+
 	PROTO_NODE_INIT(tree);
 }
 
@@ -770,6 +869,8 @@ proto_tree_free(proto_tree *tree)
 		g_hash_table_destroy(tree_data->interesting_hfids);
 	}
 
+	proto_slab_free(tree_data->slab);
+
 	g_slice_free(tree_data_t, tree_data);
 
 	g_slice_free(proto_tree, tree);
@@ -5707,7 +5808,7 @@ proto_tree_add_node(proto_tree *tree, field_info *fi)
 		/* XXX - is it safe to continue here? */
 	}
 
-	pnode = wmem_new(PNODE_POOL(tree), proto_node);
+	PROTO_NODE_NEW(tree, pnode);
 	PROTO_NODE_INIT(pnode);
 	pnode->parent = tnode;
 	PNODE_FINFO(pnode) = fi;
@@ -6034,7 +6135,7 @@ new_field_info(proto_tree *tree, header_field_info *hfinfo, tvbuff_t *tvb,
 {
 	field_info *fi;
 
-	FIELD_INFO_NEW(PNODE_POOL(tree), fi);
+	FIELD_INFO_NEW(tree, fi);
 
 	fi->hfinfo     = hfinfo;
 	fi->start      = start;
@@ -6830,6 +6931,8 @@ proto_tree_create_root(packet_info *pinfo)
 	/* Keep track of the number of children */
 	pnode->tree_data->count = 0;
 
+	pnode->tree_data->slab = proto_slab_new();
+
 	return (proto_tree *)pnode;
 }
 
@@ -792,6 +792,7 @@ typedef struct {
     gboolean             fake_protocols;
     gint                 count;
     struct _packet_info *pinfo;
+    struct _proto_slab  *slab;          /**< proto_nodes and field_infos of the tree */
 } tree_data_t;
 
 /** Each proto_tree, proto_item is one of these. */
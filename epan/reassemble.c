@@ -12,12 +12,20 @@
 
 #include <string.h>
 
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include <epan/packet.h>
 #include <epan/exceptions.h>
+#include <epan/prefs.h>
 #include <epan/reassemble.h>
 #include <epan/tvbuff-int.h>
 
+#include <wsutil/file_util.h>
 #include <wsutil/str_util.h>
+#include <wsutil/tempfile.h>
 
 /*
  * Functions for reassembly tables where the endpoint addresses, and a
@@ -397,6 +405,151 @@ free_fragments(gpointer data, gpointer user_data _U_)
 	g_slice_free(fragment_item, fd_head);
 }
 
+/*
+ * Incomplete reassemblies in a reassembly table, in the order in which
+ * fragments were last added to them, so that the least recently added
+ * to ones can be discarded if they take up too much memory.
+ *
+ * The number of bytes charged to a reassembly is the number of bytes of
+ * fragment data added to it; that's approximate, as it doesn't include
+ * our own overhead, and fragments moved from one reassembly to another
+ * by fragment_add_seq_single_work() stay charged to the one to which
+ * they were first added.
+ */
+typedef struct _reassembly_lru_entry {
+	fragment_head *fd_head;
+	gpointer key;		/* key of fd_head in the fragment table */
+	gsize bytes;		/* bytes of fragment data charged to it */
+} reassembly_lru_entry;
+
+struct _reassembly_lru {
+	GQueue entries;		/* least recently added to first */
+	GHashTable *links;	/* fd_head -> its link in entries */
+	gsize memory_used;	/* sum of the entries' bytes */
+};
+
+static void
+reassembly_lru_entry_free(gpointer data, gpointer user_data _U_)
+{
+	g_slice_free(reassembly_lru_entry, (reassembly_lru_entry *)data);
+}
+
+/*
+ * Forget all incomplete reassemblies; called when the fragment table
+ * is emptied.
+ */
+static void
+reassembly_lru_destroy(reassembly_table *table)
+{
+	if (table->lru == NULL)
+		return;
+	g_queue_foreach(&table->lru->entries, reassembly_lru_entry_free, NULL);
+	g_queue_clear(&table->lru->entries);
+	g_hash_table_destroy(table->lru->links);
+	g_free(table->lru);
+	table->lru = NULL;
+}
+
+/*
+ * Stop tracking a reassembly, because it's been completed or is being
+ * removed from the fragment table.  It's not an error if it wasn't being
+ * tracked.
+ */
+static void
+reassembly_lru_forget(reassembly_table *table, const fragment_head *fd_head)
+{
+	GList *lru_link;
+	reassembly_lru_entry *entry;
+
+	if (table->lru == NULL || fd_head == NULL)
+		return;
+	lru_link = (GList *)g_hash_table_lookup(table->lru->links, fd_head);
+	if (lru_link == NULL)
+		return;
+	entry = (reassembly_lru_entry *)lru_link->data;
+	table->lru->memory_used -= entry->bytes;
+	g_hash_table_remove(table->lru->links, fd_head);
+	g_queue_delete_link(&table->lru->entries, lru_link);
+	reassembly_lru_entry_free(entry, NULL);
+}
+
+static gsize
+reassembly_lru_limit(const reassembly_table *table)
+{
+	if (table->memory_limit != 0)
+		return table->memory_limit;
+	return (gsize)prefs.reassembly_memory_limit * 1024 * 1024;
+}
+
+/*
+ * Note that frag_data_len bytes were just added to the reassembly whose
+ * head is fd_head and whose key in the fragment table is key, and, if
+ * that puts the table over its limit, discard the reassemblies that
+ * have gone the longest without a fragment being added to them.
+ *
+ * Reassemblies to which a fragment was added in the current frame are
+ * never discarded, as the caller might still be working on them.
+ */
+static void
+reassembly_lru_touch(reassembly_table *table, fragment_head *fd_head,
+		     gpointer key, const guint32 frag_data_len,
+		     const packet_info *pinfo)
+{
+	gsize limit;
+	GList *lru_link;
+	reassembly_lru_entry *entry;
+
+	limit = reassembly_lru_limit(table);
+	if (limit == 0 && table->lru == NULL)
+		return;
+
+	if (fd_head->flags & FD_DEFRAGMENTED) {
+		reassembly_lru_forget(table, fd_head);
+		return;
+	}
+
+	if (table->lru == NULL) {
+		table->lru = g_new0(struct _reassembly_lru, 1);
+		g_queue_init(&table->lru->entries);
+		table->lru->links = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+
+	lru_link = (GList *)g_hash_table_lookup(table->lru->links, fd_head);
+	if (lru_link == NULL) {
+		entry = g_slice_new0(reassembly_lru_entry);
+		entry->fd_head = fd_head;
+		entry->key = key;
+		g_queue_push_tail(&table->lru->entries, entry);
+		g_hash_table_insert(table->lru->links, fd_head,
+		    table->lru->entries.tail);
+	} else {
+		entry = (reassembly_lru_entry *)lru_link->data;
+		g_queue_unlink(&table->lru->entries, lru_link);
+		g_queue_push_tail_link(&table->lru->entries, lru_link);
+	}
+	entry->bytes += frag_data_len;
+	table->lru->memory_used += frag_data_len;
+
+	if (limit == 0)
+		return;
+	while (table->lru->memory_used > limit) {
+		entry = (reassembly_lru_entry *)g_queue_peek_head(&table->lru->entries);
+		if (entry == NULL || entry->fd_head->frame >= pinfo->num)
+			break;
+		g_queue_pop_head(&table->lru->entries);
+		g_hash_table_remove(table->lru->links, entry->fd_head);
+		table->lru->memory_used -= entry->bytes;
+
+		/*
+		 * Free the fragments and the head, and then remove the
+		 * entry from the fragment table, which frees the key.
+		 */
+		free_all_fragments(entry->key, entry->fd_head, NULL);
+		g_hash_table_remove(table->fragment_table, entry->key);
+		reassembly_lru_entry_free(entry, NULL);
+	}
+}
+
 typedef struct register_reassembly_table {
 	reassembly_table *table;
 	const reassembly_table_functions *funcs;
@@ -447,6 +600,7 @@ reassembly_table_init(reassembly_table *table,
 		 */
 		g_hash_table_foreach_remove(table->fragment_table,
 					    free_all_fragments, NULL);
+		reassembly_lru_destroy(table);
 	} else {
 		/* The fragment table does not exist. Create it */
 		table->fragment_table = g_hash_table_new_full(funcs->hash_func,
@@ -500,6 +654,7 @@ reassembly_table_destroy(reassembly_table *table)
 		 */
 		g_hash_table_foreach_remove(table->fragment_table,
 					    free_all_fragments, NULL);
+		reassembly_lru_destroy(table);
 
 		/*
 		 * Now destroy the hash table.
@@ -532,6 +687,101 @@ reassembly_table_destroy(reassembly_table *table)
 	}
 }
 
+/*
+ * Get the highest frame number of the fragments of a reassembly and of
+ * the frame in which it was reassembled.
+ */
+static guint32
+fragment_head_last_frame(const fragment_head *fd_head)
+{
+	const fragment_item *fd;
+	guint32 last_frame = 0;
+
+	for (fd = fd_head; fd != NULL; fd = fd->next) {
+		if (fd->frame > last_frame)
+			last_frame = fd->frame;
+	}
+	if (fd_head->reassembled_in > last_frame)
+		last_frame = fd_head->reassembled_in;
+	return last_frame;
+}
+
+/*
+ * For a fragment hash table entry, free the associated fragments if
+ * none of them is in or after the frame pointed to by user_data.
+ */
+typedef struct {
+	reassembly_table *table;
+	guint32 before_frame;
+	GPtrArray *allocated_fragments;
+} retire_reassembled_data;
+
+static gboolean
+retire_fragments(gpointer key_arg, gpointer value, gpointer user_data)
+{
+	retire_reassembled_data *data = (retire_reassembled_data *) user_data;
+
+	if (fragment_head_last_frame((fragment_head *)value) >= data->before_frame)
+		return FALSE;
+	reassembly_lru_forget(data->table, (fragment_head *)value);
+	return free_all_fragments(key_arg, value, NULL);
+}
+
+/*
+ * For a reassembled-packet hash table entry, free the fragment data
+ * to which the value refers, and the key, if the packet was reassembled
+ * and all its fragments were seen before the given frame.
+ */
+static gboolean
+retire_reassembled_fragments(gpointer key_arg, gpointer value,
+			     gpointer user_data)
+{
+	retire_reassembled_data *data = (retire_reassembled_data *) user_data;
+	fragment_head *fd_head = (fragment_head *) value;
+
+	/*
+	 * The packet is in the table once for each of its fragments;
+	 * if we've already decided to free it, do so for this entry as
+	 * well.
+	 */
+	if (fd_head->flags != FD_VISITED_FREE) {
+		if (fd_head->reassembled_in >= data->before_frame ||
+		    fragment_head_last_frame(fd_head) >= data->before_frame)
+			return FALSE;
+	}
+	return free_all_reassembled_fragments(key_arg, value,
+	    data->allocated_fragments);
+}
+
+/*
+ * Free all the reassemblies, in all registered reassembly tables, to
+ * which no fragment has been added since before the given frame.
+ */
+void
+reassembly_tables_retire(const guint32 before_frame)
+{
+	GList *entry;
+	reassembly_table *table;
+	retire_reassembled_data data;
+
+	data.before_frame = before_frame;
+	data.allocated_fragments = g_ptr_array_new();
+
+	for (entry = reassembly_table_list; entry != NULL; entry = entry->next) {
+		table = ((register_reassembly_table_t *)entry->data)->table;
+		data.table = table;
+		if (table->fragment_table != NULL)
+			g_hash_table_foreach_remove(table->fragment_table,
+			    retire_fragments, &data);
+		if (table->reassembled_table != NULL)
+			g_hash_table_foreach_remove(table->reassembled_table,
+			    retire_reassembled_fragments, &data);
+	}
+
+	g_ptr_array_foreach(data.allocated_fragments, free_fragments, NULL);
+	g_ptr_array_free(data.allocated_fragments, TRUE);
+}
+
 /*
  * Look up an fd_head in the fragment table, optionally returning the key
  * for it.
@@ -614,6 +864,7 @@ fragment_delete(reassembly_table *table, const packet_info *pinfo,
 		g_slice_free(fragment_item, fd);
 		fd=tmp_fd;
 	}
+	reassembly_lru_forget(table, fd_head);
 	g_slice_free(fragment_head, fd_head);
 	g_hash_table_remove(table->fragment_table, key);
 
@@ -854,12 +1105,136 @@ fragment_set_partial_reassembly(reassembly_table *table,
 static void
 fragment_unhash(reassembly_table *table, gpointer key)
 {
+	reassembly_lru_forget(table,
+	    (fragment_head *)g_hash_table_lookup(table->fragment_table, key));
+
 	/*
 	 * Remove the entry from the fragment table.
 	 */
 	g_hash_table_remove(table->fragment_table, key);
 }
 
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+/*
+ * Large reassembled packets can be written to a temporary file, which
+ * is unlinked as soon as it's created, and mapped back into memory, so
+ * that the OS can page them out rather than holding them in the heap.
+ */
+static int spill_fd = -1;
+static off_t spill_file_size;
+static GHashTable *spill_mappings;	/* mapped data -> length of mapping */
+
+static void
+spilled_data_unmap(void *data)
+{
+	gsize len;
+
+	len = GPOINTER_TO_SIZE(g_hash_table_lookup(spill_mappings, data));
+	g_hash_table_remove(spill_mappings, data);
+	munmap(data, len);
+
+	/* Reuse the file from the start once nothing's in it. */
+	if (g_hash_table_size(spill_mappings) == 0 && spill_fd != -1 &&
+	    ftruncate(spill_fd, 0) == 0)
+		spill_file_size = 0;
+}
+
+/*
+ * Close the temporary file.  Data that's still mapped stays readable,
+ * and is unmapped as usual when its tvbuff is freed.
+ */
+static void
+fragment_spill_cleanup(void)
+{
+	if (spill_fd != -1) {
+		ws_close(spill_fd);
+		spill_fd = -1;
+		spill_file_size = 0;
+	}
+	if (spill_mappings != NULL && g_hash_table_size(spill_mappings) == 0) {
+		g_hash_table_destroy(spill_mappings);
+		spill_mappings = NULL;
+	}
+}
+
+/*
+ * If the reassembled data of fd_head is at least as large as the
+ * "protocols.reassembly_spill_threshold" preference, move it to the
+ * temporary file; on any error, just leave it in memory.
+ */
+static void
+fragment_spill_reassembled_data(fragment_head *fd_head)
+{
+	const fragment_item *fd;
+	const guint8 *src;
+	guint32 len;
+	gsize written, map_len;
+	ssize_t ret;
+	long page_size;
+	off_t map_offset;
+	void *map;
+	tvbuff_t *new_tvb_data;
+
+	if (prefs.reassembly_spill_threshold == 0 || fd_head->tvb_data == NULL)
+		return;
+	len = tvb_captured_length(fd_head->tvb_data);
+	if (len < (guint64)prefs.reassembly_spill_threshold * 1024)
+		return;
+	/* Other tvbuffs may point into the data; leave it alone. */
+	for (fd = fd_head->next; fd != NULL; fd = fd->next) {
+		if (fd->flags & FD_SUBSET_TVB)
+			return;
+	}
+
+	if (spill_fd == -1) {
+		gchar *tmpname;
+
+		spill_fd = create_tempfile(&tmpname, "wireshark_reassembly", NULL, NULL);
+		if (spill_fd == -1)
+			return;
+		ws_unlink(tmpname);
+		g_free(tmpname);
+		if (spill_mappings == NULL)
+			spill_mappings = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0)
+		return;
+	map_offset = spill_file_size;
+	map_len = ((gsize)len + page_size - 1) / page_size * page_size;
+
+	src = tvb_get_ptr(fd_head->tvb_data, 0, len);
+	for (written = 0; written < len; written += (gsize)ret) {
+		ret = pwrite(spill_fd, src + written, len - written,
+		    map_offset + written);
+		if (ret <= 0)
+			return;
+	}
+	map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, spill_fd, map_offset);
+	if (map == MAP_FAILED)
+		return;
+	spill_file_size = map_offset + map_len;
+	g_hash_table_insert(spill_mappings, map, GSIZE_TO_POINTER(map_len));
+
+	new_tvb_data = tvb_new_real_data((const guint8 *)map, len,
+	    tvb_reported_length(fd_head->tvb_data));
+	tvb_set_free_cb(new_tvb_data, spilled_data_unmap);
+	tvb_free(fd_head->tvb_data);
+	fd_head->tvb_data = new_tvb_data;
+}
+#else
+static void
+fragment_spill_reassembled_data(fragment_head *fd_head _U_)
+{
+}
+
+static void
+fragment_spill_cleanup(void)
+{
+}
+#endif
+
 /*
  * This function adds fragment_head structure to a reassembled-packet
  * hash table, using the frame numbers of each of the frames from
@@ -897,6 +1272,7 @@ fragment_reassembled(reassembly_table *table, fragment_head *fd_head,
 	fd_head->flags |= FD_DEFRAGMENTED;
 	fd_head->reassembled_in = pinfo->num;
 	fd_head->reas_in_layer_num = pinfo->curr_layer_num;
+	fragment_spill_reassembled_data(fd_head);
 }
 
 /*
@@ -935,6 +1311,7 @@ fragment_reassembled_single(reassembly_table *table, fragment_head *fd_head,
 	fd_head->flags |= FD_DEFRAGMENTED;
 	fd_head->reassembled_in = pinfo->num;
 	fd_head->reas_in_layer_num = pinfo->curr_layer_num;
+	fragment_spill_reassembled_data(fd_head);
 }
 
 static void
@@ -968,6 +1345,71 @@ MERGE_FRAG(fragment_head *fd_head, fragment_item *fd)
 	fd_i->next = fd;
 }
 
+/*
+ * If the "protocols.reassembly_zero_copy" preference is set and the
+ * fragments of fd_head fit together exactly, with no overlaps and no
+ * gaps, make the reassembled data a composite of the fragments' data
+ * rather than a copy of it; the fragments then no longer have any data
+ * of their own.  Returns TRUE if that was done, FALSE if the caller has
+ * to copy the data.
+ *
+ * If blocksequence is TRUE, the fragment offsets are sequence numbers,
+ * and fragments are just concatenated; otherwise they're byte offsets.
+ * Either way, datalen is the length of the reassembled data.
+ */
+static gboolean
+fragment_reassemble_composite(fragment_head *fd_head,
+			      const gboolean blocksequence,
+			      const guint32 datalen)
+{
+	fragment_item *fd_i;
+	fragment_item *last_fd = NULL;
+	guint32 dfpos = 0;
+	guint num_members = 0;
+	tvbuff_t *tvb_data = NULL;
+
+	if (!prefs.reassembly_zero_copy || fd_head->tvb_data != NULL)
+		return FALSE;
+
+	for (fd_i = fd_head->next; fd_i; last_fd = fd_i, fd_i = fd_i->next) {
+		if (fd_i->len == 0)
+			continue;
+		if (fd_i->tvb_data == NULL || (fd_i->flags & FD_SUBSET_TVB))
+			return FALSE;
+		if (blocksequence) {
+			if (last_fd && last_fd->offset == fd_i->offset)
+				return FALSE;
+		} else {
+			if (fd_i->offset != dfpos)
+				return FALSE;
+		}
+		if (datalen - dfpos < fd_i->len)
+			return FALSE;
+		dfpos += fd_i->len;
+		num_members++;
+	}
+	if (dfpos != datalen || num_members == 0)
+		return FALSE;
+
+	if (num_members > 1)
+		tvb_data = tvb_new_composite();
+	for (fd_i = fd_head->next; fd_i; fd_i = fd_i->next) {
+		if (fd_i->len == 0)
+			continue;
+		if (num_members > 1)
+			tvb_composite_append(tvb_data, fd_i->tvb_data);
+		else
+			tvb_data = fd_i->tvb_data;
+		fd_i->tvb_data = NULL;
+	}
+	if (num_members > 1) {
+		tvb_composite_finalize(tvb_data);
+		tvb_composite_own_members(tvb_data);
+	}
+	fd_head->tvb_data = tvb_data;
+	return TRUE;
+}
+
 /*
  * This function adds a new fragment to the fragment hash table.
  * If this is the first fragment seen for this datagram, a new entry
@@ -1182,6 +1624,13 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	/* we have received an entire packet, defragment it and
 	 * free all fragments
 	 */
+	if (fragment_reassemble_composite(fd_head, FALSE, fd_head->datalen)) {
+		fd_head->flags |= FD_DEFRAGMENTED;
+		fd_head->reassembled_in=pinfo->num;
+		fd_head->reas_in_layer_num = pinfo->curr_layer_num;
+		return TRUE;
+	}
+
 	/* store old data just in case */
 	old_tvb_data=fd_head->tvb_data;
 	data = (guint8 *) g_malloc(fd_head->datalen);
@@ -1332,6 +1781,7 @@ fragment_add_common(reassembly_table *table, tvbuff_t *tvb, const int offset,
 	fragment_head *fd_head;
 	fragment_item *fd_item;
 	gboolean already_added;
+	gpointer orig_key;
 
 
 	/*
@@ -1343,7 +1793,7 @@ fragment_add_common(reassembly_table *table, tvbuff_t *tvb, const int offset,
 	 */
 	DISSECTOR_ASSERT(tvb_bytes_exist(tvb, offset, frag_data_len));
 
-	fd_head = lookup_fd_head(table, pinfo, id, data, NULL);
+	fd_head = lookup_fd_head(table, pinfo, id, data, &orig_key);
 
 #if 0
 	/* debug output of associated fragments. */
@@ -1495,7 +1945,7 @@ fragment_add_common(reassembly_table *table, tvbuff_t *tvb, const int offset,
 		/*
 		 * Insert it into the hash table.
 		 */
-		insert_fd_head(table, fd_head, pinfo, id, data);
+		orig_key = insert_fd_head(table, fd_head, pinfo, id, data);
 	}
 
 	if (fragment_add_work(fd_head, tvb, offset, pinfo, frag_offset,
@@ -1503,11 +1953,14 @@ fragment_add_common(reassembly_table *table, tvbuff_t *tvb, const int offset,
 		/*
 		 * Reassembly is complete.
 		 */
+		reassembly_lru_forget(table, fd_head);
 		return fd_head;
 	} else {
 		/*
 		 * Reassembly isn't complete.
 		 */
+		reassembly_lru_touch(table, fd_head, orig_key, frag_data_len,
+		    pinfo);
 		return NULL;
 	}
 }
@@ -1605,6 +2058,8 @@ fragment_add_check(reassembly_table *table, tvbuff_t *tvb, const int offset,
 		/*
 		 * Reassembly isn't complete.
 		 */
+		reassembly_lru_touch(table, fd_head, orig_key, frag_data_len,
+		    pinfo);
 		return NULL;
 	}
 }
@@ -1625,6 +2080,14 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 		last_fd=fd_i;
 	}
 
+	if (fragment_reassemble_composite(fd_head, TRUE, size)) {
+		fd_head->len = size;		/* record size for caller	*/
+		fd_head->flags |= FD_DEFRAGMENTED;
+		fd_head->reassembled_in=pinfo->num;
+		fd_head->reas_in_layer_num = pinfo->curr_layer_num;
+		return;
+	}
+
 	/* store old data in case the fd_i->data pointers refer to it */
 	old_tvb_data=fd_head->tvb_data;
 	data = (guint8 *) g_malloc(size);
@@ -2019,11 +2482,14 @@ fragment_add_seq_common(reassembly_table *table, tvbuff_t *tvb,
 		/*
 		 * Reassembly is complete.
 		 */
+		reassembly_lru_forget(table, fd_head);
 		return fd_head;
 	} else {
 		/*
 		 * Reassembly isn't complete.
 		 */
+		reassembly_lru_touch(table, fd_head, orig_key, frag_data_len,
+		    pinfo);
 		return NULL;
 	}
 }
@@ -2871,6 +3337,7 @@ static void
 reassembly_table_cleanup_reg_tables(void)
 {
 	g_list_foreach(reassembly_table_list, reassembly_table_cleanup_reg_table, NULL);
+	fragment_spill_cleanup();
 }
 
 void reassembly_tables_init(void)
@@ -2892,6 +3359,7 @@ reassembly_table_cleanup(void)
 {
 	g_list_foreach(reassembly_table_list, reassembly_table_free, NULL);
 	g_list_free(reassembly_table_list);
+	fragment_spill_cleanup();
 }
 
 /*
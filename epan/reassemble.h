@@ -130,6 +130,14 @@ typedef struct {
 	fragment_temporary_key temporary_key_func;
 	fragment_persistent_key persistent_key_func;
 	GDestroyNotify free_temporary_key_func;		/* temporary key destruction function */
+	/*
+	 * Maximum number of bytes of fragment data to hold for incomplete
+	 * reassemblies; when it's exceeded, the reassemblies to which no
+	 * fragment has been added for the longest time are discarded.
+	 * 0 means use the "protocols.reassembly_memory_limit" preference.
+	 */
+	gsize memory_limit;
+	struct _reassembly_lru *lru;			/* incomplete reassemblies, least recently added to first */
 } reassembly_table;
 
 /*
@@ -466,6 +474,12 @@ show_fragment_seq_tree(fragment_head *ipfd_head, const fragment_items *fit,
  */
 extern void reassembly_tables_init(void);
 
+/* Free the reassemblies, in all registered reassembly tables, to which
+ * no fragment has been added since before the given frame
+ */
+extern void
+reassembly_tables_retire(const guint32 before_frame);
+
 /* Cleanup internal structures
  */
 extern void
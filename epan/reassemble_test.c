@@ -42,8 +42,13 @@
 
 #include "config.h"
 
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+#include <unistd.h>
+#endif
+
 #include <epan/packet.h>
 #include <epan/packet_info.h>
+#include <epan/prefs.h>
 #include <epan/proto.h>
 #include <epan/tvbuff.h>
 #include <epan/reassemble.h>
@@ -309,6 +314,157 @@ test_simple_fragment_add_seq(void)
 
 /* XXX ought to have some tests for overlapping fragments */
 
+/* Test reassembly without copying: the reassembled data should be the
+ * same as when it's copied, and the fragments should give up their data.
+ *
+ *   id  frame  offset  len  more  tvb_offset
+ *   12     1       0    50   T      10
+ *   12     2      50    60   T       5
+ *   12     3     110    40   F      20
+ */
+static void
+test_fragment_add_check_zero_copy(void)
+{
+    fragment_head *fd_head;
+    guint8 spanning[20];
+
+    printf("Starting test test_fragment_add_check_zero_copy\n");
+
+    prefs.reassembly_zero_copy = TRUE;
+
+    pinfo.num = 1;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 10, &pinfo, 12, NULL,
+                               0, 50, TRUE);
+    ASSERT_EQ(1,g_hash_table_size(test_reassembly_table.fragment_table));
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 2;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 5, &pinfo, 12, NULL,
+                               50, 60, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 3;
+    fd_head=fragment_add_check(&test_reassembly_table, tvb, 20, &pinfo, 12, NULL,
+                               110, 40, FALSE);
+    ASSERT_EQ(0,g_hash_table_size(test_reassembly_table.fragment_table));
+    ASSERT_EQ(3,g_hash_table_size(test_reassembly_table.reassembled_table));
+    ASSERT_NE_POINTER(NULL,fd_head);
+
+    ASSERT_EQ(150,fd_head->datalen);
+    ASSERT_EQ(3,fd_head->reassembled_in);
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_DATALEN_SET,fd_head->flags);
+    ASSERT_NE_POINTER(NULL,fd_head->tvb_data);
+    ASSERT_EQ(150,tvb_captured_length(fd_head->tvb_data));
+    ASSERT_EQ_POINTER(NULL,fd_head->next->tvb_data);
+    ASSERT_EQ_POINTER(NULL,fd_head->next->next->tvb_data);
+    ASSERT_EQ_POINTER(NULL,fd_head->next->next->next->tvb_data);
+
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,50));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,50,data+5,60));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,110,data+20,40));
+    /* a range spanning two fragments */
+    memcpy(spanning, data+50, 10);
+    memcpy(spanning+10, data+5, 10);
+    ASSERT(!tvb_memeql(fd_head->tvb_data,40,spanning,20));
+
+    prefs.reassembly_zero_copy = FALSE;
+}
+
+/* Test that reassembled data at least as large as the spill threshold
+ * is moved to the temporary file and reads back the same.
+ *
+ *   id  frame  offset  len  more  tvb_offset
+ *   12     1       0   250   T       0
+ *   12     2     250   250   T       1
+ *   12     3     500   250   T       2
+ *   12     4     750   250   T       3
+ *   12     5    1000   250   F       4
+ */
+static void
+test_fragment_add_check_spill(void)
+{
+    fragment_head *fd_head = NULL;
+    guint32 i;
+
+    printf("Starting test test_fragment_add_check_spill\n");
+
+    prefs.reassembly_spill_threshold = 1;
+
+    for (i = 0; i < 5; i++) {
+        pinfo.num = i + 1;
+        fd_head=fragment_add_check(&test_reassembly_table, tvb, i, &pinfo, 12, NULL,
+                                   i * 250, 250, i < 4);
+    }
+    ASSERT_EQ(0,g_hash_table_size(test_reassembly_table.fragment_table));
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(1250,fd_head->datalen);
+    ASSERT_EQ(5,fd_head->reassembled_in);
+    ASSERT_NE_POINTER(NULL,fd_head->tvb_data);
+    ASSERT_EQ(1250,tvb_captured_length(fd_head->tvb_data));
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+    /* mmap()ed, not allocated on the heap */
+    ASSERT_EQ(0,(guintptr)tvb_get_ptr(fd_head->tvb_data, 0, 1) % (guintptr)sysconf(_SC_PAGESIZE));
+#endif
+
+    for (i = 0; i < 5; i++) {
+        ASSERT(!tvb_memeql(fd_head->tvb_data,i*250,data+i,250));
+    }
+
+    prefs.reassembly_spill_threshold = 0;
+}
+
+/* Test the per-table memory limit: when the fragments of incomplete
+ * reassemblies exceed it, the reassembly least recently added to is
+ * discarded, unless a fragment was added to it in the current frame.
+ *
+ *   id  frame  frag  len  more
+ *   12     1     0    50   T
+ *   13     2     0    60   T    (discards 12)
+ *   14     2     0    60   T    (discards nothing)
+ *   13     3     1    60   F    (completes 13)
+ */
+static void
+test_fragment_add_seq_memory_limit(void)
+{
+    fragment_head *fd_head;
+
+    printf("Starting test test_fragment_add_seq_memory_limit\n");
+
+    test_reassembly_table.memory_limit = 100;
+
+    pinfo.num = 1;
+    fd_head=fragment_add_seq(&test_reassembly_table, tvb, 10, &pinfo, 12, NULL,
+                             0, 50, TRUE, 0);
+    ASSERT_EQ(1,g_hash_table_size(test_reassembly_table.fragment_table));
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 2;
+    fd_head=fragment_add_seq(&test_reassembly_table, tvb, 15, &pinfo, 13, NULL,
+                             0, 60, TRUE, 0);
+    ASSERT_EQ(1,g_hash_table_size(test_reassembly_table.fragment_table));
+    ASSERT_EQ_POINTER(NULL,fd_head);
+    ASSERT_EQ_POINTER(NULL,fragment_get(&test_reassembly_table, &pinfo, 12, NULL));
+
+    fd_head=fragment_add_seq(&test_reassembly_table, tvb, 20, &pinfo, 14, NULL,
+                             0, 60, TRUE, 0);
+    ASSERT_EQ(2,g_hash_table_size(test_reassembly_table.fragment_table));
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 3;
+    fd_head=fragment_add_seq(&test_reassembly_table, tvb, 5, &pinfo, 13, NULL,
+                             1, 60, FALSE, 0);
+    ASSERT_EQ(2,g_hash_table_size(test_reassembly_table.fragment_table));
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(120,fd_head->len);
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_BLOCKSEQUENCE|FD_DATALEN_SET,fd_head->flags);
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+15,60));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,60,data+5,60));
+    ASSERT_NE_POINTER(NULL,fragment_get(&test_reassembly_table, &pinfo, 14, NULL));
+
+    test_reassembly_table.memory_limit = 0;
+}
+
+
 /* This tests the functionality of fragment_set_partial_reassembly for
  * FD_BLOCKSEQUENCE reassembly.
  *
@@ -1526,6 +1682,9 @@ main(int argc _U_, char **argv _U_)
     static void (*tests[])(void) = {
         test_simple_fragment_add_seq,              /* frag table only   */
         test_fragment_add_seq_partial_reassembly,
+        test_fragment_add_seq_memory_limit,
+        test_fragment_add_check_zero_copy,
+        test_fragment_add_check_spill,
         test_fragment_add_seq_duplicate_first,
         test_fragment_add_seq_duplicate_middle,
         test_fragment_add_seq_duplicate_last,
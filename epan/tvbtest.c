@@ -485,6 +485,68 @@ run_tests(void)
 	tvb_free_chain(tvb_parent);  /* should free all tvb's and associated data */
 }
 
+/* Build a composite of num_members 16-byte members, read it byte by
+ * byte, then at scattered offsets, and report how long that took, to
+ * show how member lookup scales with the number of members. */
+static void
+composite_benchmark(guint num_members)
+{
+	tvbuff_t	*tvb_parent;
+	tvbuff_t	*tvb_comp;
+	tvbuff_t	*tvb_member;
+	guint8		*member;
+	guint		i, j, length, offset;
+	guint64		sum, expected_sum;
+	gint64		start, sequential, scattered;
+
+	tvb_parent = tvb_new_real_data("", 0, 0);
+	tvb_comp = tvb_new_composite();
+	expected_sum = 0;
+	for (i = 0; i < num_members; i++) {
+		member = g_new(guint8, 16);
+		for (j = 0; j < 16; j++) {
+			member[j] = (guint8)(i + j);
+			expected_sum += member[j];
+		}
+		tvb_member = tvb_new_child_real_data(tvb_parent, member, 16, 16);
+		tvb_set_free_cb(tvb_member, g_free);
+		tvb_composite_append(tvb_comp, tvb_member);
+	}
+	tvb_composite_finalize(tvb_comp);
+	length = tvb_captured_length(tvb_comp);
+
+	start = g_get_monotonic_time();
+	sum = 0;
+	for (offset = 0; offset < length; offset++)
+		sum += tvb_get_guint8(tvb_comp, offset);
+	sequential = g_get_monotonic_time() - start;
+	if (sum != expected_sum) {
+		printf("Composite benchmark: sequential sum %" G_GUINT64_FORMAT
+		    " != %" G_GUINT64_FORMAT "\n", sum, expected_sum);
+		failed = TRUE;
+	}
+
+	/* Visit every offset once, in an order that jumps around. */
+	start = g_get_monotonic_time();
+	sum = 0;
+	for (i = 0, offset = 0; i < length; i++) {
+		sum += tvb_get_guint8(tvb_comp, offset);
+		offset = (offset + 7919) % length;
+	}
+	scattered = g_get_monotonic_time() - start;
+	if (sum != expected_sum) {
+		printf("Composite benchmark: scattered sum %" G_GUINT64_FORMAT
+		    " != %" G_GUINT64_FORMAT "\n", sum, expected_sum);
+		failed = TRUE;
+	}
+
+	printf("Composite of %5u members: %7u bytes sequential %6" G_GINT64_FORMAT
+	    " us, scattered %6" G_GINT64_FORMAT " us\n",
+	    num_members, length, sequential, scattered);
+
+	tvb_free_chain(tvb_parent);
+}
+
 /* Note: valgrind can be used to check for tvbuff memory leaks */
 int
 main(void)
@@ -495,6 +557,9 @@ main(void)
 
 	except_init();
 	run_tests();
+	composite_benchmark(16);
+	composite_benchmark(256);
+	composite_benchmark(4096);
 	except_deinit();
 	exit(failed?1:0);
 }
@@ -92,6 +92,8 @@ tvbuff_t *tvb_new_proxy(tvbuff_t *backing);
 
 void tvb_add_to_chain(tvbuff_t *parent, tvbuff_t *child);
 
+void tvb_composite_own_members(tvbuff_t *tvb);
+
 guint tvb_offset_from_real_beginning_counter(const tvbuff_t *tvb, const guint counter);
 
 void tvb_check_offset_length(const tvbuff_t *tvb, const gint offset, gint const length_val, guint *offset_ptr, guint *length_ptr);
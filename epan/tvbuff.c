@@ -32,6 +32,7 @@
 #include "wsutil/unicode-utils.h"
 #include "wsutil/nstime.h"
 #include "wsutil/time_util.h"
+#include "wsutil/ws_memsearch.h"
 #include "tvbuff.h"
 #include "tvbuff-int.h"
 #include "strutil.h"
@@ -2080,7 +2081,7 @@ tvb_find_guint8_generic(tvbuff_t *tvb, guint abs_offset, guint limit, guint8 nee
 
 	ptr = ensure_contiguous(tvb, abs_offset, limit); /* tvb_get_ptr() */
 
-	result = (const guint8 *) memchr(ptr, needle, limit);
+	result = ws_memchr(ptr, limit, needle);
 	if (!result)
 		return -1;
 
@@ -2117,7 +2118,7 @@ tvb_find_guint8(tvbuff_t *tvb, const gint offset, const gint maxlength, const gu
 
 	/* If we have real data, perform our search now. */
 	if (tvb->real_data) {
-		result = (const guint8 *)memchr(tvb->real_data + abs_offset, needle, limit);
+		result = ws_memchr(tvb->real_data + abs_offset, limit, needle);
 		if (result == NULL) {
 			return -1;
 		}
@@ -16,14 +16,22 @@
 #include "proto.h"	/* XXX - only used for DISSECTOR_ASSERT, probably a new header file? */
 
 typedef struct {
-	GSList		*tvbs;
-
-	/* Used for quick testing to see if this
-	 * is the tvbuff that a COMPOSITE is
-	 * interested in. */
+	GQueue		tvbs;
+
+	/* Filled in when the composite is finalized: the members
+	 * as an array, and the offsets of their first and last
+	 * bytes, so that the member containing an offset can be
+	 * found with a binary search. */
+	guint		num_members;
+	tvbuff_t	**members;
 	guint		*start_offsets;
 	guint		*end_offsets;
 
+	/* The member in which the last lookup ended, which is
+	 * checked, along with the one after it, before doing a
+	 * binary search, so that sequential access is O(1). */
+	guint		last_member;
+
 } tvb_comp_t;
 
 struct tvb_composite {
@@ -38,8 +46,9 @@ composite_free(tvbuff_t *tvb)
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	tvb_comp_t *composite = &composite_tvb->composite;
 
-	g_slist_free(composite->tvbs);
+	g_queue_clear(&composite->tvbs);
 
+	g_free(composite->members);
 	g_free(composite->start_offsets);
 	g_free(composite->end_offsets);
 	if (tvb->real_data) {
@@ -56,30 +65,55 @@ composite_offset(const tvbuff_t *tvb _U_, const guint counter)
 	return counter;
 }
 
+/*
+ * Find the index of the member containing abs_offset, or
+ * composite->num_members if abs_offset is past the last member.
+ */
+static guint
+composite_find_member(tvb_comp_t *composite, const guint abs_offset)
+{
+	guint low, high = composite->num_members, mid;
+
+	low = composite->last_member;
+	if (low < high && composite->start_offsets[low] <= abs_offset) {
+		if (abs_offset <= composite->end_offsets[low])
+			return low;
+		if (low + 1 < high && abs_offset <= composite->end_offsets[low + 1]) {
+			composite->last_member = low + 1;
+			return low + 1;
+		}
+	}
+
+	low = 0;
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (composite->end_offsets[mid] < abs_offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low < composite->num_members)
+		composite->last_member = low;
+	return low;
+}
+
 static const guint8*
 composite_get_ptr(tvbuff_t *tvb, guint abs_offset, guint abs_length)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
-	guint	    i, num_members;
+	guint	    i;
 	tvb_comp_t *composite;
 	tvbuff_t   *member_tvb = NULL;
 	guint	    member_offset;
-	GSList	   *slist;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
 	/* Maybe the range specified by offset/length
 	 * is contiguous inside one of the member tvbuffs */
 	composite = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
-
-	for (i = 0; i < num_members; i++) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			slist = g_slist_nth(composite->tvbs, i);
-			member_tvb = (tvbuff_t *)slist->data;
-			break;
-		}
-	}
+	i = composite_find_member(composite, abs_offset);
+	if (i < composite->num_members)
+		member_tvb = composite->members[i];
 
 	/* special case */
 	if (!member_tvb) {
@@ -113,26 +147,19 @@ composite_memcpy(tvbuff_t *tvb, void* _target, guint abs_offset, guint abs_lengt
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	guint8 *target = (guint8 *) _target;
 
-	guint	    i, num_members;
+	guint	    i;
 	tvb_comp_t *composite;
 	tvbuff_t   *member_tvb = NULL;
 	guint	    member_offset, member_length;
-	GSList	   *slist;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
 	/* Maybe the range specified by offset/length
 	 * is contiguous inside one of the member tvbuffs */
 	composite   = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
-
-	for (i = 0; i < num_members; i++) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			slist = g_slist_nth(composite->tvbs, i);
-			member_tvb = (tvbuff_t *)slist->data;
-			break;
-		}
-	}
+	i = composite_find_member(composite, abs_offset);
+	if (i < composite->num_members)
+		member_tvb = composite->members[i];
 
 	/* special case */
 	if (!member_tvb) {
@@ -152,19 +179,28 @@ composite_memcpy(tvbuff_t *tvb, void* _target, guint abs_offset, guint abs_lengt
 		 * then iterate across the other member tvb's, copying their portions
 		 * until we have copied all data.
 		 */
-		member_length = tvb_captured_length_remaining(member_tvb, member_offset);
-
-		/* composite_memcpy() can't handle a member_length of zero. */
-		DISSECTOR_ASSERT(member_length > 0);
-
-		tvb_memcpy(member_tvb, target, member_offset, member_length);
-		abs_offset	+= member_length;
-		abs_length	-= member_length;
-
-		/* Recurse */
-		if (abs_length > 0) {
-			composite_memcpy(tvb, target + member_length, abs_offset, abs_length);
+		guint8 *dst = target;
+
+		for (;;) {
+			member_length = tvb_captured_length_remaining(member_tvb, member_offset);
+
+			/* composite_memcpy() can't handle a member_length of zero. */
+			DISSECTOR_ASSERT(member_length > 0);
+
+			if (member_length > abs_length)
+				member_length = abs_length;
+			tvb_memcpy(member_tvb, dst, member_offset, member_length);
+			dst		+= member_length;
+			abs_length	-= member_length;
+			if (abs_length == 0)
+				break;
+
+			i++;
+			DISSECTOR_ASSERT(i < composite->num_members);
+			member_tvb	= composite->members[i];
+			member_offset	= 0;
 		}
+		composite->last_member = i;
 
 		return target;
 	}
@@ -199,9 +235,12 @@ tvb_new_composite(void)
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	tvb_comp_t *composite = &composite_tvb->composite;
 
-	composite->tvbs		 = NULL;
+	g_queue_init(&composite->tvbs);
+	composite->num_members	 = 0;
+	composite->members	 = NULL;
 	composite->start_offsets = NULL;
 	composite->end_offsets	 = NULL;
+	composite->last_member	 = 0;
 
 	return tvb;
 }
@@ -221,7 +260,7 @@ tvb_composite_append(tvbuff_t *tvb, tvbuff_t *member)
 	DISSECTOR_ASSERT(member->length);
 
 	composite       = &composite_tvb->composite;
-	composite->tvbs = g_slist_append(composite->tvbs, member);
+	g_queue_push_tail(&composite->tvbs, member);
 }
 
 void
@@ -239,14 +278,14 @@ tvb_composite_prepend(tvbuff_t *tvb, tvbuff_t *member)
 	DISSECTOR_ASSERT(member->length);
 
 	composite       = &composite_tvb->composite;
-	composite->tvbs = g_slist_prepend(composite->tvbs, member);
+	g_queue_push_head(&composite->tvbs, member);
 }
 
 void
 tvb_composite_finalize(tvbuff_t *tvb)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
-	GSList	   *slist;
+	GList	   *item;
 	guint	    num_members;
 	tvbuff_t   *member_tvb;
 	tvb_comp_t *composite;
@@ -259,7 +298,7 @@ tvb_composite_finalize(tvbuff_t *tvb)
 	DISSECTOR_ASSERT(tvb->contained_length == 0);
 
 	composite   = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
+	num_members = g_queue_get_length(&composite->tvbs);
 
 	/* Dissectors should not create composite TVBs if they're not going to
 	 * put at least one TVB in them.
@@ -267,12 +306,15 @@ tvb_composite_finalize(tvbuff_t *tvb)
 	 */
 	DISSECTOR_ASSERT(num_members);
 
+	composite->num_members = num_members;
+	composite->members = g_new(tvbuff_t *, num_members);
 	composite->start_offsets = g_new(guint, num_members);
 	composite->end_offsets = g_new(guint, num_members);
 
-	for (slist = composite->tvbs; slist != NULL; slist = slist->next) {
+	for (item = composite->tvbs.head; item != NULL; item = item->next) {
 		DISSECTOR_ASSERT((guint) i < num_members);
-		member_tvb = (tvbuff_t *)slist->data;
+		member_tvb = (tvbuff_t *)item->data;
+		composite->members[i] = member_tvb;
 		composite->start_offsets[i] = tvb->length;
 		tvb->length += member_tvb->length;
 		tvb->reported_length += member_tvb->reported_length;
@@ -281,13 +323,41 @@ tvb_composite_finalize(tvbuff_t *tvb)
 		i++;
 	}
 
-	DISSECTOR_ASSERT(composite->tvbs);
+	DISSECTOR_ASSERT(composite->members);
 
-	tvb_add_to_chain((tvbuff_t *)composite->tvbs->data, tvb); /* chain composite tvb to first member */
+	tvb_add_to_chain(composite->members[0], tvb); /* chain composite tvb to first member */
 	tvb->initialized = TRUE;
 	tvb->ds_tvb = tvb;
 }
 
+/*
+ * Make a finalized composite tvbuff own its members, so that freeing it
+ * frees them too.  The members must not be in a chain of their own, and
+ * must not be members of any other composite.
+ */
+void
+tvb_composite_own_members(tvbuff_t *tvb)
+{
+	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
+	tvb_comp_t *composite;
+	guint	    i;
+
+	DISSECTOR_ASSERT(tvb && tvb->initialized);
+	DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops);
+
+	composite = &composite_tvb->composite;
+
+	/* Undo the chaining done by tvb_composite_finalize(). */
+	DISSECTOR_ASSERT(composite->members[0]->next == tvb);
+	composite->members[0]->next = tvb->next;
+	tvb->next = NULL;
+
+	for (i = 0; i < composite->num_members; i++) {
+		DISSECTOR_ASSERT(composite->members[i]->next == NULL);
+		tvb_add_to_chain(tvb, composite->members[i]);
+	}
+}
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
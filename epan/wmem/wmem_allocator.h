@@ -21,6 +21,13 @@ extern "C" {
 
 struct _wmem_user_cb_container_t;
 
+/* For the per-thread state of the scopes and the concurrent allocator */
+#if defined(_MSC_VER)
+#define WMEM_THREAD_LOCAL __declspec(thread)
+#else
+#define WMEM_THREAD_LOCAL __thread
+#endif
+
 /* See section "4. Internal Design" of doc/README.wmem for details
  * on this structure */
 struct _wmem_allocator_t {
@@ -0,0 +1,252 @@
+/* wmem_allocator_concurrent.c
+ * Wireshark Memory Manager Concurrent Allocator
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "wmem_core.h"
+#include "wmem_allocator.h"
+#include "wmem_allocator_block.h"
+#include "wmem_allocator_concurrent.h"
+
+/* An allocator that can be used from several threads at once.
+ *
+ * Each thread allocates from an arena of its own, which is a
+ * WMEM_ALLOCATOR_BLOCK allocator guarded by a mutex. That mutex is only ever
+ * contended when another thread frees or reallocates memory that came from
+ * the arena, so allocation is about as cheap as with the plain block
+ * allocator. Every chunk starts with a pointer to its arena, which is what
+ * lets memory be handed from one thread to another: whichever thread ends up
+ * owning it may free or reallocate it.
+ *
+ * The arenas are kept until the allocator is destroyed, and free_all and gc
+ * apply to all of them; like for any other allocator, no thread may be
+ * using it while those run.
+ */
+
+/* See wmem_allocator_block.c for the reasoning behind this alignment. */
+#define WMEM_ALIGN_AMOUNT (2 * sizeof (gsize))
+#define WMEM_ALIGN_SIZE(SIZE) ((~(WMEM_ALIGN_AMOUNT-1)) & \
+        ((SIZE) + (WMEM_ALIGN_AMOUNT-1)))
+
+typedef struct _wmem_concurrent_arena_t {
+    GMutex            lock;
+    wmem_allocator_t *block;
+} wmem_concurrent_arena_t;
+
+typedef struct {
+    wmem_concurrent_arena_t *arena;
+} wmem_concurrent_chunk_t;
+#define WMEM_CHUNK_HEADER_SIZE WMEM_ALIGN_SIZE(sizeof(wmem_concurrent_chunk_t))
+
+#define WMEM_CHUNK_TO_DATA(CHUNK) ((void*)((guint8*)(CHUNK) + WMEM_CHUNK_HEADER_SIZE))
+#define WMEM_DATA_TO_CHUNK(DATA) ((wmem_concurrent_chunk_t*)((guint8*)(DATA) - WMEM_CHUNK_HEADER_SIZE))
+
+typedef struct {
+    /* Never reused, so that a stale per-thread cache (see below) can't match
+     * a new allocator that happens to live at the same address. */
+    gint        id;
+
+    GMutex      lock;   /* protects arenas */
+    GHashTable *arenas; /* GThread * -> wmem_concurrent_arena_t * */
+} wmem_concurrent_allocator_t;
+
+static volatile gint last_id = 0;
+
+/* The arena the current thread last allocated from, and its allocator's id. */
+static WMEM_THREAD_LOCAL gint cached_id = 0;
+static WMEM_THREAD_LOCAL wmem_concurrent_arena_t *cached_arena = NULL;
+
+static wmem_concurrent_arena_t *
+wmem_concurrent_arena_new(void)
+{
+    wmem_concurrent_arena_t *arena;
+
+    arena = wmem_new(NULL, wmem_concurrent_arena_t);
+    g_mutex_init(&arena->lock);
+
+    /* Not wmem_allocator_new(), which WIRESHARK_DEBUG_WMEM_OVERRIDE could
+     * send right back here */
+    arena->block = wmem_new(NULL, wmem_allocator_t);
+    arena->block->type      = WMEM_ALLOCATOR_BLOCK;
+    arena->block->callbacks = NULL;
+    arena->block->in_scope  = TRUE;
+    wmem_block_allocator_init(arena->block);
+
+    return arena;
+}
+
+static wmem_concurrent_arena_t *
+wmem_concurrent_get_arena(wmem_concurrent_allocator_t *allocator)
+{
+    wmem_concurrent_arena_t *arena;
+    GThread                 *self;
+
+    if (cached_id == allocator->id) {
+        return cached_arena;
+    }
+
+    self = g_thread_self();
+
+    g_mutex_lock(&allocator->lock);
+    arena = (wmem_concurrent_arena_t *)g_hash_table_lookup(allocator->arenas, self);
+    if (arena == NULL) {
+        arena = wmem_concurrent_arena_new();
+        g_hash_table_insert(allocator->arenas, self, arena);
+    }
+    g_mutex_unlock(&allocator->lock);
+
+    cached_id    = allocator->id;
+    cached_arena = arena;
+
+    return arena;
+}
+
+/* API */
+
+static void *
+wmem_concurrent_alloc(void *private_data, const size_t size)
+{
+    wmem_concurrent_allocator_t *allocator = (wmem_concurrent_allocator_t*) private_data;
+    wmem_concurrent_arena_t     *arena;
+    wmem_concurrent_chunk_t     *chunk;
+
+    arena = wmem_concurrent_get_arena(allocator);
+
+    g_mutex_lock(&arena->lock);
+    chunk = (wmem_concurrent_chunk_t *)wmem_alloc(arena->block, size + WMEM_CHUNK_HEADER_SIZE);
+    g_mutex_unlock(&arena->lock);
+
+    chunk->arena = arena;
+
+    return WMEM_CHUNK_TO_DATA(chunk);
+}
+
+static void
+wmem_concurrent_free(void *private_data _U_, void *ptr)
+{
+    wmem_concurrent_chunk_t *chunk = WMEM_DATA_TO_CHUNK(ptr);
+    wmem_concurrent_arena_t *arena = chunk->arena;
+
+    g_mutex_lock(&arena->lock);
+    wmem_free(arena->block, chunk);
+    g_mutex_unlock(&arena->lock);
+}
+
+static void *
+wmem_concurrent_realloc(void *private_data _U_, void *ptr, const size_t size)
+{
+    wmem_concurrent_chunk_t *chunk = WMEM_DATA_TO_CHUNK(ptr);
+    wmem_concurrent_arena_t *arena = chunk->arena;
+
+    /* The chunk stays in its arena, header included */
+    g_mutex_lock(&arena->lock);
+    chunk = (wmem_concurrent_chunk_t *)wmem_realloc(arena->block, chunk, size + WMEM_CHUNK_HEADER_SIZE);
+    g_mutex_unlock(&arena->lock);
+
+    return WMEM_CHUNK_TO_DATA(chunk);
+}
+
+static void
+wmem_concurrent_free_all_arena(gpointer key _U_, gpointer value, gpointer user_data _U_)
+{
+    wmem_concurrent_arena_t *arena = (wmem_concurrent_arena_t *)value;
+
+    g_mutex_lock(&arena->lock);
+    wmem_free_all(arena->block);
+    g_mutex_unlock(&arena->lock);
+}
+
+static void
+wmem_concurrent_free_all(void *private_data)
+{
+    wmem_concurrent_allocator_t *allocator = (wmem_concurrent_allocator_t*) private_data;
+
+    g_mutex_lock(&allocator->lock);
+    g_hash_table_foreach(allocator->arenas, wmem_concurrent_free_all_arena, NULL);
+    g_mutex_unlock(&allocator->lock);
+}
+
+static void
+wmem_concurrent_gc_arena(gpointer key _U_, gpointer value, gpointer user_data _U_)
+{
+    wmem_concurrent_arena_t *arena = (wmem_concurrent_arena_t *)value;
+
+    g_mutex_lock(&arena->lock);
+    wmem_gc(arena->block);
+    g_mutex_unlock(&arena->lock);
+}
+
+static void
+wmem_concurrent_gc(void *private_data)
+{
+    wmem_concurrent_allocator_t *allocator = (wmem_concurrent_allocator_t*) private_data;
+
+    g_mutex_lock(&allocator->lock);
+    g_hash_table_foreach(allocator->arenas, wmem_concurrent_gc_arena, NULL);
+    g_mutex_unlock(&allocator->lock);
+}
+
+static void
+wmem_concurrent_arena_destroy(gpointer data)
+{
+    wmem_concurrent_arena_t *arena = (wmem_concurrent_arena_t *)data;
+
+    wmem_destroy_allocator(arena->block);
+    g_mutex_clear(&arena->lock);
+    wmem_free(NULL, arena);
+}
+
+static void
+wmem_concurrent_allocator_cleanup(void *private_data)
+{
+    wmem_concurrent_allocator_t *allocator = (wmem_concurrent_allocator_t*) private_data;
+
+    g_hash_table_destroy(allocator->arenas);
+    g_mutex_clear(&allocator->lock);
+    wmem_free(NULL, allocator);
+}
+
+void
+wmem_concurrent_allocator_init(wmem_allocator_t *allocator)
+{
+    wmem_concurrent_allocator_t *concurrent_allocator;
+
+    concurrent_allocator = wmem_new(NULL, wmem_concurrent_allocator_t);
+
+    allocator->walloc   = &wmem_concurrent_alloc;
+    allocator->wrealloc = &wmem_concurrent_realloc;
+    allocator->wfree    = &wmem_concurrent_free;
+
+    allocator->free_all = &wmem_concurrent_free_all;
+    allocator->gc       = &wmem_concurrent_gc;
+    allocator->cleanup  = &wmem_concurrent_allocator_cleanup;
+
+    allocator->private_data = (void*) concurrent_allocator;
+
+    concurrent_allocator->id = g_atomic_int_add(&last_id, 1) + 1;
+    g_mutex_init(&concurrent_allocator->lock);
+    concurrent_allocator->arenas = g_hash_table_new_full(g_direct_hash,
+            g_direct_equal, NULL, wmem_concurrent_arena_destroy);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
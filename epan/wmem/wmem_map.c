@@ -10,8 +10,17 @@
  */
 #include "config.h"
 
+#include <string.h>
+
 #include <glib.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WMEM_MAP_SSE2 1
+#endif
+
+#include <wsutil/bits_ctz.h>
+
 #include "wmem_core.h"
 #include "wmem_list.h"
 #include "wmem_map.h"
@@ -24,6 +33,9 @@ static guint32 x; /* Used for universal integer hashing (see the HASH macro) */
 static guint32 preseed;
 static guint32 postseed;
 
+/* Used for hashing in flat maps (see the FLAT_HASH macro) */
+static guint64 flat_multiplier;
+
 void
 wmem_init_hashing(void)
 {
@@ -33,6 +45,8 @@ wmem_init_hashing(void)
 
     preseed  = g_random_int();
     postseed = g_random_int();
+
+    flat_multiplier = ((guint64)g_random_int() << 32 | g_random_int()) | 1;
 }
 
 typedef struct _wmem_map_item_t {
@@ -41,6 +55,18 @@ typedef struct _wmem_map_item_t {
     struct _wmem_map_item_t *next;
 } wmem_map_item_t;
 
+/* Maps created with wmem_map_new_flat() use open addressing instead of
+ * chaining: the keys and values are stored in place in a single array of
+ * slots, with no per-item allocation. A parallel array holds one control byte
+ * per slot: EMPTY, DELETED, or for a full slot 7 bits of the hash of its key.
+ * Lookups compare a whole group of control bytes against those 7 bits at
+ * once (with SSE2 where available), and only call the equality function for
+ * the slots that match. */
+typedef struct _wmem_map_slot_t {
+    const void *key;
+    void *value;
+} wmem_map_slot_t;
+
 struct _wmem_map_t {
     guint count; /* number of items stored */
 
@@ -52,6 +78,15 @@ struct _wmem_map_t {
 
     wmem_map_item_t **table;
 
+    /* Used instead of 'table' by flat maps. The control bytes of the first
+     * FLAT_GROUP_WIDTH-1 slots are repeated after the last one, so that a
+     * group can be loaded starting at any slot. 'growth_left' is the number
+     * of EMPTY slots that can still be filled before the table is rebuilt. */
+    gboolean          flat;
+    guint8           *ctrl;
+    wmem_map_slot_t  *slots;
+    size_t            growth_left;
+
     GHashFunc  hash_func;
     GEqualFunc eql_func;
 
@@ -76,6 +111,22 @@ struct _wmem_map_t {
 #define HASH(MAP, KEY) \
     ((guint32)(((MAP)->hash_func(KEY) * x) >> (32 - (MAP)->capacity)))
 
+/* The same for flat maps, widened to 64 bits: the top bits pick the slot at
+ * which probing starts (FLAT_POS), and the 7 bits below them are stored in the
+ * control byte (FLAT_TAG). */
+#define FLAT_HASH(MAP, KEY) \
+    ((guint64)(MAP)->hash_func(KEY) * flat_multiplier)
+#define FLAT_POS(MAP, H) ((size_t)((H) >> (64 - (MAP)->capacity)))
+#define FLAT_TAG(MAP, H) ((guint8)(((H) >> (57 - (MAP)->capacity)) & 0x7F))
+
+#define FLAT_EMPTY       ((guint8)0x80)
+#define FLAT_DELETED     ((guint8)0xFE)
+#define FLAT_IS_FULL(C)  (((C) & 0x80) == 0)
+#define FLAT_GROUP_WIDTH 16
+
+/* Keep at least 1/8th of the slots EMPTY, so that probing always ends. */
+#define FLAT_MAX_LOAD(CAP) ((CAP) - (CAP) / 8)
+
 static void
 wmem_map_init_table(wmem_map_t *map)
 {
@@ -98,6 +149,22 @@ wmem_map_new(wmem_allocator_t *allocator,
     map->allocator = allocator;
     map->count = 0;
     map->table = NULL;
+    map->flat  = FALSE;
+
+    return map;
+}
+
+wmem_map_t *
+wmem_map_new_flat(wmem_allocator_t *allocator,
+        GHashFunc hash_func, GEqualFunc eql_func)
+{
+    wmem_map_t *map;
+
+    map = wmem_map_new(allocator, hash_func, eql_func);
+
+    map->flat  = TRUE;
+    map->ctrl  = NULL;
+    map->slots = NULL;
 
     return map;
 }
@@ -110,6 +177,8 @@ wmem_map_reset_cb(wmem_allocator_t *allocator _U_, wmem_cb_event_t event,
 
     map->count = 0;
     map->table = NULL;
+    map->ctrl  = NULL;
+    map->slots = NULL;
 
     if (event == WMEM_CB_DESTROY_EVENT) {
         wmem_unregister_callback(map->master, map->master_cb_id);
@@ -144,6 +213,7 @@ wmem_map_new_autoreset(wmem_allocator_t *master, wmem_allocator_t *slave,
     map->allocator = slave;
     map->count = 0;
     map->table = NULL;
+    map->flat  = FALSE;
 
     map->master_cb_id = wmem_register_callback(master, wmem_map_destroy_cb, map);
     map->slave_cb_id  = wmem_register_callback(slave, wmem_map_reset_cb, map);
@@ -151,6 +221,211 @@ wmem_map_new_autoreset(wmem_allocator_t *master, wmem_allocator_t *slave,
     return map;
 }
 
+/* Returns a bitmask of the slots in the group starting at ctrl whose control
+ * byte is c. */
+static inline guint32
+flat_match(const guint8 *ctrl, guint8 c)
+{
+#ifdef WMEM_MAP_SSE2
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+    return (guint32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)c)));
+#else
+    guint32 bits = 0;
+    int i;
+
+    for (i = 0; i < FLAT_GROUP_WIDTH; i++) {
+        if (ctrl[i] == c) {
+            bits |= 1U << i;
+        }
+    }
+    return bits;
+#endif
+}
+
+/* Returns a bitmask of the slots in the group starting at ctrl that are EMPTY
+ * or DELETED. */
+static inline guint32
+flat_match_free(const guint8 *ctrl)
+{
+#ifdef WMEM_MAP_SSE2
+    return (guint32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    guint32 bits = 0;
+    int i;
+
+    for (i = 0; i < FLAT_GROUP_WIDTH; i++) {
+        if (!FLAT_IS_FULL(ctrl[i])) {
+            bits |= 1U << i;
+        }
+    }
+    return bits;
+#endif
+}
+
+static inline void
+flat_set_ctrl(wmem_map_t *map, size_t i, guint8 c)
+{
+    map->ctrl[i] = c;
+    if (i < FLAT_GROUP_WIDTH - 1) {
+        map->ctrl[CAPACITY(map) + i] = c;
+    }
+}
+
+static void
+wmem_map_flat_init_table(wmem_map_t *map)
+{
+    map->ctrl  = (guint8 *)wmem_alloc(map->allocator, CAPACITY(map) + FLAT_GROUP_WIDTH - 1);
+    memset(map->ctrl, FLAT_EMPTY, CAPACITY(map) + FLAT_GROUP_WIDTH - 1);
+    map->slots = wmem_alloc_array(map->allocator, wmem_map_slot_t, CAPACITY(map));
+    map->growth_left = FLAT_MAX_LOAD(CAPACITY(map)) - map->count;
+}
+
+/* Probe groups of slots at triangular offsets (pos, pos+16, pos+48, ...),
+ * which visits every group of a power-of-two sized table. */
+static wmem_map_slot_t *
+wmem_map_flat_find(wmem_map_t *map, const void *key, guint64 h)
+{
+    size_t   mask = CAPACITY(map) - 1;
+    size_t   pos  = FLAT_POS(map, h);
+    size_t   step = 0;
+    guint8   tag  = FLAT_TAG(map, h);
+    guint32  bits;
+
+    for (;;) {
+        const guint8 *group = map->ctrl + pos;
+
+        for (bits = flat_match(group, tag); bits; bits &= bits - 1) {
+            size_t i = (pos + ws_ctz(bits)) & mask;
+
+            if (map->eql_func(key, map->slots[i].key)) {
+                return &map->slots[i];
+            }
+        }
+        if (flat_match(group, FLAT_EMPTY)) {
+            return NULL;
+        }
+        step += FLAT_GROUP_WIDTH;
+        pos = (pos + step) & mask;
+    }
+}
+
+static size_t
+wmem_map_flat_find_free(wmem_map_t *map, guint64 h)
+{
+    size_t   mask = CAPACITY(map) - 1;
+    size_t   pos  = FLAT_POS(map, h);
+    size_t   step = 0;
+    guint32  bits;
+
+    while ((bits = flat_match_free(map->ctrl + pos)) == 0) {
+        step += FLAT_GROUP_WIDTH;
+        pos = (pos + step) & mask;
+    }
+
+    return (pos + ws_ctz(bits)) & mask;
+}
+
+/* Rebuilds the table once no EMPTY slots can be filled any more. It doubles
+ * in size, unless at least half of the slots in use are DELETED, in which case
+ * rebuilding it at the same size is enough to reclaim them. */
+static void
+wmem_map_flat_rebuild(wmem_map_t *map)
+{
+    guint8          *old_ctrl  = map->ctrl;
+    wmem_map_slot_t *old_slots = map->slots;
+    size_t           old_cap   = CAPACITY(map);
+    size_t           i, j;
+    guint64          h;
+
+    if (map->count >= FLAT_MAX_LOAD(old_cap) / 2) {
+        map->capacity++;
+    }
+    wmem_map_flat_init_table(map);
+
+    for (i = 0; i < old_cap; i++) {
+        if (FLAT_IS_FULL(old_ctrl[i])) {
+            h = FLAT_HASH(map, old_slots[i].key);
+            j = wmem_map_flat_find_free(map, h);
+            flat_set_ctrl(map, j, FLAT_TAG(map, h));
+            map->slots[j] = old_slots[i];
+        }
+    }
+
+    wmem_free(map->allocator, old_ctrl);
+    wmem_free(map->allocator, old_slots);
+}
+
+static void *
+wmem_map_flat_insert(wmem_map_t *map, const void *key, void *value)
+{
+    wmem_map_slot_t *slot;
+    guint64 h;
+    size_t i;
+    void *old_val;
+
+    /* Make sure we have a table */
+    if (map->ctrl == NULL) {
+        map->count    = 0;
+        map->capacity = WMEM_MAP_DEFAULT_CAPACITY;
+        wmem_map_flat_init_table(map);
+    }
+
+    h = FLAT_HASH(map, key);
+
+    slot = wmem_map_flat_find(map, key, h);
+    if (slot) {
+        /* replace and return old value for this key */
+        old_val = slot->value;
+        slot->value = value;
+        return old_val;
+    }
+
+    if (map->growth_left == 0) {
+        wmem_map_flat_rebuild(map);
+        h = FLAT_HASH(map, key);
+    }
+
+    i = wmem_map_flat_find_free(map, h);
+    if (map->ctrl[i] == FLAT_EMPTY) {
+        map->growth_left--;
+    }
+    flat_set_ctrl(map, i, FLAT_TAG(map, h));
+    map->slots[i].key   = key;
+    map->slots[i].value = value;
+
+    map->count++;
+
+    /* no previous entry, return NULL */
+    return NULL;
+}
+
+static wmem_map_slot_t *
+wmem_map_flat_lookup(wmem_map_t *map, const void *key)
+{
+    /* Make sure we have a table */
+    if (map->ctrl == NULL) {
+        return NULL;
+    }
+
+    return wmem_map_flat_find(map, key, FLAT_HASH(map, key));
+}
+
+static wmem_map_slot_t *
+wmem_map_flat_remove(wmem_map_t *map, const void *key)
+{
+    wmem_map_slot_t *slot;
+
+    slot = wmem_map_flat_lookup(map, key);
+    if (slot) {
+        /* Leave a tombstone so that probing for other keys goes on past it */
+        flat_set_ctrl(map, (size_t)(slot - map->slots), FLAT_DELETED);
+        map->count--;
+    }
+
+    return slot;
+}
+
 static inline void
 wmem_map_grow(wmem_map_t *map)
 {
@@ -189,6 +464,10 @@ wmem_map_insert(wmem_map_t *map, const void *key, void *value)
     wmem_map_item_t **item;
     void *old_val;
 
+    if (map->flat) {
+        return wmem_map_flat_insert(map, key, value);
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         wmem_map_init_table(map);
@@ -231,6 +510,10 @@ wmem_map_contains(wmem_map_t *map, const void *key)
 {
     wmem_map_item_t *item;
 
+    if (map->flat) {
+        return wmem_map_flat_lookup(map, key) != NULL;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return FALSE;
@@ -255,6 +538,12 @@ wmem_map_lookup(wmem_map_t *map, const void *key)
 {
     wmem_map_item_t *item;
 
+    if (map->flat) {
+        wmem_map_slot_t *slot = wmem_map_flat_lookup(map, key);
+
+        return slot ? slot->value : NULL;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return NULL;
@@ -279,6 +568,21 @@ wmem_map_lookup_extended(wmem_map_t *map, const void *key, const void **orig_key
 {
     wmem_map_item_t *item;
 
+    if (map->flat) {
+        wmem_map_slot_t *slot = wmem_map_flat_lookup(map, key);
+
+        if (slot == NULL) {
+            return FALSE;
+        }
+        if (orig_key) {
+            *orig_key = slot->key;
+        }
+        if (value) {
+            *value = slot->value;
+        }
+        return TRUE;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return FALSE;
@@ -310,6 +614,12 @@ wmem_map_remove(wmem_map_t *map, const void *key)
     wmem_map_item_t **item, *tmp;
     void *value;
 
+    if (map->flat) {
+        wmem_map_slot_t *slot = wmem_map_flat_remove(map, key);
+
+        return slot ? slot->value : NULL;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return NULL;
@@ -341,6 +651,10 @@ wmem_map_steal(wmem_map_t *map, const void *key)
 {
     wmem_map_item_t **item, *tmp;
 
+    if (map->flat) {
+        return wmem_map_flat_remove(map, key) != NULL;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return FALSE;
@@ -372,7 +686,15 @@ wmem_map_get_keys(wmem_allocator_t *list_allocator, wmem_map_t *map)
     wmem_map_item_t *cur;
     wmem_list_t* list = wmem_list_new(list_allocator);
 
-    if (map->table != NULL) {
+    if (map->flat && map->ctrl != NULL) {
+        capacity = CAPACITY(map);
+
+        for (i=0; i<capacity; i++) {
+            if (FLAT_IS_FULL(map->ctrl[i])) {
+                wmem_list_prepend(list, (void*)map->slots[i].key);
+            }
+        }
+    } else if (map->table != NULL) {
         capacity = CAPACITY(map);
 
         /* copy all the elements into the list over from table */
@@ -394,6 +716,18 @@ wmem_map_foreach(wmem_map_t *map, GHFunc foreach_func, gpointer user_data)
     wmem_map_item_t *cur;
     unsigned i;
 
+    if (map->flat) {
+        if (map->ctrl == NULL) {
+            return;
+        }
+        for (i = 0; i < CAPACITY(map); i++) {
+            if (FLAT_IS_FULL(map->ctrl[i])) {
+                foreach_func((gpointer)map->slots[i].key, map->slots[i].value, user_data);
+            }
+        }
+        return;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return;
@@ -58,6 +58,26 @@ wmem_map_new(wmem_allocator_t *allocator,
         GHashFunc hash_func, GEqualFunc eql_func)
 G_GNUC_MALLOC;
 
+/** Creates a map like wmem_map_new(), but using open addressing: keys and
+ * values are stored in place in a flat array rather than in individually
+ * allocated buckets, which makes lookups and iteration cheaper and saves an
+ * allocation per item. All the other wmem_map_* functions work on it as usual.
+ *
+ * Prefer it for large maps with cheap equality functions. Removing items
+ * leaves tombstones behind until the map is next resized, so maps with heavy
+ * churn may use somewhat more memory than chained ones.
+ *
+ * @param allocator The allocator scope with which to create the map.
+ * @param hash_func The hash function used to place inserted keys.
+ * @param eql_func  The equality function used to compare inserted keys.
+ * @return The newly-allocated map.
+ */
+WS_DLL_PUBLIC
+wmem_map_t *
+wmem_map_new_flat(wmem_allocator_t *allocator,
+        GHashFunc hash_func, GEqualFunc eql_func)
+G_GNUC_MALLOC;
+
 /** Creates a map with two allocator scopes. The base structure lives in the
  * master scope, however the data lives in the slave scope. Every time free_all
  * occurs in the slave scope the map is transparently emptied without affecting
@@ -19,6 +19,7 @@
 #include "wmem_allocator.h"
 #include "wmem_allocator_block.h"
 #include "wmem_allocator_block_fast.h"
+#include "wmem_allocator_concurrent.h"
 #include "wmem_allocator_simple.h"
 #include "wmem_allocator_strict.h"
 
@@ -28,6 +29,8 @@
 #define MAX_ALLOC_SIZE          (1024*64)
 #define MAX_SIMULTANEOUS_ALLOCS  1024
 #define CONTAINER_ITERS          10000
+#define THREAD_COUNT             8
+#define THREAD_ITERS             20000
 
 typedef void (*wmem_verify_func)(wmem_allocator_t *allocator);
 
@@ -57,6 +60,9 @@ wmem_allocator_force_new(const wmem_allocator_type_t type)
         case WMEM_ALLOCATOR_STRICT:
             wmem_strict_allocator_init(allocator);
             break;
+        case WMEM_ALLOCATOR_CONCURRENT:
+            wmem_concurrent_allocator_init(allocator);
+            break;
         default:
             g_assert_not_reached();
             /* This is necessary to squelch MSVC errors; is there
@@ -353,6 +359,147 @@ wmem_test_allocator_block_fast(void)
     wmem_test_allocator_jumbo(WMEM_ALLOCATOR_BLOCK, NULL);
 }
 
+static void
+wmem_test_allocator_concurrent(void)
+{
+    wmem_test_allocator(WMEM_ALLOCATOR_CONCURRENT, NULL,
+            MAX_SIMULTANEOUS_ALLOCS*64);
+    wmem_test_allocator_jumbo(WMEM_ALLOCATOR_CONCURRENT, NULL);
+}
+
+/* Allocations made by the threads below start with their length and the id of
+ * the thread that filled them, and the rest is filled with that id. */
+typedef struct {
+    wmem_allocator_t *allocator;
+    GAsyncQueue      *inbox;  /* allocations handed over by the previous thread */
+    GAsyncQueue      *outbox; /* the next thread's inbox */
+    guint8            id;
+} wmem_test_thread_t;
+
+#define THREAD_ALLOC_HEADER (sizeof(guint32) + 1)
+
+static void
+wmem_test_thread_fill(guint8 *ptr, guint32 len, guint8 id)
+{
+    memcpy(ptr, &len, sizeof len);
+    memset(ptr + sizeof len, id, len - sizeof len);
+}
+
+static void
+wmem_test_thread_check(const guint8 *ptr)
+{
+    guint32 len, i;
+
+    memcpy(&len, ptr, sizeof len);
+    for (i = sizeof len + 1; i < len; i++) {
+        g_assert(ptr[i] == ptr[sizeof len]);
+    }
+}
+
+static gpointer
+wmem_test_allocator_thread(gpointer data)
+{
+    wmem_test_thread_t *thread = (wmem_test_thread_t *)data;
+    guint8 *ptrs[64] = { NULL };
+    guint8 *ptr;
+    guint32 len;
+    int i, j;
+
+    for (i = 0; i < THREAD_ITERS; i++) {
+        j = g_random_int_range(0, (gint32)G_N_ELEMENTS(ptrs));
+
+        if (ptrs[j] == NULL) {
+            len = g_random_int_range((gint32)THREAD_ALLOC_HEADER, 4096);
+            ptrs[j] = (guint8 *)wmem_alloc(thread->allocator, len);
+            wmem_test_thread_fill(ptrs[j], len, thread->id);
+            continue;
+        }
+
+        wmem_test_thread_check(ptrs[j]);
+        switch (g_random_int_range(0, 3)) {
+            case 0:
+                wmem_free(thread->allocator, ptrs[j]);
+                break;
+            case 1:
+                len = g_random_int_range((gint32)THREAD_ALLOC_HEADER, 4096);
+                ptrs[j] = (guint8 *)wmem_realloc(thread->allocator, ptrs[j], len);
+                wmem_test_thread_fill(ptrs[j], len, thread->id);
+                continue;
+            default:
+                /* hand it over to the next thread, which will free it */
+                g_async_queue_push(thread->outbox, ptrs[j]);
+                break;
+        }
+        ptrs[j] = NULL;
+
+        while ((ptr = (guint8 *)g_async_queue_try_pop(thread->inbox)) != NULL) {
+            wmem_test_thread_check(ptr);
+            if (g_random_boolean()) {
+                len = g_random_int_range((gint32)THREAD_ALLOC_HEADER, 4096);
+                ptr = (guint8 *)wmem_realloc(thread->allocator, ptr, len);
+                wmem_test_thread_fill(ptr, len, thread->id);
+            }
+            wmem_free(thread->allocator, ptr);
+        }
+    }
+
+    for (j = 0; j < (int)G_N_ELEMENTS(ptrs); j++) {
+        if (ptrs[j]) {
+            wmem_test_thread_check(ptrs[j]);
+            wmem_free(thread->allocator, ptrs[j]);
+        }
+    }
+
+    return NULL;
+}
+
+static void
+wmem_test_allocator_concurrent_threads(void)
+{
+    wmem_allocator_t   *allocator;
+    wmem_test_thread_t  threads[THREAD_COUNT];
+    GThread            *handles[THREAD_COUNT];
+    guint8             *ptr;
+    int                 i, round;
+
+    allocator = wmem_allocator_force_new(WMEM_ALLOCATOR_CONCURRENT);
+
+    for (i = 0; i < THREAD_COUNT; i++) {
+        threads[i].allocator = allocator;
+        threads[i].inbox     = g_async_queue_new();
+        threads[i].id        = (guint8)i;
+    }
+    for (i = 0; i < THREAD_COUNT; i++) {
+        threads[i].outbox = threads[(i + 1) % THREAD_COUNT].inbox;
+    }
+
+    /* Twice, so that the second round reuses the arenas after free_all */
+    for (round = 0; round < 2; round++) {
+        for (i = 0; i < THREAD_COUNT; i++) {
+            handles[i] = g_thread_new("wmem_test", wmem_test_allocator_thread, &threads[i]);
+        }
+        for (i = 0; i < THREAD_COUNT; i++) {
+            g_thread_join(handles[i]);
+        }
+
+        /* what was handed over after its recipient finished */
+        for (i = 0; i < THREAD_COUNT; i++) {
+            while ((ptr = (guint8 *)g_async_queue_try_pop(threads[i].inbox)) != NULL) {
+                wmem_test_thread_check(ptr);
+                wmem_free(allocator, ptr);
+            }
+        }
+
+        wmem_free_all(allocator);
+        wmem_gc(allocator);
+    }
+
+    for (i = 0; i < THREAD_COUNT; i++) {
+        g_async_queue_unref(threads[i].inbox);
+    }
+    wmem_destroy_allocator(allocator);
+}
+
 static void
 wmem_test_allocator_simple(void)
 {
@@ -1007,6 +1154,164 @@ wmem_test_map(void)
     wmem_destroy_allocator(allocator);
 }
 
+static void
+count_map(gpointer key _U_, gpointer val _U_, gpointer user_data)
+{
+    (*(unsigned int *)user_data)++;
+}
+
+static void
+wmem_test_map_flat(void)
+{
+    wmem_allocator_t   *allocator;
+    wmem_map_t       *map;
+    GHashTable       *reference;
+    wmem_list_t      *keys;
+    gchar            *str_key;
+    unsigned int      i, key, count;
+    const void       *key_ret;
+    void             *value_ret;
+    void             *ret;
+
+    allocator = wmem_allocator_new(WMEM_ALLOCATOR_STRICT);
+
+    /* the same basics as for chained maps */
+    map = wmem_map_new_flat(allocator, g_direct_hash, g_direct_equal);
+    g_assert(map);
+    g_assert(wmem_map_lookup(map, GINT_TO_POINTER(1)) == NULL);
+    g_assert(wmem_map_remove(map, GINT_TO_POINTER(1)) == NULL);
+    g_assert(wmem_map_size(map) == 0);
+
+    for (i=0; i<CONTAINER_ITERS; i++) {
+        ret = wmem_map_insert(map, GINT_TO_POINTER(i), GINT_TO_POINTER(777777));
+        g_assert(ret == NULL);
+        ret = wmem_map_insert(map, GINT_TO_POINTER(i), GINT_TO_POINTER(i));
+        g_assert(ret == GINT_TO_POINTER(777777));
+    }
+    g_assert(wmem_map_size(map) == CONTAINER_ITERS);
+    for (i=0; i<CONTAINER_ITERS; i++) {
+        g_assert(wmem_map_lookup(map, GINT_TO_POINTER(i)) == GINT_TO_POINTER(i));
+        g_assert(wmem_map_contains(map, GINT_TO_POINTER(i)) == TRUE);
+        key_ret = NULL;
+        value_ret = NULL;
+        g_assert(wmem_map_lookup_extended(map, GINT_TO_POINTER(i), &key_ret, &value_ret));
+        g_assert(key_ret == GINT_TO_POINTER(i));
+        g_assert(value_ret == GINT_TO_POINTER(i));
+    }
+    for (i=0; i<CONTAINER_ITERS; i+=2) {
+        g_assert(wmem_map_remove(map, GINT_TO_POINTER(i)) == GINT_TO_POINTER(i));
+        g_assert(wmem_map_contains(map, GINT_TO_POINTER(i)) == FALSE);
+        g_assert(wmem_map_steal(map, GINT_TO_POINTER(i+1)) == TRUE);
+        g_assert(wmem_map_steal(map, GINT_TO_POINTER(i+1)) == FALSE);
+    }
+    g_assert(wmem_map_size(map) == 0);
+    wmem_free_all(allocator);
+
+    /* random churn, checked against a GHashTable; the small key space
+     * makes removals and re-insertions of the same keys frequent, which
+     * exercises the tombstones */
+    map = wmem_map_new_flat(allocator, g_direct_hash, g_direct_equal);
+    reference = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (i=0; i<CONTAINER_ITERS*10; i++) {
+        key = g_test_rand_int_range(1, CONTAINER_ITERS);
+        if (g_test_rand_bit()) {
+            wmem_map_insert(map, GUINT_TO_POINTER(key), GUINT_TO_POINTER(i));
+            g_hash_table_insert(reference, GUINT_TO_POINTER(key), GUINT_TO_POINTER(i));
+        } else {
+            g_assert(wmem_map_remove(map, GUINT_TO_POINTER(key)) ==
+                    g_hash_table_lookup(reference, GUINT_TO_POINTER(key)));
+            g_hash_table_remove(reference, GUINT_TO_POINTER(key));
+        }
+        key = g_test_rand_int_range(1, CONTAINER_ITERS);
+        g_assert(wmem_map_lookup(map, GUINT_TO_POINTER(key)) ==
+                g_hash_table_lookup(reference, GUINT_TO_POINTER(key)));
+    }
+    g_assert(wmem_map_size(map) == g_hash_table_size(reference));
+
+    /* foreach and get_keys see every item exactly once */
+    count = 0;
+    wmem_map_foreach(map, count_map, &count);
+    g_assert(count == g_hash_table_size(reference));
+    keys = wmem_map_get_keys(allocator, map);
+    g_assert(wmem_list_count(keys) == g_hash_table_size(reference));
+    g_hash_table_destroy(reference);
+    wmem_free_all(allocator);
+
+    /* string keys */
+    map = wmem_map_new_flat(allocator, wmem_str_hash, g_str_equal);
+    for (i=0; i<CONTAINER_ITERS; i++) {
+        str_key = wmem_test_rand_string(allocator, 1, 64);
+        wmem_map_insert(map, str_key, GINT_TO_POINTER(2));
+        g_assert(wmem_map_lookup(map, str_key) == GINT_TO_POINTER(2));
+    }
+    wmem_map_foreach(map, check_val_map, GINT_TO_POINTER(2));
+
+    wmem_destroy_allocator(allocator);
+}
+
+/* NOTE: You have to run "wmem_test --verbose" to see results. */
+static void
+wmem_test_mapperf(void)
+{
+#define MAP_PERF_COUNT (1 * 1000 * 1000)
+    wmem_allocator_t   *allocator;
+    wmem_map_t         *map;
+    const char         *kind;
+    unsigned int        i, key, count, pass;
+    double              start_utime, start_stime, end_utime, end_stime, utime_ms, stime_ms;
+
+    allocator = wmem_allocator_new(WMEM_ALLOCATOR_BLOCK);
+
+    for (pass = 0; pass < 2; pass++) {
+        if (pass == 0) {
+            kind = "chained";
+            map = wmem_map_new(allocator, g_direct_hash, g_direct_equal);
+        } else {
+            kind = "flat";
+            map = wmem_map_new_flat(allocator, g_direct_hash, g_direct_equal);
+        }
+
+        RESOURCE_USAGE_START;
+        for (i = 1; i <= MAP_PERF_COUNT; i++) {
+            wmem_map_insert(map, GUINT_TO_POINTER(i * 2654435761U), GUINT_TO_POINTER(i));
+        }
+        RESOURCE_USAGE_END;
+        g_test_minimized_result(utime_ms + stime_ms,
+            "wmem_map %s insert: u %.3f ms s %.3f ms", kind, utime_ms, stime_ms);
+
+        /* Look the keys up in a different order than they were inserted in,
+         * so that chained items aren't simply read back in allocation order */
+        RESOURCE_USAGE_START;
+        for (i = 1; i <= MAP_PERF_COUNT; i++) {
+            key = (guint)(((guint64)i * 7919) % MAP_PERF_COUNT) + 1;
+            g_assert(wmem_map_lookup(map, GUINT_TO_POINTER(key * 2654435761U)) == GUINT_TO_POINTER(key));
+        }
+        RESOURCE_USAGE_END;
+        g_test_minimized_result(utime_ms + stime_ms,
+            "wmem_map %s lookup hit: u %.3f ms s %.3f ms", kind, utime_ms, stime_ms);
+
+        RESOURCE_USAGE_START;
+        for (i = 1; i <= MAP_PERF_COUNT; i++) {
+            g_assert(wmem_map_lookup(map, GUINT_TO_POINTER(i * 2654435761U + 1)) == NULL);
+        }
+        RESOURCE_USAGE_END;
+        g_test_minimized_result(utime_ms + stime_ms,
+            "wmem_map %s lookup miss: u %.3f ms s %.3f ms", kind, utime_ms, stime_ms);
+
+        count = 0;
+        RESOURCE_USAGE_START;
+        wmem_map_foreach(map, count_map, &count);
+        RESOURCE_USAGE_END;
+        g_assert(count == MAP_PERF_COUNT);
+        g_test_minimized_result(utime_ms + stime_ms,
+            "wmem_map %s foreach: u %.3f ms s %.3f ms", kind, utime_ms, stime_ms);
+
+        wmem_free_all(allocator);
+    }
+
+    wmem_destroy_allocator(allocator);
+}
+
 static void
 wmem_test_queue(void)
 {
@@ -1438,18 +1743,23 @@ main(int argc, char **argv)
     g_test_add_func("/wmem/allocator/blk_fast",  wmem_test_allocator_block_fast);
     g_test_add_func("/wmem/allocator/simple",    wmem_test_allocator_simple);
     g_test_add_func("/wmem/allocator/strict",    wmem_test_allocator_strict);
+    g_test_add_func("/wmem/allocator/concurrent", wmem_test_allocator_concurrent);
+    g_test_add_func("/wmem/allocator/concurrent_threads", wmem_test_allocator_concurrent_threads);
     g_test_add_func("/wmem/allocator/callbacks", wmem_test_allocator_callbacks);
 
+
     g_test_add_func("/wmem/utils/misc",    wmem_test_miscutls);
     g_test_add_func("/wmem/utils/strings", wmem_test_strutls);
 
     if (!g_test_perf ()) {
         g_test_add_func("/wmem/utils/stringperf", wmem_test_stringperf);
+        g_test_add_func("/wmem/datastruct/mapperf", wmem_test_mapperf);
     }
 
     g_test_add_func("/wmem/datastruct/array",  wmem_test_array);
     g_test_add_func("/wmem/datastruct/list",   wmem_test_list);
     g_test_add_func("/wmem/datastruct/map",    wmem_test_map);
+    g_test_add_func("/wmem/datastruct/map_flat", wmem_test_map_flat);
     g_test_add_func("/wmem/datastruct/queue",  wmem_test_queue);
     g_test_add_func("/wmem/datastruct/stack",  wmem_test_stack);
     g_test_add_func("/wmem/datastruct/strbuf", wmem_test_strbuf);
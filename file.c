@@ -46,6 +46,7 @@
 #include "cfile.h"
 #include "file.h"
 #include "fileset.h"
+#include "file_index.h"
 #include "frame_tvbuff.h"
 
 #include "ui/alert_box.h"
@@ -70,10 +71,13 @@
 # include <ws2tcpip.h>
 #endif
 
+static void read_indexed_records(capture_file *cf, cf_index_t *idx);
 static gboolean read_record(capture_file *cf, wtap_rec *rec, Buffer *buf,
     dfilter_t *dfcode, epan_dissect_t *edt, column_info *cinfo, gint64 offset);
 
 static void rescan_packets(capture_file *cf, const char *action, const char *action_item, gboolean redissect);
+static void set_applied_dfilter(capture_file *cf, gboolean all_frames);
+static void save_dfilter_results(capture_file *cf, guint32 count);
 
 typedef enum {
   MR_NOTMATCHED,
@@ -115,6 +119,20 @@ static void ref_time_packets(capture_file *cf);
 /* Show the progress bar after this many seconds. */
 #define PROGBAR_SHOW_DELAY 0.5
 
+/* Number of recently applied display filters whose results we keep. */
+#define DFILTER_RESULTS_MAX 4
+
+/* Which frames passed a display filter. */
+typedef struct {
+  gchar   *dftext;      /* Display filter text, "" if none */
+  guint32  count;       /* Number of frames the bitmaps cover */
+  guint8  *passed;      /* Frames that passed the filter */
+  guint8  *dependent;   /* Frames that displayed frames depend upon */
+} dfilter_results_t;
+
+#define FRAME_BIT_IS_SET(map, num) (((map)[((num) - 1) / 8] >> (((num) - 1) % 8)) & 1)
+#define FRAME_BIT_SET(map, num)    ((map)[((num) - 1) / 8] |= (1 << (((num) - 1) % 8)))
+
 /*
  * We could probably use g_signal_...() instead of the callbacks below but that
  * would require linking our CLI programs to libgobject and creating an object
@@ -232,7 +250,8 @@ ws_epan_new(capture_file *cf)
     ws_get_frame_ts,
     cap_file_provider_get_interface_name,
     cap_file_provider_get_interface_description,
-    cap_file_provider_get_user_comment
+    cap_file_provider_get_user_comment,
+    cap_file_provider_get_shift_offset
   };
 
   return epan_new(&cf->provider, &funcs);
@@ -248,6 +267,20 @@ cf_open(capture_file *cf, const char *fname, unsigned int type, gboolean is_temp
   if (wth == NULL)
     goto fail;
 
+  /* If it's compressed and we're using capture file indexes, save the
+     places we can seek to quickly, so that the next time it's opened
+     the records in the capture file index can be read without inflating
+     all of the file first. */
+  if (prefs.gui_use_capture_index)
+    wtap_use_seek_index(wth, NULL);
+
+  /* Unlike TShark, we don't read the file through a memory mapping
+     (wtap_use_mmap()).  We keep it open, and seek around in it, for as
+     long as the user looks at it, and a file that's truncated or replaced
+     in that time - a capture file still being rotated by another program,
+     or one on a network share - would crash us with SIGBUS, losing any
+     unsaved comments and edits. */
+
   /* The open succeeded.  Close whatever capture file we had open,
      and fill in the information for this file. */
   cf_close(cf);
@@ -383,6 +416,7 @@ cf_close(capture_file *cf)
 
   dfilter_free(cf->rfcode);
   cf->rfcode = NULL;
+  cf_forget_dfilter_results(cf);
   if (cf->provider.frames != NULL) {
     free_frame_data_sequence(cf->provider.frames);
     cf->provider.frames = NULL;
@@ -391,6 +425,10 @@ cf_close(capture_file *cf)
     g_tree_destroy(cf->provider.frames_user_comments);
     cf->provider.frames_user_comments = NULL;
   }
+  if (cf->provider.frames_shift_offsets) {
+    g_array_free(cf->provider.frames_shift_offsets, TRUE);
+    cf->provider.frames_shift_offsets = NULL;
+  }
   cf_unselect_packet(cf);   /* nothing to select */
   cf->first_displayed = 0;
   cf->last_displayed = 0;
@@ -495,6 +533,8 @@ cf_read(capture_file *cf, gboolean reloading)
   guint                tap_flags;
   gboolean             compiled;
   volatile gboolean    is_read_aborted = FALSE;
+  gboolean             read_from_index = FALSE;
+  cf_index_writer_t   *index_writer = NULL;
 
   /* The update_progress_dlg call below might end up accepting a user request to
    * trigger redissection/rescans which can modify/destroy the dissection
@@ -508,6 +548,9 @@ cf_read(capture_file *cf, gboolean reloading)
   }
   cf->read_lock = TRUE;
 
+  /* We're (re)building the frame list, so earlier filter results are void. */
+  cf_forget_dfilter_results(cf);
+
   /* Compile the current display filter.
    * We assume this will not fail since cf->dfilter is only set in
    * cf_filter IFF the filter was valid.
@@ -567,6 +610,29 @@ cf_read(capture_file *cf, gboolean reloading)
   wtap_rec_init(&rec);
   ws_buffer_init(&buf, 1514);
 
+  /*
+   * If we're allowed to use capture file indexes, and we don't have to
+   * dissect every packet now (no display or read filter, and no taps
+   * that need the packets), see if there's an up-to-date index for this
+   * file; if so, get the frames from it rather than from the file, and
+   * let the packet list dissect packets as they're displayed.
+   *
+   * Otherwise, try to write an index as we read the file.
+   */
+  if (prefs.gui_use_capture_index && cf->rfcode == NULL) {
+    if (!reloading && !create_proto_tree && cinfo == NULL) {
+      cf_index_t *idx = cf_index_open(cf);
+
+      if (idx != NULL) {
+        read_indexed_records(cf, idx);
+        cf_index_close(idx);
+        read_from_index = TRUE;
+      }
+    }
+    if (!read_from_index)
+      index_writer = cf_index_writer_new(cf);
+  }
+
   TRY {
     int     count             = 0;
 
@@ -576,7 +642,8 @@ cf_read(capture_file *cf, gboolean reloading)
     float   progbar_val;
     gchar   status_str[100];
 
-    while ((wtap_read(cf->provider.wth, &rec, &buf, &err, &err_info,
+    while (!read_from_index &&
+           (wtap_read(cf->provider.wth, &rec, &buf, &err, &err_info,
             &data_offset))) {
       if (size >= 0) {
         count++;
@@ -632,6 +699,8 @@ cf_read(capture_file *cf, gboolean reloading)
            hours even on fast machines) just to see that it was the wrong file. */
         break;
       }
+      if (index_writer != NULL)
+        cf_index_writer_add(index_writer, &rec, data_offset);
       read_record(cf, &rec, &buf, dfcode, &edt, cinfo, data_offset);
     }
   }
@@ -652,6 +721,11 @@ cf_read(capture_file *cf, gboolean reloading)
   /* We're done reading sequentially through the file. */
   cf->state = FILE_READ_DONE;
 
+  /* Only keep the index if we read every record. */
+  if (index_writer != NULL)
+    cf_index_writer_close(index_writer, cf,
+                          err == 0 && !cf->stop_flag && !is_read_aborted);
+
   /* Destroy the progress bar if it was created. */
   if (progbar != NULL)
     destroy_progress_dlg(progbar);
@@ -717,6 +791,10 @@ cf_read(capture_file *cf, gboolean reloading)
     /* Redissection was queued up. Clear the request and perform it now. */
     gboolean redissect = cf->redissection_queued == RESCAN_REDISSECT;
     rescan_packets(cf, "Reprocessing", "all packets", redissect);
+  } else {
+    /* Every frame we read was checked against the current display filter. */
+    set_applied_dfilter(cf, TRUE);
+    save_dfilter_results(cf, cf->count);
   }
 
   if (cf->stop_flag) {
@@ -759,6 +837,9 @@ cf_continue_tail(capture_file *cf, volatile int to_read, wtap_rec *rec,
   compiled = dfilter_compile(cf->dfilter, &dfcode, NULL);
   g_assert(!cf->dfilter || (compiled && dfcode));
 
+  /* The frames we add are checked against the current display filter. */
+  set_applied_dfilter(cf, FALSE);
+
   /* Get the union of the flags for all tap listeners. */
   tap_flags = union_of_tap_listener_flags();
 
@@ -900,6 +981,9 @@ cf_finish_tail(capture_file *cf, wtap_rec *rec, Buffer *buf, int *err)
   compiled = dfilter_compile(cf->dfilter, &dfcode, NULL);
   g_assert(!cf->dfilter || (compiled && dfcode));
 
+  /* The frames we add are checked against the current display filter. */
+  set_applied_dfilter(cf, FALSE);
+
   /* Get the union of the flags for all tap listeners. */
   tap_flags = union_of_tap_listener_flags();
 
@@ -1211,6 +1295,75 @@ add_packet_to_packet_list(frame_data *fdata, capture_file *cf,
   epan_dissect_reset(edt);
 }
 
+/*
+ * Update a frame whose display filter result we already know, as
+ * add_packet_to_packet_list() would, but without dissecting it.
+ */
+static void
+add_filtered_frame(capture_file *cf, frame_data *fdata, gboolean passed)
+{
+  frame_data_set_before_dissect(fdata, &cf->elapsed_time,
+                                &cf->provider.ref, cf->provider.prev_dis);
+  cf->provider.prev_cap = fdata;
+
+  fdata->passed_dfilter = passed ? 1 : 0;
+
+  if (fdata->passed_dfilter || fdata->ref_time) {
+    cf->displayed_count++;
+
+    frame_data_set_after_dissect(fdata, &cf->cum_bytes);
+    cf->provider.prev_dis = fdata;
+
+    if (cf->first_displayed == 0)
+      cf->first_displayed = fdata->num;
+    cf->last_displayed = fdata->num;
+  }
+}
+
+/*
+ * Add the records listed in a capture file index to the frame list and
+ * the packet list, as read_record() would with no read or display filter,
+ * but without dissecting them.
+ */
+static void
+read_indexed_records(capture_file *cf, cf_index_t *idx)
+{
+  wtap_rec      rec;
+  frame_data    fdlocal;
+  frame_data   *fdata;
+  gint64        offset;
+  gboolean      has_comment;
+
+  wtap_rec_init(&rec);
+  while (cf_index_next(idx, &rec, &offset, &has_comment)) {
+    cf_add_encapsulation_type(cf, rec.rec_header.packet_header.pkt_encap);
+
+    frame_data_init(&fdlocal, cf->count + 1, &rec, offset, cf->cum_bytes);
+    fdlocal.has_phdr_comment = has_comment;
+    fdata = frame_data_sequence_add(cf->provider.frames, &fdlocal);
+
+    cf->count++;
+    if (has_comment)
+      cf->packet_comment_count++;
+    cf->f_datalen = offset + fdlocal.cap_len;
+
+    frame_data_set_before_dissect(fdata, &cf->elapsed_time,
+                                  &cf->provider.ref, cf->provider.prev_dis);
+    cf->provider.prev_cap = fdata;
+
+    fdata->passed_dfilter = 1;
+    cf->displayed_count++;
+    packet_list_append(NULL, fdata);
+
+    frame_data_set_after_dissect(fdata, &cf->cum_bytes);
+    cf->provider.prev_dis = fdata;
+    if (cf->first_displayed == 0)
+      cf->first_displayed = fdata->num;
+    cf->last_displayed = fdata->num;
+  }
+  wtap_rec_cleanup(&rec);
+}
+
 /*
  * Read in a new record.
  * Returns TRUE if the packet was added to the packet (record) list,
@@ -1451,6 +1604,108 @@ cf_merge_files_to_tempfile(gpointer pd_window, char **out_filenamep,
     return CF_OK;
 }
 
+/*
+ * Note that frames are being checked against the current display filter.
+ * If all of them are, remember that filter; otherwise, forget the filter
+ * they were checked against before, unless it's the same one.
+ */
+static void
+set_applied_dfilter(capture_file *cf, gboolean all_frames)
+{
+  const char *dftext = cf->dfilter ? cf->dfilter : "";
+
+  if (!all_frames && g_strcmp0(cf->applied_dfilter, dftext) == 0)
+    return;
+  g_free(cf->applied_dfilter);
+  cf->applied_dfilter = all_frames ? g_strdup(dftext) : NULL;
+}
+
+static void
+free_dfilter_results(gpointer data)
+{
+  dfilter_results_t *results = (dfilter_results_t *)data;
+
+  g_free(results->dftext);
+  g_free(results->passed);
+  g_free(results->dependent);
+  g_free(results);
+}
+
+void
+cf_forget_dfilter_results(capture_file *cf)
+{
+  g_free(cf->applied_dfilter);
+  cf->applied_dfilter = NULL;
+  g_slist_free_full(cf->dfilter_results, free_dfilter_results);
+  cf->dfilter_results = NULL;
+}
+
+/*
+ * Find the results of the current display filter for the frames we have,
+ * if we have them, and make them the most recently used.
+ */
+static dfilter_results_t *
+find_dfilter_results(capture_file *cf)
+{
+  const char *dftext = cf->dfilter ? cf->dfilter : "";
+  GSList *item;
+  dfilter_results_t *results;
+
+  for (item = cf->dfilter_results; item != NULL; item = item->next) {
+    results = (dfilter_results_t *)item->data;
+    if (results->count == cf->count && strcmp(results->dftext, dftext) == 0) {
+      cf->dfilter_results = g_slist_remove_link(cf->dfilter_results, item);
+      cf->dfilter_results = g_slist_concat(item, cf->dfilter_results);
+      return results;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Remember which of the first "count" frames passed the current display
+ * filter, dropping the results of the least recently used filter if we
+ * have too many.
+ */
+static void
+save_dfilter_results(capture_file *cf, guint32 count)
+{
+  const char *dftext = cf->dfilter ? cf->dfilter : "";
+  dfilter_results_t *results;
+  frame_data *fdata;
+  guint32 framenum;
+  GSList *item, *next;
+
+  for (item = cf->dfilter_results; item != NULL; item = next) {
+    next = item->next;
+    results = (dfilter_results_t *)item->data;
+    if (strcmp(results->dftext, dftext) == 0) {
+      free_dfilter_results(results);
+      cf->dfilter_results = g_slist_delete_link(cf->dfilter_results, item);
+    }
+  }
+
+  results = g_new(dfilter_results_t, 1);
+  results->dftext = g_strdup(dftext);
+  results->count = count;
+  results->passed = (guint8 *)g_malloc0((count + 7) / 8);
+  results->dependent = (guint8 *)g_malloc0((count + 7) / 8);
+  for (framenum = 1; framenum <= count; framenum++) {
+    fdata = frame_data_sequence_find(cf->provider.frames, framenum);
+    if (fdata->passed_dfilter)
+      FRAME_BIT_SET(results->passed, framenum);
+    if (fdata->dependent_of_displayed)
+      FRAME_BIT_SET(results->dependent, framenum);
+  }
+  cf->dfilter_results = g_slist_prepend(cf->dfilter_results, results);
+
+  if (g_slist_length(cf->dfilter_results) > DFILTER_RESULTS_MAX) {
+    item = g_slist_last(cf->dfilter_results);
+    free_dfilter_results(item->data);
+    cf->dfilter_results = g_slist_delete_link(cf->dfilter_results, item);
+  }
+}
+
 cf_status_t
 cf_filter_packets(capture_file *cf, gchar *dftext, gboolean force)
 {
@@ -1525,6 +1780,8 @@ cf_filter_packets(capture_file *cf, gchar *dftext, gboolean force)
 void
 cf_reftime_packets(capture_file *cf)
 {
+  /* frame.ref_time and relative times may have changed. */
+  cf_forget_dfilter_results(cf);
   ref_time_packets(cf);
 }
 
@@ -1622,6 +1879,8 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
   gboolean    compiled;
   guint32     frames_count;
   gboolean    queued_rescan_type = RESCAN_NONE;
+  dfilter_results_t *results = NULL;
+  gboolean    refine = FALSE;
 
   /* Rescan in progress, clear pending actions. */
   cf->redissection_queued = RESCAN_NONE;
@@ -1644,6 +1903,29 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
   /* If any tap listeners require the columns, construct them. */
   cinfo = (tap_flags & TL_REQUIRES_COLUMNS) ? &cf->cinfo : NULL;
 
+  /*
+   * Unless we have to redissect, or tap listeners have to see every
+   * frame, see whether we can avoid dissecting frames:
+   *
+   *    if we still have the results of this filter from a recent
+   *    pass, we don't have to dissect any;
+   *
+   *    if the filter only adds tests to the one every frame was
+   *    checked against last, frames that didn't pass that one can't
+   *    pass this one, so we only have to dissect the ones that did.
+   */
+  if (redissect) {
+    cf_forget_dfilter_results(cf);
+  } else if (!tap_listeners_require_dissection()) {
+    results = find_dfilter_results(cf);
+    if (results == NULL)
+      refine = dfilter_is_refinement(cf->applied_dfilter, cf->dfilter);
+  }
+
+  /* Until we've been through all of them, frames have been checked
+     against different filters. */
+  set_applied_dfilter(cf, FALSE);
+
   /*
    * Determine whether we need to create a protocol tree.
    * We do if:
@@ -1834,8 +2116,10 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
     /* Frame dependencies from the previous dissection/filtering are no longer valid. */
     fdata->dependent_of_displayed = 0;
 
-    if (!cf_read_record(cf, fdata, &rec, &buf))
-      break; /* error reading the frame */
+    if (results == NULL && !(refine && !fdata->passed_dfilter && !fdata->ref_time)) {
+      if (!cf_read_record(cf, fdata, &rec, &buf))
+        break; /* error reading the frame */
+    }
 
     /* If the previous frame is displayed, and we haven't yet seen the
        selected frame, remember that frame - it's the closest one we've
@@ -1845,9 +2129,19 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
       preceding_frame = prev_frame;
     }
 
-    add_packet_to_packet_list(fdata, cf, &edt, dfcode,
-                                    cinfo, &rec, &buf,
-                                    add_to_packet_list);
+    if (results != NULL) {
+      /* We know the result of this filter for this frame. */
+      if (FRAME_BIT_IS_SET(results->dependent, framenum))
+        fdata->dependent_of_displayed = 1;
+      add_filtered_frame(cf, fdata, FRAME_BIT_IS_SET(results->passed, framenum));
+    } else if (refine && !fdata->passed_dfilter && !fdata->ref_time) {
+      /* This frame didn't pass the filter we're refining. */
+      add_filtered_frame(cf, fdata, FALSE);
+    } else {
+      add_packet_to_packet_list(fdata, cf, &edt, dfcode,
+                                      cinfo, &rec, &buf,
+                                      add_to_packet_list);
+    }
 
     /* If this frame is displayed, and this is the first frame we've
        seen displayed after the selected frame, remember this frame -
@@ -1873,6 +2167,14 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
   wtap_rec_cleanup(&rec);
   ws_buffer_free(&buf);
 
+  /* If we went through all the frames, they've all been checked against
+     the current filter; remember which ones passed it. */
+  if (framenum > frames_count) {
+    set_applied_dfilter(cf, TRUE);
+    if (results == NULL)
+      save_dfilter_results(cf, frames_count);
+  }
+
   /* We are done redissecting the packet list. */
   cf->redissecting = FALSE;
 
@@ -3894,6 +4196,7 @@ cf_mark_frame(capture_file *cf, frame_data *frame)
     frame->marked = TRUE;
     if (cf->count > cf->marked_count)
       cf->marked_count++;
+    cf_forget_dfilter_results(cf);
   }
 }
 
@@ -3907,6 +4210,7 @@ cf_unmark_frame(capture_file *cf, frame_data *frame)
     frame->marked = FALSE;
     if (cf->marked_count > 0)
       cf->marked_count--;
+    cf_forget_dfilter_results(cf);
   }
 }
 
@@ -3920,6 +4224,7 @@ cf_ignore_frame(capture_file *cf, frame_data *frame)
     frame->ignored = TRUE;
     if (cf->count > cf->ignored_count)
       cf->ignored_count++;
+    cf_forget_dfilter_results(cf);
   }
 }
 
@@ -3933,6 +4238,7 @@ cf_unignore_frame(capture_file *cf, frame_data *frame)
     frame->ignored = FALSE;
     if (cf->ignored_count > 0)
       cf->ignored_count--;
+    cf_forget_dfilter_results(cf);
   }
 }
 
@@ -4045,6 +4351,9 @@ cf_set_user_packet_comment(capture_file *cf, frame_data *fd, const gchar *new_co
 
   cap_file_provider_set_user_comment(&cf->provider, fd, new_comment);
 
+  /* Filters on frame.comment may now give different results. */
+  cf_forget_dfilter_results(cf);
+
   expert_update_comment_count(cf->packet_comment_count);
 
   /* OK, we have unsaved changes. */
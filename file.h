@@ -393,6 +393,14 @@ cf_status_t cf_filter_packets(capture_file *cf, gchar *dfilter, gboolean force);
  */
 void cf_reftime_packets(capture_file *cf);
 
+/**
+ * Forget which frames passed the display filters applied so far, because
+ * something display filters can test (e.g. packet times) has changed.
+ *
+ * @param cf the capture file
+ */
+void cf_forget_dfilter_results(capture_file *cf);
+
 /**
  * Return the time it took to load the file (in msec).
  */
@@ -0,0 +1,415 @@
+/* file_index.c
+ * Routines for sidecar capture file indexes.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <errno.h>
+
+#include <glib.h>
+
+#include <wsutil/file_util.h>
+
+#include "file_index.h"
+
+#define CF_INDEX_SUFFIX         ".wsidx"
+#define CF_INDEX_MAGIC          "WSIDX\r\n\032"
+#define CF_INDEX_VERSION        1
+#define CF_INDEX_BYTE_ORDER     0x01020304
+
+/* We digest this much of the start of the capture file. */
+#define CF_INDEX_DIGEST_SPAN    (64 * 1024)
+#define CF_INDEX_DIGEST_LEN     32      /* SHA-256 */
+
+/*
+ * The index is a header followed by one record per frame, both in the
+ * byte order of the machine that wrote it; an index written on a machine
+ * with the other byte order is just ignored.
+ */
+typedef struct {
+  char    magic[8];
+  guint32 version;
+  guint32 byte_order;
+  gint64  source_size;
+  gint64  source_mtime;
+  guint8  source_digest[CF_INDEX_DIGEST_LEN];
+  gint32  file_type_subtype;
+  guint32 interface_count;
+  guint32 frame_count;
+  guint32 reserved;
+} cf_index_header_t;
+
+#define CF_INDEX_REC_HAS_TS       0x01
+#define CF_INDEX_REC_HAS_COMMENT  0x02
+
+typedef struct {
+  gint64  file_off;
+  gint64  ts_secs;
+  gint32  ts_nsecs;
+  guint32 pkt_len;
+  guint32 cap_len;
+  gint16  pkt_encap;
+  guint8  tsprec;
+  guint8  flags;
+} cf_index_record_t;
+
+G_STATIC_ASSERT(sizeof(cf_index_header_t) == 80);
+G_STATIC_ASSERT(sizeof(cf_index_record_t) == 32);
+
+struct cf_index {
+  GMappedFile             *mapped;
+  const cf_index_record_t *records;
+  guint32                  count;
+  guint32                  next;
+};
+
+struct cf_index_writer {
+  FILE              *fh;
+  char              *name;
+  char              *tmp_name;
+  cf_index_header_t  hdr;
+  gboolean           ok;
+};
+
+/*
+ * Can we index this file?  We need random access to every record by
+ * offset, so the file must not be compressed, unless it's a gzip file
+ * for which wiretap keeps an index of the places it can start inflating
+ * from; if we're about to use the index, rather than write it, that
+ * index must have been loaded, so that we needn't inflate the file from
+ * the start to find them.  Every record must also be readable by
+ * wtap_seek_read() without having read the records before it, which is
+ * true of pcap files and, as long as there are no interface
+ * description, name resolution or decryption secrets blocks after the
+ * first packet, of pcapng files.
+ */
+static gboolean
+cf_is_indexable(capture_file *cf, gboolean reading)
+{
+  gboolean seek_index_loaded;
+
+  if (cf->is_tempfile || cf->provider.wth == NULL)
+    return FALSE;
+
+  switch (wtap_get_compression_type(cf->provider.wth)) {
+
+  case WTAP_UNCOMPRESSED:
+    break;
+
+  case WTAP_GZIP_COMPRESSED:
+    if (!wtap_has_seek_index(cf->provider.wth, &seek_index_loaded) ||
+        (reading && !seek_index_loaded))
+      return FALSE;
+    break;
+
+  default:
+    return FALSE;
+  }
+
+  switch (cf->cd_t) {
+
+  case WTAP_FILE_TYPE_SUBTYPE_PCAP:
+  case WTAP_FILE_TYPE_SUBTYPE_PCAP_NSEC:
+  case WTAP_FILE_TYPE_SUBTYPE_PCAPNG:
+    return TRUE;
+
+  default:
+    return FALSE;
+  }
+}
+
+static guint32
+cf_interface_count(capture_file *cf)
+{
+  wtapng_iface_descriptions_t *idb_info;
+  guint32 count;
+
+  idb_info = wtap_file_get_idb_info(cf->provider.wth);
+  count = idb_info->interface_data->len;
+  g_free(idb_info);
+  return count;
+}
+
+/*
+ * Fill in the part of an index header that describes the capture file
+ * as it is now.
+ */
+static gboolean
+cf_index_describe_source(capture_file *cf, cf_index_header_t *hdr)
+{
+  ws_statb64 statb;
+  GChecksum *checksum;
+  guint8 *buf;
+  gsize digest_len = CF_INDEX_DIGEST_LEN;
+  int fd;
+  int nread;
+
+  fd = ws_open(cf->filename, O_RDONLY | O_BINARY, 0000);
+  if (fd == -1)
+    return FALSE;
+  if (ws_fstat64(fd, &statb) != 0) {
+    ws_close(fd);
+    return FALSE;
+  }
+  buf = (guint8 *)g_malloc(CF_INDEX_DIGEST_SPAN);
+  nread = (int)ws_read(fd, buf, CF_INDEX_DIGEST_SPAN);
+  ws_close(fd);
+  if (nread < 0) {
+    g_free(buf);
+    return FALSE;
+  }
+
+  checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  g_checksum_update(checksum, buf, nread);
+  g_checksum_get_digest(checksum, hdr->source_digest, &digest_len);
+  g_checksum_free(checksum);
+  g_free(buf);
+
+  hdr->source_size = (gint64)statb.st_size;
+  hdr->source_mtime = (gint64)statb.st_mtime;
+  hdr->file_type_subtype = cf->cd_t;
+  hdr->interface_count = cf_interface_count(cf);
+  return TRUE;
+}
+
+cf_index_t *
+cf_index_open(capture_file *cf)
+{
+  cf_index_header_t cur;
+  const cf_index_header_t *hdr;
+  GMappedFile *mapped;
+  gchar *name;
+  gsize len;
+  cf_index_t *idx;
+
+  if (!cf_is_indexable(cf, TRUE))
+    return NULL;
+
+  name = g_strconcat(cf->filename, CF_INDEX_SUFFIX, NULL);
+  mapped = g_mapped_file_new(name, FALSE, NULL);
+  g_free(name);
+  if (mapped == NULL)
+    return NULL;
+
+  len = g_mapped_file_get_length(mapped);
+  hdr = (const cf_index_header_t *)g_mapped_file_get_contents(mapped);
+  if (len < sizeof *hdr ||
+      memcmp(hdr->magic, CF_INDEX_MAGIC, sizeof hdr->magic) != 0 ||
+      hdr->version != CF_INDEX_VERSION ||
+      hdr->byte_order != CF_INDEX_BYTE_ORDER ||
+      len != sizeof *hdr + (gsize)hdr->frame_count * sizeof(cf_index_record_t))
+    goto stale;
+
+  /*
+   * A pcapng file whose interface description blocks aren't all before
+   * its first packet will have fewer interfaces now than it had when
+   * we'd read all of it, and we can't index it.
+   */
+  memset(&cur, 0, sizeof cur);
+  if (!cf_index_describe_source(cf, &cur) ||
+      cur.source_size != hdr->source_size ||
+      cur.source_mtime != hdr->source_mtime ||
+      memcmp(cur.source_digest, hdr->source_digest, CF_INDEX_DIGEST_LEN) != 0 ||
+      cur.file_type_subtype != hdr->file_type_subtype ||
+      cur.interface_count != hdr->interface_count)
+    goto stale;
+
+  idx = g_new(cf_index_t, 1);
+  idx->mapped = mapped;
+  idx->records = (const cf_index_record_t *)(hdr + 1);
+  idx->count = hdr->frame_count;
+  idx->next = 0;
+  return idx;
+
+stale:
+  g_mapped_file_unref(mapped);
+  return NULL;
+}
+
+gboolean
+cf_index_next(cf_index_t *idx, wtap_rec *rec, gint64 *offset,
+              gboolean *has_comment)
+{
+  const cf_index_record_t *irec;
+
+  if (idx->next >= idx->count)
+    return FALSE;
+  irec = &idx->records[idx->next++];
+
+  rec->rec_type = REC_TYPE_PACKET;
+  rec->presence_flags = WTAP_HAS_CAP_LEN;
+  if (irec->flags & CF_INDEX_REC_HAS_TS)
+    rec->presence_flags |= WTAP_HAS_TS;
+  rec->ts.secs = (time_t)irec->ts_secs;
+  rec->ts.nsecs = irec->ts_nsecs;
+  rec->tsprec = irec->tsprec;
+  rec->rec_header.packet_header.caplen = irec->cap_len;
+  rec->rec_header.packet_header.len = irec->pkt_len;
+  rec->rec_header.packet_header.pkt_encap = irec->pkt_encap;
+
+  *offset = irec->file_off;
+  *has_comment = (irec->flags & CF_INDEX_REC_HAS_COMMENT) != 0;
+  return TRUE;
+}
+
+void
+cf_index_close(cf_index_t *idx)
+{
+  g_mapped_file_unref(idx->mapped);
+  g_free(idx);
+}
+
+cf_index_writer_t *
+cf_index_writer_new(capture_file *cf)
+{
+  cf_index_writer_t *writer;
+  int fd;
+
+  if (!cf_is_indexable(cf, FALSE))
+    return NULL;
+
+  writer = g_new0(cf_index_writer_t, 1);
+  if (!cf_index_describe_source(cf, &writer->hdr)) {
+    g_free(writer);
+    return NULL;
+  }
+  memcpy(writer->hdr.magic, CF_INDEX_MAGIC, sizeof writer->hdr.magic);
+  writer->hdr.version = CF_INDEX_VERSION;
+  writer->hdr.byte_order = CF_INDEX_BYTE_ORDER;
+
+  writer->name = g_strconcat(cf->filename, CF_INDEX_SUFFIX, NULL);
+  /* The temporary file has a name of its own in case somebody else is
+     writing an index for the same file. */
+  writer->tmp_name = g_strdup_printf("%s.XXXXXX", writer->name);
+
+  /* If we can't write next to the capture file, we just don't index it. */
+  fd = g_mkstemp(writer->tmp_name);
+  writer->fh = fd != -1 ? ws_fdopen(fd, "wb") : NULL;
+  if (writer->fh == NULL) {
+    if (fd != -1) {
+      ws_close(fd);
+      ws_unlink(writer->tmp_name);
+    }
+    g_free(writer->tmp_name);
+    g_free(writer->name);
+    g_free(writer);
+    return NULL;
+  }
+
+  /* Leave room for the header, which we write when we're done. */
+  writer->ok = fwrite(&writer->hdr, sizeof writer->hdr, 1, writer->fh) == 1;
+  return writer;
+}
+
+void
+cf_index_writer_add(cf_index_writer_t *writer, const wtap_rec *rec,
+                    gint64 offset)
+{
+  cf_index_record_t irec;
+
+  if (!writer->ok)
+    return;
+
+  /* We can only index packets. */
+  if (rec->rec_type != REC_TYPE_PACKET ||
+      rec->rec_header.packet_header.pkt_encap > G_MAXINT16 ||
+      rec->rec_header.packet_header.pkt_encap < G_MININT16 ||
+      writer->hdr.frame_count == G_MAXUINT32) {
+    writer->ok = FALSE;
+    return;
+  }
+
+  memset(&irec, 0, sizeof irec);
+  irec.file_off = offset;
+  irec.ts_secs = (gint64)rec->ts.secs;
+  irec.ts_nsecs = rec->ts.nsecs;
+  irec.pkt_len = rec->rec_header.packet_header.len;
+  irec.cap_len = rec->rec_header.packet_header.caplen;
+  irec.pkt_encap = (gint16)rec->rec_header.packet_header.pkt_encap;
+  irec.tsprec = (guint8)rec->tsprec;
+  if (rec->presence_flags & WTAP_HAS_TS)
+    irec.flags |= CF_INDEX_REC_HAS_TS;
+  if (rec->opt_comment != NULL)
+    irec.flags |= CF_INDEX_REC_HAS_COMMENT;
+
+  if (fwrite(&irec, sizeof irec, 1, writer->fh) != 1)
+    writer->ok = FALSE;
+  else
+    writer->hdr.frame_count++;
+}
+
+void
+cf_index_writer_close(cf_index_writer_t *writer, capture_file *cf,
+                      gboolean commit)
+{
+  cf_index_header_t cur;
+
+  if (commit && writer->ok) {
+    wtap_dump_params params;
+
+    /*
+     * Name resolution and decryption secrets blocks are only seen when
+     * reading the file sequentially; if there are any, we'd lose them
+     * when reading the frames from the index.
+     */
+    wtap_dump_params_init(&params, cf->provider.wth);
+    if (params.nrb_hdrs != NULL ||
+        (params.dsbs_growing != NULL && params.dsbs_growing->len != 0))
+      writer->ok = FALSE;
+    g_free(params.idb_inf);
+    wtap_dump_params_cleanup(&params);
+
+    /* If the file changed while we were reading it, don't trust the index. */
+    memset(&cur, 0, sizeof cur);
+    if (!cf_index_describe_source(cf, &cur) ||
+        cur.source_size != writer->hdr.source_size ||
+        cur.source_mtime != writer->hdr.source_mtime)
+      writer->ok = FALSE;
+    /* Interface count as of the end of the file. */
+    writer->hdr.interface_count = cur.interface_count;
+
+    if (writer->ok) {
+      if (fseek(writer->fh, 0, SEEK_SET) != 0 ||
+          fwrite(&writer->hdr, sizeof writer->hdr, 1, writer->fh) != 1)
+        writer->ok = FALSE;
+    }
+  } else {
+    writer->ok = FALSE;
+  }
+
+  if (fclose(writer->fh) != 0)
+    writer->ok = FALSE;
+
+  if (writer->ok) {
+    /* rename() doesn't replace an existing file on Windows. */
+    ws_unlink(writer->name);
+    if (ws_rename(writer->tmp_name, writer->name) != 0)
+      ws_unlink(writer->tmp_name);
+  } else {
+    ws_unlink(writer->tmp_name);
+  }
+
+  g_free(writer->tmp_name);
+  g_free(writer->name);
+  g_free(writer);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 2
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=2 tabstop=8 expandtab:
+ * :indentSize=2:tabSize=8:noTabs=true:
+ */
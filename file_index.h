@@ -0,0 +1,102 @@
+/* file_index.h
+ * Definitions for sidecar capture file indexes.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __FILE_INDEX_H__
+#define __FILE_INDEX_H__
+
+#include "cfile.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A capture file index is a file next to the capture file, named
+ * "<capture file>.wsidx", which holds the offset, time stamp, lengths
+ * and encapsulation of every record in the capture file.  It lets
+ * cf_read() fill in the frame list of a capture file it has read before
+ * without reading, or dissecting, every record.  For a gzip-compressed
+ * capture file, it's only used along with wiretap's index of the places
+ * in the file where inflating can start (see wtap_use_seek_index()), so
+ * that the records can be read without inflating all of the file first.
+ *
+ * The index records the size, modification time and a digest of the
+ * beginning of the capture file, and is ignored if they don't match.
+ */
+typedef struct cf_index cf_index_t;
+typedef struct cf_index_writer cf_index_writer_t;
+
+/**
+ * Open the index of a capture file, if it has an up-to-date one and
+ * it can be used to read the file.
+ *
+ * @param cf The capture file, which must have been opened.
+ * @return The index, or NULL.
+ */
+extern cf_index_t *cf_index_open(capture_file *cf);
+
+/**
+ * Get the next record from an index.
+ *
+ * @param idx The index.
+ * @param rec Filled in with the record metadata, as wtap_read() would.
+ * @param offset Set to the offset of the record in the capture file.
+ * @param has_comment Set to TRUE if the record has a comment.
+ * @return TRUE if there was another record, FALSE at the end of the index.
+ */
+extern gboolean cf_index_next(cf_index_t *idx, wtap_rec *rec, gint64 *offset,
+    gboolean *has_comment);
+
+extern void cf_index_close(cf_index_t *idx);
+
+/**
+ * Start writing an index for a capture file that's about to be read,
+ * if we can index it.
+ *
+ * @param cf The capture file, which must have been opened.
+ * @return A writer, or NULL.
+ */
+extern cf_index_writer_t *cf_index_writer_new(capture_file *cf);
+
+/**
+ * Add a record that was read from the capture file to the index.
+ */
+extern void cf_index_writer_add(cf_index_writer_t *writer, const wtap_rec *rec,
+    gint64 offset);
+
+/**
+ * Finish writing an index.
+ *
+ * @param writer The writer.
+ * @param cf The capture file.
+ * @param commit TRUE if every record in the capture file was read and
+ * added; otherwise the index is discarded.
+ */
+extern void cf_index_writer_close(cf_index_writer_t *writer, capture_file *cf,
+    gboolean commit);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __FILE_INDEX_H__ */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 2
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=2 tabstop=8 expandtab:
+ * :indentSize=2:tabSize=8:noTabs=true:
+ */
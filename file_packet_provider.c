@@ -90,3 +90,33 @@ cap_file_provider_set_user_comment(struct packet_provider_data *prov, frame_data
 
   fd->has_user_comment = TRUE;
 }
+
+const nstime_t *
+cap_file_provider_get_shift_offset(struct packet_provider_data *prov, const frame_data *fd)
+{
+  if (fd->has_shift_offset && prov->frames_shift_offsets &&
+      fd->num <= prov->frames_shift_offsets->len)
+    return &g_array_index(prov->frames_shift_offsets, nstime_t, fd->num - 1);
+
+  return NULL;
+}
+
+void
+cap_file_provider_set_shift_offset(struct packet_provider_data *prov, frame_data *fd, const nstime_t *offset)
+{
+  if (offset->secs == 0 && offset->nsecs == 0) {
+    fd->has_shift_offset = FALSE;
+    return;
+  }
+
+  /* Allocated on the first shift, and indexed by frame number, so that
+   * files that are never shifted don't pay anything for it. */
+  if (!prov->frames_shift_offsets)
+    prov->frames_shift_offsets = g_array_new(FALSE, TRUE, sizeof(nstime_t));
+  if (fd->num > prov->frames_shift_offsets->len)
+    g_array_set_size(prov->frames_shift_offsets, fd->num);
+
+  g_array_index(prov->frames_shift_offsets, nstime_t, fd->num - 1) = *offset;
+
+  fd->has_shift_offset = TRUE;
+}
@@ -1454,6 +1454,7 @@ raw_epan_new(capture_file *cf)
         cap_file_provider_get_interface_name,
         cap_file_provider_get_interface_description,
         NULL,
+        NULL
     };
 
     return epan_new(&cf->provider, &funcs);
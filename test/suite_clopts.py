@@ -16,6 +16,8 @@ import subprocess
 import subprocesstest
 import fixtures
 import shutil
+import socket
+import struct
 
 #glossaries = ('fields', 'protocols', 'values', 'decodes', 'defaultprefs', 'currentprefs')
 
@@ -284,6 +286,70 @@ class case_tshark_z_expert(subprocesstest.SubprocessTestCase):
         self.assertFalse(self.grepOutput('Chats'))
 
 
+def prefilter_ipv4(src, dst, proto, payload, ident, frag_offset=0, more_fragments=False):
+    flags_offset = (0x2000 if more_fragments else 0) | (frag_offset // 8)
+    header = struct.pack('!BBHHHBBH4s4s', 0x45, 0, 20 + len(payload), ident,
+        flags_offset, 64, proto, 0, socket.inet_aton(src), socket.inet_aton(dst))
+    cksum = sum(struct.unpack('!10H', header))
+    while cksum > 0xffff:
+        cksum = (cksum & 0xffff) + (cksum >> 16)
+    return header[:10] + struct.pack('!H', ~cksum & 0xffff) + header[12:] + payload
+
+def prefilter_udp(sport, dport, payload):
+    return struct.pack('!HHHH', sport, dport, 8 + len(payload), 0) + payload
+
+def prefilter_ether(payload):
+    return b'\x00\x00\x5e\x00\x53\x01' + b'\x00\x00\x5e\x00\x53\x02' + b'\x08\x00' + payload
+
+def prefilter_fragments(src, dst, sport, dport, ident):
+    '''Two fragments of a UDP datagram; only the first has the ports.'''
+    datagram = prefilter_udp(sport, dport, b'\xaa' * 24)
+    return (prefilter_ipv4(src, dst, 17, datagram[:16], ident, 0, True),
+        prefilter_ipv4(src, dst, 17, datagram[16:], ident, 16))
+
+def write_prefilter_pcap(filename):
+    '''A UDP datagram in fragments, carried directly, inside VXLAN and inside IPIP'''
+    packets = []
+    for frag in prefilter_fragments('10.0.0.1', '10.0.0.2', 1111, 2222, 1):
+        packets.append(prefilter_ether(frag))
+    for frag in prefilter_fragments('10.1.0.1', '10.1.0.2', 3333, 4444, 2):
+        vxlan = struct.pack('!B3xI', 0x08, 1 << 8) + prefilter_ether(frag)
+        packets.append(prefilter_ether(prefilter_ipv4('192.0.2.1', '192.0.2.2', 17,
+            prefilter_udp(40000, 4789, vxlan), 3)))
+    for frag in prefilter_fragments('10.2.0.1', '10.2.0.2', 5555, 6666, 4):
+        packets.append(prefilter_ether(prefilter_ipv4('192.0.2.3', '192.0.2.4', 4, frag, 5)))
+    with open(filename, 'wb') as f:
+        f.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+        for i, packet in enumerate(packets):
+            f.write(struct.pack('<IIII', 1000 + i, 0, len(packet), len(packet)))
+            f.write(packet)
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_tshark_prefilter(subprocesstest.SubprocessTestCase):
+    def run_with_and_without_prefilter(self, cmd_tshark, pcap_file, dfilter, env=None):
+        args = (cmd_tshark, '-r', pcap_file, '-Y', dfilter, '-Tfields', '-e', 'frame.number')
+        without = self.assertRun(args, env=env).stdout_str
+        with_prefilter = self.assertRun(args + ('--prefilter',), env=env).stdout_str
+        self.assertEqual(without, with_prefilter)
+        return without.split()
+
+    def test_tshark_prefilter_fragments(self, cmd_tshark):
+        '''--prefilter dissects fragments, tunneled or not, that complete a match'''
+        pcap_file = self.filename_from_id('prefilter.pcap')
+        write_prefilter_pcap(pcap_file)
+        frames = self.run_with_and_without_prefilter(cmd_tshark, pcap_file,
+            'udp.port in {2222 4444 6666}')
+        self.assertEqual(frames, ['2', '4', '6'])
+
+    def test_tshark_prefilter_decryption(self, cmd_tshark, capture_file):
+        '''--prefilter isn't used for a file with decryption secrets'''
+        frames = self.run_with_and_without_prefilter(cmd_tshark,
+            capture_file('wireguard-ping-tcp-dsb.pcapng'), 'tcp.port == 443')
+        self.assertIn('17', frames)
+
+
 @fixtures.mark_usefixtures('test_env')
 @fixtures.uses_fixtures
 class case_tshark_extcap(subprocesstest.SubprocessTestCase):
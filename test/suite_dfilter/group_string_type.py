@@ -132,6 +132,30 @@ class case_string(unittest.TestCase):
         dfilter = 'http.request.method contains 48:45:41:44' # "HEAD"
         checkDFilterCount(dfilter, 1)
 
+    def test_matches_1(self, checkDFilterCount):
+        dfilter = 'http.request.method matches "^HEAD$"'
+        checkDFilterCount(dfilter, 1)
+
+    def test_matches_optional_1(self, checkDFilterCount):
+        dfilter = 'http.request.method matches "HEX?AD"'
+        checkDFilterCount(dfilter, 1)
+
+    def test_matches_star_1(self, checkDFilterCount):
+        dfilter = 'http.request.method matches "HEX*AD"'
+        checkDFilterCount(dfilter, 1)
+
+    def test_matches_plus_1(self, checkDFilterCount):
+        dfilter = 'http.request.method matches "HEX+AD"'
+        checkDFilterCount(dfilter, 0)
+
+    def test_matches_repeat_1(self, checkDFilterCount):
+        dfilter = 'http.request.method matches "HEX{0,2}AD"'
+        checkDFilterCount(dfilter, 1)
+
+    def test_matches_escaped_optional_1(self, checkDFilterCount):
+        dfilter = r'http.request.method matches "HEA\\.?D"'
+        checkDFilterCount(dfilter, 1)
+
     def test_contains_fail_0(self, checkDFilterCount):
         dfilter = 'http.user_agent contains "update"'
         checkDFilterCount(dfilter, 0)
@@ -249,3 +249,34 @@ class case_decompress_smb2(subprocesstest.SubprocessTestCase):
         if sys.byteorder == 'big':
             fixtures.skip('this test is supported on little endian only')
         self.extract_compressed_payload(cmd_tshark, capture_file, 3)
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_dissect_adaptive_heuristics(subprocesstest.SubprocessTestCase):
+    # Captures whose UDP and TCP payloads are found by heuristic dissectors
+    heuristic_captures = ('udt-dtls.pcapng.gz', 'wireguard-ping-tcp.pcap')
+
+    def dissect(self, cmd_tshark, capture_file, filename, extra_args=()):
+        proc = self.assertRun((cmd_tshark,
+                '-r', capture_file(filename),
+                '-V',
+            ) + tuple(extra_args))
+        return proc.stdout_str
+
+    def test_adaptive_heuristics_repeatable(self, cmd_tshark, capture_file):
+        '''The same capture dissects the same every time with adaptive heuristics.'''
+        for filename in self.heuristic_captures:
+            for extra_args in ((), ('-2',)):
+                args = ('-o', 'protocols.adaptive_heuristics:TRUE') + extra_args
+                first = self.dissect(cmd_tshark, capture_file, filename, args)
+                second = self.dissect(cmd_tshark, capture_file, filename, args)
+                self.assertNotEqual(first, '')
+                self.assertEqual(first, second)
+
+    def test_adaptive_heuristics_off(self, cmd_tshark, capture_file):
+        '''Turning adaptive heuristics off gives the default dissection.'''
+        for filename in self.heuristic_captures:
+            default = self.dissect(cmd_tshark, capture_file, filename)
+            off = self.dissect(cmd_tshark, capture_file, filename,
+                ('-o', 'protocols.adaptive_heuristics:FALSE'))
+            self.assertEqual(default, off)
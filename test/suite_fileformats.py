@@ -9,7 +9,9 @@
 #
 '''File format conversion tests'''
 
+import gzip
 import os.path
+import struct
 import subprocesstest
 import unittest
 import fixtures
@@ -247,3 +249,117 @@ class case_fileformat_mime(subprocesstest.SubprocessTestCase):
                 '-Tfields', '-e', 'frame.len', '-e', 'pcapng.block.length',
             ))
         self.assertEqual(proc.stdout_str.strip(), '480\t128,128,88,88,132,132,132,132')
+
+
+compressed_read_args = ('-o', 'frame.generate_md5_hash:TRUE',
+        '-Tfields', '-e', 'frame.number', '-e', 'frame.time_epoch', '-e', 'frame.len', '-e', 'frame.md5_hash')
+
+
+@fixtures.fixture
+def compress_capture(request, cmd_editcap):
+    '''Factory that compresses a capture file with editcap --compress.'''
+    self = request.instance
+    def compress_capture_real(infile, compression):
+        outfile = self.filename_from_id(os.path.basename(infile) + '.' + compression)
+        self.assertRun((cmd_editcap, '--compress', compression, infile, outfile))
+        return outfile
+    return compress_capture_real
+
+
+@fixtures.fixture
+def check_compressed_read(request, cmd_tshark):
+    '''Factory that checks that a compressed capture file reads the same as
+    the uncompressed one, in one pass, and in two, where each record is
+    read again by seeking to it.'''
+    self = request.instance
+    def check_compressed_read_real(infile, compressed_file):
+        expected = self.assertRun((cmd_tshark, '-r', infile) + compressed_read_args).stdout_str
+        self.assertNotEqual(expected, '')
+        for pass_args in ((), ('-2',)):
+            proc = self.assertRun((cmd_tshark, '-r', compressed_file) + pass_args + compressed_read_args)
+            self.assertEqual(proc.stdout_str, expected)
+    return check_compressed_read_real
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_fileformat_compression(subprocesstest.SubprocessTestCase):
+    def test_gzip(self, capture_file, compress_capture, check_compressed_read):
+        '''Read back a file compressed with gzip by editcap.'''
+        infile = capture_file('dhcp.pcap')
+        check_compressed_read(infile, compress_capture(infile, 'gzip'))
+
+    def test_gzip_bgzf_blocks(self, capture_file, compress_capture, check_compressed_read):
+        '''Read back a file that editcap compresses into several BGZF blocks.'''
+        # Bigger than the 0xff00 bytes editcap puts in a block
+        infile = capture_file('http2-data-reassembly.pcap')
+        outfile = compress_capture(infile, 'gzip')
+        with open(outfile, 'rb') as f:
+            contents = f.read()
+        with open(infile, 'rb') as f:
+            self.assertEqual(gzip.decompress(contents), f.read())
+        # Walk the blocks, using the size in each one's "BC" subfield.
+        offset = 0
+        block_count = 0
+        while offset < len(contents):
+            id1, id2, cm, flg, xlen, si1, si2, slen, bsize = struct.unpack('<BBBB6xHBBHH', contents[offset:offset + 18])
+            self.assertEqual((id1, id2, cm, flg, xlen, si1, si2, slen), (0x1f, 0x8b, 8, 4, 6, ord('B'), ord('C'), 2))
+            offset += bsize + 1
+            block_count += 1
+        self.assertEqual(offset, len(contents))
+        # At least two blocks of data, and the empty end-of-file block
+        self.assertGreaterEqual(block_count, 3)
+        check_compressed_read(infile, outfile)
+
+    def test_gzip_multiple_members(self, capture_file, check_compressed_read):
+        '''Read a gzip file with several ordinary (not BGZF) members.'''
+        infile = capture_file('http2-data-reassembly.pcap')
+        with open(infile, 'rb') as f:
+            data = f.read()
+        # Split the data at places that aren't record boundaries
+        outfile = self.filename_from_id('http2-data-reassembly.pcap.gz')
+        with open(outfile, 'wb') as f:
+            for start, end in ((0, 1000), (1000, 40001), (40001, len(data))):
+                f.write(gzip.compress(data[start:end]))
+        check_compressed_read(infile, outfile)
+
+    def test_zstd(self, features, capture_file, compress_capture, check_compressed_read):
+        '''Read back a file compressed with zstd by editcap.'''
+        if not features.have_zstd:
+            self.skipTest('Requires Zstandard.')
+        infile = capture_file('dhcp.pcap')
+        check_compressed_read(infile, compress_capture(infile, 'zstd'))
+
+    def test_zstd_bad_seek_table(self, features, capture_file, compress_capture, check_compressed_read):
+        '''A zstd seek table whose frames don't add up to the data before it is ignored.'''
+        if not features.have_zstd:
+            self.skipTest('Requires Zstandard.')
+        infile = capture_file('dhcp.pcap')
+        with open(compress_capture(infile, 'zstd'), 'rb') as f:
+            contents = f.read()
+        # The file is small enough to be one frame, followed by a seek
+        # table with one entry without a checksum.
+        num_frames, descriptor, magic = struct.unpack('<IBI', contents[-9:])
+        self.assertEqual((num_frames, descriptor, magic), (1, 0, 0x8F92EAB1))
+        table_len = 8 + 8 + 9
+        data = contents[:-table_len]
+        compressed_size, decompressed_size = struct.unpack('<II', contents[-table_len + 8:-9])
+        self.assertEqual(compressed_size, len(data))
+        # Claim that there's a second frame in the middle of the first
+        # one, with the sizes one byte short of the data.
+        entries = struct.pack('<IIII',
+            compressed_size // 2, decompressed_size // 2,
+            compressed_size - compressed_size // 2 - 1, decompressed_size - decompressed_size // 2)
+        footer = struct.pack('<IBI', 2, 0, 0x8F92EAB1)
+        bad_table = struct.pack('<II', 0x184D2A5E, len(entries) + len(footer)) + entries + footer
+        outfile = self.filename_from_id('dhcp-bad-seek-table.pcap.zstd')
+        with open(outfile, 'wb') as f:
+            f.write(data + bad_table)
+        check_compressed_read(infile, outfile)
+
+    def test_lz4(self, features, capture_file, compress_capture, check_compressed_read):
+        '''Read back a file compressed with LZ4 by editcap.'''
+        if not features.have_lz4:
+            self.skipTest('Requires LZ4.')
+        infile = capture_file('dhcp.pcap')
+        check_compressed_read(infile, compress_capture(infile, 'lz4'))
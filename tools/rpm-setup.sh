@@ -171,6 +171,9 @@ echo "libcap is unavailable" >&2
 add_package ADDITIONAL_LIST nghttp2-devel || add_package ADDITIONAL_LIST libnghttp2-devel ||
 echo "nghttp2 is unavailable" >&2
 
+add_package ADDITIONAL_LIST pcre2-devel ||
+echo "pcre2 is unavailable" >&2
+
 add_package ADDITIONAL_LIST snappy || add_package ADDITIONAL_LIST libsnappy1 ||
 echo "snappy is unavailable" >&2
 
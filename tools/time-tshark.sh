@@ -0,0 +1,73 @@
+#!/bin/bash
+
+# A little script to time tshark building and printing full protocol
+# trees (-V and -T json) for capture file[s], e.g. to compare the speed
+# of two builds:
+#
+#   tools/time-tshark.sh -b /path/to/old/run big.pcapng
+#   tools/time-tshark.sh -b /path/to/new/run big.pcapng
+#
+# For each file and output format, it prints the best of several runs,
+# in seconds of user + system CPU time.
+#
+# Wireshark - Network traffic analyzer
+# By Gerald Combs <gerald@wireshark.org>
+# Copyright 1998 Gerald Combs
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+TEST_TYPE="manual"
+# shellcheck source=tools/test-common.sh
+. "$( dirname "$0" )"/test-common.sh || exit 1
+
+RUNS=5
+
+while getopts "b:n:" OPTCHAR ; do
+    case $OPTCHAR in
+        b) WIRESHARK_BIN_DIR=$OPTARG ;;
+        n) RUNS=$OPTARG ;;
+        *) printf "Unknown option: %s\\n" "$OPTARG"
+    esac
+done
+shift $(( OPTIND - 1 ))
+
+if [ $# -lt 1 ]
+then
+	printf "Usage: %s [-b bin_dir] [-n runs] /path/to/file[s].pcap\\n" "$( basename "$0" )"
+	exit 1
+fi
+
+ws_bind_exec_paths
+ws_check_exec "$TSHARK"
+
+# Print the user + system CPU time of a run of tshark with the given
+# arguments, in milliseconds.
+function cpu_time_ms() {
+	local TIMEFORMAT="%3U %3S"
+	local times
+	times=$( { time "$TSHARK" "$@" > /dev/null 2>&1 ; } 2>&1 ) || return 1
+	# shellcheck disable=SC2086
+	set -- $times
+	echo $(( 10#${1/./} + 10#${2/./} ))
+}
+
+for file in "$@"
+do
+	for format in "-V" "-Tjson"
+	do
+		BEST=
+		for (( run = 0; run < RUNS; run++ ))
+		do
+			if ! MS=$( cpu_time_ms -n $format -r "$file" )
+			then
+				echo "$file: tshark $format failed"
+				exit 1
+			fi
+			if [ -z "$BEST" ] || [ "$MS" -lt "$BEST" ]
+			then
+				BEST=$MS
+			fi
+		done
+		printf "%s: tshark %s: %d.%03d s\\n" "$file" "$format" $(( BEST / 1000 )) $(( BEST % 1000 ))
+	done
+done
@@ -32,6 +32,14 @@
 #include <signal.h>
 #endif
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_WAIT_H
+# include <sys/wait.h>
+#endif
+
 #ifndef HAVE_GETOPT_LONG
 #include "wsutil/wsgetopt.h"
 #endif
@@ -45,6 +53,7 @@
 #include <ui/cmdarg_err.h>
 #include <wsutil/filesystem.h>
 #include <wsutil/file_util.h>
+#include <wsutil/tempfile.h>
 #include <wsutil/socket.h>
 #include <wsutil/privileges.h>
 #include <wsutil/report_message.h>
@@ -63,6 +72,7 @@
 #include "frame_tvbuff.h"
 #include <epan/disabled_protos.h>
 #include <epan/prefs.h>
+#include <epan/prefs-int.h>
 #include <epan/column.h>
 #include <epan/decode_as.h>
 #include <epan/print.h>
@@ -93,6 +103,8 @@
 #include <epan/ex-opt.h>
 #include <epan/exported_pdu.h>
 #include <epan/secrets.h>
+#include <epan/uat-int.h>
+#include <epan/in_cksum.h>
 
 #include "capture_opts.h"
 
@@ -109,6 +121,7 @@
 #endif /* HAVE_LIBPCAP */
 #include "log.h"
 #include <epan/funnel.h>
+#include <epan/app_mem_usage.h>
 
 #include <wsutil/str_util.h>
 #include <wsutil/utf8_entities.h>
@@ -137,6 +150,10 @@
 #define LONGOPT_COLOR                   LONGOPT_BASE_APPLICATION+2
 #define LONGOPT_NO_DUPLICATE_KEYS       LONGOPT_BASE_APPLICATION+3
 #define LONGOPT_ELASTIC_MAPPING_FILTER  LONGOPT_BASE_APPLICATION+4
+#define LONGOPT_THREADS                 LONGOPT_BASE_APPLICATION+5
+#define LONGOPT_PREFILTER               LONGOPT_BASE_APPLICATION+6
+#define LONGOPT_IDLE_TIMEOUT            LONGOPT_BASE_APPLICATION+7
+#define LONGOPT_MEMORY_LIMIT            LONGOPT_BASE_APPLICATION+8
 
 #if 0
 #define tshark_debug(...) g_warning(__VA_ARGS__)
@@ -155,6 +172,52 @@ static gboolean perform_two_pass_analysis;
 static guint32 epan_auto_reset_count = 0;
 static gboolean epan_auto_reset = FALSE;
 
+/*
+ * --prefilter: don't dissect packets whose raw bytes show that they
+ * can't match the read or display filter.  "prefilter_active" is set
+ * while reading a file if that's possible for the current filters.
+ */
+static gboolean prefilter_packets = FALSE;
+static gboolean prefilter_active = FALSE;
+static gboolean prefilter_secrets_seen = FALSE;
+
+/*
+ * Bounded-memory single-pass dissection.  --idle-timeout discards the
+ * state of conversations and reassemblies that have been idle for that
+ * many seconds of capture time; "idle_checkpoints" holds, for every
+ * "idle_granularity" seconds within the timeout, the first frame seen
+ * in them.  --memory-limit resets the session, as -M does, when the
+ * process uses more than that many bytes; "memory_limit_floor" is how
+ * much it used just after the last reset.
+ */
+typedef struct {
+  time_t   secs;
+  guint32  frame_num;
+} idle_checkpoint_t;
+
+static guint32 idle_timeout = 0;
+static guint32 idle_granularity = 1;
+static GQueue idle_checkpoints = G_QUEUE_INIT;
+static gsize memory_limit = 0;
+static gsize memory_limit_floor = 0;
+
+/* How often, in packets, to check the memory usage against the limit. */
+#define MEMORY_LIMIT_CHECK_INTERVAL 1024
+
+/*
+ * Flow-sharded parallel dissection (--threads).  The dissection engine
+ * keeps its state in process-wide globals, so each worker is a separate
+ * process with its own epan session; "dissect_worker_index" is the shard
+ * this process dissects, and "dissect_worker_ctl_fd" is the pipe on which
+ * it reports its output to the parent.
+ */
+static guint dissect_worker_count = 0;
+#ifndef _WIN32
+static guint dissect_worker_index = 0;
+static int dissect_worker_ctl_fd = -1;
+static gint64 dissect_worker_out_offset = 0;
+#endif
+
 /*
  * The way the packet decode is to be written.
  */
@@ -226,6 +289,8 @@ static void report_counts_siginfo(int);
 #endif /* HAVE_LIBPCAP */
 
 static void reset_epan_mem(capture_file *cf, epan_dissect_t *edt, gboolean tree, gboolean visual);
+static gboolean get_memory_usage(gsize *usage);
+static void retire_idle_state(const wtap_rec *rec, guint32 framenum);
 
 typedef enum {
   PROCESS_FILE_SUCCEEDED,
@@ -238,6 +303,17 @@ static process_file_status_t process_cap_file(capture_file *, char *, int, gbool
 static gboolean process_packet_single_pass(capture_file *cf,
     epan_dissect_t *edt, gint64 offset, wtap_rec *rec, Buffer *buf,
     guint tap_flags);
+static gboolean packet_might_match(dfilter_t *dfcode, const wtap_rec *rec,
+    const guint8 *pd);
+static gboolean prefilter_decryption_configured(void);
+static void tshark_secrets_callback(guint32 secrets_type, const void *secrets,
+    guint size);
+#ifndef _WIN32
+static void process_packet_skipped(capture_file *cf, gint64 offset,
+    wtap_rec *rec);
+static guint32 flow_hash(const wtap_rec *rec, const guint8 *pd);
+static gboolean dissect_worker_report_frame(guint32 framenum);
+#endif
 static void show_print_file_io_error(int err);
 static gboolean write_preamble(capture_file *cf);
 static gboolean print_packet(capture_file *cf, epan_dissect_t *edt);
@@ -378,12 +454,20 @@ print_usage(FILE *output)
   fprintf(output, "Processing:\n");
   fprintf(output, "  -2                       perform a two-pass analysis\n");
   fprintf(output, "  -M <packet count>        perform session auto reset\n");
+  fprintf(output, "  --idle-timeout <seconds> discard the state of conversations and reassemblies\n");
+  fprintf(output, "                           idle for this long (single-pass only)\n");
+  fprintf(output, "  --memory-limit <MB>      reset the session when using more memory than this\n");
+  fprintf(output, "                           (single-pass only)\n");
+  fprintf(output, "  --threads <count>        dissect flows in parallel with count worker processes\n");
+  fprintf(output, "                           (single-pass file reading only)\n");
   fprintf(output, "  -R <read filter>, --read-filter <read filter>\n");
   fprintf(output, "                           packet Read filter in Wireshark display filter syntax\n");
   fprintf(output, "                           (requires -2)\n");
   fprintf(output, "  -Y <display filter>, --display-filter <display filter>\n");
   fprintf(output, "                           packet displaY filter in Wireshark display filter\n");
   fprintf(output, "                           syntax\n");
+  fprintf(output, "  --prefilter              don't dissect packets whose raw bytes show they can't\n");
+  fprintf(output, "                           match the read or display filter (reading files only)\n");
   fprintf(output, "  -n                       disable all name resolutions (def: all enabled)\n");
   fprintf(output, "  -N <name resolve flags>  enable specific name resolution(s): \"mnNtdv\"\n");
   fprintf(output, "  -d %s ...\n", DECODE_AS_ARG_TEMPLATE);
@@ -702,6 +786,10 @@ main(int argc, char *argv[])
     {"color", no_argument, NULL, LONGOPT_COLOR},
     {"no-duplicate-keys", no_argument, NULL, LONGOPT_NO_DUPLICATE_KEYS},
     {"elastic-mapping-filter", required_argument, NULL, LONGOPT_ELASTIC_MAPPING_FILTER},
+    {"threads", required_argument, NULL, LONGOPT_THREADS},
+    {"prefilter", no_argument, NULL, LONGOPT_PREFILTER},
+    {"idle-timeout", required_argument, NULL, LONGOPT_IDLE_TIMEOUT},
+    {"memory-limit", required_argument, NULL, LONGOPT_MEMORY_LIMIT},
     {0, 0, 0, 0 }
   };
   gboolean             arg_error = FALSE;
@@ -740,6 +828,7 @@ main(int argc, char *argv[])
   char                *volatile exp_pdu_filename = NULL;
   exp_pdu_t            exp_pdu_tap_data;
   const gchar*         elastic_mapping_filter = NULL;
+  gboolean             taps_requested = FALSE;
 
 /*
  * The leading + ensures that getopt_long() does not permute the argv[]
@@ -1424,6 +1513,7 @@ main(int argc, char *argv[])
         exit_status = INVALID_OPTION;
         goto clean_exit;
       }
+      taps_requested = TRUE;
       break;
     case 'd':        /* Decode as rule */
     case 'K':        /* Kerberos keytab file */
@@ -1451,6 +1541,7 @@ main(int argc, char *argv[])
         exit_status = INVALID_OPTION;
         goto clean_exit;
       }
+      taps_requested = TRUE;
       break;
     case LONGOPT_COLOR: /* print in color where appropriate */
       dissect_color = TRUE;
@@ -1459,6 +1550,20 @@ main(int argc, char *argv[])
       no_duplicate_keys = TRUE;
       node_children_grouper = proto_node_group_children_by_json_key;
       break;
+    case LONGOPT_THREADS:
+      dissect_worker_count = get_positive_int(optarg, "thread count");
+      break;
+    case LONGOPT_PREFILTER:
+      prefilter_packets = TRUE;
+      break;
+    case LONGOPT_IDLE_TIMEOUT:
+      idle_timeout = get_positive_int(optarg, "idle timeout");
+      /* Don't scan for idle state more often than 16 times per timeout. */
+      idle_granularity = MAX(idle_timeout / 16, 1);
+      break;
+    case LONGOPT_MEMORY_LIMIT:
+      memory_limit = (gsize)get_positive_int(optarg, "memory limit") * 1024 * 1024;
+      break;
     default:
     case '?':        /* Bad flag - print usage message */
       switch(optopt) {
@@ -1616,6 +1721,54 @@ main(int argc, char *argv[])
     goto clean_exit;
   }
 
+  if ((idle_timeout != 0 || memory_limit != 0) && perform_two_pass_analysis) {
+    cmdarg_err("--idle-timeout and --memory-limit do not support two pass analysis.");
+    exit_status = INVALID_OPTION;
+    goto clean_exit;
+  }
+
+  if (memory_limit != 0 && !get_memory_usage(NULL)) {
+    cmdarg_err("--memory-limit is not supported on this platform.");
+    exit_status = INVALID_OPTION;
+    goto clean_exit;
+  }
+
+  if (dissect_worker_count > 1) {
+#ifdef _WIN32
+    cmdarg_err("--threads is not supported on this platform.");
+    exit_status = INVALID_OPTION;
+    goto clean_exit;
+#else
+    /*
+     * Each worker re-reads the capture file and writes its own share
+     * of the output, which the parent puts back into frame order, so
+     * we need a seekable file, output that is a sequence of independent
+     * per-packet records, and nothing that accumulates state across
+     * all packets.
+     */
+    if (cf_name == NULL || strcmp(cf_name, "-") == 0) {
+      cmdarg_err("--threads requires a capture file to be read with -r.");
+      exit_status = INVALID_OPTION;
+      goto clean_exit;
+    }
+    if (perform_two_pass_analysis || epan_auto_reset) {
+      cmdarg_err("--threads does not support -2 or -M.");
+      exit_status = INVALID_OPTION;
+      goto clean_exit;
+    }
+    if (output_file_name != NULL || pdu_export_arg != NULL || taps_requested) {
+      cmdarg_err("--threads does not support -w, -U, -z or --export-objects.");
+      exit_status = INVALID_OPTION;
+      goto clean_exit;
+    }
+    if (output_action == WRITE_JSON || output_action == WRITE_JSON_RAW) {
+      cmdarg_err("--threads does not support \"-T json\" or \"-T jsonraw\"; use \"-T ek\".");
+      exit_status = INVALID_OPTION;
+      goto clean_exit;
+    }
+#endif
+  }
+
 #ifdef HAVE_LIBPCAP
   if (caps_queries) {
     /* We're supposed to list the link-layer/timestamp types for an interface;
@@ -2419,6 +2572,7 @@ tshark_epan_new(capture_file *cf)
     cap_file_provider_get_interface_name,
     cap_file_provider_get_interface_description,
     NULL,
+    NULL
   };
 
   return epan_new(&cf->provider, &funcs);
@@ -2973,13 +3127,19 @@ process_packet_first_pass(capture_file *cf, epan_dissect_t *edt,
       cf->provider.ref = &ref_frame;
     }
 
-    epan_dissect_run(edt, cf->cd_t, rec,
-                     frame_tvbuff_new_buffer(&cf->provider, &fdlocal, buf),
-                     &fdlocal, NULL);
+    if (prefilter_active &&
+        !packet_might_match(cf->rfcode, rec, ws_buffer_start_ptr(buf))) {
+      /* It can't pass the read filter; don't bother dissecting it. */
+      passed = FALSE;
+    } else {
+      epan_dissect_run(edt, cf->cd_t, rec,
+                       frame_tvbuff_new_buffer(&cf->provider, &fdlocal, buf),
+                       &fdlocal, NULL);
 
-    /* Run the read filter if we have one. */
-    if (cf->rfcode)
-      passed = dfilter_apply_edt(cf->rfcode, edt);
+      /* Run the read filter if we have one. */
+      if (cf->rfcode)
+        passed = dfilter_apply_edt(cf->rfcode, edt);
+    }
   }
 
   if (passed) {
@@ -3060,21 +3220,22 @@ typedef enum {
   PASS_SUCCEEDED,
   PASS_READ_ERROR,
   PASS_WRITE_ERROR,
-  PASS_INTERRUPTED
+  PASS_INTERRUPTED,
+  PASS_WORKER_ERROR     /* --threads worker failure, already reported */
 } pass_status_t;
 
 static pass_status_t
 process_cap_file_first_pass(capture_file *cf, int max_packet_count,
                             gint64 max_byte_count, int *err, gchar **err_info)
 {
-  wtap_rec        rec;
-  Buffer          buf;
+  wtap_batch     *batch;
+  guint           i;
+  gboolean        done = FALSE;
   epan_dissect_t *edt = NULL;
   gint64          data_offset;
   pass_status_t   status = PASS_SUCCEEDED;
 
-  wtap_rec_init(&rec);
-  ws_buffer_init(&buf, 1514);
+  batch = wtap_batch_new(WTAP_BATCH_SIZE);
 
   /* Allocate a frame_data_sequence for all the frames. */
   cf->provider.frames = new_frame_data_sequence();
@@ -3101,32 +3262,45 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
     /* We're not going to display the protocol tree on this pass,
        so it's not going to be "visible". */
     edt = epan_dissect_new(cf->epan, create_proto_tree, FALSE);
+
+    /* Packets that fail the read filter are dropped, so, if nothing
+       else wants to see them, they needn't be dissected. */
+    prefilter_active = prefilter_packets && cf->rfcode != NULL &&
+      dfilter_has_prefilter(cf->rfcode) && !postdissectors_want_hfids() &&
+      !prefilter_decryption_configured();
   }
 
   tshark_debug("tshark: reading records for first pass");
   *err = 0;
-  while (wtap_read(cf->provider.wth, &rec, &buf, err, err_info, &data_offset)) {
-    if (read_interrupted) {
-      status = PASS_INTERRUPTED;
-      break;
-    }
-    if (process_packet_first_pass(cf, edt, data_offset, &rec, &buf)) {
-      /* Stop reading if we have the maximum number of packets;
-       * When the -c option has not been used, max_packet_count
-       * starts at 0, which practically means, never stop reading.
-       * (unless we roll over max_packet_count ?)
-       */
-      if ( (--max_packet_count == 0) || (max_byte_count != 0 && data_offset >= max_byte_count)) {
-        tshark_debug("tshark: max_packet_count (%d) or max_byte_count (%" G_GINT64_MODIFIER "d/%" G_GINT64_MODIFIER "d) reached",
-                      max_packet_count, data_offset, max_byte_count);
-        *err = 0; /* This is not an error */
+  while (!done && wtap_read_batch(cf->provider.wth, batch, err, err_info)) {
+    for (i = 0; i < batch->count; i++) {
+      if (read_interrupted) {
+        status = PASS_INTERRUPTED;
+        done = TRUE;
         break;
       }
+      data_offset = batch->offsets[i];
+      if (process_packet_first_pass(cf, edt, data_offset, &batch->recs[i], &batch->bufs[i])) {
+        /* Stop reading if we have the maximum number of packets;
+         * When the -c option has not been used, max_packet_count
+         * starts at 0, which practically means, never stop reading.
+         * (unless we roll over max_packet_count ?)
+         */
+        if ( (--max_packet_count == 0) || (max_byte_count != 0 && data_offset >= max_byte_count)) {
+          tshark_debug("tshark: max_packet_count (%d) or max_byte_count (%" G_GINT64_MODIFIER "d/%" G_GINT64_MODIFIER "d) reached",
+                        max_packet_count, data_offset, max_byte_count);
+          *err = 0; /* This is not an error */
+          done = TRUE;
+          break;
+        }
+      }
     }
   }
   if (*err != 0)
     status = PASS_READ_ERROR;
 
+  prefilter_active = FALSE;
+
   if (edt)
     epan_dissect_free(edt);
 
@@ -3140,8 +3314,7 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
   cf->provider.prev_dis = NULL;
   cf->provider.prev_cap = NULL;
 
-  ws_buffer_free(&buf);
-  wtap_rec_cleanup(&rec);
+  wtap_batch_free(batch);
 
   return status;
 }
@@ -3390,6 +3563,14 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
        ("print_packet_info" is true) and we're in verbose mode
        ("packet_details" is true). */
     edt = epan_dissect_new(cf->epan, create_proto_tree, print_packet_info && print_details);
+
+    /* Packets that fail the display filter are only dissected for
+       the benefit of taps and postdissectors, so, if there are none
+       of those, they needn't be dissected. */
+    prefilter_active = prefilter_packets && cf->dfcode != NULL &&
+      dfilter_has_prefilter(cf->dfcode) &&
+      !tap_listeners_require_dissection() && !postdissectors_want_hfids() &&
+      !prefilter_decryption_configured();
   }
 
   /*
@@ -3407,6 +3588,20 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
     }
     framenum++;
 
+#ifndef _WIN32
+    /*
+     * If we're one of several dissection workers, only dissect the
+     * flows that hash to us; just do the frame bookkeeping for the
+     * others, so that frame numbers and relative times still match
+     * those of a single-process run.
+     */
+    if (dissect_worker_count > 1 &&
+        flow_hash(&rec, ws_buffer_start_ptr(&buf)) % dissect_worker_count != dissect_worker_index) {
+      process_packet_skipped(cf, data_offset, &rec);
+      goto next_packet;
+    }
+#endif
+
     tshark_debug("tshark: processing packet #%d", framenum);
 
     reset_epan_mem(cf, edt, create_proto_tree, print_packet_info && print_details);
@@ -3426,6 +3621,15 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
         }
       }
     }
+#ifndef _WIN32
+    if (dissect_worker_ctl_fd != -1 && !dissect_worker_report_frame(framenum)) {
+      /* The parent went away; there's no point in going on. */
+      status = PASS_INTERRUPTED;
+      break;
+    }
+
+next_packet:
+#endif
     /* Stop reading if we have the maximum number of packets;
      * When the -c option has not been used, max_packet_count
      * starts at 0, which practically means, never stop reading.
@@ -3443,6 +3647,8 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
     status = PASS_READ_ERROR;
   }
 
+  prefilter_active = FALSE;
+
   if (edt)
     epan_dissect_free(edt);
 
@@ -3452,6 +3658,638 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
   return status;
 }
 
+/*
+ * Find the IP header of a record, from a cheap parse of its link-layer
+ * header.  Returns the Ethertype of the network layer (0x0800 or 0x86dd)
+ * and sets *ip and *iplen, or returns 0 if the record isn't a packet
+ * with an encapsulation we know that directly carries IPv4 or IPv6.
+ */
+static guint16
+packet_ip_header(const wtap_rec *rec, const guint8 *pd,
+                 const guint8 **ip, guint32 *iplen)
+{
+  guint32 caplen, off = 0;
+  guint16 ethertype = 0;
+
+  if (rec->rec_type != REC_TYPE_PACKET)
+    return 0;
+  caplen = rec->rec_header.packet_header.caplen;
+
+  switch (rec->rec_header.packet_header.pkt_encap) {
+
+  case WTAP_ENCAP_ETHERNET:
+    if (caplen < 14)
+      return 0;
+    ethertype = pntoh16(pd + 12);
+    off = 14;
+    /* Skip 802.1Q/802.1ad VLAN tags. */
+    while ((ethertype == 0x8100 || ethertype == 0x88a8 || ethertype == 0x9100) &&
+           caplen >= off + 4) {
+      ethertype = pntoh16(pd + off + 2);
+      off += 4;
+    }
+    break;
+
+  case WTAP_ENCAP_SLL:
+    if (caplen < 16)
+      return 0;
+    ethertype = pntoh16(pd + 14);
+    off = 16;
+    break;
+
+  case WTAP_ENCAP_RAW_IP:
+    if (caplen < 1)
+      return 0;
+    ethertype = (pd[0] >> 4) == 6 ? 0x86dd : 0x0800;
+    break;
+
+  case WTAP_ENCAP_RAW_IP4:
+    ethertype = 0x0800;
+    break;
+
+  case WTAP_ENCAP_RAW_IP6:
+    ethertype = 0x86dd;
+    break;
+
+  default:
+    return 0;
+  }
+
+  if (ethertype != 0x0800 && ethertype != 0x86dd)
+    return 0;
+
+  *ip = pd + off;
+  *iplen = caplen - off;
+  return ethertype;
+}
+
+/*
+ * Whether the IPv4 (version 4) or IPv6 (version 6) header at "ip"
+ * might be followed by something in which the values a filter looks
+ * for don't appear as they are.
+ *
+ * We only trust headers that directly carry ICMP, TCP, UDP or SCTP, as
+ * the values might be compressed or encrypted in anything else.  A
+ * fragment of an IP datagram other than the first doesn't carry the
+ * transport-layer header, but completing the reassembly of the datagram
+ * might add the fields the filter tests; in IPv6, any extension header
+ * might be, or be followed by, a fragment header.
+ */
+static gboolean
+ip_header_hides_values(guint version, const guint8 *ip, guint32 iplen)
+{
+  if (version == 4) {
+    if (iplen < 20 || (pntoh16(ip + 6) & 0x1fff) != 0)
+      return TRUE;
+    return ip[9] != 1 && ip[9] != 6 && ip[9] != 17 && ip[9] != 132;
+  }
+  if (iplen < 40)
+    return TRUE;
+  return ip[6] != 6 && ip[6] != 17 && ip[6] != 58 && ip[6] != 132;
+}
+
+/*
+ * Whether anything after the outer IP header, of length "hdrlen", looks
+ * like the IP header of a tunneled datagram that ip_header_hides_values()
+ * wouldn't trust.  An IPv4 header has to have a valid checksum and an
+ * IPv6 header has to end at the end of the packet, so that the payload
+ * is seldom mistaken for one; when it is, the packet is just dissected.
+ */
+static gboolean
+tunneled_ip_hides_values(const guint8 *ip, guint32 iplen, guint32 hdrlen)
+{
+  const guint8 *p;
+  guint32 off, left, ihl;
+
+  for (off = hdrlen; off + 20 <= iplen; off++) {
+    p = ip + off;
+    left = iplen - off;
+    if ((p[0] >> 4) == 4) {
+      ihl = (p[0] & 0x0f) * 4;
+      if (ihl < 20 || ihl > left || pntoh16(p + 2) < ihl ||
+          pntoh16(p + 2) > left || ip_checksum(p, (int)ihl) != 0)
+        continue;
+      if (ip_header_hides_values(4, p, left))
+        return TRUE;
+    } else if ((p[0] >> 4) == 6) {
+      if (left < 40 || 40 + (guint32)pntoh16(p + 4) != left)
+        continue;
+      if (ip_header_hides_values(6, p, left))
+        return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/*
+ * Check, without dissecting it, whether a packet could match a filter
+ * for which dfilter_has_prefilter() is true (--prefilter).
+ *
+ * We only trust the test on packets that directly carry IP, with an IP
+ * header, and the header of any datagram tunneled inside it, that
+ * ip_header_hides_values() trusts.
+ */
+static gboolean
+packet_might_match(dfilter_t *dfcode, const wtap_rec *rec, const guint8 *pd)
+{
+  guint16 ethertype;
+  const guint8 *ip;
+  guint32 iplen, hdrlen;
+
+  ethertype = packet_ip_header(rec, pd, &ip, &iplen);
+  if (ethertype == 0x0800) {
+    if (ip_header_hides_values(4, ip, iplen))
+      return TRUE;
+    hdrlen = (ip[0] & 0x0f) * 4;
+  } else if (ethertype == 0x86dd) {
+    if (ip_header_hides_values(6, ip, iplen))
+      return TRUE;
+    hdrlen = 40;
+  } else {
+    return TRUE;
+  }
+  if (tunneled_ip_hides_values(ip, iplen, hdrlen))
+    return TRUE;
+
+  return dfilter_prefilter_might_match(dfcode, pd,
+                                       rec->rec_header.packet_header.caplen);
+}
+
+/*
+ * Values that dissectors decrypt aren't in the raw bytes at all, so
+ * --prefilter isn't used if we have keys to decrypt IPsec or WireGuard
+ * with, from the preferences or from a decryption secrets block in
+ * the file.
+ */
+static void
+tshark_secrets_callback(guint32 secrets_type, const void *secrets, guint size)
+{
+  prefilter_secrets_seen = TRUE;
+  prefilter_active = FALSE;
+  secrets_wtap_callback(secrets_type, secrets, size);
+}
+
+static gboolean
+prefilter_decryption_configured(void)
+{
+  module_t *module;
+  pref_t *pref;
+  const char *keylog_file;
+  uat_t *keys;
+
+  if (prefilter_secrets_seen)
+    return TRUE;
+
+  module = prefs_find_module("esp");
+  pref = module ? prefs_find_preference(module, "enable_encryption_decode") : NULL;
+  if (pref && prefs_get_bool_value(pref, pref_current))
+    return TRUE;
+
+  module = prefs_find_module("wg");
+  pref = module ? prefs_find_preference(module, "keylog_file") : NULL;
+  keylog_file = pref ? prefs_get_string_value(pref, pref_current) : NULL;
+  if (keylog_file && *keylog_file)
+    return TRUE;
+  keys = uat_get_table_by_name("WireGuard static keys");
+  if (keys && keys->user_data->len != 0)
+    return TRUE;
+
+  return FALSE;
+}
+
+#ifndef _WIN32
+/*
+ * Record sent by a dissection worker to the parent, over its control
+ * pipe, for each packet it printed; the output for the packet is in
+ * the worker's output file at [offset, offset + len).  A record with
+ * a frame number of 0 is the trailer, which carries the status of the
+ * worker's pass and is followed by err_info_len bytes of error info.
+ */
+typedef struct {
+  guint32 framenum;
+  gint32  status;
+  gint32  err;
+  guint32 err_info_len;
+  gint64  offset;
+  gint64  len;
+} dissect_worker_rec_t;
+
+static inline guint32
+flow_hash_bytes(guint32 h, const guint8 *p, size_t len)
+{
+  /* FNV-1a */
+  while (len-- != 0) {
+    h ^= *p++;
+    h *= 16777619U;
+  }
+  return h;
+}
+
+static guint32
+flow_hash_endpoint(const guint8 *addr, size_t addr_len, const guint8 *port)
+{
+  guint32 h = 2166136261U;
+
+  h = flow_hash_bytes(h, addr, addr_len);
+  if (port != NULL)
+    h = flow_hash_bytes(h, port, 2);
+  return h;
+}
+
+/*
+ * Compute a hash of the flow to which a record belongs, from a cheap
+ * parse of its link-layer and IP headers.  The hash is symmetric, so
+ * both directions of a flow go to the same worker.
+ *
+ * TCP segments are hashed on addresses and ports, so that TCP-based
+ * protocols spread across workers; everything else is hashed on the
+ * address pair only, so that all fragments of an IP datagram, and
+ * UDP flows whose ports change (e.g. RTP set up by SIP), stay together.
+ * Records we can't parse all go to the same worker.
+ */
+static guint32
+flow_hash(const wtap_rec *rec, const guint8 *pd)
+{
+  guint16 ethertype;
+  const guint8 *ip;
+  guint32 iplen;
+  guint32 h1, h2;
+
+  ethertype = packet_ip_header(rec, pd, &ip, &iplen);
+  if (ethertype == 0x0800) {
+    guint32 ihl;
+    gboolean fragmented;
+
+    if (iplen < 20 || (ip[0] >> 4) != 4)
+      return 0;
+    ihl = (ip[0] & 0x0f) * 4;
+    /* MF set, or a non-zero fragment offset. */
+    fragmented = (pntoh16(ip + 6) & 0x3fff) != 0;
+    if (ip[9] == 6 && !fragmented && ihl >= 20 && iplen >= ihl + 4) {
+      h1 = flow_hash_endpoint(ip + 12, 4, ip + ihl);
+      h2 = flow_hash_endpoint(ip + 16, 4, ip + ihl + 2);
+    } else {
+      h1 = flow_hash_endpoint(ip + 12, 4, NULL);
+      h2 = flow_hash_endpoint(ip + 16, 4, NULL);
+    }
+  } else if (ethertype == 0x86dd) {
+    if (iplen < 40 || (ip[0] >> 4) != 6)
+      return 0;
+    /* Only look at the ports if TCP immediately follows the fixed header. */
+    if (ip[6] == 6 && iplen >= 44) {
+      h1 = flow_hash_endpoint(ip + 8, 16, ip + 40);
+      h2 = flow_hash_endpoint(ip + 24, 16, ip + 42);
+    } else {
+      h1 = flow_hash_endpoint(ip + 8, 16, NULL);
+      h2 = flow_hash_endpoint(ip + 24, 16, NULL);
+    }
+  } else {
+    return 0;
+  }
+
+  /* XOR is symmetric; mix the result so the low bits are usable. */
+  h1 ^= h2;
+  h1 ^= h1 >> 16;
+  h1 *= 0x45d9f3bU;
+  h1 ^= h1 >> 16;
+  return h1;
+}
+
+/*
+ * Do the per-frame bookkeeping for a packet that belongs to another
+ * worker's flows, without dissecting it.
+ *
+ * If there's no display filter, the packet would have been displayed,
+ * so it also becomes the previous displayed frame.  If there is one,
+ * we can't know, so frame.time_delta_displayed and frame.cum_bytes
+ * only take into account packets displayed by this worker.
+ */
+static void
+process_packet_skipped(capture_file *cf, gint64 offset, wtap_rec *rec)
+{
+  frame_data fdata;
+
+  cf->count++;
+
+  frame_data_init(&fdata, cf->count, rec, offset, cum_bytes);
+  frame_data_set_before_dissect(&fdata, &cf->elapsed_time,
+                                &cf->provider.ref, cf->provider.prev_dis);
+  if (cf->provider.ref == &fdata) {
+    ref_frame = fdata;
+    cf->provider.ref = &ref_frame;
+  }
+
+  if (cf->dfcode == NULL) {
+    frame_data_set_after_dissect(&fdata, &cum_bytes);
+    prev_dis_frame = fdata;
+    cf->provider.prev_dis = &prev_dis_frame;
+  }
+
+  prev_cap_frame = fdata;
+  cf->provider.prev_cap = &prev_cap_frame;
+
+  frame_data_destroy(&fdata);
+}
+
+static gboolean
+write_all(int fd, const void *data, size_t len)
+{
+  const char *p = (const char *)data;
+  ssize_t nwritten;
+
+  while (len != 0) {
+    nwritten = ws_write(fd, p, (unsigned int)len);
+    if (nwritten < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+    p += nwritten;
+    len -= nwritten;
+  }
+  return TRUE;
+}
+
+static gboolean
+read_all(int fd, void *data, size_t len)
+{
+  char *p = (char *)data;
+  ssize_t nread;
+
+  while (len != 0) {
+    nread = ws_read(fd, p, (unsigned int)len);
+    if (nread < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+    if (nread == 0)
+      return FALSE;
+    p += nread;
+    len -= nread;
+  }
+  return TRUE;
+}
+
+/*
+ * In a dissection worker, tell the parent about any output we
+ * produced for the packet we just processed.
+ */
+static gboolean
+dissect_worker_report_frame(guint32 framenum)
+{
+  dissect_worker_rec_t wrec;
+  gint64 offset;
+
+  fflush(stdout);
+  offset = ws_lseek64(1, 0, SEEK_CUR);
+  if (offset < 0 || offset == dissect_worker_out_offset)
+    return TRUE;
+
+  memset(&wrec, 0, sizeof wrec);
+  wrec.framenum = framenum;
+  wrec.offset = dissect_worker_out_offset;
+  wrec.len = offset - dissect_worker_out_offset;
+  dissect_worker_out_offset = offset;
+  return write_all(dissect_worker_ctl_fd, &wrec, sizeof wrec);
+}
+
+/*
+ * Body of a dissection worker process: reopen the capture file, so
+ * we have our own file offset, dissect our share of the flows with
+ * our output going to out_fd, send the trailer, and exit.
+ */
+WS_NORETURN static void
+dissect_worker_run(capture_file *cf, guint index, int ctl_fd, int out_fd,
+                   int max_packet_count, gint64 max_byte_count)
+{
+  dissect_worker_rec_t wrec;
+  char *fname;
+  int err = 0;
+  gchar *err_info = NULL;
+  guint32 err_framenum;
+  pass_status_t status;
+
+  dissect_worker_index = index;
+  dissect_worker_ctl_fd = ctl_fd;
+  if (dup2(out_fd, 1) == -1)
+    _exit(2);
+  ws_close(out_fd);
+
+  wtap_close(cf->provider.wth);
+  fname = cf->filename;
+  if (cf_open(cf, fname, cf->open_type, FALSE, &err) != CF_OK) {
+    /* cf_open() reported the error. */
+    status = PASS_WORKER_ERROR;
+  } else {
+    status = process_cap_file_single_pass(cf, NULL, max_packet_count,
+                                          max_byte_count, &err, &err_info,
+                                          &err_framenum);
+    wtap_close(cf->provider.wth);
+  }
+  g_free(fname);
+  fflush(stdout);
+
+  memset(&wrec, 0, sizeof wrec);
+  wrec.status = status;
+  wrec.err = err;
+  wrec.err_info_len = err_info != NULL ? (guint32)strlen(err_info) : 0;
+  if (write_all(ctl_fd, &wrec, sizeof wrec) && wrec.err_info_len != 0)
+    write_all(ctl_fd, err_info, wrec.err_info_len);
+  _exit(0);
+}
+
+/*
+ * Process a capture file with dissect_worker_count worker processes,
+ * each of which dissects the flows that hash to it, and merge their
+ * output back into frame order.
+ *
+ * Each worker writes to its own (unlinked) temporary file and reports
+ * the frame number and extent of each packet's output on a pipe; as
+ * every worker reports in increasing frame order, merging is a k-way
+ * merge of the reports, with the temporary files acting as the reorder
+ * buffer.
+ *
+ * If we can't start all the workers, we stop the ones we did start and
+ * process the file in a single pass ourselves.
+ */
+static pass_status_t
+process_cap_file_workers(capture_file *cf, int max_packet_count,
+                         gint64 max_byte_count, int *err, gchar **err_info,
+                         volatile guint32 *err_framenum)
+{
+  guint n = dissect_worker_count;
+  int *ctl_fds = g_new(int, n);
+  int *out_fds = g_new(int, n);
+  pid_t *pids = g_new(pid_t, n);
+  dissect_worker_rec_t *heads = g_new0(dissect_worker_rec_t, n);
+  gboolean *live = g_new0(gboolean, n);
+  guint nlive = 0;
+  guint i;
+  char *copybuf;
+  gboolean started;
+  pass_status_t status = PASS_SUCCEEDED;
+
+  *err = 0;
+  *err_info = NULL;
+
+  for (i = 0; i < n; i++) {
+    ctl_fds[i] = -1;
+    out_fds[i] = -1;
+    pids[i] = -1;
+  }
+
+  /* Don't let the workers inherit, and duplicate, our buffered output. */
+  fflush(stdout);
+
+  for (i = 0; i < n; i++) {
+    int pipe_fds[2];
+    gchar *tmpname;
+    GError *gerr = NULL;
+
+    out_fds[i] = create_tempfile(&tmpname, "tshark_worker", NULL, &gerr);
+    if (out_fds[i] == -1) {
+      cmdarg_err("Couldn't create a worker output file: %s", gerr->message);
+      g_error_free(gerr);
+      status = PASS_WORKER_ERROR;
+      break;
+    }
+    ws_unlink(tmpname);
+    g_free(tmpname);
+
+    if (pipe(pipe_fds) == -1) {
+      cmdarg_err("Couldn't create a worker pipe: %s", g_strerror(errno));
+      status = PASS_WORKER_ERROR;
+      break;
+    }
+
+    pids[i] = fork();
+    if (pids[i] == -1) {
+      cmdarg_err("Couldn't start a worker process: %s", g_strerror(errno));
+      ws_close(pipe_fds[0]);
+      ws_close(pipe_fds[1]);
+      status = PASS_WORKER_ERROR;
+      break;
+    }
+    if (pids[i] == 0) {
+      guint j;
+
+      /* Child: close what belongs to the parent and the other workers. */
+      ws_close(pipe_fds[0]);
+      for (j = 0; j < i; j++) {
+        ws_close(ctl_fds[j]);
+        ws_close(out_fds[j]);
+      }
+      dissect_worker_run(cf, i, pipe_fds[1], out_fds[i],
+                         max_packet_count, max_byte_count);
+    }
+    ws_close(pipe_fds[1]);
+    ctl_fds[i] = pipe_fds[0];
+  }
+  started = (status == PASS_SUCCEEDED);
+
+  /* Prime the merge with each worker's first report. */
+  for (i = 0; started && i < n; i++) {
+    if (read_all(ctl_fds[i], &heads[i], sizeof heads[i])) {
+      live[i] = TRUE;
+      nlive++;
+    }
+  }
+
+  copybuf = (char *)g_malloc(65536);
+  while (nlive != 0) {
+    guint best = n;
+
+    /* Retire the workers whose next report is their trailer. */
+    for (i = 0; i < n; i++) {
+      if (!live[i] || heads[i].framenum != 0)
+        continue;
+      if (heads[i].status != PASS_SUCCEEDED && status == PASS_SUCCEEDED) {
+        /* All workers read the same file, so report only the first error. */
+        status = (pass_status_t)heads[i].status;
+        *err = heads[i].err;
+        if (heads[i].err_info_len != 0) {
+          *err_info = (gchar *)g_malloc0(heads[i].err_info_len + 1);
+          if (!read_all(ctl_fds[i], *err_info, heads[i].err_info_len)) {
+            g_free(*err_info);
+            *err_info = NULL;
+          }
+        }
+      }
+      live[i] = FALSE;
+      nlive--;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (live[i] && (best == n || heads[i].framenum < heads[best].framenum))
+        best = i;
+    }
+    if (best == n)
+      break;
+
+    /* Copy this packet's output from the worker's file. */
+    if (ws_lseek64(out_fds[best], heads[best].offset, SEEK_SET) == -1) {
+      cmdarg_err("Couldn't read a worker output file: %s", g_strerror(errno));
+      status = PASS_WORKER_ERROR;
+      break;
+    }
+    while (heads[best].len != 0) {
+      size_t chunk = (size_t)MIN(heads[best].len, 65536);
+
+      if (!read_all(out_fds[best], copybuf, chunk)) {
+        cmdarg_err("Couldn't read a worker output file: %s", g_strerror(errno));
+        status = PASS_WORKER_ERROR;
+        break;
+      }
+      fwrite(copybuf, 1, chunk, stdout);
+      heads[best].len -= chunk;
+    }
+    if (status == PASS_WORKER_ERROR)
+      break;
+    if (line_buffered)
+      fflush(stdout);
+    if (ferror(stdout)) {
+      show_print_file_io_error(errno);
+      exit(2);
+    }
+
+    if (!read_all(ctl_fds[best], &heads[best], sizeof heads[best])) {
+      /* The worker died without sending its trailer. */
+      cmdarg_err("A dissection worker process exited unexpectedly.");
+      status = PASS_WORKER_ERROR;
+      live[best] = FALSE;
+      nlive--;
+    }
+  }
+  g_free(copybuf);
+
+  for (i = 0; i < n; i++) {
+    if (ctl_fds[i] != -1)
+      ws_close(ctl_fds[i]);
+    if (out_fds[i] != -1)
+      ws_close(out_fds[i]);
+    if (pids[i] > 0) {
+      if (status == PASS_WORKER_ERROR)
+        kill(pids[i], SIGTERM);
+      waitpid(pids[i], NULL, 0);
+    }
+  }
+  g_free(live);
+  g_free(heads);
+  g_free(pids);
+  g_free(out_fds);
+  g_free(ctl_fds);
+
+  if (!started) {
+    cmdarg_err_cont("Dissecting in a single process instead.");
+    return process_cap_file_single_pass(cf, NULL, max_packet_count,
+                                        max_byte_count, err, err_info,
+                                        err_framenum);
+  }
+  return status;
+}
+#endif /* _WIN32 */
+
 static process_file_status_t
 process_cap_file(capture_file *cf, char *save_file, int out_file_type,
     gboolean out_file_name_res, int max_packet_count, gint64 max_byte_count)
@@ -3566,6 +4404,14 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
     tshark_debug("tshark: perform one pass analysis, do_dissection=%s", do_dissection ? "TRUE" : "FALSE");
 
     first_pass_status = PASS_SUCCEEDED; /* There is no first pass */
+#ifndef _WIN32
+    if (dissect_worker_count > 1) {
+      second_pass_status = process_cap_file_workers(cf, max_packet_count,
+                                                    max_byte_count,
+                                                    &err, &err_info,
+                                                    &err_framenum);
+    } else
+#endif
     second_pass_status = process_cap_file_single_pass(cf, pdh,
                                                       max_packet_count,
                                                       max_byte_count,
@@ -3621,6 +4467,7 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
       break;
 
     case PASS_WRITE_ERROR:
+    case PASS_WORKER_ERROR:
       /* Won't happen on the first pass. */
       break;
 
@@ -3653,6 +4500,11 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
       status = PROCESS_FILE_ERROR;
       break;
 
+    case PASS_WORKER_ERROR:
+      /* Already reported. */
+      status = PROCESS_FILE_ERROR;
+      break;
+
     case PASS_INTERRUPTED:
       /* Not an error, so nothing to report. */
       status = PROCESS_FILE_INTERRUPTED;
@@ -3755,13 +4607,19 @@ process_packet_single_pass(capture_file *cf, epan_dissect_t *edt, gint64 offset,
       fdata.need_colorize = 1;
     }
 
-    epan_dissect_run_with_taps(edt, cf->cd_t, rec,
-                               frame_tvbuff_new_buffer(&cf->provider, &fdata, buf),
-                               &fdata, cinfo);
+    if (prefilter_active &&
+        !packet_might_match(cf->dfcode, rec, ws_buffer_start_ptr(buf))) {
+      /* It can't pass the display filter; don't bother dissecting it. */
+      passed = FALSE;
+    } else {
+      epan_dissect_run_with_taps(edt, cf->cd_t, rec,
+                                 frame_tvbuff_new_buffer(&cf->provider, &fdata, buf),
+                                 &fdata, cinfo);
 
-    /* Run the filter if we have it. */
-    if (cf->dfcode)
-      passed = dfilter_apply_edt(cf->dfcode, edt);
+      /* Run the filter if we have it. */
+      if (cf->dfcode)
+        passed = dfilter_apply_edt(cf->dfcode, edt);
+    }
   }
 
   if (passed) {
@@ -3798,9 +4656,50 @@ process_packet_single_pass(capture_file *cf, epan_dissect_t *edt, gint64 offset,
     epan_dissect_reset(edt);
     frame_data_destroy(&fdata);
   }
+
+  if (idle_timeout != 0)
+    retire_idle_state(rec, fdata.num);
+
   return passed;
 }
 
+/*
+ * --idle-timeout: note the first frame seen in each "idle_granularity"
+ * seconds of capture time, and, once such a frame is "idle_timeout"
+ * seconds old, discard state that hasn't been used since before it.
+ * That assumes that time stamps don't go backwards, which isn't always
+ * true, but it's only off by the amount they go backwards.
+ */
+static void
+retire_idle_state(const wtap_rec *rec, guint32 framenum)
+{
+  idle_checkpoint_t *checkpoint, *cutoff = NULL;
+  time_t now;
+
+  if (!(rec->presence_flags & WTAP_HAS_TS))
+    return;
+  now = rec->ts.secs;
+
+  checkpoint = (idle_checkpoint_t *)g_queue_peek_tail(&idle_checkpoints);
+  if (checkpoint != NULL && now < checkpoint->secs + (time_t)idle_granularity)
+    return;
+
+  checkpoint = g_new(idle_checkpoint_t, 1);
+  checkpoint->secs = now;
+  checkpoint->frame_num = framenum;
+  g_queue_push_tail(&idle_checkpoints, checkpoint);
+
+  while ((checkpoint = (idle_checkpoint_t *)g_queue_peek_head(&idle_checkpoints)) != NULL &&
+         now - checkpoint->secs >= (time_t)idle_timeout) {
+    g_free(cutoff);
+    cutoff = (idle_checkpoint_t *)g_queue_pop_head(&idle_checkpoints);
+  }
+  if (cutoff != NULL) {
+    epan_retire_idle_state(cutoff->frame_num);
+    g_free(cutoff);
+  }
+}
+
 static gboolean
 write_preamble(capture_file *cf)
 {
@@ -4263,6 +5162,13 @@ cf_open(capture_file *cf, const char *fname, unsigned int type, gboolean is_temp
   if (wth == NULL)
     goto fail;
 
+  /* We only ever look at a record's data until we read the next one, and
+     we don't modify it, so it can stay in the mapped file.  The pages of
+     the mapping count toward our RSS, though, and no session reset can
+     free them, so don't map the file if we're limiting that. */
+  if (memory_limit == 0)
+    wtap_use_mmap(wth);
+
   /* The open succeeded.  Fill in the information for this file. */
 
   cf->provider.wth = wth;
@@ -4296,7 +5202,8 @@ cf_open(capture_file *cf, const char *fname, unsigned int type, gboolean is_temp
 
   wtap_set_cb_new_ipv4(cf->provider.wth, add_ipv4_name);
   wtap_set_cb_new_ipv6(cf->provider.wth, (wtap_new_ipv6_callback_t) add_ipv6_name);
-  wtap_set_cb_new_secrets(cf->provider.wth, secrets_wtap_callback);
+  prefilter_secrets_seen = FALSE;
+  wtap_set_cb_new_secrets(cf->provider.wth, tshark_secrets_callback);
 
   return CF_OK;
 
@@ -4389,9 +5296,51 @@ write_failure_message(const char *filename, int err)
              filename, g_strerror(err));
 }
 
+/*
+ * Get the amount of memory the process is using, preferring the resident
+ * set size if we can get it.  Returns FALSE if we can't get either.
+ */
+static gboolean
+get_memory_usage(gsize *usage)
+{
+  const char *name;
+  gsize value;
+  gboolean found = FALSE;
+  guint i;
+
+  for (i = 0; (name = memory_usage_get(i, &value)) != NULL; i++) {
+    if (strcmp(name, "RSS") == 0 || (!found && strcmp(name, "Total") == 0)) {
+      if (usage)
+        *usage = value;
+      found = TRUE;
+    }
+  }
+  return found;
+}
+
+static gboolean
+memory_limit_reached(capture_file *cf)
+{
+  gsize usage;
+
+  if (memory_limit == 0 || cf->count == 0 ||
+      (cf->count % MEMORY_LIMIT_CHECK_INTERVAL) != 0)
+    return FALSE;
+  if (!get_memory_usage(&usage) || usage <= memory_limit)
+    return FALSE;
+
+  /* If the last reset didn't get us back under the limit, e.g. because
+     the memory isn't returned to the system, don't reset again until we
+     have grown by a quarter of the limit, or we'd reset at every check. */
+  return usage >= memory_limit_floor + memory_limit / 4;
+}
+
 static void reset_epan_mem(capture_file *cf,epan_dissect_t *edt, gboolean tree, gboolean visual)
 {
-  if (!epan_auto_reset || (cf->count < epan_auto_reset_count))
+  gsize usage;
+
+  if ((!epan_auto_reset || (cf->count < epan_auto_reset_count)) &&
+      !memory_limit_reached(cf))
     return;
 
   fprintf(stderr, "resetting session.\n");
@@ -4402,6 +5351,18 @@ static void reset_epan_mem(capture_file *cf,epan_dissect_t *edt, gboolean tree,
   cf->epan = tshark_epan_new(cf);
   epan_dissect_init(edt, cf->epan, tree, visual);
   cf->count = 0;
+
+  /* Frame numbers start over, so the idle checkpoints are meaningless. */
+  while (!g_queue_is_empty(&idle_checkpoints))
+    g_free(g_queue_pop_head(&idle_checkpoints));
+
+  if (memory_limit != 0) {
+    /* Freeing the file scope gave its memory back to the allocator;
+       try to give it back to the system as well. */
+    memory_usage_gc();
+    if (get_memory_usage(&usage))
+      memory_limit_floor = usage;
+  }
 }
 
 /*
@@ -33,10 +33,10 @@ ConversationHashTablesDialog::ConversationHashTablesDialog(QWidget *parent) :
 
     html += "<h3>Conversation Hash Tables</h3>\n";
 
-    html += hashTableToHtmlTable("conversation_hashtable_exact", get_conversation_hashtable_exact());
-    html += hashTableToHtmlTable("conversation_hashtable_no_addr2", get_conversation_hashtable_no_addr2());
-    html += hashTableToHtmlTable("conversation_hashtable_no_port2", get_conversation_hashtable_no_port2());
-    html += hashTableToHtmlTable("conversation_hashtable_no_addr2_or_port2", get_conversation_hashtable_no_addr2_or_port2());
+    html += hashTableToHtmlTable("exact", conversation_get_keys(NULL, 0));
+    html += hashTableToHtmlTable("no_addr2", conversation_get_keys(NULL, NO_ADDR2));
+    html += hashTableToHtmlTable("no_port2", conversation_get_keys(NULL, NO_PORT2));
+    html += hashTableToHtmlTable("no_addr2_or_port2", conversation_get_keys(NULL, NO_ADDR2|NO_PORT2));
 
     ui->conversationTextEdit->setHtml(html);
 }
@@ -58,15 +58,9 @@ populate_html_table(gpointer data, gpointer user_data)
     wmem_free(NULL, tmp);
 }
 
-const QString ConversationHashTablesDialog::hashTableToHtmlTable(const QString table_name, wmem_map_t *hash_table)
+const QString ConversationHashTablesDialog::hashTableToHtmlTable(const QString table_name, wmem_list_t *conversation_keys)
 {
-    wmem_list_t *conversation_keys = NULL;
-    guint num_keys = 0;
-    if (hash_table)
-    {
-        conversation_keys = wmem_map_get_keys(NULL, hash_table);
-        num_keys = wmem_list_count(conversation_keys);
-    }
+    guint num_keys = wmem_list_count(conversation_keys);
 
     QString html_table = QString("<p>%1, %2 entries</p>").arg(table_name).arg(num_keys);
     if (num_keys > 0)
@@ -79,8 +73,7 @@ const QString ConversationHashTablesDialog::hashTableToHtmlTable(const QString t
         wmem_list_foreach(conversation_keys, populate_html_table, (void*)&html_table);
         html_table += "</table>\n";
     }
-    if (conversation_keys)
-        wmem_destroy_list(conversation_keys);
+    wmem_destroy_list(conversation_keys);
     return html_table;
 }
 
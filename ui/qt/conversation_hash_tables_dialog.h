@@ -28,7 +28,7 @@ public:
 private:
     Ui::ConversationHashTablesDialog *ui;
 
-    const QString hashTableToHtmlTable(const QString table_name, wmem_map_t *hash_table);
+    const QString hashTableToHtmlTable(const QString table_name, wmem_list_t *conversation_keys);
 };
 
 #endif // CONVERSATION_HASH_TABLES_DIALOG_H
@@ -2241,7 +2241,7 @@ wtap_dump_can_open(int file_type_subtype)
 	return TRUE;
 }
 
-#ifdef HAVE_ZLIB
+#if defined(HAVE_ZLIB) || defined(HAVE_FRAMEWFILE)
 gboolean
 wtap_dump_can_compress(int file_type_subtype)
 {
@@ -2289,6 +2289,12 @@ wtap_dump_supports_comment_types(int file_type_subtype, guint32 comment_types)
 	return FALSE;
 }
 
+#ifdef HAVE_FRAMEWFILE
+/* Is this a compression type written by the zstd/LZ4 frame writer? */
+#define IS_FRAME_COMPRESSED(type) \
+	((type) == WTAP_ZSTD_COMPRESSED || (type) == WTAP_LZ4_COMPRESSED)
+#endif
+
 static gboolean wtap_dump_open_check(int file_type_subtype, int encap, gboolean compressed, int *err);
 static wtap_dumper* wtap_dump_alloc_wdh(int file_type_subtype, int encap, int snaplen,
 					wtap_compression_type compression_type,
@@ -2317,6 +2323,13 @@ wtap_dump_init_dumper(int file_type_subtype, wtap_compression_type compression_t
 	    (compression_type != WTAP_UNCOMPRESSED), err))
 		return NULL;
 
+	/* ...and whether we can write that kind of compressed file at all. */
+	if (compression_type != WTAP_UNCOMPRESSED &&
+	    wtap_compression_type_description(compression_type) == NULL) {
+		*err = WTAP_ERR_COMPRESSION_NOT_SUPPORTED;
+		return NULL;
+	}
+
 	/* Allocate a data structure for the output stream. */
 	wdh = wtap_dump_alloc_wdh(file_type_subtype, params->encap,
 	    params->snaplen, compression_type, err);
@@ -2668,6 +2681,11 @@ wtap_dump_flush(wtap_dumper *wdh)
 	if (wdh->compression_type == WTAP_GZIP_COMPRESSED) {
 		gzwfile_flush((GZWFILE_T)wdh->fh);
 	} else
+#endif
+#ifdef HAVE_FRAMEWFILE
+	if (IS_FRAME_COMPRESSED(wdh->compression_type)) {
+		framewfile_flush((FRAMEWFILE_T)wdh->fh);
+	} else
 #endif
 	{
 		fflush((FILE *)wdh->fh);
@@ -2759,13 +2777,21 @@ gboolean wtap_dump_get_needs_reload(wtap_dumper *wdh) {
 }
 
 /* internally open a file for writing (compressed or not) */
-#ifdef HAVE_ZLIB
+#if defined(HAVE_ZLIB) || defined(HAVE_FRAMEWFILE)
 static WFILE_T
 wtap_dump_file_open(wtap_dumper *wdh, const char *filename)
 {
+#ifdef HAVE_ZLIB
 	if (wdh->compression_type == WTAP_GZIP_COMPRESSED) {
 		return gzwfile_open(filename);
-	} else {
+	} else
+#endif
+#ifdef HAVE_FRAMEWFILE
+	if (IS_FRAME_COMPRESSED(wdh->compression_type)) {
+		return framewfile_open(filename, wdh->compression_type);
+	} else
+#endif
+	{
 		return ws_fopen(filename, "wb");
 	}
 }
@@ -2778,13 +2804,21 @@ wtap_dump_file_open(wtap_dumper *wdh _U_, const char *filename)
 #endif
 
 /* internally open a file for writing (compressed or not) */
-#ifdef HAVE_ZLIB
+#if defined(HAVE_ZLIB) || defined(HAVE_FRAMEWFILE)
 static WFILE_T
 wtap_dump_file_fdopen(wtap_dumper *wdh, int fd)
 {
+#ifdef HAVE_ZLIB
 	if (wdh->compression_type == WTAP_GZIP_COMPRESSED) {
 		return gzwfile_fdopen(fd);
-	} else {
+	} else
+#endif
+#ifdef HAVE_FRAMEWFILE
+	if (IS_FRAME_COMPRESSED(wdh->compression_type)) {
+		return framewfile_fdopen(fd, wdh->compression_type);
+	} else
+#endif
+	{
 		return ws_fdopen(fd, "wb");
 	}
 }
@@ -2813,6 +2847,18 @@ wtap_dump_file_write(wtap_dumper *wdh, const void *buf, size_t bufsize, int *err
 			return FALSE;
 		}
 	} else
+#endif
+#ifdef HAVE_FRAMEWFILE
+	if (IS_FRAME_COMPRESSED(wdh->compression_type)) {
+		nwritten = framewfile_write((FRAMEWFILE_T)wdh->fh, buf, (unsigned int) bufsize);
+		/*
+		 * framewfile_write() returns 0 on error.
+		 */
+		if (nwritten == 0) {
+			*err = framewfile_geterr((FRAMEWFILE_T)wdh->fh);
+			return FALSE;
+		}
+	} else
 #endif
 	{
 		errno = WTAP_ERR_CANT_WRITE;
@@ -2840,6 +2886,11 @@ wtap_dump_file_close(wtap_dumper *wdh)
 	if (wdh->compression_type == WTAP_GZIP_COMPRESSED)
 		return gzwfile_close((GZWFILE_T)wdh->fh);
 	else
+#endif
+#ifdef HAVE_FRAMEWFILE
+	if (IS_FRAME_COMPRESSED(wdh->compression_type))
+		return framewfile_close((FRAMEWFILE_T)wdh->fh);
+	else
 #endif
 		return fclose((FILE *)wdh->fh);
 }
@@ -2847,7 +2898,7 @@ wtap_dump_file_close(wtap_dumper *wdh)
 gint64
 wtap_dump_file_seek(wtap_dumper *wdh, gint64 offset, int whence, int *err)
 {
-#ifdef HAVE_ZLIB
+#if defined(HAVE_ZLIB) || defined(HAVE_FRAMEWFILE)
 	if (wdh->compression_type != WTAP_UNCOMPRESSED) {
 		*err = WTAP_ERR_CANT_SEEK_COMPRESSED;
 		return -1;
@@ -2868,7 +2919,7 @@ gint64
 wtap_dump_file_tell(wtap_dumper *wdh, int *err)
 {
 	gint64 rval;
-#ifdef HAVE_ZLIB
+#if defined(HAVE_ZLIB) || defined(HAVE_FRAMEWFILE)
 	if (wdh->compression_type != WTAP_UNCOMPRESSED) {
 		*err = WTAP_ERR_CANT_SEEK_COMPRESSED;
 		return -1;
@@ -21,12 +21,27 @@
 #include "wtap-int.h"
 #include "file_wrappers.h"
 #include <wsutil/file_util.h>
+#include <wsutil/pint.h>
+
+#include <glib/gstdio.h>
+
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+#include <sys/mman.h>
+#endif
 
 #ifdef HAVE_ZLIB
 #define ZLIB_CONST
 #include <zlib.h>
 #endif /* HAVE_ZLIB */
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif /* HAVE_ZSTD */
+
+#ifdef HAVE_LZ4FRAME_H
+#include <lz4frame.h>
+#endif /* HAVE_LZ4FRAME_H */
+
 /*
  * See RFC 1952:
  *
@@ -34,6 +49,18 @@
  *
  * for a description of the gzip file format.
  *
+ * See
+ *
+ *      https://github.com/facebook/zstd/blob/dev/doc/zstd_compression_format.md
+ *      https://github.com/facebook/zstd/blob/dev/contrib/seekable_format/zstd_seekable_compression_format.md
+ *
+ * for descriptions of the zstd file format and of the seek table that
+ * can be put at the end of a zstd file, and
+ *
+ *      https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md
+ *
+ * for a description of the LZ4 frame format.
+ *
  * Some other compressed file formats we might want to support:
  *
  *      XZ format: https://tukaani.org/xz/
@@ -50,22 +77,20 @@ static struct compression_type {
     wtap_compression_type  type;
     const char            *extension;
     const char            *description;
+    const char            *name;
 } compression_types[] = {
 #ifdef HAVE_ZLIB
-    { WTAP_GZIP_COMPRESSED, "gz", "gzip compressed" },
+    { WTAP_GZIP_COMPRESSED, "gz", "gzip compressed", "gzip" },
+#endif
+#ifdef HAVE_ZSTD
+    { WTAP_ZSTD_COMPRESSED, "zst", "zstd compressed", "zstd" },
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    { WTAP_LZ4_COMPRESSED, "lz4", "LZ4 compressed", "lz4" },
 #endif
-    { WTAP_UNCOMPRESSED, NULL, NULL }
+    { WTAP_UNCOMPRESSED, NULL, NULL, NULL }
 };
 
-wtap_compression_type
-wtap_get_compression_type(wtap *wth)
-{
-	gboolean is_compressed;
-
-	is_compressed = file_iscompressed((wth->fh == NULL) ? wth->random_fh : wth->fh);
-	return is_compressed ? WTAP_GZIP_COMPRESSED : WTAP_UNCOMPRESSED;
-}
-
 const char *
 wtap_compression_type_description(wtap_compression_type compression_type)
 {
@@ -88,6 +113,19 @@ wtap_compression_type_extension(wtap_compression_type compression_type)
 	return NULL;
 }
 
+gboolean
+wtap_name_to_compression_type(const char *name, wtap_compression_type *compression_type)
+{
+	for (struct compression_type *p = compression_types;
+	    p->type != WTAP_UNCOMPRESSED; p++) {
+		if (g_ascii_strcasecmp(p->name, name) == 0) {
+			*compression_type = p->type;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 GSList *
 wtap_get_all_compression_type_extensions_list(void)
 {
@@ -105,13 +143,24 @@ wtap_get_all_compression_type_extensions_list(void)
 /* #define GZBUFSIZE 8192 */
 #define GZBUFSIZE 4096
 
+/* Magic numbers at the beginning of zstd and LZ4 frames */
+#define ZSTD_FRAME_MAGIC        0xFD2FB528U
+#define LZ4_FRAME_MAGIC         0x184D2204U
+
 /* values for wtap_reader compression */
 typedef enum {
     UNKNOWN,       /* unknown - look for a gzip header */
     UNCOMPRESSED,  /* uncompressed - copy input directly */
 #ifdef HAVE_ZLIB
     ZLIB,          /* decompress a zlib stream */
-    GZIP_AFTER_HEADER
+    GZIP_AFTER_HEADER,
+    BGZF,          /* decompress BGZF blocks, several at a time */
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD,          /* decompress a zstd stream */
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    LZ4,           /* decompress an LZ4 frame stream */
 #endif
 } compression_t;
 
@@ -135,6 +184,7 @@ struct wtap_reader {
     gint64 raw;                 /* where the raw data started, for seeking */
     compression_t compression;  /* type of compression, if any */
     gboolean is_compressed;     /* FALSE if completely uncompressed, TRUE otherwise */
+    wtap_compression_type compression_type; /* type of compression, for wtap_get_compression_type() */
 
     /* seek request */
     gint64 skip;                /* amount to skip (already rewound if backwards) */
@@ -148,12 +198,40 @@ struct wtap_reader {
     /* zlib inflate stream */
     z_stream strm;              /* stream structure in-place (not a pointer) */
     gboolean dont_check_crc;    /* TRUE if we aren't supposed to check the CRC */
+    struct bgzf_queue *bgzf;    /* BGZF blocks being decompressed, or NULL */
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zstd_dstream; /* zstd decompression stream */
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    LZ4F_decompressionContext_t lz4_ctx; /* LZ4 decompression context */
+#endif
+#if defined(HAVE_ZSTD) || defined(HAVE_LZ4FRAME_H)
+    gboolean in_frame;          /* TRUE if we're partway through a zstd or LZ4 frame */
 #endif
     /* fast seeking */
     GPtrArray *fast_seek;
     void *fast_seek_cur;
+
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+    /* memory mapping, if file_set_mmap() was called */
+    gboolean map_allowed;       /* TRUE if we may map the file */
+    gboolean map_tried;         /* TRUE if we've tried to map it */
+    guint8 *map;                /* the mapping, or NULL */
+    gint64 map_len;             /* length of the mapping */
+    gboolean in_map;            /* TRUE if out is a window onto the mapping */
+    unsigned char *out_buf;     /* our own output buffer, while it is */
+#endif
 };
 
+wtap_compression_type
+wtap_get_compression_type(wtap *wth)
+{
+	FILE_T fh = (wth->fh == NULL) ? wth->random_fh : wth->fh;
+
+	return fh->compression_type;
+}
+
 /* Current read offset within a buffer. */
 static guint
 offset_in_buffer(struct wtap_reader_buf *buf)
@@ -240,6 +318,119 @@ fill_in_buffer(FILE_T state)
     return 0;
 }
 
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+/*
+ * If file_set_mmap() has been called, an uncompressed regular file is
+ * mapped into memory the first time we need more data from it, and
+ * from then on the output buffer is a window onto the mapping, so that
+ * reading doesn't take a system call, and, with file_read_mapped(),
+ * doesn't copy anything either.
+ *
+ * The mapping is private and writable, so that code that modifies
+ * packet data in place doesn't crash if it's handed data in the
+ * mapping; the changes never make it to the file.
+ *
+ * The mapping covers what was in the file when it was made; if the
+ * file grows, because something's still writing to it, we go back to
+ * reading it once we're past the end of the mapping.
+ */
+static void
+map_file(FILE_T state)
+{
+    ws_statb64 st;
+    void *map;
+
+    state->map_tried = TRUE;
+    if (state->is_compressed)
+        return;
+    if (ws_fstat64(state->fd, &st) == -1 || !S_ISREG(st.st_mode))
+        return;
+    if (st.st_size <= state->start || (guint64)st.st_size > G_MAXSIZE)
+        return;
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+               state->fd, 0);
+    if (map == MAP_FAILED)
+        return;
+    state->map = (guint8 *)map;
+    state->map_len = st.st_size;
+}
+
+/* Make the output buffer a window onto the mapping, starting at the
+   given position in the data. */
+static void
+enter_map(FILE_T state, gint64 pos)
+{
+    gint64 left = state->map_len - state->start - pos;
+
+    if (!state->in_map) {
+        state->out_buf = state->out.buf;
+        state->in_map = TRUE;
+    }
+    state->out.buf = state->map + state->start + pos;
+    state->out.next = state->out.buf;
+    /* Its length is an unsigned int, so we might only see part of
+       the rest of a very large file through it. */
+    state->out.avail = left > G_MAXINT ? G_MAXINT : (guint)left;
+    state->pos = pos;
+    buf_reset(&state->in);
+    state->eof = FALSE;
+    state->err = 0;
+    state->err_info = NULL;
+}
+
+/* Go back to reading the file into our own output buffer, from the
+   current position. */
+static int
+leave_map(FILE_T state)
+{
+    gint64 off = state->start + state->pos;
+
+    state->out.buf = state->out_buf;
+    state->in_map = FALSE;
+    buf_reset(&state->out);
+    if (ws_lseek64(state->fd, off, SEEK_SET) == -1) {
+        state->err = errno;
+        state->err_info = NULL;
+        return -1;
+    }
+    state->raw_pos = off;
+    return 0;
+}
+
+/* Get more uncompressed data from the mapping, if we can.  Returns 1 if
+   there's now data in the output buffer, 0 if the caller should read
+   from the file, and -1 on error. */
+static int
+fill_from_map(FILE_T state)
+{
+    if (!state->map_allowed)
+        return 0;
+    if (state->map == NULL && !state->map_tried)
+        map_file(state);
+    if (state->map != NULL && state->pos < state->map_len - state->start) {
+        enter_map(state, state->pos);
+        return 1;
+    }
+    if (state->in_map && leave_map(state) == -1)
+        return -1;
+    return 0;
+}
+
+static void
+unmap_file(FILE_T state)
+{
+    if (state->in_map) {
+        state->out.buf = state->out_buf;
+        state->in_map = FALSE;
+        buf_reset(&state->out);
+    }
+    if (state->map != NULL) {
+        munmap(state->map, (size_t)state->map_len);
+        state->map = NULL;
+    }
+}
+#endif
+
 #define ZLIB_WINSIZE 32768
 
 struct fast_seek_point {
@@ -247,18 +438,21 @@ struct fast_seek_point {
     gint64 in;          /* offset in input file of first full byte */
 
     compression_t compression;
-    union {
-        struct {
+};
+
+/* Only points in the middle of a deflate stream need the 32K window,
+   so they're allocated as this, and the others as just the header. */
+struct zlib_fast_seek_point {
+    struct fast_seek_point hdr;
+
 #ifdef HAVE_INFLATEPRIME
-            int bits;   /* number of bits (1-7) from byte at in - 1, or 0 */
+    int bits;           /* number of bits (1-7) from byte at in - 1, or 0 */
 #endif
-            unsigned char window[ZLIB_WINSIZE]; /* preceding 32K of uncompressed data */
+    unsigned char window[ZLIB_WINSIZE]; /* preceding 32K of uncompressed data */
 
-            /* be gentle with Z_STREAM_END, 8 bytes more... Another solution would be to comment checks out */
-            guint32 adler;
-            guint32 total_out;
-        } zlib;
-    } data;
+    /* be gentle with Z_STREAM_END, 8 bytes more... Another solution would be to comment checks out */
+    guint32 adler;
+    guint32 total_out;
 };
 
 struct zlib_cur_seek_point {
@@ -330,6 +524,32 @@ fast_seek_reset(
 #endif
 }
 
+/* Is this a fast seek point at the beginning of a zstd or LZ4 frame, or
+   of a BGZF block, from which we can start decompressing without any
+   other state? */
+static gboolean
+fast_seek_at_frame(
+#if defined(HAVE_ZLIB) || defined(HAVE_ZSTD) || defined(HAVE_LZ4FRAME_H)
+    const struct fast_seek_point *point)
+#else
+    const struct fast_seek_point *point _U_)
+#endif
+{
+#ifdef HAVE_ZLIB
+    if (point->compression == BGZF)
+        return TRUE;
+#endif
+#ifdef HAVE_ZSTD
+    if (point->compression == ZSTD)
+        return TRUE;
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    if (point->compression == LZ4)
+        return TRUE;
+#endif
+    return FALSE;
+}
+
 #ifdef HAVE_ZLIB
 
 /* Get next byte from input, or -1 if end or error.
@@ -475,20 +695,20 @@ zlib_fast_seek_add(FILE_T file, struct zlib_cur_seek_point *point, int bits, gin
      *      It's not big deal, cause first-read don't usually invoke seeking
      */
     if (item->out + SPAN < out_pos) {
-        struct fast_seek_point *val = g_new(struct fast_seek_point,1);
-        val->in = in_pos;
-        val->out = out_pos;
-        val->compression = ZLIB;
+        struct zlib_fast_seek_point *val = g_new(struct zlib_fast_seek_point,1);
+        val->hdr.in = in_pos;
+        val->hdr.out = out_pos;
+        val->hdr.compression = ZLIB;
 #ifdef HAVE_INFLATEPRIME
-        val->data.zlib.bits = bits;
+        val->bits = bits;
 #endif
         if (point->pos != 0) {
             unsigned int left = ZLIB_WINSIZE - point->pos;
 
-            memcpy(val->data.zlib.window, point->window + point->pos, left);
-            memcpy(val->data.zlib.window + left, point->window, point->pos);
+            memcpy(val->window, point->window + point->pos, left);
+            memcpy(val->window + left, point->window, point->pos);
         } else
-            memcpy(val->data.zlib.window, point->window, ZLIB_WINSIZE);
+            memcpy(val->window, point->window, ZLIB_WINSIZE);
 
         /*
          * XXX - strm.adler is a uLong in at least some versions
@@ -503,8 +723,8 @@ zlib_fast_seek_add(FILE_T file, struct zlib_cur_seek_point *point, int bits, gin
          *
          * The same applies to strm.total_out.
          */
-        val->data.zlib.adler = (guint32) file->strm.adler;
-        val->data.zlib.total_out = (guint32) file->strm.total_out;
+        val->adler = (guint32) file->strm.adler;
+        val->total_out = (guint32) file->strm.total_out;
         g_ptr_array_add(file->fast_seek, val);
     }
 }
@@ -642,103 +862,869 @@ DIAG_ON(cast-qual)
 }
 #endif
 
-static int
-gz_head(FILE_T state)
+#if defined(HAVE_ZSTD) || defined(HAVE_LZ4FRAME_H)
+/* Note that we've got to the end of a zstd or LZ4 frame.  Everything
+   after it can be decompressed without it, so, unless that's the end
+   of the file, we can seek directly to the next frame. */
+static void
+frame_end(FILE_T state, gint64 out_pos, compression_t compression)
 {
-    guint already_read;
+    state->in_frame = FALSE;
+    if (state->fast_seek && !(state->eof && state->in.avail == 0))
+        fast_seek_header(state, state->raw_pos - state->in.avail, out_pos, compression);
+}
 
-    /* get some data in the input buffer */
-    if (state->in.avail == 0) {
-        if (fill_in_buffer(state) == -1)
+/* The decompressor might be holding on to output that didn't fit into
+   our buffer; if so, don't let our caller think it's got everything
+   just because it's got all of the input. */
+static void
+frame_check_pending(FILE_T state, unsigned int count)
+{
+    if (state->in_frame && state->out.avail == count &&
+        state->eof && state->in.avail == 0)
+        state->eof = FALSE;
+}
+#endif
+
+#if defined(HAVE_ZLIB) || defined(HAVE_ZSTD)
+/* Read len bytes at a given offset in the file. */
+static gboolean
+raw_read_at(FILE_T state, gint64 off, void *buf, unsigned int len)
+{
+    if (ws_lseek64(state->fd, off, SEEK_SET) == -1)
+        return FALSE;
+    return ws_read(state->fd, buf, len) == (ssize_t)len;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+/* Set up to decompress zstd data, starting at the beginning of a frame.
+   Returns -1, and sets state->err, on failure; returns 0 on success. */
+static int
+zstd_start(FILE_T state)
+{
+    if (state->zstd_dstream == NULL) {
+        state->zstd_dstream = ZSTD_createDStream();
+        if (state->zstd_dstream == NULL) {
+            state->err = ENOMEM;
+            state->err_info = NULL;
             return -1;
-        if (state->in.avail == 0)
-            return 0;
+        }
+    }
+    if (ZSTD_isError(ZSTD_initDStream(state->zstd_dstream))) {
+        /* This "shouldn't happen". */
+        state->err = WTAP_ERR_INTERNAL;
+        state->err_info = NULL;
+        return -1;
     }
+    state->in_frame = FALSE;
+    state->compression = ZSTD;
+    return 0;
+}
 
-    /* look for the gzip magic header bytes 31 and 139 */
-    if (state->in.next[0] == 31) {
-        state->in.avail--;
-        state->in.next++;
+static void
+zstd_read(FILE_T state, unsigned char *buf, unsigned int count)
+{
+    ZSTD_inBuffer input;
+    ZSTD_outBuffer output;
+    size_t before;
+    size_t ret;
 
-        /* Make sure the byte after the first byte is present */
-        if (state->in.avail == 0 && fill_in_buffer(state) == -1) {
-            /* Read error. */
-            return -1;
+    output.dst = buf;
+    output.size = count;
+    output.pos = 0;
+
+    /* fill output buffer up to end of input or error */
+    do {
+        /* get more input */
+        if (state->in.avail == 0 && fill_in_buffer(state) == -1)
+            break;
+
+        input.src = state->in.next;
+        input.size = state->in.avail;
+        input.pos = 0;
+        before = output.pos;
+        ret = ZSTD_decompressStream(state->zstd_dstream, &output, &input);
+        state->in.next += input.pos;
+        state->in.avail -= (guint)input.pos;
+        if (ZSTD_isError(ret)) {
+            state->err = WTAP_ERR_DECOMPRESS;
+            state->err_info = ZSTD_getErrorName(ret);
+            break;
         }
-        if (state->in.avail != 0) {
-            if (state->in.next[0] == 139) {
-                /*
-                 * We have what looks like the ID1 and ID2 bytes of a gzip
-                 * header.
-                 * Continue processing the file.
-                 *
-                 * XXX - some capture file formats (I'M LOOKING AT YOU,
-                 * ENDACE!) can have 31 in the first byte of the file
-                 * and 139 in the second byte of the file.  For now, in
-                 * those cases, you lose.
-                 */
-#ifdef HAVE_ZLIB
-                guint8 cm;
-                guint8 flags;
-                guint16 len;
-                guint16 hcrc;
+        if (ret == 0)
+            frame_end(state, state->pos + output.pos, ZSTD);
+        else if (input.pos != 0 || output.pos != before)
+            state->in_frame = TRUE;
+
+        if (state->in.avail == 0 && state->eof && output.pos == before) {
+            /* Nothing more to come; did the file end in mid-frame? */
+            if (state->in_frame) {
+                state->err = WTAP_ERR_SHORT_READ;
+                state->err_info = NULL;
+            }
+            break;
+        }
+    } while (output.pos < output.size);
 
-                state->in.avail--;
-                state->in.next++;
+    state->out.next = buf;
+    state->out.avail = (guint)output.pos;
+    frame_check_pending(state, count);
+}
 
-                /* read rest of header */
+/* Magic numbers and sizes for the zstd seekable format's seek table */
+#define ZSTD_SEEK_TABLE_MAGIC       0x184D2A5EU /* a skippable frame */
+#define ZSTD_SEEKABLE_MAGIC         0x8F92EAB1U
+#define ZSTD_SEEK_TABLE_HEADER_SIZE 8
+#define ZSTD_SEEK_TABLE_FOOTER_SIZE 9
 
-                /* compression method (CM) */
-                if (gz_next1(state, &cm) == -1)
-                    return -1;
-                if (cm != 8) {
-                    state->err = WTAP_ERR_DECOMPRESS;
-                    state->err_info = "unknown compression method";
-                    return -1;
-                }
+/*
+ * If this zstd file has a seek table at the end, add a fast seek point
+ * for the beginning of every frame, so that we don't have to have read
+ * up to a frame to seek to it.  If it hasn't, or the seek table doesn't
+ * look right, including if its frames don't add up to exactly the data
+ * before it, we just find the frames as we read through the file.
+ */
+static void
+zstd_load_seek_table(FILE_T state)
+{
+    ws_statb64 st;
+    guint8 footer[ZSTD_SEEK_TABLE_FOOTER_SIZE];
+    guint32 num_frames, entry_size, i;
+    guint table_size;
+    guint8 *table = NULL;
+    gint64 table_off, in_pos, out_pos;
+    const guint8 *entry;
+    guint32 compressed_size;
+
+    if (ws_fstat64(state->fd, &st) == -1)
+        return;
+    if (st.st_size - state->start < ZSTD_SEEK_TABLE_HEADER_SIZE + ZSTD_SEEK_TABLE_FOOTER_SIZE)
+        return;
+    if (!raw_read_at(state, st.st_size - ZSTD_SEEK_TABLE_FOOTER_SIZE, footer, sizeof footer))
+        goto done;
+    if (pletoh32(&footer[5]) != ZSTD_SEEKABLE_MAGIC || (footer[4] & 0x7C) != 0)
+        goto done;
+    num_frames = pletoh32(&footer[0]);
+    entry_size = (footer[4] & 0x80) ? 12 : 8;   /* with or without checksums */
+    if (num_frames == 0 || num_frames > G_MAXINT / 16)
+        goto done;
+    table_size = num_frames * entry_size;
+    table_off = st.st_size - ZSTD_SEEK_TABLE_FOOTER_SIZE - table_size - ZSTD_SEEK_TABLE_HEADER_SIZE;
+    if (table_off < state->start)
+        goto done;
+    table = (guint8 *)g_try_malloc(ZSTD_SEEK_TABLE_HEADER_SIZE + table_size);
+    if (table == NULL)
+        goto done;
+    if (!raw_read_at(state, table_off, table, ZSTD_SEEK_TABLE_HEADER_SIZE + table_size))
+        goto done;
+    if (pletoh32(&table[0]) != ZSTD_SEEK_TABLE_MAGIC ||
+        pletoh32(&table[4]) != table_size + ZSTD_SEEK_TABLE_FOOTER_SIZE)
+        goto done;
+
+    /* The frames must be everything between the start and the table */
+    in_pos = state->start;
+    entry = table + ZSTD_SEEK_TABLE_HEADER_SIZE;
+    for (i = 0; i < num_frames; i++, entry += entry_size) {
+        compressed_size = pletoh32(&entry[0]);
+        if (compressed_size == 0 || compressed_size > table_off - in_pos)
+            goto done;
+        in_pos += compressed_size;
+    }
+    if (in_pos != table_off)
+        goto done;
+
+    in_pos = state->start;
+    out_pos = 0;
+    entry = table + ZSTD_SEEK_TABLE_HEADER_SIZE;
+    for (i = 0; i < num_frames; i++, entry += entry_size) {
+        fast_seek_header(state, in_pos, out_pos, ZSTD);
+        in_pos += pletoh32(&entry[0]);      /* Compressed_Size */
+        out_pos += pletoh32(&entry[4]);     /* Decompressed_Size */
+    }
 
-                /* flags (FLG) */
-                if (gz_next1(state, &flags) == -1) {
-                    /* Read error. */
-                    return -1;
-                }
-                if (flags & 0xe0) {     /* reserved flag bits */
-                    state->err = WTAP_ERR_DECOMPRESS;
-                    state->err_info = "reserved flag bits set";
-                    return -1;
-                }
+done:
+    g_free(table);
+    /* Put the file back where we were reading it */
+    if (ws_lseek64(state->fd, state->raw_pos, SEEK_SET) == -1) {
+        state->err = errno;
+        state->err_info = NULL;
+    }
+}
+#endif /* HAVE_ZSTD */
 
-                /* modification time (MTIME) */
-                if (gz_skipn(state, 4) == -1) {
-                    /* Read error. */
-                    return -1;
-                }
+#ifdef HAVE_LZ4FRAME_H
+/* Set up to decompress LZ4 data, starting at the beginning of a frame.
+   Returns -1, and sets state->err, on failure; returns 0 on success. */
+static int
+lz4_start(FILE_T state)
+{
+    /* Older versions of liblz4 have no way to reset a context */
+    if (state->lz4_ctx != NULL) {
+        LZ4F_freeDecompressionContext(state->lz4_ctx);
+        state->lz4_ctx = NULL;
+    }
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&state->lz4_ctx, LZ4F_VERSION))) {
+        state->lz4_ctx = NULL;
+        state->err = ENOMEM;
+        state->err_info = NULL;
+        return -1;
+    }
+    state->in_frame = FALSE;
+    state->compression = LZ4;
+    return 0;
+}
 
-                /* extra flags (XFL) */
-                if (gz_skipn(state, 1) == -1) {
-                    /* Read error. */
-                    return -1;
-                }
+static void
+lz4_read(FILE_T state, unsigned char *buf, unsigned int count)
+{
+    unsigned int have = 0;
+    size_t src_size, dst_size;
+    size_t ret;
 
-                /* operating system (OS) */
-                if (gz_skipn(state, 1) == -1) {
-                    /* Read error. */
-                    return -1;
-                }
+    /* fill output buffer up to end of input or error */
+    do {
+        /* get more input */
+        if (state->in.avail == 0 && fill_in_buffer(state) == -1)
+            break;
 
-                if (flags & 4) {
-                    /* extra field - get XLEN */
-                    if (gz_next2(state, &len) == -1) {
-                        /* Read error. */
-                        return -1;
-                    }
+        src_size = state->in.avail;
+        dst_size = count - have;
+        ret = LZ4F_decompress(state->lz4_ctx, buf + have, &dst_size,
+                              state->in.next, &src_size, NULL);
+        state->in.next += src_size;
+        state->in.avail -= (guint)src_size;
+        have += (unsigned int)dst_size;
+        if (LZ4F_isError(ret)) {
+            state->err = WTAP_ERR_DECOMPRESS;
+            state->err_info = LZ4F_getErrorName(ret);
+            break;
+        }
+        if (ret == 0)
+            frame_end(state, state->pos + have, LZ4);
+        else if (src_size != 0 || dst_size != 0)
+            state->in_frame = TRUE;
+
+        if (state->in.avail == 0 && state->eof && dst_size == 0) {
+            /* Nothing more to come; did the file end in mid-frame? */
+            if (state->in_frame) {
+                state->err = WTAP_ERR_SHORT_READ;
+                state->err_info = NULL;
+            }
+            break;
+        }
+    } while (have < count);
 
-                    /* skip the extra field */
-                    if (gz_skipn(state, len) == -1) {
-                        /* Read error. */
-                        return -1;
-                    }
-                }
+    state->out.next = buf;
+    state->out.avail = have;
+    frame_check_pending(state, count);
+}
+#endif /* HAVE_LZ4FRAME_H */
+
+/* Make sure there are at least n bytes in the input buffer, unless the
+   file ends first.  Returns -1 on error, 0 otherwise. */
+static int
+fill_in_buffer_n(FILE_T state, guint n)
+{
+    while (state->in.avail < n && !state->eof) {
+        /* Move what we have to the beginning of the buffer, so that
+           there's room for the rest after it. */
+        if (state->in.next != state->in.buf) {
+            memmove(state->in.buf, state->in.next, state->in.avail);
+            state->in.next = state->in.buf;
+        }
+        if (fill_in_buffer(state) == -1)
+            return -1;
+    }
+    return 0;
+}
+
+#ifdef HAVE_ZLIB
+/*
+ * BGZF files.
+ *
+ * A BGZF file, as described in the SAM/BAM specification at
+ *
+ *      https://samtools.github.io/hts-specs/SAMv1.pdf
+ *
+ * is a gzip file made of members, or "blocks", of at most 64K each,
+ * each with its size in a "BC" subfield of its extra field.  That lets
+ * us find the blocks without decompressing them, so we read several
+ * blocks ahead and decompress them on a pool of threads, one block per
+ * thread, handing out their contents in order; it also means we can
+ * start reading at the beginning of any block.  gzip files we write are
+ * in this format, with the blocks compressed on the same threads.
+ */
+#define BGZF_MAX_BLOCK_SIZE 65536   /* compressed or uncompressed */
+#define BGZF_BLOCK_SIZE     0xff00  /* data we put in a block, so that it fits even if it won't compress */
+#define BGZF_HEADER_SIZE    18      /* gzip header with only a "BC" subfield */
+#define BGZF_TRAILER_SIZE   8       /* CRC-32 and ISIZE */
+#define BGZF_MAX_QUEUED     64      /* most blocks to have queued for the threads */
+
+struct bgzf_block {
+    struct bgzf_queue *queue;   /* queue the block is in */
+    gboolean compress;          /* TRUE to compress data into cdata, FALSE to decompress cdata into data */
+    gboolean check_crc;         /* TRUE to check the CRC when decompressing */
+    gint64 in_end;              /* offset in input file just past the block */
+    unsigned char *cdata;       /* compressed data */
+    guint clen;                 /* compressed length */
+    unsigned char *data;        /* uncompressed data */
+    guint len;                  /* uncompressed length */
+    int err;                    /* error code */
+    const char *err_info;       /* additional error information string */
+    gboolean done;              /* TRUE once it's been (de)compressed */
+};
+
+struct bgzf_queue {
+    GMutex mutex;               /* protects the blocks' done flags */
+    GCond cond;                 /* signalled when a block is done */
+    struct bgzf_block *blocks;  /* ring of blocks */
+    guint size;                 /* number of blocks in the ring */
+    guint head;                 /* oldest block queued */
+    guint count;                /* number of blocks queued */
+    guint used;                 /* bytes of data handed out from, or put into, the current block */
+    guint ahead;                /* number of blocks to read ahead when reading */
+    gboolean ended;             /* TRUE if what follows the queued blocks isn't a BGZF block */
+    int err;                    /* error reading past the queued blocks */
+    const char *err_info;       /* additional error information string */
+};
+
+static GMutex bgzf_pool_mutex;
+static GThreadPool *bgzf_pool;  /* NULL if there's only one processor */
+static gboolean bgzf_pool_tried;
+static guint bgzf_threads = 1;
+
+static void
+bgzf_inflate(struct bgzf_block *block)
+{
+    z_stream strm;
+    int ret;
+
+    memset(&strm, 0, sizeof strm);
+    if (inflateInit2(&strm, -15) != Z_OK) {     /* raw inflate */
+        block->err = ENOMEM;
+        return;
+    }
+    strm.next_in = block->cdata;
+    strm.avail_in = block->clen - BGZF_TRAILER_SIZE;
+    strm.next_out = block->data;
+    strm.avail_out = BGZF_MAX_BLOCK_SIZE;
+    ret = inflate(&strm, Z_FINISH);
+    block->len = BGZF_MAX_BLOCK_SIZE - strm.avail_out;
+    if (ret == Z_MEM_ERROR) {
+        block->err = ENOMEM;
+    } else if (ret != Z_STREAM_END) {
+        block->err = WTAP_ERR_DECOMPRESS;
+        block->err_info = strm.msg != NULL ? strm.msg : "BGZF block doesn't decompress to its size";
+    } else if (block->check_crc &&
+               crc32(0L, block->data, block->len) != pletoh32(block->cdata + block->clen - 8)) {
+        block->err = WTAP_ERR_DECOMPRESS;
+        block->err_info = "bad CRC";
+    } else if (block->len != pletoh32(block->cdata + block->clen - 4)) {
+        block->err = WTAP_ERR_DECOMPRESS;
+        block->err_info = "length field wrong";
+    }
+    inflateEnd(&strm);
+}
+
+static void
+bgzf_deflate(struct bgzf_block *block)
+{
+    static const guint8 header[BGZF_HEADER_SIZE] = {
+        31, 139, 8, 4,          /* magic, deflate, FEXTRA */
+        0, 0, 0, 0,             /* no modification time */
+        0, 255,                 /* no extra flags, unknown OS */
+        6, 0,                   /* XLEN */
+        'B', 'C', 2, 0,         /* the BGZF subfield... */
+        0, 0                    /* ...with the block size, less 1 */
+    };
+    z_stream strm;
+    int level, ret;
+
+    /* If it won't fit compressed, store it. */
+    for (level = Z_DEFAULT_COMPRESSION; ; level = Z_NO_COMPRESSION) {
+        memset(&strm, 0, sizeof strm);
+        if (deflateInit2(&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            block->err = ENOMEM;
+            return;
+        }
+        strm.next_in = block->data;
+        strm.avail_in = block->len;
+        strm.next_out = block->cdata + BGZF_HEADER_SIZE;
+        strm.avail_out = BGZF_MAX_BLOCK_SIZE - BGZF_HEADER_SIZE - BGZF_TRAILER_SIZE;
+        ret = deflate(&strm, Z_FINISH);
+        block->clen = BGZF_HEADER_SIZE + (guint)strm.total_out + BGZF_TRAILER_SIZE;
+        deflateEnd(&strm);
+        if (ret == Z_STREAM_END || level == Z_NO_COMPRESSION)
+            break;
+    }
+    if (ret != Z_STREAM_END) {
+        /* This "shouldn't happen". */
+        block->err = WTAP_ERR_INTERNAL;
+        return;
+    }
+    memcpy(block->cdata, header, BGZF_HEADER_SIZE);
+    phtole16(block->cdata + 16, (guint16)(block->clen - 1));
+    phtole32(block->cdata + block->clen - 8, (guint32)crc32(0L, block->data, block->len));
+    phtole32(block->cdata + block->clen - 4, block->len);
+}
+
+static void
+bgzf_work(gpointer data, gpointer user_data _U_)
+{
+    struct bgzf_block *block = (struct bgzf_block *)data;
+
+    if (block->compress)
+        bgzf_deflate(block);
+    else
+        bgzf_inflate(block);
+
+    g_mutex_lock(&block->queue->mutex);
+    block->done = TRUE;
+    g_cond_broadcast(&block->queue->cond);
+    g_mutex_unlock(&block->queue->mutex);
+}
+
+/* Get the thread pool, if there's any point in having one. */
+static GThreadPool *
+bgzf_get_pool(void)
+{
+    GThreadPool *pool;
+
+    g_mutex_lock(&bgzf_pool_mutex);
+    if (!bgzf_pool_tried) {
+#if GLIB_CHECK_VERSION(2,36,0)
+        bgzf_threads = g_get_num_processors();
+#endif
+        if (bgzf_threads > 1)
+            bgzf_pool = g_thread_pool_new(bgzf_work, NULL, (gint)bgzf_threads, FALSE, NULL);
+        bgzf_pool_tried = TRUE;
+    }
+    pool = bgzf_pool;
+    g_mutex_unlock(&bgzf_pool_mutex);
+    return pool;
+}
+
+void
+file_wrappers_cleanup(void)
+{
+    g_mutex_lock(&bgzf_pool_mutex);
+    if (bgzf_pool != NULL) {
+        g_thread_pool_free(bgzf_pool, FALSE, TRUE);
+        bgzf_pool = NULL;
+    }
+    bgzf_pool_tried = FALSE;
+    g_mutex_unlock(&bgzf_pool_mutex);
+}
+
+/* Start (de)compressing a block, on the thread pool if we have one. */
+static void
+bgzf_submit(struct bgzf_block *block)
+{
+    GThreadPool *pool = bgzf_get_pool();
+
+    block->done = FALSE;
+    block->err = 0;
+    block->err_info = NULL;
+    if (pool != NULL)
+        g_thread_pool_push(pool, block, NULL);
+    else
+        bgzf_work(block, NULL);
+}
+
+static void
+bgzf_wait(struct bgzf_block *block)
+{
+    g_mutex_lock(&block->queue->mutex);
+    while (!block->done)
+        g_cond_wait(&block->queue->cond, &block->queue->mutex);
+    g_mutex_unlock(&block->queue->mutex);
+}
+
+/* Wait for all the queued blocks, and forget about them. */
+static void
+bgzf_drain(struct bgzf_queue *q)
+{
+    for (; q->count != 0; q->count--) {
+        bgzf_wait(&q->blocks[q->head]);
+        q->head = (q->head + 1) % q->size;
+    }
+    q->head = 0;
+    q->used = 0;
+}
+
+static void
+bgzf_queue_free(struct bgzf_queue *q)
+{
+    guint i;
+
+    bgzf_drain(q);
+    for (i = 0; i < q->size; i++) {
+        g_free(q->blocks[i].cdata);
+        g_free(q->blocks[i].data);
+    }
+    g_free(q->blocks);
+    g_cond_clear(&q->cond);
+    g_mutex_clear(&q->mutex);
+    g_free(q);
+}
+
+static struct bgzf_queue *
+bgzf_queue_new(void)
+{
+    struct bgzf_queue *q;
+    guint i;
+
+    q = g_new0(struct bgzf_queue, 1);
+    g_mutex_init(&q->mutex);
+    g_cond_init(&q->cond);
+    /* Enough to keep all the threads busy while we use up the blocks. */
+    q->size = (bgzf_get_pool() != NULL) ? MIN(2 * bgzf_threads, BGZF_MAX_QUEUED) : 1;
+    q->blocks = g_new0(struct bgzf_block, q->size);
+    q->ahead = 1;
+    for (i = 0; i < q->size; i++) {
+        q->blocks[i].queue = q;
+        q->blocks[i].cdata = (unsigned char *)g_try_malloc(BGZF_MAX_BLOCK_SIZE);
+        q->blocks[i].data = (unsigned char *)g_try_malloc(BGZF_MAX_BLOCK_SIZE);
+        if (q->blocks[i].cdata == NULL || q->blocks[i].data == NULL) {
+            q->size = i + 1;
+            bgzf_queue_free(q);
+            return NULL;
+        }
+    }
+    return q;
+}
+
+/* Get the size of a BGZF block from the extra field of its header, or
+   return 0 if there's no "BC" subfield. */
+static guint
+bgzf_block_size(const guint8 *extra, guint xlen)
+{
+    guint off, slen;
+
+    for (off = 0; off + 4 <= xlen; off += 4 + slen) {
+        slen = pletoh16(&extra[off + 2]);
+        if (extra[off] == 'B' && extra[off + 1] == 'C' && slen == 2 &&
+            off + 6 <= xlen)
+            return pletoh16(&extra[off + 4]) + 1;
+    }
+    return 0;
+}
+
+/*
+ * See whether the input buffer starts with the header of a BGZF block,
+ * reading more if necessary.  Returns -1, and sets state->err, on error;
+ * returns 0 if it doesn't; returns 1, and sets *header_len and
+ * *block_size, if it does.
+ */
+static int
+bgzf_peek(FILE_T state, guint *header_len, guint *block_size)
+{
+    guint xlen;
+
+    /* Look for a gzip header with only the FEXTRA flag set. */
+    if (fill_in_buffer_n(state, 12) == -1)
+        return -1;
+    if (state->in.avail < 12 || state->in.next[0] != 31 || state->in.next[1] != 139 ||
+        state->in.next[2] != 8 || state->in.next[3] != 4)
+        return 0;
+    xlen = pletoh16(&state->in.next[10]);
+    *header_len = 12 + xlen;
+    if (*header_len > state->size)
+        return 0;
+    if (fill_in_buffer_n(state, *header_len) == -1)
+        return -1;
+    if (state->in.avail < *header_len)
+        return 0;
+    *block_size = bgzf_block_size(&state->in.next[12], xlen);
+    if (*block_size < *header_len + BGZF_TRAILER_SIZE)
+        return 0;
+    return 1;
+}
+
+/*
+ * Read the next block, if it's a BGZF block, and queue it to be
+ * decompressed.  Returns -1, and sets state->err, on error; returns 0,
+ * having read nothing, if there's no BGZF block next; returns 1 if it
+ * queued one.
+ */
+static int
+bgzf_queue_block(FILE_T state)
+{
+    struct bgzf_queue *q = state->bgzf;
+    struct bgzf_block *block = &q->blocks[(q->head + q->count) % q->size];
+    guint header_len, block_size, n;
+    ssize_t got;
+    int ret;
+
+    ret = bgzf_peek(state, &header_len, &block_size);
+    if (ret != 1)
+        return ret;
+    state->in.next += header_len;
+    state->in.avail -= header_len;
+
+    /* Take what we've already read, and read the rest straight into the block. */
+    block->clen = block_size - header_len;
+    n = MIN(state->in.avail, block->clen);
+    memcpy(block->cdata, state->in.next, n);
+    state->in.next += n;
+    state->in.avail -= n;
+    while (n < block->clen) {
+        got = ws_read(state->fd, block->cdata + n, block->clen - n);
+        if (got < 0) {
+            state->err = errno;
+            state->err_info = NULL;
+            return -1;
+        }
+        if (got == 0) {
+            state->err = WTAP_ERR_SHORT_READ;
+            state->err_info = NULL;
+            return -1;
+        }
+        state->raw_pos += got;
+        n += (guint)got;
+    }
+    block->in_end = state->raw_pos - state->in.avail;
+    block->compress = FALSE;
+    block->check_crc = !state->dont_check_crc;
+    q->count++;
+    bgzf_submit(block);
+    return 1;
+}
+
+/*
+ * If this is a BGZF block, start reading BGZF blocks.  Returns -1, and
+ * sets state->err, on error; returns 0 if it isn't a BGZF block, and 1
+ * if it is.
+ */
+static int
+bgzf_start(FILE_T state)
+{
+    gint64 in_pos;
+    guint header_len, block_size;
+    int ret;
+
+    ret = bgzf_peek(state, &header_len, &block_size);
+    if (ret != 1)
+        return ret;
+    in_pos = state->raw_pos - state->in.avail;
+    if (state->bgzf == NULL) {
+        state->bgzf = bgzf_queue_new();
+        if (state->bgzf == NULL) {
+            state->err = ENOMEM;
+            state->err_info = NULL;
+            return -1;
+        }
+    }
+    state->bgzf->ended = FALSE;
+    ret = bgzf_queue_block(state);
+    if (ret != 1)
+        return ret;
+
+    state->compression = BGZF;
+    state->is_compressed = TRUE;
+    state->compression_type = WTAP_GZIP_COMPRESSED;
+    if (state->fast_seek)
+        fast_seek_header(state, in_pos, state->pos, BGZF);
+    return 1;
+}
+
+/* Forget about any blocks we've read ahead, before seeking. */
+static void
+bgzf_reset(FILE_T state)
+{
+    if (state->bgzf != NULL) {
+        bgzf_drain(state->bgzf);
+        state->bgzf->ahead = 1;
+        state->bgzf->ended = FALSE;
+        state->bgzf->err = 0;
+        state->bgzf->err_info = NULL;
+    }
+}
+
+static void
+bgzf_read(FILE_T state, unsigned char *buf, unsigned int count)
+{
+    struct bgzf_queue *q = state->bgzf;
+    struct bgzf_block *block;
+    struct fast_seek_point *item;
+    guint n;
+    int ret;
+
+    /* Keep the threads busy.  If we can't read the next block, we
+       report that once we've handed out the blocks before it. */
+    while (!q->ended && q->count < q->ahead) {
+        ret = bgzf_queue_block(state);
+        if (ret != 1) {
+            if (ret == -1) {
+                q->err = state->err;
+                q->err_info = state->err_info;
+                state->err = 0;
+                state->err_info = NULL;
+            }
+            q->ended = TRUE;
+        }
+    }
+
+    if (q->count == 0) {
+        if (q->err != 0) {
+            state->err = q->err;
+            state->err_info = q->err_info;
+            q->err = 0;
+        } else {
+            /* look at whatever comes next, as we would after any gzip member */
+            state->compression = UNKNOWN;
+        }
+        return;
+    }
+
+    block = &q->blocks[q->head];
+    bgzf_wait(block);
+    if (block->err != 0) {
+        state->err = block->err;
+        state->err_info = block->err_info;
+        return;
+    }
+    n = MIN(block->len - q->used, count);
+    memcpy(buf, block->data + q->used, n);
+    q->used += n;
+    state->out.next = buf;
+    state->out.avail = n;
+
+    if (q->used == block->len) {
+        /* On to the next block; read further ahead, now that it looks
+           as if we're reading sequentially. */
+        q->head = (q->head + 1) % q->size;
+        q->count--;
+        q->used = 0;
+        if (q->ahead < q->size)
+            q->ahead = MIN(2 * q->ahead, q->size);
+
+        /* We can start reading at the next block, so, every so often,
+           make that a fast seek point. */
+        if (state->fast_seek && state->fast_seek->len != 0) {
+            item = (struct fast_seek_point *)state->fast_seek->pdata[state->fast_seek->len - 1];
+            if (item->out + SPAN < state->pos + n)
+                fast_seek_header(state, block->in_end, state->pos + n, BGZF);
+        }
+    }
+
+    /* Don't let our caller think it's got everything just because
+       we've read all of the input. */
+    if (q->count != 0 && state->eof && state->in.avail == 0)
+        state->eof = FALSE;
+}
+#endif /* HAVE_ZLIB */
+
+static int
+gz_head(FILE_T state)
+{
+    guint already_read;
+
+    /* get some data in the input buffer */
+    if (state->in.avail == 0) {
+        if (fill_in_buffer(state) == -1)
+            return -1;
+        if (state->in.avail == 0)
+            return 0;
+    }
+
+#ifdef HAVE_ZLIB
+    /* look for a BGZF block, which we can decompress along with the ones after it */
+    if (state->in.next[0] == 31) {
+        int ret = bgzf_start(state);
+
+        if (ret == -1)
+            return -1;
+        if (ret == 1)
+            return 0;
+    }
+#endif
+
+    /* look for the gzip magic header bytes 31 and 139 */
+    if (state->in.next[0] == 31) {
+        state->in.avail--;
+        state->in.next++;
+
+        /* Make sure the byte after the first byte is present */
+        if (state->in.avail == 0 && fill_in_buffer(state) == -1) {
+            /* Read error. */
+            return -1;
+        }
+        if (state->in.avail != 0) {
+            if (state->in.next[0] == 139) {
+                /*
+                 * We have what looks like the ID1 and ID2 bytes of a gzip
+                 * header.
+                 * Continue processing the file.
+                 *
+                 * XXX - some capture file formats (I'M LOOKING AT YOU,
+                 * ENDACE!) can have 31 in the first byte of the file
+                 * and 139 in the second byte of the file.  For now, in
+                 * those cases, you lose.
+                 */
+#ifdef HAVE_ZLIB
+                guint8 cm;
+                guint8 flags;
+                guint16 len;
+                guint16 hcrc;
+
+                state->in.avail--;
+                state->in.next++;
+
+                /* read rest of header */
+
+                /* compression method (CM) */
+                if (gz_next1(state, &cm) == -1)
+                    return -1;
+                if (cm != 8) {
+                    state->err = WTAP_ERR_DECOMPRESS;
+                    state->err_info = "unknown compression method";
+                    return -1;
+                }
+
+                /* flags (FLG) */
+                if (gz_next1(state, &flags) == -1) {
+                    /* Read error. */
+                    return -1;
+                }
+                if (flags & 0xe0) {     /* reserved flag bits */
+                    state->err = WTAP_ERR_DECOMPRESS;
+                    state->err_info = "reserved flag bits set";
+                    return -1;
+                }
+
+                /* modification time (MTIME) */
+                if (gz_skipn(state, 4) == -1) {
+                    /* Read error. */
+                    return -1;
+                }
+
+                /* extra flags (XFL) */
+                if (gz_skipn(state, 1) == -1) {
+                    /* Read error. */
+                    return -1;
+                }
+
+                /* operating system (OS) */
+                if (gz_skipn(state, 1) == -1) {
+                    /* Read error. */
+                    return -1;
+                }
+
+                if (flags & 4) {
+                    /* extra field - get XLEN */
+                    if (gz_next2(state, &len) == -1) {
+                        /* Read error. */
+                        return -1;
+                    }
+
+                    /* skip the extra field */
+                    if (gz_skipn(state, len) == -1) {
+                        /* Read error. */
+                        return -1;
+                    }
+                }
                 if (flags & 8) {
                     /* file name */
                     if (gz_skipzstr(state) == -1) {
@@ -767,6 +1753,7 @@ gz_head(FILE_T state)
                 state->strm.adler = crc32(0L, Z_NULL, 0);
                 state->compression = ZLIB;
                 state->is_compressed = TRUE;
+                state->compression_type = WTAP_GZIP_COMPRESSED;
 #ifdef Z_BLOCK
                 if (state->fast_seek) {
                     struct zlib_cur_seek_point *cur = g_new(struct zlib_cur_seek_point,1);
@@ -804,6 +1791,50 @@ gz_head(FILE_T state)
             state->in.next--;
         }
     }
+
+    /* look for the magic number at the beginning of a zstd or LZ4 frame */
+    if (fill_in_buffer_n(state, 4) == -1)
+        return -1;
+    if (state->in.avail >= 4) {
+        guint32 magic = pletoh32(state->in.next);
+
+        if (magic == ZSTD_FRAME_MAGIC) {
+#ifdef HAVE_ZSTD
+            if (zstd_start(state) == -1)
+                return -1;
+            state->is_compressed = TRUE;
+            state->compression_type = WTAP_ZSTD_COMPRESSED;
+            if (state->fast_seek) {
+                if (state->pos == 0 && state->fast_seek->len == 0) {
+                    zstd_load_seek_table(state);
+                    if (state->err != 0)
+                        return -1;
+                }
+                fast_seek_header(state, state->raw_pos - state->in.avail, state->pos, ZSTD);
+            }
+            return 0;
+#else
+            state->err = WTAP_ERR_DECOMPRESSION_NOT_SUPPORTED;
+            state->err_info = "reading zstd-compressed files isn't supported";
+            return -1;
+#endif
+        }
+        if (magic == LZ4_FRAME_MAGIC) {
+#ifdef HAVE_LZ4FRAME_H
+            if (lz4_start(state) == -1)
+                return -1;
+            state->is_compressed = TRUE;
+            state->compression_type = WTAP_LZ4_COMPRESSED;
+            if (state->fast_seek)
+                fast_seek_header(state, state->raw_pos - state->in.avail, state->pos, LZ4);
+            return 0;
+#else
+            state->err = WTAP_ERR_DECOMPRESSION_NOT_SUPPORTED;
+            state->err_info = "reading LZ4-compressed files isn't supported";
+            return -1;
+#endif
+        }
+    }
 #ifdef HAVE_LIBXZ
     /* { 0xFD, '7', 'z', 'X', 'Z', 0x00 } */
     /* FD 37 7A 58 5A 00 */
@@ -841,6 +1872,14 @@ fill_out_buffer(FILE_T state)
             return 0;
     }
     if (state->compression == UNCOMPRESSED) {           /* straight copy */
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+        switch (fill_from_map(state)) {
+            case 1:
+                return 0;
+            case -1:
+                return -1;
+        }
+#endif
         if (buf_read(state, &state->out) < 0)
             return -1;
     }
@@ -848,6 +1887,19 @@ fill_out_buffer(FILE_T state)
     else if (state->compression == ZLIB) {      /* decompress */
         zlib_read(state, state->out.buf, state->size << 1);
     }
+    else if (state->compression == BGZF) {
+        bgzf_read(state, state->out.buf, state->size << 1);
+    }
+#endif
+#ifdef HAVE_ZSTD
+    else if (state->compression == ZSTD) {
+        zstd_read(state, state->out.buf, state->size << 1);
+    }
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    else if (state->compression == LZ4) {
+        lz4_read(state, state->out.buf, state->size << 1);
+    }
 #endif
     return 0;
 }
@@ -945,6 +1997,7 @@ file_fdopen(int fd)
 
     /* we don't yet know whether it's compressed */
     state->is_compressed = FALSE;
+    state->compression_type = WTAP_UNCOMPRESSED;
 
     /* save the current position for rewinding (only if reading) */
     state->start = ws_lseek64(state->fd, 0, SEEK_CUR);
@@ -1065,6 +2118,450 @@ file_set_random_access(FILE_T stream, gboolean random_flag _U_, GPtrArray *seek)
     stream->fast_seek = seek;
 }
 
+void
+file_set_mmap(
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+    FILE_T stream)
+#else
+    FILE_T stream _U_)
+#endif
+{
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+    stream->map_allowed = TRUE;
+#endif
+}
+
+#ifdef HAVE_ZLIB
+/*
+ * Saved fast seek points.
+ *
+ * Finding the fast seek points for a gzip file means inflating all of
+ * it, so once it has been read through they can be saved in an index
+ * file and loaded the next time the same file is opened; as an index is
+ * only saved for a file that has been read through, one that's loaded
+ * covers all of the file.  The index file is named after a SHA-256
+ * digest of the capture file's size, its modification time, and its
+ * first and last 64K, and it starts with that digest, so that we don't
+ * use an index for a file that's changed since the index was made.
+ *
+ * Index files are kept in a cache directory, whose total size is kept
+ * under SEEK_INDEX_CACHE_SIZE by removing the least recently used ones.
+ *
+ * All integers are little-endian.  The index starts with
+ *
+ *      "WSSI" and a 4-byte version number;
+ *      the 32-byte digest;
+ *      a 4-byte count of points;
+ *
+ * and each point is
+ *
+ *      8-byte uncompressed and compressed offsets;
+ *      a 1-byte kind of point;
+ *
+ * followed, for a point in the middle of a deflate stream, by
+ *
+ *      a 1-byte count of bits, and 4-byte Adler-32 and total_out;
+ *      the 4-byte length of the window, compressed with compress2(),
+ *      and the compressed window.
+ */
+#define SEEK_INDEX_MAGIC        "WSSI"
+#define SEEK_INDEX_VERSION      2
+#define SEEK_INDEX_DIGEST_LEN   32
+#define SEEK_INDEX_HEADER_SIZE  (4 + 4 + SEEK_INDEX_DIGEST_LEN + 4)
+#define SEEK_INDEX_POINT_SIZE   (8 + 8 + 1)
+#define SEEK_INDEX_ZLIB_SIZE    (1 + 4 + 4 + 4)
+#define SEEK_INDEX_SAMPLE_SIZE  65536
+#define SEEK_INDEX_SUFFIX       ".seekidx"
+#define SEEK_INDEX_CACHE_SIZE   G_GINT64_CONSTANT(256 * 1024 * 1024)
+
+/* Kinds of point */
+#define SEEK_INDEX_UNCOMPRESSED 0
+#define SEEK_INDEX_GZIP_HEADER  1
+#define SEEK_INDEX_ZLIB         2
+#define SEEK_INDEX_BGZF         3
+
+/* Compute the digest identifying the file; returns FALSE on error. */
+static gboolean
+seek_index_digest(FILE_T state, guint8 *digest)
+{
+    ws_statb64 st;
+    GChecksum *checksum;
+    guint8 stamp[16];
+    guint8 *sample;
+    unsigned int sample_len;
+    gsize digest_len = SEEK_INDEX_DIGEST_LEN;
+    gboolean ok;
+
+    if (ws_fstat64(state->fd, &st) == -1)
+        return FALSE;
+    sample_len = st.st_size < SEEK_INDEX_SAMPLE_SIZE ? (unsigned int)st.st_size : SEEK_INDEX_SAMPLE_SIZE;
+
+    checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    phtole64(&stamp[0], (guint64)st.st_size);
+    phtole64(&stamp[8], (guint64)st.st_mtime);
+    g_checksum_update(checksum, stamp, sizeof stamp);
+
+    sample = (guint8 *)g_malloc(SEEK_INDEX_SAMPLE_SIZE);
+    ok = raw_read_at(state, 0, sample, sample_len);
+    if (ok) {
+        g_checksum_update(checksum, sample, sample_len);
+        ok = raw_read_at(state, st.st_size - sample_len, sample, sample_len);
+    }
+    if (ok) {
+        g_checksum_update(checksum, sample, sample_len);
+        g_checksum_get_digest(checksum, digest, &digest_len);
+    }
+    g_free(sample);
+    g_checksum_free(checksum);
+
+    /* put the file back where we found it */
+    if (ws_lseek64(state->fd, state->raw_pos, SEEK_SET) == -1)
+        return FALSE;
+    return ok;
+}
+
+static gchar *
+seek_index_name(const guint8 *digest)
+{
+    GString *name = g_string_sized_new(SEEK_INDEX_DIGEST_LEN * 2 + 8);
+    int i;
+
+    for (i = 0; i < SEEK_INDEX_DIGEST_LEN; i++)
+        g_string_append_printf(name, "%02x", digest[i]);
+    g_string_append(name, SEEK_INDEX_SUFFIX);
+    return g_string_free(name, FALSE);
+}
+
+/*
+ * Return the pathname of the index file for this file in dir, or NULL
+ * if we can't identify the file.
+ */
+gchar *
+file_seek_index_path(FILE_T stream, const char *dir)
+{
+    guint8 digest[SEEK_INDEX_DIGEST_LEN];
+    gchar *name, *path;
+
+    if (!seek_index_digest(stream, digest))
+        return NULL;
+    name = seek_index_name(digest);
+    path = g_build_filename(dir, name, NULL);
+    g_free(name);
+    return path;
+}
+
+/* Read one point from an index file; returns NULL at a bad point. */
+static struct fast_seek_point *
+seek_index_read_point(FILE *fp, unsigned char *zbuf)
+{
+    guint8 rec[SEEK_INDEX_POINT_SIZE];
+    guint8 zrec[SEEK_INDEX_ZLIB_SIZE];
+    struct fast_seek_point *item;
+    struct zlib_fast_seek_point *zitem;
+    guint32 zlen;
+    uLongf window_len = ZLIB_WINSIZE;
+
+    if (fread(rec, 1, sizeof rec, fp) != sizeof rec)
+        return NULL;
+
+    switch (rec[16]) {
+
+    case SEEK_INDEX_UNCOMPRESSED:
+        item = g_new(struct fast_seek_point, 1);
+        item->compression = UNCOMPRESSED;
+        break;
+
+    case SEEK_INDEX_GZIP_HEADER:
+        item = g_new(struct fast_seek_point, 1);
+        item->compression = GZIP_AFTER_HEADER;
+        break;
+
+    case SEEK_INDEX_BGZF:
+        item = g_new(struct fast_seek_point, 1);
+        item->compression = BGZF;
+        break;
+
+    case SEEK_INDEX_ZLIB:
+        if (fread(zrec, 1, sizeof zrec, fp) != sizeof zrec)
+            return NULL;
+#ifdef HAVE_INFLATEPRIME
+        if (zrec[0] > 7)
+#else
+        if (zrec[0] != 0)
+#endif
+            return NULL;
+        zlen = pletoh32(&zrec[9]);
+        if (zlen > compressBound(ZLIB_WINSIZE) || fread(zbuf, 1, zlen, fp) != zlen)
+            return NULL;
+        zitem = g_new(struct zlib_fast_seek_point, 1);
+        if (uncompress(zitem->window, &window_len, zbuf, zlen) != Z_OK ||
+            window_len != ZLIB_WINSIZE) {
+            g_free(zitem);
+            return NULL;
+        }
+#ifdef HAVE_INFLATEPRIME
+        zitem->bits = zrec[0];
+#endif
+        zitem->adler = pletoh32(&zrec[1]);
+        zitem->total_out = pletoh32(&zrec[5]);
+        item = &zitem->hdr;
+        item->compression = ZLIB;
+        break;
+
+    default:
+        return NULL;
+    }
+    item->out = (gint64)pletoh64(&rec[0]);
+    item->in = (gint64)pletoh64(&rec[8]);
+    return item;
+}
+
+/*
+ * Load the fast seek points saved in the index file at path, if it's
+ * an index for this file, adding the ones past those we already have.
+ * If the index is bad, we just don't use any of it.  Returns TRUE if
+ * the index was loaded.
+ */
+gboolean
+file_load_seek_index(FILE_T stream, const char *path)
+{
+    guint8 digest[SEEK_INDEX_DIGEST_LEN];
+    guint8 hdr[SEEK_INDEX_HEADER_SIZE];
+    GPtrArray *points;
+    struct fast_seek_point *item, *last;
+    unsigned char *zbuf;
+    guint32 count, i;
+    gint64 prev_out = -1;
+    gboolean loaded;
+    FILE *fp;
+
+    if (stream->fast_seek == NULL || !seek_index_digest(stream, digest))
+        return FALSE;
+    fp = ws_fopen(path, "rb");
+    if (fp == NULL)
+        return FALSE;
+    if (fread(hdr, 1, sizeof hdr, fp) != sizeof hdr ||
+        memcmp(&hdr[0], SEEK_INDEX_MAGIC, 4) != 0 ||
+        pletoh32(&hdr[4]) != SEEK_INDEX_VERSION ||
+        memcmp(&hdr[8], digest, SEEK_INDEX_DIGEST_LEN) != 0) {
+        fclose(fp);
+        return FALSE;
+    }
+    count = pletoh32(&hdr[8 + SEEK_INDEX_DIGEST_LEN]);
+
+    points = g_ptr_array_new();
+    zbuf = (unsigned char *)g_malloc(compressBound(ZLIB_WINSIZE));
+    for (i = 0; i < count; i++) {
+        item = seek_index_read_point(fp, zbuf);
+        if (item == NULL || item->out <= prev_out || item->in < stream->start) {
+            g_free(item);
+            break;
+        }
+        prev_out = item->out;
+        g_ptr_array_add(points, item);
+    }
+    g_free(zbuf);
+    fclose(fp);
+
+    last = NULL;
+    if (stream->fast_seek->len != 0)
+        last = (struct fast_seek_point *)stream->fast_seek->pdata[stream->fast_seek->len - 1];
+    /* If the index is bad, forget all of it */
+    loaded = points->len == count;
+    for (i = 0; i < points->len; i++) {
+        item = (struct fast_seek_point *)points->pdata[i];
+        if (loaded && (last == NULL || item->out > last->out))
+            g_ptr_array_add(stream->fast_seek, item);
+        else
+            g_free(item);
+    }
+    g_ptr_array_free(points, TRUE);
+
+    /* Mark it as recently used, so it's among the last to be removed */
+    if (loaded)
+        g_utime(path, NULL);
+    return loaded;
+}
+
+typedef struct {
+    gchar *path;
+    time_t mtime;
+    gint64 size;
+} seek_index_file_t;
+
+static gint
+seek_index_file_cmp(gconstpointer a, gconstpointer b)
+{
+    const seek_index_file_t *file_a = (const seek_index_file_t *)a;
+    const seek_index_file_t *file_b = (const seek_index_file_t *)b;
+
+    if (file_a->mtime < file_b->mtime)
+        return -1;
+    return file_a->mtime > file_b->mtime ? 1 : 0;
+}
+
+/*
+ * Remove the least recently used index files in dir until the total
+ * size of those left is at most SEEK_INDEX_CACHE_SIZE.
+ */
+static void
+seek_index_prune(const char *dir)
+{
+    GDir *gdir;
+    const gchar *name;
+    GArray *files;
+    seek_index_file_t file;
+    ws_statb64 st;
+    gint64 total = 0;
+    guint i;
+
+    gdir = g_dir_open(dir, 0, NULL);
+    if (gdir == NULL)
+        return;
+    files = g_array_new(FALSE, FALSE, sizeof(seek_index_file_t));
+    while ((name = g_dir_read_name(gdir)) != NULL) {
+        if (!g_str_has_suffix(name, SEEK_INDEX_SUFFIX))
+            continue;
+        file.path = g_build_filename(dir, name, NULL);
+        if (ws_stat64(file.path, &st) != 0) {
+            g_free(file.path);
+            continue;
+        }
+        file.mtime = st.st_mtime;
+        file.size = st.st_size;
+        total += file.size;
+        g_array_append_val(files, file);
+    }
+    g_dir_close(gdir);
+
+    g_array_sort(files, seek_index_file_cmp);
+    for (i = 0; i < files->len; i++) {
+        seek_index_file_t *oldest = &g_array_index(files, seek_index_file_t, i);
+
+        if (total > SEEK_INDEX_CACHE_SIZE && ws_unlink(oldest->path) == 0)
+            total -= oldest->size;
+        g_free(oldest->path);
+    }
+    g_array_free(files, TRUE);
+}
+
+/*
+ * Save this file's fast seek points in an index file at path, unless
+ * the file has changed since path was chosen for it, and then remove
+ * old index files from its directory if it's grown too big.  This
+ * should only be called once the file has been read through, so that
+ * there are points for all of it.  The index is only an optimization,
+ * so errors are ignored.
+ */
+void
+file_save_seek_index(FILE_T stream, const char *path)
+{
+    guint8 digest[SEEK_INDEX_DIGEST_LEN];
+    guint8 hdr[SEEK_INDEX_HEADER_SIZE];
+    guint8 rec[SEEK_INDEX_POINT_SIZE];
+    guint8 zrec[SEEK_INDEX_ZLIB_SIZE];
+    struct fast_seek_point *item;
+    gchar *name, *basename, *dir, *tmp_path;
+    unsigned char *zbuf;
+    uLongf zlen;
+    guint32 count, i;
+    gboolean ok;
+    int fd;
+    FILE *fp;
+
+    if (stream->fast_seek == NULL || !seek_index_digest(stream, digest))
+        return;
+    name = seek_index_name(digest);
+    basename = g_path_get_basename(path);
+    ok = strcmp(name, basename) == 0;
+    g_free(basename);
+    g_free(name);
+    if (!ok)
+        return;
+
+    dir = g_path_get_dirname(path);
+    if (g_mkdir_with_parents(dir, 0755) != 0) {
+        g_free(dir);
+        return;
+    }
+
+    /* Write to a temporary file, so nobody sees a partial index, with
+       a name of its own in case somebody else is writing it as well. */
+    tmp_path = g_strdup_printf("%s.XXXXXX", path);
+    fd = g_mkstemp(tmp_path);
+    if (fd == -1) {
+        g_free(tmp_path);
+        g_free(dir);
+        return;
+    }
+    fp = ws_fdopen(fd, "wb");
+    if (fp == NULL) {
+        ws_close(fd);
+        ws_unlink(tmp_path);
+        g_free(tmp_path);
+        g_free(dir);
+        return;
+    }
+
+    count = 0;
+    for (i = 0; i < stream->fast_seek->len; i++) {
+        item = (struct fast_seek_point *)stream->fast_seek->pdata[i];
+        if (item->compression == UNCOMPRESSED || item->compression == GZIP_AFTER_HEADER ||
+            item->compression == ZLIB || item->compression == BGZF)
+            count++;
+    }
+    memcpy(&hdr[0], SEEK_INDEX_MAGIC, 4);
+    phtole32(&hdr[4], SEEK_INDEX_VERSION);
+    memcpy(&hdr[8], digest, SEEK_INDEX_DIGEST_LEN);
+    phtole32(&hdr[8 + SEEK_INDEX_DIGEST_LEN], count);
+    ok = fwrite(hdr, 1, sizeof hdr, fp) == sizeof hdr;
+
+    zbuf = (unsigned char *)g_malloc(compressBound(ZLIB_WINSIZE));
+    for (i = 0; ok && i < stream->fast_seek->len; i++) {
+        item = (struct fast_seek_point *)stream->fast_seek->pdata[i];
+        phtole64(&rec[0], (guint64)item->out);
+        phtole64(&rec[8], (guint64)item->in);
+        if (item->compression == UNCOMPRESSED)
+            rec[16] = SEEK_INDEX_UNCOMPRESSED;
+        else if (item->compression == GZIP_AFTER_HEADER)
+            rec[16] = SEEK_INDEX_GZIP_HEADER;
+        else if (item->compression == ZLIB)
+            rec[16] = SEEK_INDEX_ZLIB;
+        else if (item->compression == BGZF)
+            rec[16] = SEEK_INDEX_BGZF;
+        else
+            continue;
+        ok = fwrite(rec, 1, sizeof rec, fp) == sizeof rec;
+        if (ok && item->compression == ZLIB) {
+            const struct zlib_fast_seek_point *zitem = (const struct zlib_fast_seek_point *)item;
+
+            zlen = compressBound(ZLIB_WINSIZE);
+            ok = compress2(zbuf, &zlen, zitem->window, ZLIB_WINSIZE, Z_BEST_SPEED) == Z_OK;
+#ifdef HAVE_INFLATEPRIME
+            zrec[0] = (guint8)zitem->bits;
+#else
+            zrec[0] = 0;
+#endif
+            phtole32(&zrec[1], zitem->adler);
+            phtole32(&zrec[5], zitem->total_out);
+            phtole32(&zrec[9], (guint32)zlen);
+            ok = ok && fwrite(zrec, 1, sizeof zrec, fp) == sizeof zrec &&
+                 fwrite(zbuf, 1, zlen, fp) == zlen;
+        }
+    }
+    g_free(zbuf);
+
+    if (fclose(fp) != 0)
+        ok = FALSE;
+    if (!ok || ws_rename(tmp_path, path) != 0)
+        ws_unlink(tmp_path);
+    g_free(tmp_path);
+
+    seek_index_prune(dir);
+    g_free(dir);
+}
+#endif /* HAVE_ZLIB */
+
 gint64
 file_seek(FILE_T file, gint64 offset, int whence, int *err)
 {
@@ -1169,6 +2666,27 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
         }
     }
 
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+    /*
+     * We're not seeking within the buffer.  If we're seeking to
+     * somewhere in the mapping, just look at it through a different
+     * window; otherwise, if we're in the mapping, leave it, as the
+     * code below expects the output buffer to be ours.
+     */
+    if (file->map != NULL) {
+        gint64 target = file->pos + offset;
+
+        if (target >= 0 && target < file->map_len - file->start) {
+            enter_map(file, target);
+            return file->pos;
+        }
+        if (file->in_map && leave_map(file) == -1) {
+            *err = file->err;
+            return -1;
+        }
+    }
+#endif
+
     /*
      * We're not seeking within the buffer.  Do we have "fast seek" data
      * for the location to which we will be seeking, and is the offset
@@ -1178,7 +2696,8 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
      * XXX, profile
      */
     if ((here = fast_seek_find(file, file->pos + offset)) &&
-        (offset < 0 || offset > SPAN || here->compression == UNCOMPRESSED)) {
+        (offset < 0 || offset > SPAN || here->compression == UNCOMPRESSED ||
+         (fast_seek_at_frame(here) && here->out > file->pos))) {
         gint64 off, off2;
 
         /*
@@ -1190,7 +2709,7 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
 #ifdef HAVE_ZLIB
         if (here->compression == ZLIB) {
 #ifdef HAVE_INFLATEPRIME
-            off = here->in - (here->data.zlib.bits ? 1 : 0);
+            off = here->in - (((struct zlib_fast_seek_point *)here)->bits ? 1 : 0);
 #else
             off = here->in;
 #endif
@@ -1200,7 +2719,10 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             off2 = here->out;
         } else
 #endif
-        {
+        if (fast_seek_at_frame(here)) {
+            off = here->in;
+            off2 = here->out;
+        } else {
             off2 = (file->pos + offset);
             off = here->in + (off2 - here->out);
         }
@@ -1210,6 +2732,9 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             return -1;
         }
         fast_seek_reset(file);
+#ifdef HAVE_ZLIB
+        bgzf_reset(file);
+#endif
 
         file->raw_pos = off;
         buf_reset(&file->out);
@@ -1221,13 +2746,14 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
 
 #ifdef HAVE_ZLIB
         if (here->compression == ZLIB) {
+            const struct zlib_fast_seek_point *zhere = (const struct zlib_fast_seek_point *)here;
             z_stream *strm = &file->strm;
 
             inflateReset(strm);
-            strm->adler = here->data.zlib.adler;
-            strm->total_out = here->data.zlib.total_out;
+            strm->adler = zhere->adler;
+            strm->total_out = zhere->total_out;
 #ifdef HAVE_INFLATEPRIME
-            if (here->data.zlib.bits) {
+            if (zhere->bits) {
                 FILE_T state = file;
                 int ret = GZ_GETC();
 
@@ -1239,10 +2765,10 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
                         *err = state->err;
                     return -1;
                 }
-                (void)inflatePrime(strm, here->data.zlib.bits, ret >> (8 - here->data.zlib.bits));
+                (void)inflatePrime(strm, zhere->bits, ret >> (8 - zhere->bits));
             }
 #endif
-            (void)inflateSetDictionary(strm, here->data.zlib.window, ZLIB_WINSIZE);
+            (void)inflateSetDictionary(strm, zhere->window, ZLIB_WINSIZE);
             file->compression = ZLIB;
         } else if (here->compression == GZIP_AFTER_HEADER) {
             z_stream *strm = &file->strm;
@@ -1250,6 +2776,25 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             inflateReset(strm);
             strm->adler = crc32(0L, Z_NULL, 0);
             file->compression = ZLIB;
+        } else if (here->compression == BGZF) {
+            /* look at the block's header again */
+            file->compression = UNKNOWN;
+        } else
+#endif
+#ifdef HAVE_ZSTD
+        if (here->compression == ZSTD) {
+            if (zstd_start(file) == -1) {
+                *err = file->err;
+                return -1;
+            }
+        } else
+#endif
+#ifdef HAVE_LZ4FRAME_H
+        if (here->compression == LZ4) {
+            if (lz4_start(file) == -1) {
+                *err = file->err;
+                return -1;
+            }
         } else
 #endif
             file->compression = here->compression;
@@ -1324,6 +2869,9 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             return -1;
         }
         fast_seek_reset(file);
+#ifdef HAVE_ZLIB
+        bgzf_reset(file);
+#endif
         file->raw_pos = file->start;
         gz_reset(file);
     }
@@ -1361,6 +2909,11 @@ file_tell(FILE_T stream)
 gint64
 file_tell_raw(FILE_T stream)
 {
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+    /* We haven't read any of the mapping, but we've got that far */
+    if (stream->in_map)
+        return stream->start + stream->pos;
+#endif
     return stream->raw_pos;
 }
 
@@ -1442,6 +2995,36 @@ file_read(void *buf, unsigned int len, FILE_T file)
     return (int)got;
 }
 
+/*
+ * If the next len bytes of the file are in memory into which it's been
+ * mapped, return a pointer to them and skip past them; otherwise return
+ * NULL, in which case the caller should file_read() them instead.
+ *
+ * The data remains valid until the file is closed or reopened.
+ */
+const guint8 *
+file_read_mapped(
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+    FILE_T file, unsigned int len)
+#else
+    FILE_T file _U_, unsigned int len _U_)
+#endif
+{
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+    const guint8 *data;
+
+    if (!file->in_map || file->seek_pending || file->out.avail < len)
+        return NULL;
+    data = file->out.next;
+    file->out.next += len;
+    file->out.avail -= len;
+    file->pos += len;
+    return data;
+#else
+    return NULL;
+#endif
+}
+
 /*
  * XXX - this *peeks* at next byte, not a character.
  */
@@ -1636,6 +3219,15 @@ file_fdreopen(FILE_T file, const char *path)
     if ((fd = ws_open(path, O_RDONLY|O_BINARY, 0000)) == -1)
         return FALSE;
     file->fd = fd;
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+    /* The file might not have the contents we mapped any more */
+    if (file->map != NULL) {
+        if (file->in_map)
+            (void)leave_map(file);
+        unmap_file(file);
+        file->map_tried = FALSE;
+    }
+#endif
     return TRUE;
 }
 
@@ -1644,14 +3236,27 @@ file_close(FILE_T file)
 {
     int fd = file->fd;
 
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+    unmap_file(file);
+#endif
+
     /* free memory and close file */
     if (file->size) {
 #ifdef HAVE_ZLIB
         inflateEnd(&(file->strm));
+        if (file->bgzf != NULL)
+            bgzf_queue_free(file->bgzf);
 #endif
         g_free(file->out.buf);
         g_free(file->in.buf);
     }
+#ifdef HAVE_ZSTD
+    ZSTD_freeDStream(file->zstd_dstream);
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    if (file->lz4_ctx != NULL)
+        LZ4F_freeDecompressionContext(file->lz4_ctx);
+#endif
     g_free(file->fast_seek_cur);
     file->err = 0;
     file->err_info = NULL;
@@ -1666,20 +3271,21 @@ file_close(FILE_T file)
 }
 
 #ifdef HAVE_ZLIB
+/*
+ * Writing gzip files.
+ *
+ * We write BGZF blocks, compressing several at a time on the thread
+ * pool, and write them out in order; any gzip reader can read the
+ * result, and we can read it quickly.  The last block is an empty one,
+ * which BGZF readers take to mean the end of the file.
+ */
+
 /* internal gzip file state data structure for writing */
 struct wtap_writer {
-    int fd;                 /* file descriptor */
-    gint64 pos;             /* current position in uncompressed data */
-    guint size;          /* buffer size, zero if not allocated yet */
-    guint want;          /* requested buffer size, default is GZBUFSIZE */
-    unsigned char *in;      /* input buffer */
-    unsigned char *out;     /* output buffer (double-sized when reading) */
-    unsigned char *next;    /* next output data to deliver or write */
-    int level;              /* compression level */
-    int strategy;           /* compression strategy */
-    int err;                /* error code */
-    /* zlib deflate stream */
-    z_stream strm;          /* stream structure in-place (not a pointer) */
+    int fd;                     /* file descriptor */
+    gint64 pos;                 /* current position in uncompressed data */
+    int err;                    /* error code */
+    struct bgzf_queue *queue;   /* blocks being compressed, NULL if not allocated yet */
 };
 
 GZWFILE_T
@@ -1711,128 +3317,74 @@ gzwfile_fdopen(int fd)
     if (state == NULL)
         return NULL;
     state->fd = fd;
-    state->size = 0;            /* no buffers allocated yet */
-    state->want = GZBUFSIZE;    /* requested buffer size */
-
-    state->level = Z_DEFAULT_COMPRESSION;
-    state->strategy = Z_DEFAULT_STRATEGY;
+    state->queue = NULL;        /* no blocks allocated yet */
 
     /* initialize stream */
     state->err = Z_OK;              /* clear error */
     state->pos = 0;                 /* no uncompressed data yet */
-    state->strm.avail_in = 0;       /* no input data yet */
 
     /* return stream */
     return state;
 }
 
-/* Initialize state for writing a gzip file.  Mark initialization by setting
-   state->size to non-zero.  Return -1, and set state->err, on failure;
-   return 0 on success. */
+/* Initialize state for writing a gzip file.  Return -1, and set
+   state->err, on failure; return 0 on success. */
 static int
 gz_init(GZWFILE_T state)
 {
-    int ret;
-    z_streamp strm = &(state->strm);
-
-    /* allocate input and output buffers */
-    state->in = (unsigned char *)g_try_malloc(state->want);
-    state->out = (unsigned char *)g_try_malloc(state->want);
-    if (state->in == NULL || state->out == NULL) {
-        g_free(state->out);
-        g_free(state->in);
+    state->queue = bgzf_queue_new();
+    if (state->queue == NULL) {
         state->err = ENOMEM;
         return -1;
     }
-
-    /* allocate deflate memory, set up for gzip compression */
-    strm->zalloc = Z_NULL;
-    strm->zfree = Z_NULL;
-    strm->opaque = Z_NULL;
-    ret = deflateInit2(strm, state->level, Z_DEFLATED,
-                       15 + 16, 8, state->strategy);
-    if (ret != Z_OK) {
-        g_free(state->out);
-        g_free(state->in);
-        if (ret == Z_MEM_ERROR) {
-            /* This means "not enough memory". */
-            state->err = ENOMEM;
-        } else {
-            /* This "shouldn't happen". */
-            state->err = WTAP_ERR_INTERNAL;
-        }
-        return -1;
-    }
-
-    /* mark state as initialized */
-    state->size = state->want;
-
-    /* initialize write buffer */
-    strm->avail_out = state->size;
-    strm->next_out = state->out;
-    state->next = strm->next_out;
     return 0;
 }
 
-/* Compress whatever is at avail_in and next_in and write to the output file.
-   Return -1, and set state->err, if there is an error writing to the output
-   file; return 0 on success.
-   flush is assumed to be a valid deflate() flush value.  If flush is Z_FINISH,
-   then the deflate() state is reset to start a new gzip stream. */
+/* Wait for the oldest block to be compressed, and write it to the output
+   file.  Return -1, and set state->err, if there is an error; return 0
+   on success. */
 static int
-gz_comp(GZWFILE_T state, int flush)
+gz_write_block(GZWFILE_T state)
 {
-    int ret;
+    struct bgzf_queue *q = state->queue;
+    struct bgzf_block *block = &q->blocks[q->head];
     ssize_t got;
-    ptrdiff_t have;
-    z_streamp strm = &(state->strm);
 
-    /* allocate memory if this is the first time through */
-    if (state->size == 0 && gz_init(state) == -1)
+    bgzf_wait(block);
+    q->head = (q->head + 1) % q->size;
+    q->count--;
+    if (block->err != 0) {
+        state->err = block->err;
         return -1;
+    }
+    got = ws_write(state->fd, block->cdata, block->clen);
+    if (got < 0) {
+        state->err = errno;
+        return -1;
+    }
+    if ((guint)got != block->clen) {
+        state->err = WTAP_ERR_SHORT_WRITE;
+        return -1;
+    }
+    return 0;
+}
 
-    /* run deflate() on provided input until it produces no more output */
-    ret = Z_OK;
-    do {
-        /* write out current buffer contents if full, or if flushing, but if
-           doing Z_FINISH then don't write until we get to Z_STREAM_END */
-        if (strm->avail_out == 0 || (flush != Z_NO_FLUSH &&
-                                     (flush != Z_FINISH || ret == Z_STREAM_END))) {
-            have = strm->next_out - state->next;
-            if (have) {
-                got = ws_write(state->fd, state->next, (unsigned int)have);
-                if (got < 0) {
-                    state->err = errno;
-                    return -1;
-                }
-                if ((ptrdiff_t)got != have) {
-                    state->err = WTAP_ERR_SHORT_WRITE;
-                    return -1;
-                }
-            }
-            if (strm->avail_out == 0) {
-                strm->avail_out = state->size;
-                strm->next_out = state->out;
-            }
-            state->next = strm->next_out;
-        }
-
-        /* compress */
-        have = strm->avail_out;
-        ret = deflate(strm, flush);
-        if (ret == Z_STREAM_ERROR) {
-            /* This "shouldn't happen". */
-            state->err = WTAP_ERR_INTERNAL;
-            return -1;
-        }
-        have -= strm->avail_out;
-    } while (have);
-
-    /* if that completed a deflate stream, allow another to start */
-    if (flush == Z_FINISH)
-        deflateReset(strm);
-
-    /* all done, no errors */
+/* Start compressing the block being filled, even if it's empty.  Return
+   -1, and set state->err, if there is an error writing out an earlier
+   block to make room for the next one; return 0 on success. */
+static int
+gz_comp(GZWFILE_T state)
+{
+    struct bgzf_queue *q = state->queue;
+    struct bgzf_block *block = &q->blocks[(q->head + q->count) % q->size];
+
+    block->compress = TRUE;
+    block->len = q->used;
+    q->used = 0;
+    q->count++;
+    bgzf_submit(block);
+    if (q->count == q->size)
+        return gz_write_block(state);
     return 0;
 }
 
@@ -1844,9 +3396,8 @@ gzwfile_write(GZWFILE_T state, const void *buf, guint len)
 {
     guint put = len;
     guint n;
-    z_streamp strm;
-
-    strm = &(state->strm);
+    struct bgzf_queue *q;
+    struct bgzf_block *block;
 
     /* check that there's no error */
     if (state->err != Z_OK)
@@ -1857,51 +3408,24 @@ gzwfile_write(GZWFILE_T state, const void *buf, guint len)
         return 0;
 
     /* allocate memory if this is the first time through */
-    if (state->size == 0 && gz_init(state) == -1)
+    if (state->queue == NULL && gz_init(state) == -1)
         return 0;
+    q = state->queue;
 
-    /* for small len, copy to input buffer, otherwise compress directly */
-    if (len < state->size) {
-        /* copy to input buffer, compress when full */
-        do {
-            if (strm->avail_in == 0)
-                strm->next_in = state->in;
-            n = state->size - strm->avail_in;
-            if (n > len)
-                n = len;
-#ifdef z_const
-DIAG_OFF(cast-qual)
-            memcpy((Bytef *)strm->next_in + strm->avail_in, buf, n);
-DIAG_ON(cast-qual)
-#else
-            memcpy(strm->next_in + strm->avail_in, buf, n);
-#endif
-            strm->avail_in += n;
-            state->pos += n;
-            buf = (const char *)buf + n;
-            len -= n;
-            if (len && gz_comp(state, Z_NO_FLUSH) == -1)
-                return 0;
-        } while (len);
-    }
-    else {
-        /* consume whatever's left in the input buffer */
-        if (strm->avail_in != 0 && gz_comp(state, Z_NO_FLUSH) == -1)
-            return 0;
-
-        /* directly compress user buffer to file */
-        strm->avail_in = len;
-#ifdef z_const
-        strm->next_in = (z_const Bytef *)buf;
-#else
-DIAG_OFF(cast-qual)
-        strm->next_in = (Bytef *)buf;
-DIAG_ON(cast-qual)
-#endif
-        state->pos += len;
-        if (gz_comp(state, Z_NO_FLUSH) == -1)
+    /* copy to the block being filled, compress it when full */
+    do {
+        block = &q->blocks[(q->head + q->count) % q->size];
+        n = BGZF_BLOCK_SIZE - q->used;
+        if (n > len)
+            n = len;
+        memcpy(block->data + q->used, buf, n);
+        q->used += n;
+        state->pos += n;
+        buf = (const char *)buf + n;
+        len -= n;
+        if (q->used == BGZF_BLOCK_SIZE && gz_comp(state) == -1)
             return 0;
-    }
+    } while (len);
 
     /* input was all buffered or compressed (put will fit in int) */
     return (int)put;
@@ -1915,11 +3439,16 @@ gzwfile_flush(GZWFILE_T state)
     /* check that there's no error */
     if (state->err != Z_OK)
         return -1;
+    if (state->queue == NULL)
+        return 0;
 
-    /* compress remaining data with Z_SYNC_FLUSH */
-    gz_comp(state, Z_SYNC_FLUSH);
-    if (state->err != Z_OK)
+    /* end the current block, and write out all the blocks */
+    if (state->queue->used != 0 && gz_comp(state) == -1)
         return -1;
+    while (state->queue->count != 0) {
+        if (gz_write_block(state) == -1)
+            return -1;
+    }
     return 0;
 }
 
@@ -1930,12 +3459,14 @@ gzwfile_close(GZWFILE_T state)
 {
     int ret = 0;
 
-    /* flush, free memory, and close file */
-    if (gz_comp(state, Z_FINISH) == -1 && ret == 0)
+    /* flush, add the empty block at the end, free memory, and close file */
+    if (state->queue == NULL && gz_init(state) == -1)
         ret = state->err;
-    (void)deflateEnd(&(state->strm));
-    g_free(state->out);
-    g_free(state->in);
+    if (ret == 0 && (gzwfile_flush(state) == -1 || gz_comp(state) == -1 ||
+                     gzwfile_flush(state) == -1))
+        ret = state->err;
+    if (state->queue != NULL)
+        bgzf_queue_free(state->queue);
     state->err = Z_OK;
     if (ws_close(state->fd) == -1 && ret == 0)
         ret = errno;
@@ -1950,6 +3481,299 @@ gzwfile_geterr(GZWFILE_T state)
 }
 #endif
 
+#ifdef HAVE_FRAMEWFILE
+/*
+ * Writing zstd and LZ4 files.
+ *
+ * The data is compressed in independent frames of at most
+ * FRAMEW_FRAME_SIZE bytes of uncompressed data each, so that a reader
+ * can start decompressing at the beginning of any of them; zstd files
+ * also get a seek table, in the zstd seekable format, at the end, so
+ * that a reader can find the frames without reading through the file.
+ */
+#define FRAMEW_FRAME_SIZE   (1024 * 1024)
+#define FRAMEW_ZSTD_LEVEL   3       /* zstd's default */
+
+/* internal zstd/LZ4 file state data structure for writing */
+struct wtap_frame_writer {
+    int fd;                 /* file descriptor */
+    wtap_compression_type type; /* zstd or LZ4 */
+    unsigned char *in;      /* uncompressed data for the current frame */
+    guint have;             /* amount of data in it */
+    unsigned char *out;     /* compressed frame */
+    size_t out_size;        /* size of out */
+    guint32 frames;         /* number of frames written */
+    int err;                /* error code */
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx *zstd_cctx;   /* zstd compression context */
+    GArray *seek_table;     /* compressed and uncompressed frame sizes */
+#endif
+};
+
+FRAMEWFILE_T
+framewfile_open(const char *path, wtap_compression_type type)
+{
+    int fd;
+    FRAMEWFILE_T state;
+    int save_errno;
+
+    fd = ws_open(path, O_BINARY|O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (fd == -1)
+        return NULL;
+    state = framewfile_fdopen(fd, type);
+    if (state == NULL) {
+        save_errno = errno;
+        ws_close(fd);
+        errno = save_errno;
+    }
+    return state;
+}
+
+FRAMEWFILE_T
+framewfile_fdopen(int fd, wtap_compression_type type)
+{
+    FRAMEWFILE_T state;
+
+    /* allocate wtap_frame_writer structure to return */
+    state = (FRAMEWFILE_T)g_try_malloc0(sizeof *state);
+    if (state == NULL)
+        return NULL;
+    state->fd = fd;
+    state->type = type;
+
+    switch (type) {
+
+#ifdef HAVE_ZSTD
+    case WTAP_ZSTD_COMPRESSED:
+        state->out_size = ZSTD_compressBound(FRAMEW_FRAME_SIZE);
+        state->zstd_cctx = ZSTD_createCCtx();
+        if (state->zstd_cctx == NULL)
+            goto fail;
+        state->seek_table = g_array_new(FALSE, FALSE, sizeof(guint32));
+        break;
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+    case WTAP_LZ4_COMPRESSED:
+        state->out_size = LZ4F_compressFrameBound(FRAMEW_FRAME_SIZE, NULL);
+        break;
+#endif
+
+    default:
+        g_free(state);
+        errno = WTAP_ERR_COMPRESSION_NOT_SUPPORTED;
+        return NULL;
+    }
+
+    /* allocate input and output buffers */
+    state->in = (unsigned char *)g_try_malloc(FRAMEW_FRAME_SIZE);
+    state->out = (unsigned char *)g_try_malloc(state->out_size);
+    if (state->in == NULL || state->out == NULL)
+        goto fail;
+
+    /* return stream */
+    return state;
+
+fail:
+    g_free(state->out);
+    g_free(state->in);
+#ifdef HAVE_ZSTD
+    ZSTD_freeCCtx(state->zstd_cctx);
+    if (state->seek_table != NULL)
+        g_array_free(state->seek_table, TRUE);
+#endif
+    g_free(state);
+    errno = ENOMEM;
+    return NULL;
+}
+
+/* Write out len bytes.  Return -1, and set state->err, on failure;
+   return 0 on success. */
+static int
+framew_write_out(FRAMEWFILE_T state, const void *buf, size_t len)
+{
+    ssize_t got;
+
+    got = ws_write(state->fd, buf, (unsigned int)len);
+    if (got < 0) {
+        state->err = errno;
+        return -1;
+    }
+    if ((size_t)got != len) {
+        state->err = WTAP_ERR_SHORT_WRITE;
+        return -1;
+    }
+    return 0;
+}
+
+/* Compress the data we have as a frame and write it out.  Return -1, and
+   set state->err, on failure; return 0 on success. */
+static int
+framew_comp(FRAMEWFILE_T state)
+{
+    size_t len;
+
+    switch (state->type) {
+
+#ifdef HAVE_ZSTD
+    case WTAP_ZSTD_COMPRESSED:
+        len = ZSTD_compressCCtx(state->zstd_cctx, state->out, state->out_size,
+                                state->in, state->have, FRAMEW_ZSTD_LEVEL);
+        if (ZSTD_isError(len)) {
+            /* This "shouldn't happen". */
+            state->err = WTAP_ERR_INTERNAL;
+            return -1;
+        }
+        break;
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+    case WTAP_LZ4_COMPRESSED:
+        len = LZ4F_compressFrame(state->out, state->out_size,
+                                 state->in, state->have, NULL);
+        if (LZ4F_isError(len)) {
+            /* This "shouldn't happen". */
+            state->err = WTAP_ERR_INTERNAL;
+            return -1;
+        }
+        break;
+#endif
+
+    default:
+        state->err = WTAP_ERR_INTERNAL;
+        return -1;
+    }
+
+    if (framew_write_out(state, state->out, len) == -1)
+        return -1;
+#ifdef HAVE_ZSTD
+    if (state->seek_table != NULL) {
+        guint32 sizes[2];
+
+        sizes[0] = (guint32)len;            /* Compressed_Size */
+        sizes[1] = state->have;             /* Decompressed_Size */
+        g_array_append_vals(state->seek_table, sizes, 2);
+    }
+#endif
+    state->frames++;
+    state->have = 0;
+    return 0;
+}
+
+#ifdef HAVE_ZSTD
+/* Write the seek table, as a skippable frame.  Return -1, and set
+   state->err, on failure; return 0 on success. */
+static int
+zstd_write_seek_table(FRAMEWFILE_T state)
+{
+    guint entries_len = state->seek_table->len * 4;
+    guint len = ZSTD_SEEK_TABLE_HEADER_SIZE + entries_len + ZSTD_SEEK_TABLE_FOOTER_SIZE;
+    guint8 *table, *p;
+    guint i;
+    int ret;
+
+    table = (guint8 *)g_malloc(len);
+    p = table;
+    phtole32(p, ZSTD_SEEK_TABLE_MAGIC);
+    phtole32(p + 4, entries_len + ZSTD_SEEK_TABLE_FOOTER_SIZE);
+    p += ZSTD_SEEK_TABLE_HEADER_SIZE;
+    for (i = 0; i < state->seek_table->len; i++, p += 4)
+        phtole32(p, g_array_index(state->seek_table, guint32, i));
+    phtole32(p, state->frames);             /* Number_Of_Frames */
+    p[4] = 0;                               /* Seek_Table_Descriptor: no checksums */
+    phtole32(p + 5, ZSTD_SEEKABLE_MAGIC);
+    ret = framew_write_out(state, table, len);
+    g_free(table);
+    return ret;
+}
+#endif
+
+/* Write out len bytes from buf.  Return 0, and set state->err, on
+   failure or on an attempt to write 0 bytes (in which case state->err
+   is 0); return the number of bytes written on success. */
+guint
+framewfile_write(FRAMEWFILE_T state, const void *buf, guint len)
+{
+    guint put = len;
+    guint n;
+
+    /* check that there's no error */
+    if (state->err != 0)
+        return 0;
+
+    /* if len is zero, avoid unnecessary operations */
+    if (len == 0)
+        return 0;
+
+    /* copy to input buffer, compress a frame when full */
+    do {
+        n = FRAMEW_FRAME_SIZE - state->have;
+        if (n > len)
+            n = len;
+        memcpy(state->in + state->have, buf, n);
+        state->have += n;
+        buf = (const char *)buf + n;
+        len -= n;
+        if (state->have == FRAMEW_FRAME_SIZE && framew_comp(state) == -1)
+            return 0;
+    } while (len);
+
+    return put;
+}
+
+/* Flush out what we've written so far, ending the current frame.  Returns
+   -1, and sets state->err, on failure; returns 0 on success. */
+int
+framewfile_flush(FRAMEWFILE_T state)
+{
+    /* check that there's no error */
+    if (state->err != 0)
+        return -1;
+
+    if (state->have != 0 && framew_comp(state) == -1)
+        return -1;
+    return 0;
+}
+
+/* Flush out all data written, and close the file.  Returns a Wiretap
+   error on failure; returns 0 on success. */
+int
+framewfile_close(FRAMEWFILE_T state)
+{
+    int ret = state->err;
+
+    /* write out the last frame; an empty file still gets one, so that
+       readers can tell what it is */
+    if (ret == 0 && (state->have != 0 || state->frames == 0) &&
+        framew_comp(state) == -1)
+        ret = state->err;
+#ifdef HAVE_ZSTD
+    if (ret == 0 && state->seek_table != NULL &&
+        zstd_write_seek_table(state) == -1)
+        ret = state->err;
+#endif
+
+    /* free memory, and close file */
+#ifdef HAVE_ZSTD
+    ZSTD_freeCCtx(state->zstd_cctx);
+    if (state->seek_table != NULL)
+        g_array_free(state->seek_table, TRUE);
+#endif
+    g_free(state->out);
+    g_free(state->in);
+    if (ws_close(state->fd) == -1 && ret == 0)
+        ret = errno;
+    g_free(state);
+    return ret;
+}
+
+int
+framewfile_geterr(FRAMEWFILE_T state)
+{
+    return state->err;
+}
+#endif /* HAVE_FRAMEWFILE */
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
@@ -17,12 +17,19 @@
 extern FILE_T file_open(const char *path);
 extern FILE_T file_fdopen(int fildes);
 extern void file_set_random_access(FILE_T stream, gboolean random_flag, GPtrArray *seek);
+extern void file_set_mmap(FILE_T stream);
+#ifdef HAVE_ZLIB
+extern gchar *file_seek_index_path(FILE_T stream, const char *dir);
+extern gboolean file_load_seek_index(FILE_T stream, const char *path);
+extern void file_save_seek_index(FILE_T stream, const char *path);
+#endif /* HAVE_ZLIB */
 WS_DLL_PUBLIC gint64 file_seek(FILE_T stream, gint64 offset, int whence, int *err);
 WS_DLL_PUBLIC gint64 file_tell(FILE_T stream);
 extern gint64 file_tell_raw(FILE_T stream);
 extern int file_fstat(FILE_T stream, ws_statb64 *statb, int *err);
 WS_DLL_PUBLIC gboolean file_iscompressed(FILE_T stream);
 WS_DLL_PUBLIC int file_read(void *buf, unsigned int count, FILE_T file);
+extern const guint8 *file_read_mapped(FILE_T file, unsigned int count);
 WS_DLL_PUBLIC int file_peekc(FILE_T stream);
 WS_DLL_PUBLIC int file_getc(FILE_T stream);
 WS_DLL_PUBLIC char *file_gets(char *buf, int len, FILE_T stream);
@@ -34,6 +41,10 @@ extern void file_fdclose(FILE_T file);
 extern int file_fdreopen(FILE_T file, const char *path);
 extern void file_close(FILE_T file);
 
+#ifdef HAVE_ZLIB
+extern void file_wrappers_cleanup(void);
+#endif /* HAVE_ZLIB */
+
 #ifdef HAVE_ZLIB
 typedef struct wtap_writer *GZWFILE_T;
 
@@ -45,4 +56,17 @@ extern int gzwfile_close(GZWFILE_T state);
 extern int gzwfile_geterr(GZWFILE_T state);
 #endif /* HAVE_ZLIB */
 
+#if defined(HAVE_ZSTD) || defined(HAVE_LZ4FRAME_H)
+#define HAVE_FRAMEWFILE
+
+typedef struct wtap_frame_writer *FRAMEWFILE_T;
+
+extern FRAMEWFILE_T framewfile_open(const char *path, wtap_compression_type type);
+extern FRAMEWFILE_T framewfile_fdopen(int fd, wtap_compression_type type);
+extern guint framewfile_write(FRAMEWFILE_T state, const void *buf, guint len);
+extern int framewfile_flush(FRAMEWFILE_T state);
+extern int framewfile_close(FRAMEWFILE_T state);
+extern int framewfile_geterr(FRAMEWFILE_T state);
+#endif /* HAVE_ZSTD || HAVE_LZ4FRAME_H */
+
 #endif /* __FILE_H__ */
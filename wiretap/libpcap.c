@@ -52,6 +52,9 @@ static gboolean libpcap_dump(wtap_dumper *wdh, const wtap_rec *rec,
     const guint8 *pd, int *err, gchar **err_info);
 static int libpcap_read_header(wtap *wth, FILE_T fh, int *err, gchar **err_info,
     struct pcaprec_ss990915_hdr *hdr);
+static void libpcap_adjust_header(libpcap_t *libpcap, struct pcaprec_hdr *hdr);
+static guint libpcap_read_batch(wtap *wth, wtap_batch *batch, int *err,
+    gchar **err_info);
 static void libpcap_close(wtap *wth);
 
 wtap_open_return_val libpcap_open(wtap *wth, int *err, gchar **err_info)
@@ -521,6 +524,15 @@ done:
 		/*Reset the ERF interface lookup table*/
 		libpcap->encap_priv = erf_priv_create();
 	}
+
+	/*
+	 * Files with standard record headers and no pseudo-headers
+	 * can be read a batch at a time.
+	 */
+	if ((wth->file_type_subtype == WTAP_FILE_TYPE_SUBTYPE_PCAP ||
+	     wth->file_type_subtype == WTAP_FILE_TYPE_SUBTYPE_PCAP_NSEC) &&
+	    !wtap_encap_requires_phdr(wth->file_encap))
+		wth->subtype_read_batch = libpcap_read_batch;
 	return WTAP_OPEN_MINE;
 }
 
@@ -826,16 +838,86 @@ libpcap_read_packet(wtap *wth, FILE_T fh, wtap_rec *rec,
 	rec->rec_header.packet_header.len = orig_size;
 
 	/*
-	 * Read the packet data.
+	 * Read the packet data.  Unless pcap_read_post_process() will
+	 * have to byte-swap some of it in place, it can be left where it
+	 * is if the file is mapped into memory.
 	 */
-	if (!wtap_read_packet_bytes(fh, buf, packet_size, err, err_info))
-		return FALSE;	/* failed */
+	if (libpcap->byte_swapped) {
+		if (!wtap_read_packet_bytes(fh, buf, packet_size, err, err_info))
+			return FALSE;	/* failed */
+	} else {
+		if (!wtap_map_packet_bytes(fh, buf, packet_size, err, err_info))
+			return FALSE;	/* failed */
+	}
 
 	pcap_read_post_process(wth->file_type_subtype, wth->file_encap,
 	    rec, ws_buffer_start_ptr(buf), libpcap->byte_swapped, -1);
 	return TRUE;
 }
 
+/*
+ * Read a batch of records from a file with standard record headers
+ * and no pseudo-headers; this is libpcap_read_packet() with everything
+ * that can't happen in such a file left out.
+ */
+static guint
+libpcap_read_batch(wtap *wth, wtap_batch *batch, int *err,
+    gchar **err_info)
+{
+	libpcap_t *libpcap = (libpcap_t *)wth->priv;
+	FILE_T fh = wth->fh;
+	guint max_snaplen = wtap_max_snaplen_for_encap(wth->file_encap);
+	struct pcaprec_hdr hdr;
+	wtap_rec *rec;
+	Buffer *buf;
+	guint i;
+
+	for (i = 0; i < batch->size; i++) {
+		rec = &batch->recs[i];
+		buf = &batch->bufs[i];
+
+		batch->offsets[i] = file_tell(fh);
+		if (!wtap_read_bytes_or_eof(fh, &hdr, sizeof hdr, err, err_info))
+			break;
+		libpcap_adjust_header(libpcap, &hdr);
+
+		if (hdr.incl_len > max_snaplen) {
+			/* See libpcap_read_packet() */
+			*err = WTAP_ERR_BAD_FILE;
+			*err_info = g_strdup_printf("pcap: File has %u-byte packet, bigger than maximum of %u",
+			    hdr.incl_len, max_snaplen);
+			break;
+		}
+
+		/* Sets up the pseudo-header, but doesn't read anything */
+		if (pcap_process_pseudo_header(fh, wth->file_type_subtype,
+		    wth->file_encap, hdr.incl_len, rec, err, err_info) < 0)
+			break;
+
+		rec->rec_type = REC_TYPE_PACKET;
+		rec->presence_flags = WTAP_HAS_TS|WTAP_HAS_CAP_LEN;
+		rec->ts.secs = hdr.ts_sec;
+		if (wth->file_tsprec == WTAP_TSPREC_NSEC)
+			rec->ts.nsecs = hdr.ts_usec;
+		else
+			rec->ts.nsecs = hdr.ts_usec * 1000;
+		rec->rec_header.packet_header.caplen = hdr.incl_len;
+		rec->rec_header.packet_header.len = hdr.orig_len;
+
+		if (libpcap->byte_swapped) {
+			if (!wtap_read_packet_bytes(fh, buf, hdr.incl_len, err, err_info))
+				break;
+		} else {
+			if (!wtap_map_packet_bytes(fh, buf, hdr.incl_len, err, err_info))
+				break;
+		}
+
+		pcap_read_post_process(wth->file_type_subtype, wth->file_encap,
+		    rec, ws_buffer_start_ptr(buf), libpcap->byte_swapped, -1);
+	}
+	return i;
+}
+
 /* Read the header of the next packet.
 
    Return FALSE on an error, TRUE on success. */
@@ -843,7 +925,6 @@ static int libpcap_read_header(wtap *wth, FILE_T fh, int *err, gchar **err_info,
     struct pcaprec_ss990915_hdr *hdr)
 {
 	int bytes_to_read;
-	guint32 temp;
 	libpcap_t *libpcap;
 
 	switch (wth->file_type_subtype) {
@@ -875,12 +956,24 @@ static int libpcap_read_header(wtap *wth, FILE_T fh, int *err, gchar **err_info,
 		return FALSE;
 
 	libpcap = (libpcap_t *)wth->priv;
+	libpcap_adjust_header(libpcap, &hdr->hdr);
+
+	return TRUE;
+}
+
+/* Put the fields of a record header that we use into host byte order,
+   and in the right order. */
+static void
+libpcap_adjust_header(libpcap_t *libpcap, struct pcaprec_hdr *hdr)
+{
+	guint32 temp;
+
 	if (libpcap->byte_swapped) {
 		/* Byte-swap the record header fields. */
-		hdr->hdr.ts_sec = GUINT32_SWAP_LE_BE(hdr->hdr.ts_sec);
-		hdr->hdr.ts_usec = GUINT32_SWAP_LE_BE(hdr->hdr.ts_usec);
-		hdr->hdr.incl_len = GUINT32_SWAP_LE_BE(hdr->hdr.incl_len);
-		hdr->hdr.orig_len = GUINT32_SWAP_LE_BE(hdr->hdr.orig_len);
+		hdr->ts_sec = GUINT32_SWAP_LE_BE(hdr->ts_sec);
+		hdr->ts_usec = GUINT32_SWAP_LE_BE(hdr->ts_usec);
+		hdr->incl_len = GUINT32_SWAP_LE_BE(hdr->incl_len);
+		hdr->orig_len = GUINT32_SWAP_LE_BE(hdr->orig_len);
 	}
 
 	/* Swap the "incl_len" and "orig_len" fields, if necessary. */
@@ -890,7 +983,7 @@ static int libpcap_read_header(wtap *wth, FILE_T fh, int *err, gchar **err_info,
 		break;
 
 	case MAYBE_SWAPPED:
-		if (hdr->hdr.incl_len <= hdr->hdr.orig_len) {
+		if (hdr->incl_len <= hdr->orig_len) {
 			/*
 			 * The captured length is <= the actual length,
 			 * so presumably they weren't swapped.
@@ -900,13 +993,11 @@ static int libpcap_read_header(wtap *wth, FILE_T fh, int *err, gchar **err_info,
 		/* FALLTHROUGH */
 
 	case SWAPPED:
-		temp = hdr->hdr.orig_len;
-		hdr->hdr.orig_len = hdr->hdr.incl_len;
-		hdr->hdr.incl_len = temp;
+		temp = hdr->orig_len;
+		hdr->orig_len = hdr->incl_len;
+		hdr->incl_len = temp;
 		break;
 	}
-
-	return TRUE;
 }
 
 /* Returns 0 if we could write the specified encapsulation type,
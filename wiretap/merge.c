@@ -82,8 +82,10 @@ cleanup_in_file(merge_in_file_t *in_file)
     g_array_free(in_file->idb_index_map, TRUE);
     in_file->idb_index_map = NULL;
 
-    wtap_rec_cleanup(&in_file->rec);
-    ws_buffer_free(&in_file->frame_buffer);
+    wtap_batch_free(in_file->batch);
+    in_file->batch = NULL;
+    in_file->rec = NULL;
+    in_file->frame_buffer = NULL;
 }
 
 static void
@@ -148,8 +150,7 @@ merge_open_in_files(guint in_file_count, const char *const *in_file_names,
             *err_fileno = i;
             return FALSE;
         }
-        wtap_rec_init(&files[i].rec);
-        ws_buffer_init(&files[i].frame_buffer, 1514);
+        files[i].batch = wtap_batch_new(WTAP_BATCH_SIZE);
         files[i].size = size;
         files[i].idb_index_map = g_array_new(FALSE, FALSE, sizeof(guint));
     }
@@ -225,6 +226,24 @@ is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
     return TRUE;
 }
 
+/*
+ * Read the next record from an input file, reading the file a batch
+ * of records at a time.
+ */
+static gboolean
+merge_read_rec(merge_in_file_t *in_file, int *err, gchar **err_info)
+{
+    if (in_file->batch_index >= in_file->batch->count) {
+        if (!wtap_read_batch(in_file->wth, in_file->batch, err, err_info))
+            return FALSE;
+        in_file->batch_index = 0;
+    }
+    in_file->rec = &in_file->batch->recs[in_file->batch_index];
+    in_file->frame_buffer = &in_file->batch->bufs[in_file->batch_index];
+    in_file->batch_index++;
+    return TRUE;
+}
+
 /** Read the next packet, in chronological order, from the set of files to
  * be merged.
  *
@@ -262,16 +281,12 @@ merge_read_packet(int in_file_count, merge_in_file_t in_files[],
      * merge of those records, but you obviously *can't* get that.
      */
     for (i = 0; i < in_file_count; i++) {
-        gint64 data_offset;
-
         if (in_files[i].state == RECORD_NOT_PRESENT) {
             /*
              * No packet available, and we haven't seen an error or EOF yet,
              * so try to read the next packet.
              */
-            if (!wtap_read(in_files[i].wth, &in_files[i].rec,
-                           &in_files[i].frame_buffer, err, err_info,
-                           &data_offset)) {
+            if (!merge_read_rec(&in_files[i], err, err_info)) {
                 if (*err != 0) {
                     in_files[i].state = GOT_ERROR;
                     return &in_files[i];
@@ -282,7 +297,7 @@ merge_read_packet(int in_file_count, merge_in_file_t in_files[],
         }
 
         if (in_files[i].state == RECORD_PRESENT) {
-            rec = &in_files[i].rec;
+            rec = in_files[i].rec;
             if (!(rec->presence_flags & WTAP_HAS_TS)) {
                 /*
                  * No time stamp.  Pick this record, and stop looking.
@@ -347,7 +362,6 @@ merge_append_read_packet(int in_file_count, merge_in_file_t in_files[],
                          int *err, gchar **err_info)
 {
     int i;
-    gint64 data_offset;
 
     /*
      * Find the first file not at EOF, and read the next packet from it.
@@ -355,9 +369,7 @@ merge_append_read_packet(int in_file_count, merge_in_file_t in_files[],
     for (i = 0; i < in_file_count; i++) {
         if (in_files[i].state == AT_EOF)
             continue; /* This file is already at EOF */
-        if (wtap_read(in_files[i].wth, &in_files[i].rec,
-                      &in_files[i].frame_buffer, err, err_info,
-                      &data_offset))
+        if (merge_read_rec(&in_files[i], err, err_info))
             break; /* We have a packet */
         if (*err != 0) {
             /* Read error - quit immediately. */
@@ -885,7 +897,7 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
             break;
         }
 
-        rec = &in_file->rec;
+        rec = in_file->rec;
 
         switch (rec->rec_type) {
 
@@ -935,7 +947,7 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
             }
         }
 
-        if (!wtap_dump(pdh, rec, ws_buffer_start_ptr(&in_file->frame_buffer),
+        if (!wtap_dump(pdh, rec, ws_buffer_start_ptr(in_file->frame_buffer),
                        err, err_info)) {
             status = MERGE_ERR_CANT_WRITE_OUTFILE;
             break;
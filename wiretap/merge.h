@@ -30,8 +30,10 @@ typedef enum {
 typedef struct merge_in_file_s {
     const char     *filename;
     wtap           *wth;
-    wtap_rec        rec;
-    Buffer          frame_buffer;
+    wtap_batch     *batch;          /* records read from the file */
+    guint           batch_index;    /* next record in batch */
+    wtap_rec       *rec;            /* current record, in batch */
+    Buffer         *frame_buffer;   /* current record's data, in batch */
     in_file_state_e state;
     guint32         packet_num;     /* current packet number */
     gint64          size;           /* file size */
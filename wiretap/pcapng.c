@@ -40,6 +40,8 @@
 static gboolean
 pcapng_read(wtap *wth, wtap_rec *rec, Buffer *buf, int *err,
             gchar **err_info, gint64 *data_offset);
+static guint
+pcapng_read_batch(wtap *wth, wtap_batch *batch, int *err, gchar **err_info);
 static gboolean
 pcapng_seek_read(wtap *wth, gint64 seek_off,
                  wtap_rec *rec, Buffer *buf, int *err, gchar **err_info);
@@ -1127,7 +1129,7 @@ pcapng_read_packet_block(FILE_T fh, pcapng_block_header_t *bh, pcapng_t *pn, wta
     guint32 padding;
     interface_info_t iface_info;
     guint64 ts;
-    guint8 *opt_ptr;
+    guint8 *opt_ptr = NULL;
     pcapng_option_header_t *oh;
     guint8 *option_content;
     int pseudo_header_len;
@@ -1308,10 +1310,17 @@ pcapng_read_packet_block(FILE_T fh, pcapng_block_header_t *bh, pcapng_t *pn, wta
     wblock->rec->ts.secs = (time_t)(ts / iface_info.time_units_per_second);
     wblock->rec->ts.nsecs = (int)(((ts % iface_info.time_units_per_second) * 1000000000) / iface_info.time_units_per_second);
 
-    /* "(Enhanced) Packet Block" read capture data */
-    if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
-                                packet.cap_len - pseudo_header_len, err, err_info))
-        return FALSE;
+    /* "(Enhanced) Packet Block" read capture data; unless it'll be
+       byte-swapped in place, it can stay in the mapping if there is one */
+    if (pn->byte_swapped) {
+        if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
+                                    packet.cap_len - pseudo_header_len, err, err_info))
+            return FALSE;
+    } else {
+        if (!wtap_map_packet_bytes(fh, wblock->frame_buffer,
+                                   packet.cap_len - pseudo_header_len, err, err_info))
+            return FALSE;
+    }
     block_read += packet.cap_len - pseudo_header_len;
 
     /* jump over potential padding bytes at end of the packet data */
@@ -1344,11 +1353,15 @@ pcapng_read_packet_block(FILE_T fh, pcapng_block_header_t *bh, pcapng_t *pn, wta
     /* Ensure sufficient temporary memory to hold all options. It is not freed
      * on return to avoid frequent reallocations. When called for sequential
      * read (wtap_read), "wblock->rec == &wth->rec" (options_buf will be freed
-     * by wtap_sequential_close). For random access, memory is managed by the
-     * caller of wtap_seek_read. */
+     * by wtap_sequential_close); for batched reads it belongs to the batch.
+     * For random access, memory is managed by the caller of wtap_seek_read.
+     * Most packet blocks have no options, so don't bother with the buffer
+     * for those. */
     opt_cont_buf_len = to_read;
-    ws_buffer_assure_space(&wblock->rec->options_buf, opt_cont_buf_len);
-    opt_ptr = ws_buffer_start_ptr(&wblock->rec->options_buf);
+    if (to_read != 0) {
+        ws_buffer_assure_space(&wblock->rec->options_buf, opt_cont_buf_len);
+        opt_ptr = ws_buffer_start_ptr(&wblock->rec->options_buf);
+    }
 
     while (to_read != 0) {
         /* read option */
@@ -1593,10 +1606,16 @@ pcapng_read_simple_packet_block(FILE_T fh, pcapng_block_header_t *bh, pcapng_t *
 
     memset((void *)&wblock->rec->rec_header.packet_header.pseudo_header, 0, sizeof(union wtap_pseudo_header));
 
-    /* "Simple Packet Block" read capture data */
-    if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
-                                simple_packet.cap_len, err, err_info))
-        return FALSE;
+    /* "Simple Packet Block" read capture data; as above */
+    if (pn->byte_swapped) {
+        if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
+                                    simple_packet.cap_len, err, err_info))
+            return FALSE;
+    } else {
+        if (!wtap_map_packet_bytes(fh, wblock->frame_buffer,
+                                   simple_packet.cap_len, err, err_info))
+            return FALSE;
+    }
 
     /* jump over potential padding bytes at end of the packet data */
     if ((simple_packet.cap_len % 4) != 0) {
@@ -2739,6 +2758,7 @@ pcapng_open(wtap *wth, int *err, gchar **err_info)
     pcapng->interfaces = g_array_new(FALSE, FALSE, sizeof(interface_info_t));
 
     wth->subtype_read = pcapng_read;
+    wth->subtype_read_batch = pcapng_read_batch;
     wth->subtype_seek_read = pcapng_seek_read;
     wth->subtype_close = pcapng_close;
     wth->file_type_subtype = WTAP_FILE_TYPE_SUBTYPE_PCAPNG;
@@ -2793,6 +2813,101 @@ pcapng_open(wtap *wth, int *err, gchar **err_info)
 }
 
 
+/* process a block that isn't returned to the caller */
+static void
+pcapng_process_internal_block(wtap *wth, pcapng_t *pcapng, wtapng_block_t *wblock)
+{
+    wtap_block_t wtapng_if_descr;
+    wtap_block_t if_stats;
+    wtapng_if_stats_mandatory_t *if_stats_mand_block, *if_stats_mand;
+    wtapng_if_descr_mandatory_t *wtapng_if_descr_mand;
+
+    switch (wblock->type) {
+
+        case(BLOCK_TYPE_SHB):
+            pcapng_debug("pcapng_read: another section header block");
+            g_array_append_val(wth->shb_hdrs, wblock->block);
+            break;
+
+        case(BLOCK_TYPE_IDB):
+            /* A new interface */
+            pcapng_debug("pcapng_read: block type BLOCK_TYPE_IDB");
+            pcapng_process_idb(wth, pcapng, wblock);
+            wtap_block_free(wblock->block);
+            break;
+
+        case(BLOCK_TYPE_DSB):
+            /* Decryption secrets. */
+            pcapng_debug("pcapng_read: block type BLOCK_TYPE_DSB");
+            pcapng_process_dsb(wth, wblock);
+            /* Do not free wblock->block, it is consumed by pcapng_process_dsb */
+            break;
+
+        case(BLOCK_TYPE_NRB):
+            /* More name resolution entries */
+            pcapng_debug("pcapng_read: block type BLOCK_TYPE_NRB");
+            if (wth->nrb_hdrs == NULL) {
+                wth->nrb_hdrs = g_array_new(FALSE, FALSE, sizeof(wtap_block_t));
+            }
+            g_array_append_val(wth->nrb_hdrs, wblock->block);
+            break;
+
+        case(BLOCK_TYPE_ISB):
+            /*
+             * Another interface statistics report
+             *
+             * XXX - given that they're reports, we should be
+             * supplying them in read calls, and displaying them
+             * in the "packet" list, so you can see what the
+             * statistics were *at the time when the report was
+             * made*.
+             *
+             * The statistics from the *last* ISB could be displayed
+             * in the summary, but if there are packets after the
+             * last ISB, that could be misleading.
+             *
+             * If we only display them if that ISB has an isb_endtime
+             * option, which *should* only appear when capturing ended
+             * on that interface (so there should be no more packet
+             * blocks or ISBs for that interface after that point,
+             * that would be the best way of showing "summary"
+             * statistics.
+             */
+            pcapng_debug("pcapng_read: block type BLOCK_TYPE_ISB");
+            if_stats_mand_block = (wtapng_if_stats_mandatory_t*)wtap_block_get_mandatory_data(wblock->block);
+            if (wth->interface_data->len <= if_stats_mand_block->interface_id) {
+                pcapng_debug("pcapng_read: BLOCK_TYPE_ISB wblock->if_stats.interface_id %u >= number_of_interfaces", if_stats_mand_block->interface_id);
+            } else {
+                /* Get the interface description */
+                wtapng_if_descr = g_array_index(wth->interface_data, wtap_block_t, if_stats_mand_block->interface_id);
+                wtapng_if_descr_mand = (wtapng_if_descr_mandatory_t*)wtap_block_get_mandatory_data(wtapng_if_descr);
+                if (wtapng_if_descr_mand->num_stat_entries == 0) {
+                    /* First ISB found, no previous entry */
+                    pcapng_debug("pcapng_read: block type BLOCK_TYPE_ISB. First ISB found, no previous entry");
+                    wtapng_if_descr_mand->interface_statistics = g_array_new(FALSE, FALSE, sizeof(wtap_block_t));
+                }
+
+                if_stats = wtap_block_create(WTAP_BLOCK_IF_STATS);
+                if_stats_mand = (wtapng_if_stats_mandatory_t*)wtap_block_get_mandatory_data(if_stats);
+                if_stats_mand->interface_id  = if_stats_mand_block->interface_id;
+                if_stats_mand->ts_high       = if_stats_mand_block->ts_high;
+                if_stats_mand->ts_low        = if_stats_mand_block->ts_low;
+
+                wtap_block_copy(if_stats, wblock->block);
+                g_array_append_val(wtapng_if_descr_mand->interface_statistics, if_stats);
+                wtapng_if_descr_mand->num_stat_entries++;
+            }
+            wtap_block_free(wblock->block);
+            break;
+
+        default:
+            /* XXX - improve handling of "unknown" blocks */
+            pcapng_debug("pcapng_read: Unknown block type 0x%08x", wblock->type);
+            break;
+    }
+}
+
+
 /* classic wtap: read packet */
 static gboolean
 pcapng_read(wtap *wth, wtap_rec *rec, Buffer *buf, int *err,
@@ -2800,10 +2915,6 @@ pcapng_read(wtap *wth, wtap_rec *rec, Buffer *buf, int *err,
 {
     pcapng_t *pcapng = (pcapng_t *)wth->priv;
     wtapng_block_t wblock;
-    wtap_block_t wtapng_if_descr;
-    wtap_block_t if_stats;
-    wtapng_if_stats_mandatory_t *if_stats_mand_block, *if_stats_mand;
-    wtapng_if_descr_mandatory_t *wtapng_if_descr_mand;
 
     wblock.frame_buffer  = buf;
     wblock.rec = rec;
@@ -2833,95 +2944,44 @@ pcapng_read(wtap *wth, wtap_rec *rec, Buffer *buf, int *err,
          * This is a block type we process internally, rather than
          * returning it for the caller to process.
          */
-        switch (wblock.type) {
-
-            case(BLOCK_TYPE_SHB):
-                pcapng_debug("pcapng_read: another section header block");
-                g_array_append_val(wth->shb_hdrs, wblock.block);
-                break;
+        pcapng_process_internal_block(wth, pcapng, &wblock);
+    }
 
-            case(BLOCK_TYPE_IDB):
-                /* A new interface */
-                pcapng_debug("pcapng_read: block type BLOCK_TYPE_IDB");
-                pcapng_process_idb(wth, pcapng, &wblock);
-                wtap_block_free(wblock.block);
-                break;
+    /*pcapng_debug("Read length: %u Packet length: %u", bytes_read, rec->rec_header.packet_header.caplen);*/
+    pcapng_debug("pcapng_read: data_offset is finally %" G_GINT64_MODIFIER "d", *data_offset);
 
-            case(BLOCK_TYPE_DSB):
-                /* Decryption secrets. */
-                pcapng_debug("pcapng_read: block type BLOCK_TYPE_DSB");
-                pcapng_process_dsb(wth, &wblock);
-                /* Do not free wblock.block, it is consumed by pcapng_process_dsb */
-                break;
+    return TRUE;
+}
 
-            case(BLOCK_TYPE_NRB):
-                /* More name resolution entries */
-                pcapng_debug("pcapng_read: block type BLOCK_TYPE_NRB");
-                if (wth->nrb_hdrs == NULL) {
-                    wth->nrb_hdrs = g_array_new(FALSE, FALSE, sizeof(wtap_block_t));
-                }
-                g_array_append_val(wth->nrb_hdrs, wblock.block);
-                break;
 
-            case(BLOCK_TYPE_ISB):
-                /*
-                 * Another interface statistics report
-                 *
-                 * XXX - given that they're reports, we should be
-                 * supplying them in read calls, and displaying them
-                 * in the "packet" list, so you can see what the
-                 * statistics were *at the time when the report was
-                 * made*.
-                 *
-                 * The statistics from the *last* ISB could be displayed
-                 * in the summary, but if there are packets after the
-                 * last ISB, that could be misleading.
-                 *
-                 * If we only display them if that ISB has an isb_endtime
-                 * option, which *should* only appear when capturing ended
-                 * on that interface (so there should be no more packet
-                 * blocks or ISBs for that interface after that point,
-                 * that would be the best way of showing "summary"
-                 * statistics.
-                 */
-                pcapng_debug("pcapng_read: block type BLOCK_TYPE_ISB");
-                if_stats_mand_block = (wtapng_if_stats_mandatory_t*)wtap_block_get_mandatory_data(wblock.block);
-                if (wth->interface_data->len <= if_stats_mand_block->interface_id) {
-                    pcapng_debug("pcapng_read: BLOCK_TYPE_ISB wblock.if_stats.interface_id %u >= number_of_interfaces", if_stats_mand_block->interface_id);
-                } else {
-                    /* Get the interface description */
-                    wtapng_if_descr = g_array_index(wth->interface_data, wtap_block_t, if_stats_mand_block->interface_id);
-                    wtapng_if_descr_mand = (wtapng_if_descr_mandatory_t*)wtap_block_get_mandatory_data(wtapng_if_descr);
-                    if (wtapng_if_descr_mand->num_stat_entries == 0) {
-                        /* First ISB found, no previous entry */
-                        pcapng_debug("pcapng_read: block type BLOCK_TYPE_ISB. First ISB found, no previous entry");
-                        wtapng_if_descr_mand->interface_statistics = g_array_new(FALSE, FALSE, sizeof(wtap_block_t));
-                    }
+/* read a batch of packets */
+static guint
+pcapng_read_batch(wtap *wth, wtap_batch *batch, int *err, gchar **err_info)
+{
+    pcapng_t *pcapng = (pcapng_t *)wth->priv;
+    wtapng_block_t wblock;
+    guint count = 0;
 
-                    if_stats = wtap_block_create(WTAP_BLOCK_IF_STATS);
-                    if_stats_mand = (wtapng_if_stats_mandatory_t*)wtap_block_get_mandatory_data(if_stats);
-                    if_stats_mand->interface_id  = if_stats_mand_block->interface_id;
-                    if_stats_mand->ts_high       = if_stats_mand_block->ts_high;
-                    if_stats_mand->ts_low        = if_stats_mand_block->ts_low;
+    pcapng->add_new_ipv4 = wth->add_new_ipv4;
+    pcapng->add_new_ipv6 = wth->add_new_ipv6;
 
-                    wtap_block_copy(if_stats, wblock.block);
-                    g_array_append_val(wtapng_if_descr_mand->interface_statistics, if_stats);
-                    wtapng_if_descr_mand->num_stat_entries++;
-                }
-                wtap_block_free(wblock.block);
-                break;
+    while (count < batch->size) {
+        wblock.frame_buffer = &batch->bufs[count];
+        wblock.rec = &batch->recs[count];
 
-            default:
-                /* XXX - improve handling of "unknown" blocks */
-                pcapng_debug("pcapng_read: Unknown block type 0x%08x", wblock.type);
-                break;
+        batch->offsets[count] = file_tell(wth->fh);
+        if (pcapng_read_block(wth, wth->fh, pcapng, &wblock, err, err_info) != PCAPNG_BLOCK_OK) {
+            pcapng_debug("pcapng_read_batch: couldn't read block after %u records", count);
+            wtap_block_free(wblock.block);
+            break;
         }
-    }
 
-    /*pcapng_debug("Read length: %u Packet length: %u", bytes_read, rec->rec_header.packet_header.caplen);*/
-    pcapng_debug("pcapng_read: data_offset is finally %" G_GINT64_MODIFIER "d", *data_offset);
-
-    return TRUE;
+        if (wblock.internal)
+            pcapng_process_internal_block(wth, pcapng, &wblock);
+        else
+            count++;
+    }
+    return count;
 }
 
 
@@ -28,6 +28,8 @@ typedef gboolean (*subtype_read_func)(struct wtap*, wtap_rec *,
                                       Buffer *, int *, char **, gint64 *);
 typedef gboolean (*subtype_seek_read_func)(struct wtap*, gint64, wtap_rec *,
                                            Buffer *, int *, char **);
+typedef guint (*subtype_read_batch_func)(struct wtap*, wtap_batch *,
+                                         int *, char **);
 
 /**
  * Struct holding data of the currently read file.
@@ -48,6 +50,7 @@ struct wtap {
 
     subtype_read_func           subtype_read;
     subtype_seek_read_func      subtype_seek_read;
+    subtype_read_batch_func     subtype_read_batch;     /**< NULL if records are read one at a time */
     void                        (*subtype_sequential_close)(struct wtap*);
     void                        (*subtype_close)(struct wtap*);
     int                         file_encap;    /* per-file, for those
@@ -70,6 +73,11 @@ struct wtap {
     wtap_new_ipv6_callback_t    add_new_ipv6;
     wtap_new_secrets_callback_t add_new_secrets;
     GPtrArray                   *fast_seek;
+    gchar                       *seek_index_path;   /**< index file to save fast_seek in, or NULL */
+    gboolean                    seek_index_loaded;  /**< TRUE if fast_seek was loaded from an index */
+    gboolean                    seek_index_read_all; /**< TRUE if the file has been read through */
+    int                         batch_err;      /**< error to report from the next wtap_read_batch() */
+    gchar                       *batch_err_info;
 };
 
 struct wtap_dumper;
@@ -312,6 +320,16 @@ gboolean
 wtap_read_packet_bytes(FILE_T fh, Buffer *buf, guint length, int *err,
     gchar **err_info);
 
+/*
+ * Like wtap_read_packet_bytes(), but, if the file has been mapped into
+ * memory (see wtap_use_mmap()), make the Buffer refer to the packet
+ * data in the mapping rather than copying it.  Only use this if the
+ * data won't be modified in place afterwards.
+ */
+gboolean
+wtap_map_packet_bytes(FILE_T fh, Buffer *buf, guint length, int *err,
+    gchar **err_info);
+
 /*
  * Implementation of wth->subtype_read that reads the full file contents
  * as a single packet.
@@ -1203,9 +1203,23 @@ wtap_strerror(int err)
 void
 wtap_sequential_close(wtap *wth)
 {
+#ifdef HAVE_ZLIB
+	gchar *err_info;
+#endif
+
 	if (wth->subtype_sequential_close != NULL)
 		(*wth->subtype_sequential_close)(wth);
 
+#ifdef HAVE_ZLIB
+	/*
+	 * If we read all of the file, we've found all the fast seek
+	 * points, and they can be saved.
+	 */
+	if (wth->seek_index_path != NULL && wth->fh != NULL &&
+	    file_eof(wth->fh) && file_error(wth->fh, &err_info) == 0)
+		wth->seek_index_read_all = TRUE;
+#endif
+
 	if (wth->fh != NULL) {
 		file_close(wth->fh);
 		wth->fh = NULL;
@@ -1241,6 +1255,15 @@ wtap_close(wtap *wth)
 	if (wth->subtype_close != NULL)
 		(*wth->subtype_close)(wth);
 
+#ifdef HAVE_ZLIB
+	if (wth->seek_index_path != NULL) {
+		/* Save the index if we've found all the fast seek points */
+		if (!wth->seek_index_loaded && wth->seek_index_read_all)
+			file_save_seek_index(wth->random_fh, wth->seek_index_path);
+		g_free(wth->seek_index_path);
+	}
+#endif
+
 	if (wth->random_fh != NULL)
 		file_close(wth->random_fh);
 
@@ -1256,6 +1279,7 @@ wtap_close(wtap *wth)
 	wtap_block_array_free(wth->interface_data);
 	wtap_block_array_free(wth->dsbs);
 
+	g_free(wth->batch_err_info);
 	g_free(wth);
 }
 
@@ -1265,6 +1289,57 @@ wtap_cleareof(wtap *wth) {
 	file_clearerr(wth->fh);
 }
 
+void
+wtap_use_mmap(wtap *wth)
+{
+	if (wth->fh != NULL)
+		file_set_mmap(wth->fh);
+	if (wth->random_fh != NULL)
+		file_set_mmap(wth->random_fh);
+}
+
+void
+#ifdef HAVE_ZLIB
+wtap_use_seek_index(wtap *wth, const char *dir)
+#else
+wtap_use_seek_index(wtap *wth _U_, const char *dir _U_)
+#endif
+{
+#ifdef HAVE_ZLIB
+	gchar *default_dir = NULL;
+
+	/*
+	 * Only gzip files need a sequential pass over them before we
+	 * can seek quickly.
+	 */
+	if (wth->random_fh == NULL || wth->fast_seek == NULL ||
+	    wth->seek_index_path != NULL ||
+	    wtap_get_compression_type(wth) != WTAP_GZIP_COMPRESSED)
+		return;
+
+	if (dir == NULL) {
+		default_dir = g_build_filename(g_get_user_cache_dir(),
+		    "wireshark", "seek-index", NULL);
+		dir = default_dir;
+	}
+	wth->seek_index_path = file_seek_index_path(wth->random_fh, dir);
+	g_free(default_dir);
+	if (wth->seek_index_path == NULL)
+		return;
+
+	wth->seek_index_loaded = file_load_seek_index(wth->random_fh,
+	    wth->seek_index_path);
+#endif
+}
+
+gboolean
+wtap_has_seek_index(wtap *wth, gboolean *loaded)
+{
+	if (loaded != NULL)
+		*loaded = wth->seek_index_loaded;
+	return wth->seek_index_path != NULL;
+}
+
 void wtap_set_cb_new_ipv4(wtap *wth, wtap_new_ipv4_callback_t add_new_ipv4) {
 	if (wth)
 		wth->add_new_ipv4 = add_new_ipv4;
@@ -1301,6 +1376,33 @@ wtapng_process_dsb(wtap *wth, wtap_block_t dsb)
 		wth->add_new_secrets(dsb_mand->secrets_type, dsb_mand->secrets_data, dsb_mand->secrets_len);
 }
 
+/*
+ * Fix up a record that a read routine returned.
+ */
+static void
+wtap_fixup_rec(wtap_rec *rec)
+{
+	/*
+	 * Is this a packet record?
+	 */
+	if (rec->rec_type == REC_TYPE_PACKET) {
+		/*
+		 * It makes no sense for the captured data length
+		 * to be bigger than the actual data length.
+		 */
+		if (rec->rec_header.packet_header.caplen > rec->rec_header.packet_header.len)
+			rec->rec_header.packet_header.caplen = rec->rec_header.packet_header.len;
+
+		/*
+		 * Make sure that it's not WTAP_ENCAP_PER_PACKET, as that
+		 * probably means the file has that encapsulation type
+		 * but the read routine didn't set this packet's
+		 * encapsulation type.
+		 */
+		g_assert(rec->rec_header.packet_header.pkt_encap != WTAP_ENCAP_PER_PACKET);
+	}
+}
+
 gboolean
 wtap_read(wtap *wth, wtap_rec *rec, Buffer *buf, int *err,
 	gchar **err_info, gint64 *offset)
@@ -1335,27 +1437,104 @@ wtap_read(wtap *wth, wtap_rec *rec, Buffer *buf, int *err,
 		return FALSE;	/* failure */
 	}
 
+	wtap_fixup_rec(rec);
+
+	return TRUE;	/* success */
+}
+
+gboolean
+wtap_read_batch(wtap *wth, wtap_batch *batch, int *err, gchar **err_info)
+{
+	guint i;
+
+	*err = 0;
+	*err_info = NULL;
+
 	/*
-	 * Is this a packet record?
+	 * Did the last batch end with an error?  If so, report it now
+	 * that the records read before it have been processed.
 	 */
-	if (rec->rec_type == REC_TYPE_PACKET) {
-		/*
-		 * It makes no sense for the captured data length
-		 * to be bigger than the actual data length.
-		 */
-		if (rec->rec_header.packet_header.caplen > rec->rec_header.packet_header.len)
-			rec->rec_header.packet_header.caplen = rec->rec_header.packet_header.len;
+	if (wth->batch_err != 0) {
+		*err = wth->batch_err;
+		*err_info = wth->batch_err_info;
+		wth->batch_err = 0;
+		wth->batch_err_info = NULL;
+		batch->count = 0;
+		return FALSE;
+	}
 
-		/*
-		 * Make sure that it's not WTAP_ENCAP_PER_PACKET, as that
-		 * probably means the file has that encapsulation type
-		 * but the read routine didn't set this packet's
-		 * encapsulation type.
-		 */
-		g_assert(rec->rec_header.packet_header.pkt_encap != WTAP_ENCAP_PER_PACKET);
+	/* See wtap_read() */
+	for (i = 0; i < batch->size; i++) {
+		batch->recs[i].rec_header.packet_header.pkt_encap = wth->file_encap;
+		batch->recs[i].tsprec = wth->file_tsprec;
 	}
 
-	return TRUE;	/* success */
+	if (wth->subtype_read_batch != NULL) {
+		batch->count = wth->subtype_read_batch(wth, batch, err, err_info);
+	} else {
+		for (i = 0; i < batch->size; i++) {
+			if (!wth->subtype_read(wth, &batch->recs[i],
+			    &batch->bufs[i], err, err_info, &batch->offsets[i]))
+				break;
+		}
+		batch->count = i;
+	}
+
+	if (batch->count < batch->size && *err == 0) {
+		/* See wtap_read() */
+		*err = file_error(wth->fh, err_info);
+	}
+
+	for (i = 0; i < batch->count; i++)
+		wtap_fixup_rec(&batch->recs[i]);
+
+	if (batch->count == 0)
+		return FALSE;
+
+	if (*err != 0) {
+		/* Hold on to the error until the next call */
+		wth->batch_err = *err;
+		wth->batch_err_info = *err_info;
+		*err = 0;
+		*err_info = NULL;
+	}
+	return TRUE;
+}
+
+wtap_batch *
+wtap_batch_new(guint size)
+{
+	wtap_batch *batch;
+	guint i;
+
+	batch = g_new(wtap_batch, 1);
+	batch->size = size;
+	batch->count = 0;
+	batch->recs = g_new(wtap_rec, size);
+	batch->bufs = g_new(Buffer, size);
+	batch->offsets = g_new(gint64, size);
+	for (i = 0; i < size; i++) {
+		wtap_rec_init(&batch->recs[i]);
+		ws_buffer_init(&batch->bufs[i], 1514);
+	}
+	return batch;
+}
+
+void
+wtap_batch_free(wtap_batch *batch)
+{
+	guint i;
+
+	if (batch == NULL)
+		return;
+	for (i = 0; i < batch->size; i++) {
+		wtap_rec_cleanup(&batch->recs[i]);
+		ws_buffer_free(&batch->bufs[i]);
+	}
+	g_free(batch->recs);
+	g_free(batch->bufs);
+	g_free(batch->offsets);
+	g_free(batch);
 }
 
 /*
@@ -1437,6 +1616,23 @@ wtap_read_packet_bytes(FILE_T fh, Buffer *buf, guint length, int *err,
 	    err_info);
 }
 
+/*
+ * Read packet data into a Buffer, or, if it's in memory into which the
+ * file has been mapped, make the Buffer refer to it where it is.
+ */
+gboolean
+wtap_map_packet_bytes(FILE_T fh, Buffer *buf, guint length, int *err,
+    gchar **err_info)
+{
+	const guint8 *data;
+
+	data = file_read_mapped(fh, length);
+	if (data == NULL)
+		return wtap_read_packet_bytes(fh, buf, length, err, err_info);
+	ws_buffer_borrow(buf, data, length);
+	return TRUE;
+}
+
 /*
  * Return an approximation of the amount of data we've read sequentially
  * from the file so far.  (gint64, in case that's 64 bits.)
@@ -1624,6 +1820,9 @@ wtap_cleanup(void)
 	wtap_opttypes_cleanup();
 	ws_buffer_cleanup();
 	cleanup_open_routines();
+#ifdef HAVE_ZLIB
+	file_wrappers_cleanup();
+#endif
 #ifdef HAVE_PLUGINS
 	g_slist_free(wtap_plugins);
 	wtap_plugins = NULL;
@@ -1759,6 +1759,58 @@ struct wtap* wtap_open_offline(const char *filename, unsigned int type, int *err
 WS_DLL_PUBLIC
 void wtap_cleareof(wtap *wth);
 
+/**
+ * Read an uncompressed file by mapping it into memory, if that's
+ * possible, rather than with read calls.
+ *
+ * For pcap and pcapng files, the Buffer filled in by wtap_read() or
+ * wtap_seek_read() will then usually refer to the packet data in the
+ * mapping, rather than to a copy of it. That data must not be modified,
+ * and is only valid until the file is closed (or, for data from
+ * wtap_read(), until wtap_sequential_close() is called).
+ *
+ * If the file is truncated while it's mapped, reading it might crash
+ * with SIGBUS, so don't use this for files that might be.
+ *
+ * @param wth The wiretap session.
+ */
+WS_DLL_PUBLIC
+void wtap_use_mmap(wtap *wth);
+
+/**
+ * Keep the fast seek points for a gzip-compressed file in an index
+ * file, so that random access to it is quick as soon as it's opened
+ * again, rather than only after it's been read through once.
+ *
+ * If there's an index for the file in the directory, it's loaded now;
+ * otherwise, if the file is read through with wtap_read(), the index is
+ * saved when the file is closed.  Index files are named after a digest
+ * of the file's size, modification time, and contents, so several files
+ * can share a directory; the least recently used ones are removed when
+ * their total size grows too big.
+ *
+ * This does nothing for files opened without random access, or that
+ * aren't gzip-compressed.
+ *
+ * @param wth The wiretap session.
+ * @param dir The directory for index files, or NULL for a "wireshark"
+ * directory in the user's cache directory.
+ */
+WS_DLL_PUBLIC
+void wtap_use_seek_index(wtap *wth, const char *dir);
+
+/**
+ * See whether wtap_use_seek_index() is keeping an index for a file.
+ *
+ * @param wth The wiretap session.
+ * @param loaded If not NULL, set to TRUE if an index was loaded when
+ * the file was opened, in which case any record can be read quickly with
+ * wtap_seek_read() without reading the file through first.
+ * @return TRUE if an index is being kept.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_has_seek_index(wtap *wth, gboolean *loaded);
+
 /**
  * Set callback functions to add new hostnames. Currently pcapng-only.
  * MUST match add_ipv4_name and add_ipv6_name in addr_resolv.c.
@@ -1818,6 +1870,51 @@ WS_DLL_PUBLIC
 gboolean wtap_seek_read(wtap *wth, gint64 seek_off, wtap_rec *rec,
     Buffer *buf, int *err, gchar **err_info);
 
+/** A reasonable number of records for a batch */
+#define WTAP_BATCH_SIZE 64
+
+/**
+ * A batch of records, read by wtap_read_batch().
+ */
+typedef struct {
+    guint     size;     /**< number of records the batch can hold */
+    guint     count;    /**< number of records read into it */
+    wtap_rec *recs;     /**< the records */
+    Buffer   *bufs;     /**< the records' data */
+    gint64   *offsets;  /**< the records' offsets, for wtap_seek_read() */
+} wtap_batch;
+
+/** Read up to batch->size records, setting batch->count to the number
+ * read.
+ *
+ * For some file types (currently pcap and pcapng), this is considerably
+ * cheaper than reading the records one at a time with wtap_read().
+ * If the file has been mapped (see wtap_use_mmap()), the data of those
+ * records usually stays in the mapping.
+ *
+ * @wth a wtap * returned by a call that opened a file for reading.
+ * @batch a batch created with wtap_batch_new().
+ * @param err a positive "errno" value, or a negative number indicating
+ * the type of error, if the read failed.
+ * @param err_info for some errors, a string giving more details of
+ * the error
+ * @return TRUE if at least one record was read, FALSE at the end of the
+ * file or on failure. If the read fails after some records have been
+ * read, those records are returned, and the failure is reported by the
+ * next call.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_read_batch(wtap *wth, wtap_batch *batch, int *err,
+    gchar **err_info);
+
+/*** create a batch of records for wtap_read_batch() ***/
+WS_DLL_PUBLIC
+wtap_batch *wtap_batch_new(guint size);
+
+/*** free a batch created with wtap_batch_new() ***/
+WS_DLL_PUBLIC
+void wtap_batch_free(wtap_batch *batch);
+
 /*** initialize a wtap_rec structure ***/
 WS_DLL_PUBLIC
 void wtap_rec_init(wtap_rec *rec);
@@ -1831,7 +1928,9 @@ void wtap_rec_cleanup(wtap_rec *rec);
  */
 typedef enum {
     WTAP_UNCOMPRESSED,
-    WTAP_GZIP_COMPRESSED
+    WTAP_GZIP_COMPRESSED,
+    WTAP_ZSTD_COMPRESSED,
+    WTAP_LZ4_COMPRESSED
 } wtap_compression_type;
 
 WS_DLL_PUBLIC
@@ -1840,6 +1939,13 @@ WS_DLL_PUBLIC
 const char *wtap_compression_type_description(wtap_compression_type compression_type);
 WS_DLL_PUBLIC
 const char *wtap_compression_type_extension(wtap_compression_type compression_type);
+/**
+ * Look up a compression type by name ("gzip", "zstd" or "lz4"), ignoring
+ * case.  Returns FALSE if there's no such type, or this build can't
+ * write it.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_name_to_compression_type(const char *name, wtap_compression_type *compression_type);
 WS_DLL_PUBLIC
 GSList *wtap_get_all_compression_type_extensions_list(void);
 
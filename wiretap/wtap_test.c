@@ -0,0 +1,223 @@
+/* wtap_test.c
+ * Standalone program to test reading records a batch at a time with
+ * wtap_read_batch().
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <wsutil/file_util.h>
+#include <wsutil/pint.h>
+
+#include "wtap.h"
+
+#define PACKET_LEN  60
+
+static void
+write_all(int fd, const void *buf, gsize len)
+{
+    gssize written;
+
+    written = ws_write(fd, buf, (unsigned int)len);
+    g_assert_cmpint(written, ==, (gssize)len);
+}
+
+/* Write a little-endian microsecond pcap file with num_packets Ethernet
+ * packets, packet i being PACKET_LEN bytes of i, followed by a record
+ * header and only half of the packet data if truncated is TRUE.
+ * Returns the name of the file, to be g_free()d. */
+static char *
+write_pcap(guint num_packets, gboolean truncated)
+{
+    GError *error = NULL;
+    char *name;
+    int fd;
+    guint8 hdr[24], rec_hdr[16], data[PACKET_LEN];
+    guint i, count;
+
+    fd = g_file_open_tmp("wtap_test_XXXXXX.pcap", &name, &error);
+    g_assert_no_error(error);
+
+    phtole32(&hdr[0], 0xa1b2c3d4);          /* magic */
+    phtole16(&hdr[4], 2);                   /* version_major */
+    phtole16(&hdr[6], 4);                   /* version_minor */
+    phtole32(&hdr[8], 0);                   /* thiszone */
+    phtole32(&hdr[12], 0);                  /* sigfigs */
+    phtole32(&hdr[16], 65535);              /* snaplen */
+    phtole32(&hdr[20], 1);                  /* network: Ethernet */
+    write_all(fd, hdr, sizeof hdr);
+
+    count = truncated ? num_packets + 1 : num_packets;
+    for (i = 0; i < count; i++) {
+        phtole32(&rec_hdr[0], 1000 + i);    /* ts_sec */
+        phtole32(&rec_hdr[4], i);           /* ts_usec */
+        phtole32(&rec_hdr[8], PACKET_LEN);  /* incl_len */
+        phtole32(&rec_hdr[12], PACKET_LEN); /* orig_len */
+        write_all(fd, rec_hdr, sizeof rec_hdr);
+        memset(data, (int)i, sizeof data);
+        write_all(fd, data, i < num_packets ? sizeof data : sizeof data / 2);
+    }
+    ws_close(fd);
+    return name;
+}
+
+static wtap *
+open_pcap(const char *name, gboolean use_mmap)
+{
+    wtap *wth;
+    int err;
+    gchar *err_info = NULL;
+
+    wth = wtap_open_offline(name, WTAP_TYPE_AUTO, &err, &err_info, TRUE);
+    g_assert(wth != NULL);
+    if (use_mmap)
+        wtap_use_mmap(wth);
+    return wth;
+}
+
+/* Check that the records in batch are the next ones in the file */
+static void
+check_batch(wtap *wth, wtap_batch *batch, guint first)
+{
+    wtap_rec rec;
+    Buffer buf;
+    int err;
+    gchar *err_info;
+    guint i;
+    const guint8 *data;
+    guint j;
+
+    wtap_rec_init(&rec);
+    ws_buffer_init(&buf, 1514);
+    for (i = 0; i < batch->count; i++) {
+        g_assert_cmpuint(batch->recs[i].rec_type, ==, REC_TYPE_PACKET);
+        g_assert_cmpint(batch->recs[i].ts.secs, ==, 1000 + first + i);
+        g_assert_cmpint(batch->recs[i].ts.nsecs, ==, (first + i) * 1000);
+        g_assert_cmpuint(batch->recs[i].rec_header.packet_header.caplen, ==, PACKET_LEN);
+        data = ws_buffer_start_ptr(&batch->bufs[i]);
+        for (j = 0; j < PACKET_LEN; j++)
+            g_assert_cmpuint(data[j], ==, (guint8)(first + i));
+
+        /* The offset has to get the same record back */
+        g_assert(wtap_seek_read(wth, batch->offsets[i], &rec, &buf, &err, &err_info));
+        g_assert_cmpint(rec.ts.secs, ==, 1000 + first + i);
+        g_assert(memcmp(ws_buffer_start_ptr(&buf), data, PACKET_LEN) == 0);
+    }
+    ws_buffer_free(&buf);
+    wtap_rec_cleanup(&rec);
+}
+
+static void
+wtap_test_read_batch(gconstpointer use_mmap)
+{
+    char *name;
+    wtap *wth;
+    wtap_batch *batch;
+    int err;
+    gchar *err_info;
+
+    name = write_pcap(5, FALSE);
+    wth = open_pcap(name, GPOINTER_TO_INT(use_mmap));
+    batch = wtap_batch_new(2);
+
+    g_assert(wtap_read_batch(wth, batch, &err, &err_info));
+    g_assert_cmpint(err, ==, 0);
+    g_assert_cmpuint(batch->count, ==, 2);
+    check_batch(wth, batch, 0);
+
+    g_assert(wtap_read_batch(wth, batch, &err, &err_info));
+    g_assert_cmpint(err, ==, 0);
+    g_assert_cmpuint(batch->count, ==, 2);
+    check_batch(wth, batch, 2);
+
+    g_assert(wtap_read_batch(wth, batch, &err, &err_info));
+    g_assert_cmpint(err, ==, 0);
+    g_assert_cmpuint(batch->count, ==, 1);
+    check_batch(wth, batch, 4);
+
+    /* The end of the file isn't an error */
+    g_assert(!wtap_read_batch(wth, batch, &err, &err_info));
+    g_assert_cmpint(err, ==, 0);
+    g_assert_cmpuint(batch->count, ==, 0);
+
+    wtap_batch_free(batch);
+    wtap_close(wth);
+    g_unlink(name);
+    g_free(name);
+}
+
+static void
+wtap_test_read_batch_error(gconstpointer use_mmap)
+{
+    char *name;
+    wtap *wth;
+    wtap_batch *batch;
+    int err;
+    gchar *err_info;
+
+    name = write_pcap(3, TRUE);
+    wth = open_pcap(name, GPOINTER_TO_INT(use_mmap));
+    batch = wtap_batch_new(8);
+
+    /* The records before the truncated one come back without an error... */
+    g_assert(wtap_read_batch(wth, batch, &err, &err_info));
+    g_assert_cmpint(err, ==, 0);
+    g_assert(err_info == NULL);
+    g_assert_cmpuint(batch->count, ==, 3);
+    check_batch(wth, batch, 0);
+
+    /* ...and the error is reported by the next call, with no records */
+    g_assert(!wtap_read_batch(wth, batch, &err, &err_info));
+    g_assert_cmpint(err, ==, WTAP_ERR_SHORT_READ);
+    g_assert_cmpuint(batch->count, ==, 0);
+    g_free(err_info);
+
+    wtap_batch_free(batch);
+    wtap_close(wth);
+    g_unlink(name);
+    g_free(name);
+}
+
+int
+main(int argc, char **argv)
+{
+    int ret;
+
+    wtap_init(FALSE);
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_data_func("/wtap/read_batch",            GINT_TO_POINTER(FALSE), wtap_test_read_batch);
+    g_test_add_data_func("/wtap/read_batch/mmap",       GINT_TO_POINTER(TRUE),  wtap_test_read_batch);
+    g_test_add_data_func("/wtap/read_batch/error",      GINT_TO_POINTER(FALSE), wtap_test_read_batch_error);
+    g_test_add_data_func("/wtap/read_batch/error/mmap", GINT_TO_POINTER(TRUE),  wtap_test_read_batch_error);
+
+    ret = g_test_run();
+
+    wtap_cleanup();
+
+    return ret;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -37,6 +37,28 @@ ws_buffer_init(Buffer* buffer, gsize space)
 	}
 	buffer->start = 0;
 	buffer->first_free = 0;
+	buffer->own_data = NULL;
+	buffer->own_allocated = 0;
+}
+
+/* Makes a buffer that borrowed its contents with ws_buffer_borrow() use
+	its own memory again, copying the contents into it. */
+static void
+ws_buffer_unborrow(Buffer* buffer)
+{
+	gsize space_used = buffer->first_free - buffer->start;
+
+	if (space_used > buffer->own_allocated) {
+		buffer->own_allocated = space_used + 1024;
+		buffer->own_data = (guint8*)g_realloc(buffer->own_data, buffer->own_allocated);
+	}
+	memcpy(buffer->own_data, buffer->data + buffer->start, space_used);
+	buffer->data = buffer->own_data;
+	buffer->allocated = buffer->own_allocated;
+	buffer->start = 0;
+	buffer->first_free = space_used;
+	buffer->own_data = NULL;
+	buffer->own_allocated = 0;
 }
 
 /* Frees the memory used by a buffer */
@@ -44,6 +66,12 @@ void
 ws_buffer_free(Buffer* buffer)
 {
 	g_assert(buffer);
+	if (buffer->own_data) {
+		buffer->data = buffer->own_data;
+		buffer->allocated = buffer->own_allocated;
+		buffer->own_data = NULL;
+		buffer->own_allocated = 0;
+	}
 	if (buffer->allocated == SMALL_BUFFER_SIZE) {
 		g_assert(buffer->data);
 		g_ptr_array_add(small_buffers, buffer->data);
@@ -66,6 +94,12 @@ ws_buffer_assure_space(Buffer* buffer, gsize space)
 	gsize space_used;
 	gboolean space_at_beginning;
 
+	/* We can't write to memory we've only borrowed */
+	if (buffer->own_data) {
+		ws_buffer_unborrow(buffer);
+		available_at_end = buffer->allocated - buffer->first_free;
+	}
+
 	/* If we've got the space already, good! */
 	if (space <= available_at_end) {
 		return;
@@ -124,6 +158,24 @@ ws_buffer_remove_start(Buffer* buffer, gsize bytes)
 	}
 }
 
+/* Makes the contents of a buffer the 'bytes' bytes at 'from', without
+	copying them; the buffer's own memory is set aside until it's
+	written to or freed. The caller must make sure that the memory at
+	'from' stays valid for as long as the buffer refers to it, and nobody
+	may write to it through the buffer. */
+void
+ws_buffer_borrow(Buffer* buffer, const guint8 *from, gsize bytes)
+{
+	g_assert(buffer);
+	if (!buffer->own_data) {
+		buffer->own_data = buffer->data;
+		buffer->own_allocated = buffer->allocated;
+	}
+	buffer->data = (guint8*)from;
+	buffer->allocated = bytes;
+	buffer->start = 0;
+	buffer->first_free = bytes;
+}
 
 #ifndef SOME_FUNCTIONS_ARE_DEFINES
 void
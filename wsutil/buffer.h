@@ -23,6 +23,8 @@ typedef struct Buffer {
 	gsize	allocated;
 	gsize	start;
 	gsize	first_free;
+	guint8	*own_data;	/* if data was borrowed, our own allocation */
+	gsize	own_allocated;
 } Buffer;
 
 WS_DLL_PUBLIC
@@ -36,6 +38,8 @@ void ws_buffer_append(Buffer* buffer, guint8 *from, gsize bytes);
 WS_DLL_PUBLIC
 void ws_buffer_remove_start(Buffer* buffer, gsize bytes);
 WS_DLL_PUBLIC
+void ws_buffer_borrow(Buffer* buffer, const guint8 *from, gsize bytes);
+WS_DLL_PUBLIC
 void ws_buffer_cleanup(void);
 
 #ifdef SOME_FUNCTIONS_ARE_DEFINES
@@ -0,0 +1,170 @@
+/* buffer_test.c
+ * Standalone program to test Buffers that borrow their contents with
+ * ws_buffer_borrow().
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "buffer.h"
+
+static const guint8 borrowed_data[] = "borrowed contents";
+#define BORROWED_LEN (sizeof borrowed_data - 1)
+
+static void
+buffer_test_borrow(void)
+{
+    Buffer buf;
+
+    ws_buffer_init(&buf, 16);
+    ws_buffer_append(&buf, (guint8 *)"own", 3);
+
+    ws_buffer_borrow(&buf, borrowed_data, BORROWED_LEN);
+    g_assert(ws_buffer_start_ptr(&buf) == borrowed_data);
+    g_assert_cmpuint(ws_buffer_length(&buf), ==, BORROWED_LEN);
+
+    /* Removing from the start doesn't write, so it stays borrowed */
+    ws_buffer_remove_start(&buf, 9);
+    g_assert(ws_buffer_start_ptr(&buf) == borrowed_data + 9);
+    g_assert_cmpuint(ws_buffer_length(&buf), ==, BORROWED_LEN - 9);
+
+    ws_buffer_free(&buf);
+}
+
+static void
+buffer_test_borrow_unborrow_on_write(void)
+{
+    Buffer buf;
+
+    ws_buffer_init(&buf, 16);
+    ws_buffer_append(&buf, (guint8 *)"own", 3);
+    ws_buffer_borrow(&buf, borrowed_data, BORROWED_LEN);
+
+    /* Writing copies the contents into our own memory first */
+    ws_buffer_append(&buf, (guint8 *)"!", 1);
+    g_assert(ws_buffer_start_ptr(&buf) != borrowed_data);
+    g_assert_cmpuint(ws_buffer_length(&buf), ==, BORROWED_LEN + 1);
+    g_assert(memcmp(ws_buffer_start_ptr(&buf), "borrowed contents!", BORROWED_LEN + 1) == 0);
+    g_assert_cmpstr((const char *)borrowed_data, ==, "borrowed contents");
+
+    /* ...and it's an ordinary buffer again after that */
+    ws_buffer_clean(&buf);
+    ws_buffer_append(&buf, (guint8 *)"own", 3);
+    g_assert(memcmp(ws_buffer_start_ptr(&buf), "own", 3) == 0);
+
+    ws_buffer_free(&buf);
+}
+
+static void
+buffer_test_borrow_more_than_own(void)
+{
+    Buffer buf;
+    guint8 *big;
+    gsize big_len = 64 * 1024;
+    gsize i;
+
+    big = (guint8 *)g_malloc(big_len);
+    for (i = 0; i < big_len; i++)
+        big[i] = (guint8)i;
+
+    /* Our own memory is too small for what's borrowed, so making room
+     * to write has to grow it */
+    ws_buffer_init(&buf, 16);
+    ws_buffer_borrow(&buf, big, big_len);
+    ws_buffer_assure_space(&buf, 1);
+    g_assert(ws_buffer_start_ptr(&buf) != big);
+    g_assert_cmpuint(ws_buffer_length(&buf), ==, big_len);
+    g_assert(memcmp(ws_buffer_start_ptr(&buf), big, big_len) == 0);
+
+    ws_buffer_free(&buf);
+    g_free(big);
+}
+
+static void
+buffer_test_borrow_twice(void)
+{
+    Buffer buf;
+    static const guint8 other_data[] = "other";
+
+    ws_buffer_init(&buf, 16);
+    ws_buffer_append(&buf, (guint8 *)"own", 3);
+    ws_buffer_borrow(&buf, borrowed_data, BORROWED_LEN);
+
+    /* Borrowing again has to hold on to our own memory, not to what
+     * we borrowed the first time */
+    ws_buffer_borrow(&buf, other_data, 5);
+    g_assert(ws_buffer_start_ptr(&buf) == other_data);
+    ws_buffer_append(&buf, (guint8 *)"!", 1);
+    g_assert(memcmp(ws_buffer_start_ptr(&buf), "other!", 6) == 0);
+    g_assert_cmpstr((const char *)borrowed_data, ==, "borrowed contents");
+
+    ws_buffer_free(&buf);
+}
+
+static void
+buffer_test_free_while_borrowed(void)
+{
+    Buffer buf;
+    guint8 *data;
+
+    /* Freeing a buffer that's borrowing has to free its own memory, and
+     * leave what it borrowed alone; freeing the borrowed memory
+     * afterwards would then fail. */
+    data = (guint8 *)g_memdup(borrowed_data, BORROWED_LEN);
+    ws_buffer_init(&buf, 16);
+    ws_buffer_borrow(&buf, data, BORROWED_LEN);
+    ws_buffer_free(&buf);
+    g_assert(buf.data == NULL);
+    g_assert(buf.own_data == NULL);
+    g_assert(memcmp(data, borrowed_data, BORROWED_LEN) == 0);
+    g_free(data);
+
+    /* Same for a buffer that was never written to before borrowing */
+    data = (guint8 *)g_memdup(borrowed_data, BORROWED_LEN);
+    ws_buffer_init(&buf, 64 * 1024);
+    ws_buffer_borrow(&buf, data, BORROWED_LEN);
+    ws_buffer_free(&buf);
+    g_free(data);
+}
+
+int
+main(int argc, char **argv)
+{
+    int ret;
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/buffer/borrow",                   buffer_test_borrow);
+    g_test_add_func("/buffer/borrow/unborrow_on_write", buffer_test_borrow_unborrow_on_write);
+    g_test_add_func("/buffer/borrow/more_than_own",     buffer_test_borrow_more_than_own);
+    g_test_add_func("/buffer/borrow/twice",             buffer_test_borrow_twice);
+    g_test_add_func("/buffer/borrow/free",              buffer_test_free_while_borrowed);
+
+    ret = g_test_run();
+
+    ws_buffer_cleanup();
+
+    return ret;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -21,6 +21,7 @@
 
 #include <glib.h>
 #include <wsutil/crc16.h>
+#include "crc_int.h"
 
 
 /*****************************************************************/
@@ -388,25 +389,25 @@ static guint16 crc16_unreflected(const guint8 *buf, guint len,
     return (guint16)crc16;
 }
 
+/* The reflected CRCs are computed eight bytes at a time, see crc_engine.c. */
+static crc_reflected_engine crc16_ccitt_engine =
+    CRC_REFLECTED_ENGINE_INIT(crc16_ccitt_table_reverse, 16);
+static crc_reflected_engine crc16_usb_engine =
+    CRC_REFLECTED_ENGINE_INIT(crc16_usb_table, 16);
+static crc_reflected_engine crc16_9949_engine =
+    CRC_REFLECTED_ENGINE_INIT(crc16_precompiled_9949_reverse, 16);
+static crc_reflected_engine crc16_3D65_engine =
+    CRC_REFLECTED_ENGINE_INIT(crc16_precompiled_3D65_reverse, 16);
+
 static guint16 crc16_reflected(const guint8 *buf, guint len,
-                                guint16 crc_in, const guint table[])
+                                guint16 crc_in, crc_reflected_engine *engine)
 {
-    /* we use guints, rather than guint16s, as they are likely to be
-       faster. We just ignore the top 16 bits and let them do what they want.
-       XXX - does any time saved not zero-extending guint16's to 32 bits
-       into a register outweigh any increased cache footprint from the
-       larger CRC table? */
-    guint crc16 = (guint)crc_in;
-
-    while( len-- != 0 )
-       crc16 = table[(crc16 ^ *buf++) & 0xff] ^ (crc16 >> 8);
-
-    return (guint16)crc16;
+    return (guint16)crc_reflected_update(engine, crc_in, buf, len);
 }
 
 guint16 crc16_ccitt(const guint8 *buf, guint len)
 {
-    return crc16_reflected(buf,len,crc16_ccitt_start,crc16_ccitt_table_reverse)
+    return crc16_reflected(buf,len,crc16_ccitt_start,&crc16_ccitt_engine)
        ^ crc16_ccitt_xorout;
 }
 
@@ -417,7 +418,7 @@ guint16 crc16_x25_ccitt_seed(const guint8 *buf, guint len, guint16 seed)
 
 guint16 crc16_ccitt_seed(const guint8 *buf, guint len, guint16 seed)
 {
-    return crc16_reflected(buf,len,seed,crc16_ccitt_table_reverse)
+    return crc16_reflected(buf,len,seed,&crc16_ccitt_engine)
        ^ crc16_ccitt_xorout;
 }
 
@@ -426,12 +427,12 @@ guint16 crc16_ccitt_seed(const guint8 *buf, guint len, guint16 seed)
    value is not XORed with anything. */
 guint16 crc16_iso14443a(const guint8 *buf, guint len)
 {
-    return crc16_reflected(buf,len, 0x6363 ,crc16_ccitt_table_reverse);
+    return crc16_reflected(buf,len, 0x6363 ,&crc16_ccitt_engine);
 }
 
 guint16 crc16_usb(const guint8 *buf, guint len)
 {
-    return crc16_reflected(buf, len, crc16_usb_start, crc16_usb_table)
+    return crc16_reflected(buf, len, crc16_usb_start, &crc16_usb_engine)
         ^ crc16_usb_xorout;
 }
 
@@ -447,12 +448,12 @@ guint16 crc16_0x755B(const guint8 *buf, guint32 len, guint16 seed)
 
 guint16 crc16_0x9949_seed(const guint8 *buf, guint len, guint16 seed)
 {
-    return crc16_reflected(buf, len, seed, crc16_precompiled_9949_reverse);
+    return crc16_reflected(buf, len, seed, &crc16_9949_engine);
 }
 
 guint16 crc16_0x3D65_seed(const guint8 *buf, guint len, guint16 seed)
 {
-    return crc16_reflected(buf, len, seed, crc16_precompiled_3D65_reverse);
+    return crc16_reflected(buf, len, seed, &crc16_3D65_engine);
 }
 
 guint16 crc16_0x080F_seed(const guint8 *buf, guint len, guint16 seed)
@@ -17,8 +17,7 @@
 
 #include <glib.h>
 #include <wsutil/crc32.h>
-
-#define CRC32_ACCUMULATE(c,d,table) (c=(c>>8)^(table)[(c^(d))&0xFF])
+#include "crc_int.h"
 
 /*****************************************************************/
 /*                                                               */
@@ -39,8 +38,6 @@
 /* in the FTP archive "ftp.adelaide.edu.au/pub/rocksoft".        */
 /*                                                               */
 /*****************************************************************/
-#define CRC32C(c,d) CRC32_ACCUMULATE(c,d,crc32c_table)
-
 static const guint32 crc32c_table[256] = {
 		0x00000000U, 0xF26B8303U, 0xE13B70F7U, 0x1350F3F4U, 0xC79A971FU,
 		0x35F1141CU, 0x26A1E7E8U, 0xD4CA64EBU, 0x8AD958CFU, 0x78B2DBCCU,
@@ -353,6 +350,36 @@ static const guint32 crc32_5D6DCB[] =
 		0x0098206c, 0x00c54da7, 0x0022fbfa, 0x007f9631
 };
 
+/*
+ * The reflected CRCs are computed eight bytes at a time from tables
+ * derived from the ones above, and long buffers are folded with
+ * PCLMULQDQ where the CPU has it; see crc_engine.c.
+ */
+static crc_reflected_engine crc32c_engine =
+	CRC_REFLECTED_ENGINE_INIT(crc32c_table, 32);
+static crc_reflected_engine crc32_ccitt_engine =
+	CRC_REFLECTED_ENGINE_INIT(crc32_ccitt_table, 32);
+static crc_reflected_engine crc32_0AA725CF_engine =
+	CRC_REFLECTED_ENGINE_INIT(crc32_0AA725CF_reverse, 32);
+
+static guint32
+crc32c_update(guint32 crc, const guint8 *buf, size_t len)
+{
+#ifdef HAVE_SSE4_2
+	/*
+	 * The crc32 instruction beats the tables everywhere, but folding
+	 * beats the crc32 instruction on anything but short buffers.
+	 */
+	if (crc_have_sse42()) {
+#ifdef HAVE_PCLMULQDQ
+		if (len < 64 || !crc_have_pclmulqdq())
+#endif
+			return crc32c_sse42_update(crc, buf, len);
+	}
+#endif
+	return crc_reflected_update(&crc32c_engine, crc, buf, len);
+}
+
 guint32
 crc32c_table_lookup (guchar pos)
 {
@@ -368,23 +395,19 @@ crc32_ccitt_table_lookup (guchar pos)
 guint32
 crc32c_calculate(const void *buf, int len, guint32 crc)
 {
-	const guint8 *p = (const guint8 *)buf;
+	if (len <= 0)
+		return crc;
 	crc = CRC32C_SWAP(crc);
-	while (len-- > 0) {
-		CRC32C(crc, *p++);
-	}
+	crc = crc32c_update(crc, (const guint8 *)buf, len);
 	return CRC32C_SWAP(crc);
 }
 
 guint32
 crc32c_calculate_no_swap(const void *buf, int len, guint32 crc)
 {
-	const guint8 *p = (const guint8 *)buf;
-	while (len-- > 0) {
-		CRC32C(crc, *p++);
-	}
-
-	return crc;
+	if (len <= 0)
+		return crc;
+	return crc32c_update(crc, (const guint8 *)buf, len);
 }
 
 guint32
@@ -396,11 +419,9 @@ crc32_ccitt(const guint8 *buf, guint len)
 guint32
 crc32_ccitt_seed(const guint8 *buf, guint len, guint32 seed)
 {
-	guint i;
-	guint32 crc32 = seed;
+	guint32 crc32;
 
-	for (i = 0; i < len; i++)
-		CRC32_ACCUMULATE(crc32, buf[i], crc32_ccitt_table);
+	crc32 = crc_reflected_update(&crc32_ccitt_engine, seed, buf, len);
 
 	return ( ~crc32 );
 }
@@ -422,13 +443,7 @@ crc32_mpeg2_seed(const guint8 *buf, guint len, guint32 seed)
 guint32
 crc32_0x0AA725CF_seed(const guint8 *buf, guint len, guint32 seed)
 {
-	guint crc32;
-
-	crc32 = (guint)seed;
-	while( len-- != 0 )
-		CRC32_ACCUMULATE(crc32, *buf++, crc32_0AA725CF_reverse);
-
-	return (guint32)crc32;
+	return crc_reflected_update(&crc32_0AA725CF_engine, seed, buf, len);
 }
 
 guint32
@@ -0,0 +1,123 @@
+/* crc32_x86.c
+ * CRC-32 routines using the SSE 4.2 crc32 and the PCLMULQDQ instructions
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * The folding follows Intel's "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" white paper; the final
+ * reduction is left to the table-driven code.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <nmmintrin.h>
+#ifdef HAVE_PCLMULQDQ
+#include <wmmintrin.h>
+#endif
+
+#include "crc_int.h"
+
+guint32
+crc32c_sse42_update(guint32 crc, const guint8 *buf, size_t len)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+	guint64 crc64 = crc;
+
+	while (len >= 8) {
+		guint64 v;
+
+		memcpy(&v, buf, sizeof v);
+		crc64 = _mm_crc32_u64(crc64, v);
+		buf += 8;
+		len -= 8;
+	}
+	crc = (guint32)crc64;
+#endif
+	while (len >= 4) {
+		guint32 v;
+
+		memcpy(&v, buf, sizeof v);
+		crc = _mm_crc32_u32(crc, v);
+		buf += 4;
+		len -= 4;
+	}
+	while (len-- != 0)
+		crc = _mm_crc32_u8(crc, *buf++);
+
+	return crc;
+}
+
+#ifdef HAVE_PCLMULQDQ
+static inline __m128i
+crc_fold(__m128i x, __m128i k, __m128i next)
+{
+	return _mm_xor_si128(next,
+	    _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+	        _mm_clmulepi64_si128(x, k, 0x11)));
+}
+
+#define LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define FOLD_CONSTANTS(f) _mm_set_epi64x((long long)(f)[1], (long long)(f)[0])
+
+size_t
+crc32_pclmul_fold(const guint64 fold[4][2], guint32 crc, const guint8 *buf,
+    size_t len, guint8 remainder[16])
+{
+	const guint8 *p = buf;
+	__m128i x0, x1, x2, x3, k;
+
+	/* The CRC register is simply XORed into the first four bytes. */
+	x0 = _mm_xor_si128(LOAD(p), _mm_cvtsi32_si128((int)crc));
+	x1 = LOAD(p + 16);
+	x2 = LOAD(p + 32);
+	x3 = LOAD(p + 48);
+	p += 64;
+	len -= 64;
+
+	/* Four independent 128 bit lanes, each folded 512 bits forward. */
+	k = FOLD_CONSTANTS(fold[0]);
+	while (len >= 64) {
+		x0 = crc_fold(x0, k, LOAD(p));
+		x1 = crc_fold(x1, k, LOAD(p + 16));
+		x2 = crc_fold(x2, k, LOAD(p + 32));
+		x3 = crc_fold(x3, k, LOAD(p + 48));
+		p += 64;
+		len -= 64;
+	}
+
+	/* Fold the lanes into one. */
+	x3 = crc_fold(x0, FOLD_CONSTANTS(fold[1]), x3);
+	x3 = crc_fold(x1, FOLD_CONSTANTS(fold[2]), x3);
+	x3 = crc_fold(x2, FOLD_CONSTANTS(fold[3]), x3);
+
+	k = FOLD_CONSTANTS(fold[3]);
+	while (len >= 16) {
+		x3 = crc_fold(x3, k, LOAD(p));
+		p += 16;
+		len -= 16;
+	}
+
+	_mm_storeu_si128((__m128i *)remainder, x3);
+	return p - buf;
+}
+#endif /* HAVE_PCLMULQDQ */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
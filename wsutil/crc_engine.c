@@ -0,0 +1,164 @@
+/* crc_engine.c
+ * Slice-by-8 and hardware-assisted computation of reflected CRCs
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#ifdef HAVE_SSE4_2
+#include "ws_cpuid.h"
+#endif
+#include "crc_int.h"
+
+#ifdef HAVE_SSE4_2
+gboolean
+crc_have_sse42(void)
+{
+	static int have_sse42 = -1;
+
+	if (have_sse42 == -1)
+		have_sse42 = ws_cpuid_sse42() ? 1 : 0;
+	return have_sse42;
+}
+#endif
+
+#ifdef HAVE_PCLMULQDQ
+gboolean
+crc_have_pclmulqdq(void)
+{
+	static int have_pclmulqdq = -1;
+
+	if (have_pclmulqdq == -1)
+		have_pclmulqdq = (ws_cpuid_sse42() && ws_cpuid_pclmulqdq()) ? 1 : 0;
+	return have_pclmulqdq;
+}
+#endif
+
+static guint32
+reverse32(guint32 v)
+{
+	guint32 r = 0;
+	int i;
+
+	for (i = 0; i < 32; i++) {
+		r = (r << 1) | (v & 1);
+		v >>= 1;
+	}
+	return r;
+}
+
+/* x^n modulo the (unreflected) polynomial poly, whose x^32 term is implicit. */
+static guint32
+x_pow_mod(guint n, guint32 poly)
+{
+	guint32 r = 1;
+
+	while (n-- != 0)
+		r = (r & 0x80000000) ? (r << 1) ^ poly : r << 1;
+	return r;
+}
+
+/*
+ * Folding a 128 bit block B = H*x^64 + L forward by d bits replaces it
+ * with H*(x^(d+64) mod P) + L*(x^d mod P), which has the same remainder.
+ * In the reflected bit order PCLMULQDQ leaves its product one bit short,
+ * so the constants are x^(d+63) and x^(d-1), bit reversed into the top
+ * half of a 64 bit lane.  fold[0..3] are for d = 512, 384, 256 and 128.
+ */
+static void
+crc_fold_constants_init(guint64 fold[4][2], guint32 poly)
+{
+	static const guint distance[4] = { 512, 384, 256, 128 };
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		fold[i][0] = (guint64)reverse32(x_pow_mod(distance[i] + 63, poly)) << 32;
+		fold[i][1] = (guint64)reverse32(x_pow_mod(distance[i] - 1, poly)) << 32;
+	}
+}
+
+static void
+crc_reflected_init(crc_reflected_engine *engine)
+{
+	if (g_once_init_enter(&engine->initialized)) {
+		guint b, k;
+
+		for (b = 0; b < 256; b++)
+			engine->slice[0][b] = engine->table[b];
+		for (k = 1; k < 8; k++) {
+			for (b = 0; b < 256; b++) {
+				guint32 v = engine->slice[k - 1][b];
+
+				engine->slice[k][b] = (v >> 8) ^ engine->table[v & 0xff];
+			}
+		}
+
+		/* For a reflected table, entry 0x80 is the reflected polynomial. */
+		if (engine->width == 32)
+			crc_fold_constants_init(engine->fold, reverse32(engine->table[0x80]));
+
+		g_once_init_leave(&engine->initialized, 1);
+	}
+}
+
+static guint32
+crc_slice8(const guint32 slice[8][256], guint32 crc, const guint8 *buf, size_t len)
+{
+	while (len >= 8) {
+		guint32 lo = crc ^ ((guint32)buf[0] | (guint32)buf[1] << 8 |
+		    (guint32)buf[2] << 16 | (guint32)buf[3] << 24);
+		guint32 hi = (guint32)buf[4] | (guint32)buf[5] << 8 |
+		    (guint32)buf[6] << 16 | (guint32)buf[7] << 24;
+
+		crc = slice[7][lo & 0xff] ^ slice[6][(lo >> 8) & 0xff] ^
+		    slice[5][(lo >> 16) & 0xff] ^ slice[4][lo >> 24] ^
+		    slice[3][hi & 0xff] ^ slice[2][(hi >> 8) & 0xff] ^
+		    slice[1][(hi >> 16) & 0xff] ^ slice[0][hi >> 24];
+		buf += 8;
+		len -= 8;
+	}
+
+	while (len-- != 0)
+		crc = (crc >> 8) ^ slice[0][(crc ^ *buf++) & 0xff];
+
+	return crc;
+}
+
+guint32
+crc_reflected_update(crc_reflected_engine *engine, guint32 crc, const guint8 *buf, size_t len)
+{
+	crc_reflected_init(engine);
+
+#ifdef HAVE_PCLMULQDQ
+	if (engine->width == 32 && len >= 64 && crc_have_pclmulqdq()) {
+		guint8 remainder[16];
+		size_t done;
+
+		done = crc32_pclmul_fold(engine->fold, crc, buf, len, remainder);
+		crc = crc_slice8(engine->slice, 0, remainder, sizeof remainder);
+		buf += done;
+		len -= done;
+	}
+#endif
+
+	return crc_slice8(engine->slice, crc, buf, len);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
@@ -0,0 +1,57 @@
+/* crc_int.h
+ * Internal definitions for the table-driven CRC routines
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __CRC_INT_H__
+#define __CRC_INT_H__
+
+#include <glib.h>
+
+/*
+ * A reflected (bits shift right) CRC of up to 32 bits, given by its
+ * byte-at-a-time lookup table.  The slice-by-8 tables and, for 32-bit
+ * CRCs, the carry-less multiplication folding constants are derived
+ * from that table the first time the CRC is computed.
+ */
+typedef struct {
+	const guint32 *table;	/* byte-at-a-time table */
+	guint width;		/* width of the CRC, in bits */
+	gsize initialized;
+	guint32 slice[8][256];	/* slice[0] is a copy of table */
+	guint64 fold[4][2];	/* folding constants, see crc_engine.c */
+} crc_reflected_engine;
+
+#define CRC_REFLECTED_ENGINE_INIT(table, width) { (table), (width), 0, { { 0 } }, { { 0 } } }
+
+/*
+ * Run the CRC over len bytes of buf, starting with (and returning) the
+ * CRC register value; no preset or final XOR is applied.
+ */
+guint32 crc_reflected_update(crc_reflected_engine *engine, guint32 crc, const guint8 *buf, size_t len);
+
+#ifdef HAVE_SSE4_2
+/* TRUE if the CPU has the SSE 4.2 crc32 instruction. */
+gboolean crc_have_sse42(void);
+
+guint32 crc32c_sse42_update(guint32 crc, const guint8 *buf, size_t len);
+#endif
+
+#ifdef HAVE_PCLMULQDQ
+/* TRUE if the CPU has the PCLMULQDQ instruction. */
+gboolean crc_have_pclmulqdq(void);
+
+/*
+ * Fold buf, which must be at least 64 bytes long, into a 16 byte
+ * remainder with the same CRC, using PCLMULQDQ.  Returns the number of
+ * bytes of buf consumed; the rest must be run through the table.
+ */
+size_t crc32_pclmul_fold(const guint64 fold[4][2], guint32 crc, const guint8 *buf, size_t len, guint8 remainder[16]);
+#endif
+
+#endif /* __CRC_INT_H__ */
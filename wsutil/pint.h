@@ -176,6 +176,11 @@ static inline void phton64(guint8 *p, guint64 v) {
     p[7] = (guint8)(v >> 0);
 }
 
+static inline void phtole16(guint8 *p, guint16 v) {
+    p[0] = (guint8)(v >> 0);
+    p[1] = (guint8)(v >> 8);
+}
+
 static inline void phtole32(guint8 *p, guint32 v) {
     p[0] = (guint8)(v >> 0);
     p[1] = (guint8)(v >> 8);
@@ -18,6 +18,8 @@
 #include "ws_attributes.h"
 
 #if defined(_MSC_VER)     /* MSVC */
+#include <intrin.h>
+
 static gboolean
 ws_cpuid(guint32 *CPUInfo, guint32 selector)
 {
@@ -27,6 +29,12 @@ ws_cpuid(guint32 *CPUInfo, guint32 selector)
 	return TRUE;
 }
 
+static inline guint64
+ws_xgetbv0(void)
+{
+	return _xgetbv(0);
+}
+
 #elif defined(__GNUC__)  /* GCC/clang */
 
 #if defined(__x86_64__)
@@ -42,6 +50,15 @@ ws_cpuid(guint32 *CPUInfo, int selector)
 							"c" (0));
 	return TRUE;
 }
+
+static inline guint64
+ws_xgetbv0(void)
+{
+	guint32 eax, edx;
+
+	__asm__ __volatile__("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+	return ((guint64)edx << 32) | eax;
+}
 #elif defined(__i386__)
 static gboolean
 ws_cpuid(guint32 *CPUInfo _U_, int selector _U_)
@@ -71,6 +88,12 @@ ws_cpuid(guint32 *CPUInfo _U_, int selector _U_)
 	 */
 	return FALSE;
 }
+
+static inline guint64
+ws_xgetbv0(void)
+{
+	return 0;
+}
 #else /* not x86 */
 static gboolean
 ws_cpuid(guint32 *CPUInfo _U_, int selector _U_)
@@ -78,6 +101,12 @@ ws_cpuid(guint32 *CPUInfo _U_, int selector _U_)
 	/* Not x86, so no cpuid instruction */
 	return FALSE;
 }
+
+static inline guint64
+ws_xgetbv0(void)
+{
+	return 0;
+}
 #endif
 
 #else /* Other compilers */
@@ -87,9 +116,15 @@ ws_cpuid(guint32 *CPUInfo _U_, int selector _U_)
 {
 	return FALSE;
 }
+
+static inline guint64
+ws_xgetbv0(void)
+{
+	return 0;
+}
 #endif
 
-static int
+static inline int
 ws_cpuid_sse42(void)
 {
 	guint32 CPUInfo[4];
@@ -100,3 +135,41 @@ ws_cpuid_sse42(void)
 	/* in ECX bit 20 toggled on */
 	return (CPUInfo[2] & (1 << 20));
 }
+
+static inline int
+ws_cpuid_pclmulqdq(void)
+{
+	guint32 CPUInfo[4];
+
+	if (!ws_cpuid(CPUInfo, 1))
+		return 0;
+
+	/* in ECX bit 1 toggled on */
+	return (CPUInfo[2] & (1 << 1));
+}
+
+static inline int
+ws_cpuid_avx2(void)
+{
+	guint32 CPUInfo[4];
+
+	if (!ws_cpuid(CPUInfo, 0) || CPUInfo[0] < 7)
+		return 0;
+
+	if (!ws_cpuid(CPUInfo, 1))
+		return 0;
+
+	/* in ECX bit 27 (OSXSAVE) and bit 28 (AVX) toggled on */
+	if ((CPUInfo[2] & (3U << 27)) != (3U << 27))
+		return 0;
+
+	/* and the OS saves the XMM and YMM registers */
+	if ((ws_xgetbv0() & 0x6) != 0x6)
+		return 0;
+
+	if (!ws_cpuid(CPUInfo, 7))
+		return 0;
+
+	/* in EBX bit 5 toggled on */
+	return (CPUInfo[1] & (1 << 5));
+}
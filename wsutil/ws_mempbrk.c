@@ -22,23 +22,59 @@
 #endif
 #endif
 
+#include <string.h>
+
 #include <glib.h>
 #include "ws_symbol_export.h"
 #include "ws_mempbrk.h"
 #include "ws_mempbrk_int.h"
+#include "ws_memsearch_int.h"
+
+/*
+ * Set up the nibble tables used by the AVX2 and NEON searches: give each
+ * distinct high nibble of the needles its own bit, set that bit in
+ * nibble_hi for the high nibble and in nibble_lo for the low nibble of
+ * each needle with that high nibble.  Returns FALSE if there are too
+ * many distinct high nibbles for that.
+ */
+static gboolean
+ws_mempbrk_compile_nibbles(ws_mempbrk_pattern* pattern, const gchar *needles)
+{
+    const gchar *n;
+    guint8 hi, lo;
+    guint next_bit = 0;
+
+    memset(pattern->nibble_lo, 0, sizeof pattern->nibble_lo);
+    memset(pattern->nibble_hi, 0, sizeof pattern->nibble_hi);
+
+    for (n = needles; *n; n++) {
+        hi = (guint8)*n >> 4;
+        lo = (guint8)*n & 0x0f;
+        if (pattern->nibble_hi[hi] == 0) {
+            if (next_bit == 8)
+                return FALSE;
+            pattern->nibble_hi[hi] = (guint8)(1 << next_bit++);
+        }
+        pattern->nibble_lo[lo] |= pattern->nibble_hi[hi];
+    }
+    return next_bit != 0;
+}
 
 void
 ws_mempbrk_compile(ws_mempbrk_pattern* pattern, const gchar *needles)
 {
     const gchar *n = needles;
     while (*n) {
-        pattern->patt[(int)*n] = 1;
+        pattern->patt[(guint8)*n] = 1;
         n++;
     }
 
 #ifdef HAVE_SSE4_2
     ws_mempbrk_sse42_compile(pattern, needles);
 #endif
+
+    pattern->use_simd = ws_memsearch_use_simd() &&
+        ws_mempbrk_compile_nibbles(pattern, needles);
 }
 
 
@@ -63,6 +99,14 @@ ws_mempbrk_portable_exec(const guint8* haystack, size_t haystacklen, const ws_me
 WS_DLL_PUBLIC const guint8 *
 ws_mempbrk_exec(const guint8* haystack, size_t haystacklen, const ws_mempbrk_pattern* pattern, guchar *found_needle)
 {
+#if defined(HAVE_AVX2)
+    if (haystacklen >= 32 && pattern->use_simd)
+        return ws_mempbrk_avx2_exec(haystack, haystacklen, pattern, found_needle);
+#elif defined(HAVE_NEON)
+    if (haystacklen >= 16 && pattern->use_simd)
+        return ws_mempbrk_neon_exec(haystack, haystacklen, pattern, found_needle);
+#endif
+
 #ifdef HAVE_SSE4_2
     if (haystacklen >= 16 && pattern->use_sse42)
         return ws_mempbrk_sse42_exec(haystack, haystacklen, pattern, found_needle);
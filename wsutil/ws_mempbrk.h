@@ -24,6 +24,12 @@ typedef struct {
     gboolean use_sse42;
     __m128i mask;
 #endif
+    /* For the AVX2 and NEON searches: byte b is a needle iff
+     * (nibble_lo[b & 0x0f] & nibble_hi[b >> 4]) != 0, which can be
+     * set up if the needles have at most 8 distinct high nibbles. */
+    gboolean use_simd;
+    guint8 nibble_lo[16];
+    guint8 nibble_hi[16];
 } ws_mempbrk_pattern;
 
 /** Compile the pattern for the needles to find using ws_mempbrk_exec().
@@ -0,0 +1,105 @@
+/* ws_memsearch.c
+ * Byte and substring search, using SIMD instructions where available
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#ifdef HAVE_AVX2
+#include "ws_cpuid.h"
+#endif
+#include "ws_memsearch.h"
+#include "ws_memsearch_int.h"
+
+gboolean
+ws_memsearch_use_simd(void)
+{
+#if defined(HAVE_AVX2)
+	static int use_avx2 = -1;
+
+	if (use_avx2 == -1)
+		use_avx2 = ws_cpuid_avx2() ? 1 : 0;
+	return use_avx2;
+#elif defined(HAVE_NEON)
+	/* NEON is always there on 64-bit ARM. */
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+const guint8 *
+ws_memchr(const guint8 *haystack, size_t haystacklen, guint8 needle)
+{
+#if defined(HAVE_AVX2)
+	if (haystacklen >= 32 && ws_memsearch_use_simd())
+		return ws_memchr_avx2(haystack, haystacklen, needle);
+#elif defined(HAVE_NEON)
+	if (haystacklen >= 16)
+		return ws_memchr_neon(haystack, haystacklen, needle);
+#endif
+
+	return (const guint8 *)memchr(haystack, needle, haystacklen);
+}
+
+/* Algorithm copied from GNU's glibc 2.3.2 memmem() under LGPL 2.1+ */
+const guint8 *
+ws_memmem_portable(const guint8 *haystack, size_t haystacklen,
+    const guint8 *needle, size_t needlelen)
+{
+	const guint8 *begin;
+	const guint8 *last_possible;
+
+	if (needlelen == 0 || needlelen > haystacklen)
+		return NULL;
+
+	last_possible = haystack + haystacklen - needlelen;
+	for (begin = haystack; begin <= last_possible; ++begin) {
+		if (begin[0] == needle[0] &&
+		    !memcmp(&begin[1], needle + 1, needlelen - 1))
+			return begin;
+	}
+
+	return NULL;
+}
+
+const guint8 *
+ws_memmem(const guint8 *haystack, size_t haystacklen,
+    const guint8 *needle, size_t needlelen)
+{
+	if (needlelen == 0 || needlelen > haystacklen)
+		return NULL;
+	if (needlelen == 1)
+		return ws_memchr(haystack, haystacklen, needle[0]);
+
+#if defined(HAVE_AVX2)
+	if (haystacklen >= 32 + needlelen && ws_memsearch_use_simd())
+		return ws_memmem_avx2(haystack, haystacklen, needle, needlelen);
+#elif defined(HAVE_NEON)
+	if (haystacklen >= 16 + needlelen)
+		return ws_memmem_neon(haystack, haystacklen, needle, needlelen);
+#endif
+
+	return ws_memmem_portable(haystack, haystacklen, needle, needlelen);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
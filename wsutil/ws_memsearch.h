@@ -0,0 +1,58 @@
+/* ws_memsearch.h
+ * Byte and substring search, using SIMD instructions where available
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __WS_MEMSEARCH_H__
+#define __WS_MEMSEARCH_H__
+
+#include "ws_symbol_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** Find the first occurrence of a byte in a buffer.
+ *
+ * @param haystack The buffer to search.
+ * @param haystacklen The length of the buffer.
+ * @param needle The byte to search for.
+ * @return A pointer to the first occurrence of needle, or NULL if it
+ * doesn't occur.
+ */
+WS_DLL_PUBLIC const guint8 *ws_memchr(const guint8 *haystack, size_t haystacklen, guint8 needle);
+
+/** Find the first occurrence of a byte string in a buffer.
+ *
+ * @param haystack The buffer to search.
+ * @param haystacklen The length of the buffer.
+ * @param needle The byte string to search for.
+ * @param needlelen The length of the byte string.
+ * @return A pointer to the first occurrence of needle, or NULL if it
+ * doesn't occur or if needlelen is 0.
+ */
+WS_DLL_PUBLIC const guint8 *ws_memmem(const guint8 *haystack, size_t haystacklen, const guint8 *needle, size_t needlelen);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __WS_MEMSEARCH_H__ */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
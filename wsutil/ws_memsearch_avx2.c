@@ -0,0 +1,137 @@
+/* ws_memsearch_avx2.c
+ * Byte, byte set and substring search with AVX2 intrinsics
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#ifdef HAVE_AVX2
+
+#include <string.h>
+
+#include <glib.h>
+#include <immintrin.h>
+
+#include "bits_ctz.h"
+#include "ws_mempbrk.h"
+#include "ws_mempbrk_int.h"
+#include "ws_memsearch_int.h"
+
+#define cast_256__m256i(p) ((const __m256i *) (const void *) (p))
+#define cast_128__m128i(p) ((const __m128i *) (const void *) (p))
+
+/*
+ * All of these look at 32 bytes at a time, with unaligned loads, and
+ * leave whatever's left at the end to the portable code.
+ */
+
+const guint8 *
+ws_memchr_avx2(const guint8 *haystack, size_t haystacklen, guint8 needle)
+{
+	const guint8 *p = haystack;
+	const guint8 *end = haystack + haystacklen;
+	const __m256i vneedle = _mm256_set1_epi8((char)needle);
+	__m256i block;
+	guint32 mask;
+
+	while (end - p >= 32) {
+		block = _mm256_loadu_si256(cast_256__m256i(p));
+		mask = (guint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, vneedle));
+		if (mask != 0)
+			return p + ws_ctz(mask);
+		p += 32;
+	}
+
+	return (const guint8 *)memchr(p, needle, end - p);
+}
+
+/*
+ * Look for the first and last bytes of the needle at the right distance
+ * from each other, 32 positions at a time, and compare the rest only
+ * where both match.
+ */
+const guint8 *
+ws_memmem_avx2(const guint8 *haystack, size_t haystacklen,
+    const guint8 *needle, size_t needlelen)
+{
+	const __m256i first = _mm256_set1_epi8((char)needle[0]);
+	const __m256i last = _mm256_set1_epi8((char)needle[needlelen - 1]);
+	__m256i block_first, block_last;
+	size_t i;
+	guint32 mask;
+	int bit;
+
+	for (i = 0; i + needlelen - 1 + 32 <= haystacklen; i += 32) {
+		block_first = _mm256_loadu_si256(cast_256__m256i(haystack + i));
+		block_last = _mm256_loadu_si256(cast_256__m256i(haystack + i + needlelen - 1));
+		mask = (guint32)_mm256_movemask_epi8(_mm256_and_si256(
+		    _mm256_cmpeq_epi8(block_first, first),
+		    _mm256_cmpeq_epi8(block_last, last)));
+		while (mask != 0) {
+			bit = ws_ctz(mask);
+			if (memcmp(haystack + i + bit + 1, needle + 1, needlelen - 2) == 0)
+				return haystack + i + bit;
+			mask &= mask - 1;
+		}
+	}
+
+	return ws_memmem_portable(haystack + i, haystacklen - i, needle, needlelen);
+}
+
+/*
+ * Look up the low and high nibble of each byte in the pattern's tables;
+ * the byte is a needle iff the results have a bit in common.
+ */
+const guint8 *
+ws_mempbrk_avx2_exec(const guint8 *haystack, size_t haystacklen,
+    const ws_mempbrk_pattern *pattern, guchar *found_needle)
+{
+	const guint8 *p = haystack;
+	const guint8 *end = haystack + haystacklen;
+	const __m256i nibble_lo = _mm256_broadcastsi128_si256(
+	    _mm_loadu_si128(cast_128__m128i(pattern->nibble_lo)));
+	const __m256i nibble_hi = _mm256_broadcastsi128_si256(
+	    _mm_loadu_si128(cast_128__m128i(pattern->nibble_hi)));
+	const __m256i low_bits = _mm256_set1_epi8(0x0f);
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i block, lo, hi, matches;
+	guint32 mask;
+
+	while (end - p >= 32) {
+		block = _mm256_loadu_si256(cast_256__m256i(p));
+		lo = _mm256_and_si256(block, low_bits);
+		hi = _mm256_and_si256(_mm256_srli_epi16(block, 4), low_bits);
+		matches = _mm256_and_si256(_mm256_shuffle_epi8(nibble_lo, lo),
+		    _mm256_shuffle_epi8(nibble_hi, hi));
+		mask = ~(guint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(matches, zero));
+		if (mask != 0) {
+			p += ws_ctz(mask);
+			if (found_needle)
+				*found_needle = *p;
+			return p;
+		}
+		p += 32;
+	}
+
+	return ws_mempbrk_portable_exec(p, end - p, pattern, found_needle);
+}
+
+#endif /* HAVE_AVX2 */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
@@ -0,0 +1,170 @@
+/* ws_memsearch_bench.c
+ * Standalone program to compare the byte, byte set and substring
+ * searches in ws_memsearch.c and ws_mempbrk.c with plain C loops, on
+ * payloads like those of text protocols.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "ws_mempbrk.h"
+#include "ws_memsearch.h"
+
+#define ITERATIONS 2000
+
+static gboolean failed = FALSE;
+
+/* An HTTP response: a header block with short lines, then a long body. */
+static guint8 *
+make_http_payload(size_t *len)
+{
+	GString *payload = g_string_new(
+	    "HTTP/1.1 200 OK\r\n"
+	    "Date: Mon, 27 Jul 2009 12:28:53 GMT\r\n"
+	    "Server: Apache/2.2.14 (Win32)\r\n"
+	    "Last-Modified: Wed, 22 Jul 2009 19:15:56 GMT\r\n"
+	    "Content-Type: text/html; charset=\"utf-8\"\r\n"
+	    "Connection: keep-alive\r\n"
+	    "\r\n");
+	int i;
+
+	for (i = 0; i < 2000; i++)
+		g_string_append(payload, "<p>Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor.</p>\n");
+	g_string_append(payload, "--boundary--\r\n");
+
+	*len = payload->len;
+	return (guint8 *)g_string_free(payload, FALSE);
+}
+
+static const guint8 *
+plain_memchr(const guint8 *haystack, size_t haystacklen, guint8 needle)
+{
+	size_t i;
+
+	for (i = 0; i < haystacklen; i++) {
+		if (haystack[i] == needle)
+			return haystack + i;
+	}
+	return NULL;
+}
+
+static const guint8 *
+plain_mempbrk(const guint8 *haystack, size_t haystacklen, const char *needles)
+{
+	size_t i;
+
+	for (i = 0; i < haystacklen; i++) {
+		if (haystack[i] != '\0' && strchr(needles, haystack[i]) != NULL)
+			return haystack + i;
+	}
+	return NULL;
+}
+
+static const guint8 *
+plain_memmem(const guint8 *haystack, size_t haystacklen,
+    const guint8 *needle, size_t needlelen)
+{
+	size_t i;
+
+	for (i = 0; i + needlelen <= haystacklen; i++) {
+		if (memcmp(haystack + i, needle, needlelen) == 0)
+			return haystack + i;
+	}
+	return NULL;
+}
+
+static void
+report(const char *what, gint64 plain, gint64 fast, gboolean same)
+{
+	printf("%-32s plain %8" G_GINT64_FORMAT " us  ws %8" G_GINT64_FORMAT " us%s\n",
+	    what, plain, fast, same ? "" : "  MISMATCH");
+	if (!same)
+		failed = TRUE;
+}
+
+int
+main(void)
+{
+	size_t len, offset;
+	guint8 *payload;
+	ws_mempbrk_pattern crlf;
+	const guint8 *plain_result = NULL, *fast_result = NULL;
+	guint plain_lines, fast_lines;
+	gint64 start, plain_time, fast_time;
+	int i;
+	static const guint8 boundary[] = "--boundary--";
+
+	payload = make_http_payload(&len);
+	memset(&crlf, 0, sizeof crlf);
+	ws_mempbrk_compile(&crlf, "\r\n");
+
+	/* Single byte: the NUL that isn't there, so the whole body is scanned. */
+	start = g_get_monotonic_time();
+	for (i = 0; i < ITERATIONS; i++)
+		plain_result = plain_memchr(payload, len, '\0');
+	plain_time = g_get_monotonic_time() - start;
+	start = g_get_monotonic_time();
+	for (i = 0; i < ITERATIONS; i++)
+		fast_result = ws_memchr(payload, len, '\0');
+	fast_time = g_get_monotonic_time() - start;
+	report("byte (absent)", plain_time, fast_time, plain_result == fast_result);
+
+	/* Byte set: split into lines, as tvb_find_line_end() does. */
+	start = g_get_monotonic_time();
+	for (i = 0, plain_lines = 0; i < ITERATIONS / 10; i++) {
+		for (offset = 0; offset < len; offset = plain_result - payload + 1, plain_lines++) {
+			plain_result = plain_mempbrk(payload + offset, len - offset, "\r\n");
+			if (plain_result == NULL)
+				break;
+		}
+	}
+	plain_time = g_get_monotonic_time() - start;
+	start = g_get_monotonic_time();
+	for (i = 0, fast_lines = 0; i < ITERATIONS / 10; i++) {
+		for (offset = 0; offset < len; offset = fast_result - payload + 1, fast_lines++) {
+			fast_result = ws_mempbrk_exec(payload + offset, len - offset, &crlf, NULL);
+			if (fast_result == NULL)
+				break;
+		}
+	}
+	fast_time = g_get_monotonic_time() - start;
+	report("CR/LF (line splitting)", plain_time, fast_time, plain_lines == fast_lines);
+
+	/* Substring: the closing boundary at the end of the body. */
+	start = g_get_monotonic_time();
+	for (i = 0; i < ITERATIONS; i++)
+		plain_result = plain_memmem(payload, len, boundary, sizeof boundary - 1);
+	plain_time = g_get_monotonic_time() - start;
+	start = g_get_monotonic_time();
+	for (i = 0; i < ITERATIONS; i++)
+		fast_result = ws_memmem(payload, len, boundary, sizeof boundary - 1);
+	fast_time = g_get_monotonic_time() - start;
+	report("substring (boundary)", plain_time, fast_time, plain_result == fast_result);
+
+	g_free(payload);
+	return failed ? 1 : 0;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
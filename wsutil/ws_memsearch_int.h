@@ -0,0 +1,32 @@
+/* ws_memsearch_int.h
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __WS_MEMSEARCH_INT_H__
+#define __WS_MEMSEARCH_INT_H__
+
+#include "ws_mempbrk.h"
+
+/* TRUE if the AVX2 or NEON kernels below can be used on this machine. */
+gboolean ws_memsearch_use_simd(void);
+
+const guint8 *ws_memmem_portable(const guint8 *haystack, size_t haystacklen, const guint8 *needle, size_t needlelen);
+
+#ifdef HAVE_AVX2
+const guint8 *ws_memchr_avx2(const guint8 *haystack, size_t haystacklen, guint8 needle);
+const guint8 *ws_memmem_avx2(const guint8 *haystack, size_t haystacklen, const guint8 *needle, size_t needlelen);
+const guint8 *ws_mempbrk_avx2_exec(const guint8 *haystack, size_t haystacklen, const ws_mempbrk_pattern *pattern, guchar *found_needle);
+#endif
+
+#ifdef HAVE_NEON
+const guint8 *ws_memchr_neon(const guint8 *haystack, size_t haystacklen, guint8 needle);
+const guint8 *ws_memmem_neon(const guint8 *haystack, size_t haystacklen, const guint8 *needle, size_t needlelen);
+const guint8 *ws_mempbrk_neon_exec(const guint8 *haystack, size_t haystacklen, const ws_mempbrk_pattern *pattern, guchar *found_needle);
+#endif
+
+#endif /* __WS_MEMSEARCH_INT_H__ */
@@ -0,0 +1,121 @@
+/* ws_memsearch_neon.c
+ * Byte, byte set and substring search with NEON intrinsics
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#ifdef HAVE_NEON
+
+#include <string.h>
+
+#include <glib.h>
+#include <arm_neon.h>
+
+#include "ws_mempbrk.h"
+#include "ws_mempbrk_int.h"
+#include "ws_memsearch_int.h"
+
+/*
+ * All of these look at 16 bytes at a time.  NEON has no equivalent of
+ * SSE's movemask, so once a block is known to contain a match the
+ * position is found with a scalar scan of that block.  Whatever's left
+ * at the end is left to the portable code.
+ */
+
+const guint8 *
+ws_memchr_neon(const guint8 *haystack, size_t haystacklen, guint8 needle)
+{
+	const guint8 *p = haystack;
+	const guint8 *end = haystack + haystacklen;
+	const uint8x16_t vneedle = vdupq_n_u8(needle);
+
+	while (end - p >= 16) {
+		if (vmaxvq_u8(vceqq_u8(vld1q_u8(p), vneedle)) != 0)
+			return (const guint8 *)memchr(p, needle, 16);
+		p += 16;
+	}
+
+	return (const guint8 *)memchr(p, needle, end - p);
+}
+
+/*
+ * Look for the first and last bytes of the needle at the right distance
+ * from each other, 16 positions at a time, and compare the rest only
+ * where both match.
+ */
+const guint8 *
+ws_memmem_neon(const guint8 *haystack, size_t haystacklen,
+    const guint8 *needle, size_t needlelen)
+{
+	const uint8x16_t first = vdupq_n_u8(needle[0]);
+	const uint8x16_t last = vdupq_n_u8(needle[needlelen - 1]);
+	guint8 matches[16];
+	size_t i;
+	int j;
+
+	for (i = 0; i + needlelen - 1 + 16 <= haystacklen; i += 16) {
+		uint8x16_t both = vandq_u8(
+		    vceqq_u8(vld1q_u8(haystack + i), first),
+		    vceqq_u8(vld1q_u8(haystack + i + needlelen - 1), last));
+
+		if (vmaxvq_u8(both) == 0)
+			continue;
+		vst1q_u8(matches, both);
+		for (j = 0; j < 16; j++) {
+			if (matches[j] != 0 &&
+			    memcmp(haystack + i + j + 1, needle + 1, needlelen - 2) == 0)
+				return haystack + i + j;
+		}
+	}
+
+	return ws_memmem_portable(haystack + i, haystacklen - i, needle, needlelen);
+}
+
+/*
+ * Look up the low and high nibble of each byte in the pattern's tables;
+ * the byte is a needle iff the results have a bit in common.
+ */
+const guint8 *
+ws_mempbrk_neon_exec(const guint8 *haystack, size_t haystacklen,
+    const ws_mempbrk_pattern *pattern, guchar *found_needle)
+{
+	const guint8 *p = haystack;
+	const guint8 *end = haystack + haystacklen;
+	const uint8x16_t nibble_lo = vld1q_u8(pattern->nibble_lo);
+	const uint8x16_t nibble_hi = vld1q_u8(pattern->nibble_hi);
+	const uint8x16_t low_bits = vdupq_n_u8(0x0f);
+
+	while (end - p >= 16) {
+		uint8x16_t block = vld1q_u8(p);
+		uint8x16_t matches = vandq_u8(
+		    vqtbl1q_u8(nibble_lo, vandq_u8(block, low_bits)),
+		    vqtbl1q_u8(nibble_hi, vshrq_n_u8(block, 4)));
+
+		if (vmaxvq_u8(matches) != 0)
+			return ws_mempbrk_portable_exec(p, 16, pattern, found_needle);
+		p += 16;
+	}
+
+	return ws_mempbrk_portable_exec(p, end - p, pattern, found_needle);
+}
+
+#endif /* HAVE_NEON */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */